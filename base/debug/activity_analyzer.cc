@@ -16,6 +16,8 @@
 #include "base/metrics/histogram_macros.h"
 #include "base/stl_util.h"
 #include "base/strings/string_util.h"
+#include "base/sys_info.h"
+#include "base/threading/simple_thread.h"
 
 namespace base {
 namespace debug {
@@ -39,6 +41,99 @@ void LogAnalyzerCreationError(AnalyzerCreationError error) {
                             error, kAnalyzerCreationErrorMax);
 }
 
+#if !defined(OS_NACL)
+// Maps the file at |file_path| with |access| and returns a read-only allocator
+// for its contents, or null if the file can't be used.
+std::unique_ptr<PersistentMemoryAllocator> CreateFileAllocator(
+    const FilePath& file_path,
+    MemoryMappedFile::Access access) {
+  std::unique_ptr<MemoryMappedFile> mmfile(new MemoryMappedFile());
+  mmfile->Initialize(file_path, access);
+  if (!mmfile->IsValid()) {
+    LogAnalyzerCreationError(kInvalidMemoryMappedFile);
+    return nullptr;
+  }
+
+  if (!FilePersistentMemoryAllocator::IsFileAcceptable(*mmfile, true)) {
+    LogAnalyzerCreationError(kPmaBadFile);
+    return nullptr;
+  }
+
+  return std::make_unique<FilePersistentMemoryAllocator>(
+      std::move(mmfile), 0, 0, StringPiece(), /*readonly=*/true);
+}
+#endif  // !defined(OS_NACL)
+
+// The analyzers of offline trackers are created on several threads, each of
+// which gets at least this many trackers.
+constexpr size_t kMinTrackersPerThread = 64;
+constexpr int kMaxAnalysisThreads = 16;
+
+// Creates the analyzer for the tracker at |ref|, or returns null if it is not
+// a valid tracker.
+std::unique_ptr<ThreadActivityAnalyzer> CreateThreadAnalyzer(
+    PersistentMemoryAllocator* allocator,
+    GlobalActivityAnalyzer* global,
+    PersistentMemoryAllocator::Reference ref) {
+  void* const base = allocator->GetAsArray<char>(
+      ref, GlobalActivityTracker::kTypeIdActivityTracker,
+      PersistentMemoryAllocator::kSizeAny);
+  if (!base)
+    return nullptr;
+
+  // A tracker which was never initialized holds nothing, and creating the
+  // analyzer would initialize it.
+  int64_t process_id;
+  int64_t create_stamp;
+  if (!ThreadActivityTracker::GetOwningProcessId(base, &process_id,
+                                                 &create_stamp)) {
+    return nullptr;
+  }
+
+  // Create the analyzer on the data. This will capture a snapshot of the
+  // tracker state. This can fail if the tracker is somehow corrupted or is in
+  // the process of shutting down.
+  std::unique_ptr<ThreadActivityAnalyzer> analyzer(
+      new ThreadActivityAnalyzer(base, allocator->GetAllocSize(ref)));
+  if (!analyzer->IsValid())
+    return nullptr;
+  analyzer->AddGlobalInformation(global);
+  return analyzer;
+}
+
+// Creates the analyzers of a range of trackers on a thread of a pool.
+class ThreadAnalyzerCreator : public DelegateSimpleThread::Delegate {
+ public:
+  ThreadAnalyzerCreator(
+      PersistentMemoryAllocator* allocator,
+      GlobalActivityAnalyzer* global,
+      const std::vector<PersistentMemoryAllocator::Reference>* refs,
+      size_t begin,
+      size_t end,
+      std::vector<std::unique_ptr<ThreadActivityAnalyzer>>* analyzers)
+      : allocator_(allocator),
+        global_(global),
+        refs_(refs),
+        begin_(begin),
+        end_(end),
+        analyzers_(analyzers) {}
+
+  void Run() override {
+    for (size_t i = begin_; i < end_; ++i)
+      (*analyzers_)[i] = CreateThreadAnalyzer(allocator_, global_, (*refs_)[i]);
+  }
+
+ private:
+  PersistentMemoryAllocator* const allocator_;
+  GlobalActivityAnalyzer* const global_;
+  const std::vector<PersistentMemoryAllocator::Reference>* const refs_;
+  const size_t begin_;
+  const size_t end_;
+  std::vector<std::unique_ptr<ThreadActivityAnalyzer>>* const analyzers_;
+
+  DISALLOW_COPY_AND_ASSIGN(ThreadAnalyzerCreator);
+};
+
 }  // namespace
 
 ThreadActivityAnalyzer::Snapshot::Snapshot() = default;
@@ -117,20 +212,25 @@ std::unique_ptr<GlobalActivityAnalyzer> GlobalActivityAnalyzer::CreateWithFile(
     const FilePath& file_path) {
   // Map the file read-write so it can guarantee consistency between
   // the analyzer and any trackers that my still be active.
-  std::unique_ptr<MemoryMappedFile> mmfile(new MemoryMappedFile());
-  mmfile->Initialize(file_path, MemoryMappedFile::READ_WRITE);
-  if (!mmfile->IsValid()) {
-    LogAnalyzerCreationError(kInvalidMemoryMappedFile);
+  std::unique_ptr<PersistentMemoryAllocator> allocator =
+      CreateFileAllocator(file_path, MemoryMappedFile::READ_WRITE);
+  if (!allocator)
     return nullptr;
-  }
+  return CreateWithAllocator(std::move(allocator));
+}
 
-  if (!FilePersistentMemoryAllocator::IsFileAcceptable(*mmfile, true)) {
-    LogAnalyzerCreationError(kPmaBadFile);
+// static
+std::unique_ptr<GlobalActivityAnalyzer>
+GlobalActivityAnalyzer::CreateWithOfflineFile(const FilePath& file_path) {
+  std::unique_ptr<PersistentMemoryAllocator> allocator =
+      CreateFileAllocator(file_path, MemoryMappedFile::READ_ONLY);
+  if (!allocator)
     return nullptr;
-  }
-
-  return CreateWithAllocator(std::make_unique<FilePersistentMemoryAllocator>(
-      std::move(mmfile), 0, 0, StringPiece(), /*readonly=*/true));
+  std::unique_ptr<GlobalActivityAnalyzer> analyzer =
+      CreateWithAllocator(std::move(allocator));
+  if (analyzer)
+    analyzer->offline_ = true;
+  return analyzer;
 }
 #endif  // !defined(OS_NACL)
 
@@ -214,12 +314,15 @@ ActivityUserData::Snapshot GlobalActivityAnalyzer::GetUserDataSnapshot(
   void* memory = allocator_->GetAsArray<char>(
       ref, GlobalActivityTracker::kTypeIdUserDataRecord,
       PersistentMemoryAllocator::kSizeAny);
-  if (memory) {
+  int64_t process_id;
+  int64_t create_stamp;
+  // A record which was never initialized holds nothing, and creating the
+  // ActivityUserData would initialize it.
+  if (memory && ActivityUserData::GetOwningProcessId(memory, &process_id,
+                                                     &create_stamp)) {
     size_t size = allocator_->GetAllocSize(ref);
     const ActivityUserData user_data(memory, size);
     user_data.CreateSnapshot(&snapshot);
-    int64_t process_id;
-    int64_t create_stamp;
     if (!ActivityUserData::GetOwningProcessId(memory, &process_id,
                                               &create_stamp) ||
         process_id != pid || user_data.id() != id) {
@@ -333,74 +436,83 @@ void GlobalActivityAnalyzer::PrepareAllAnalyzers() {
   process_ids_.clear();
   std::set<int64_t> seen_pids;
 
+  // Create the analyzers of all the trackers first, so that the snapshots of
+  // their threads are taken together.
+  std::vector<PersistentMemoryAllocator::Reference> tracker_refs;
+  for (PersistentMemoryAllocator::Reference memory_ref : memory_references_) {
+    if (allocator_->GetType(memory_ref) ==
+        GlobalActivityTracker::kTypeIdActivityTracker) {
+      tracker_refs.push_back(memory_ref);
+    }
+  }
+  std::vector<std::unique_ptr<ThreadActivityAnalyzer>> tracker_analyzers =
+      CreateThreadAnalyzers(tracker_refs);
+
   // Go through all the known references and create objects for them with
   // snapshots of the current state.
+  size_t tracker_index = 0;
   for (PersistentMemoryAllocator::Reference memory_ref : memory_references_) {
-    // Get the actual data segment for the tracker. Any type will do since it
-    // is checked below.
+    if (tracker_index < tracker_refs.size() &&
+        tracker_refs[tracker_index] == memory_ref) {
+      std::unique_ptr<ThreadActivityAnalyzer> analyzer =
+          std::move(tracker_analyzers[tracker_index++]);
+      if (!analyzer)
+        continue;
+
+      // Track PIDs.
+      int64_t pid = analyzer->GetProcessId();
+      if (seen_pids.find(pid) == seen_pids.end()) {
+        process_ids_.push_back(pid);
+        seen_pids.insert(pid);
+      }
+
+      // Add this analyzer to the map of known ones, indexed by a unique
+      // thread identifier.
+      DCHECK(!base::ContainsKey(analyzers_, analyzer->GetThreadKey()));
+      analyzer->allocator_reference_ = memory_ref;
+      analyzers_[analyzer->GetThreadKey()] = std::move(analyzer);
+      continue;
+    }
+
+    // Get the actual data segment for the process data.
     void* const base = allocator_->GetAsArray<char>(
-        memory_ref, PersistentMemoryAllocator::kTypeIdAny,
+        memory_ref, GlobalActivityTracker::kTypeIdProcessDataRecord,
         PersistentMemoryAllocator::kSizeAny);
     const size_t size = allocator_->GetAllocSize(memory_ref);
     if (!base)
       continue;
 
-    switch (allocator_->GetType(memory_ref)) {
-      case GlobalActivityTracker::kTypeIdActivityTracker: {
-        // Create the analyzer on the data. This will capture a snapshot of the
-        // tracker state. This can fail if the tracker is somehow corrupted or
-        // is in the process of shutting down.
-        std::unique_ptr<ThreadActivityAnalyzer> analyzer(
-            new ThreadActivityAnalyzer(base, size));
-        if (!analyzer->IsValid())
-          continue;
-        analyzer->AddGlobalInformation(this);
-
-        // Track PIDs.
-        int64_t pid = analyzer->GetProcessId();
-        if (seen_pids.find(pid) == seen_pids.end()) {
-          process_ids_.push_back(pid);
-          seen_pids.insert(pid);
-        }
-
-        // Add this analyzer to the map of known ones, indexed by a unique
-        // thread
-        // identifier.
-        DCHECK(!base::ContainsKey(analyzers_, analyzer->GetThreadKey()));
-        analyzer->allocator_reference_ = ref;
-        analyzers_[analyzer->GetThreadKey()] = std::move(analyzer);
-      } break;
-
-      case GlobalActivityTracker::kTypeIdProcessDataRecord: {
-        // Get the PID associated with this data record.
-        int64_t process_id;
-        int64_t create_stamp;
-        ActivityUserData::GetOwningProcessId(base, &process_id, &create_stamp);
-        DCHECK(!base::ContainsKey(process_data_, process_id));
-
-        // Create a snapshot of the data. This can fail if the data is somehow
-        // corrupted or the process shutdown and the memory being released.
-        UserDataSnapshot& snapshot = process_data_[process_id];
-        snapshot.process_id = process_id;
-        snapshot.create_stamp = create_stamp;
-        const ActivityUserData process_data(base, size);
-        if (!process_data.CreateSnapshot(&snapshot.data))
-          break;
-
-        // Check that nothing changed. If it did, forget what was recorded.
-        ActivityUserData::GetOwningProcessId(base, &process_id, &create_stamp);
-        if (process_id != snapshot.process_id ||
-            create_stamp != snapshot.create_stamp) {
-          process_data_.erase(process_id);
-          break;
-        }
-
-        // Track PIDs.
-        if (seen_pids.find(process_id) == seen_pids.end()) {
-          process_ids_.push_back(process_id);
-          seen_pids.insert(process_id);
-        }
-      } break;
+    // Get the PID associated with this data record. A record which was never
+    // initialized holds nothing.
+    int64_t process_id;
+    int64_t create_stamp;
+    if (!ActivityUserData::GetOwningProcessId(base, &process_id,
+                                              &create_stamp)) {
+      continue;
+    }
+    DCHECK(!base::ContainsKey(process_data_, process_id));
+
+    // Create a snapshot of the data. This can fail if the data is somehow
+    // corrupted or the process shutdown and the memory being released.
+    UserDataSnapshot& snapshot = process_data_[process_id];
+    snapshot.process_id = process_id;
+    snapshot.create_stamp = create_stamp;
+    const ActivityUserData process_data(base, size);
+    if (!process_data.CreateSnapshot(&snapshot.data))
+      continue;
+
+    // Check that nothing changed. If it did, forget what was recorded.
+    ActivityUserData::GetOwningProcessId(base, &process_id, &create_stamp);
+    if (process_id != snapshot.process_id ||
+        create_stamp != snapshot.create_stamp) {
+      process_data_.erase(process_id);
+      continue;
+    }
+
+    // Track PIDs.
+    if (seen_pids.find(process_id) == seen_pids.end()) {
+      process_ids_.push_back(process_id);
+      seen_pids.insert(process_id);
     }
   }
 
@@ -408,5 +520,42 @@ void GlobalActivityAnalyzer::PrepareAllAnalyzers() {
   std::reverse(process_ids_.begin(), process_ids_.end());
 }
 
+std::vector<std::unique_ptr<ThreadActivityAnalyzer>>
+GlobalActivityAnalyzer::CreateThreadAnalyzers(
+    const std::vector<PersistentMemoryAllocator::Reference>& refs) {
+  std::vector<std::unique_ptr<ThreadActivityAnalyzer>> analyzers(refs.size());
+
+  // Nothing changes the memory of an offline system so its snapshots succeed
+  // at the first attempt and can be spread over threads. Those of a live
+  // system are taken one after the other, as they always were.
+  size_t thread_count = 1;
+  if (offline_) {
+    thread_count = std::min(
+        {refs.size() / kMinTrackersPerThread,
+         static_cast<size_t>(SysInfo::NumberOfProcessors()),
+         static_cast<size_t>(kMaxAnalysisThreads)});
+  }
+  if (thread_count <= 1) {
+    for (size_t i = 0; i < refs.size(); ++i)
+      analyzers[i] = CreateThreadAnalyzer(allocator_.get(), this, refs[i]);
+    return analyzers;
+  }
+
+  // Each thread creates the analyzers of a contiguous range of trackers.
+  const size_t per_thread = (refs.size() + thread_count - 1) / thread_count;
+  std::vector<std::unique_ptr<ThreadAnalyzerCreator>> creators;
+  DelegateSimpleThreadPool pool("ActivityAnalyzer",
+                                static_cast<int>(thread_count));
+  for (size_t begin = 0; begin < refs.size(); begin += per_thread) {
+    creators.push_back(std::make_unique<ThreadAnalyzerCreator>(
+        allocator_.get(), this, &refs, begin,
+        std::min(begin + per_thread, refs.size()), &analyzers));
+    pool.AddWork(creators.back().get());
+  }
+  pool.Start();
+  pool.JoinAll();
+  return analyzers;
+}
+
 }  // namespace debug
 }  // namespace base
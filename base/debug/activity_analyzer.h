@@ -146,6 +146,12 @@ class BASE_EXPORT GlobalActivityAnalyzer {
   // |file_path|.
   static std::unique_ptr<GlobalActivityAnalyzer> CreateWithFile(
       const FilePath& file_path);
+
+  // Like above but for a file that nothing writes anymore, such as one left
+  // behind by a process that crashed. The file is mapped read-only and the
+  // threads are snapshotted in parallel when there are many of them.
+  static std::unique_ptr<GlobalActivityAnalyzer> CreateWithOfflineFile(
+      const FilePath& file_path);
 #endif  // !defined(OS_NACL)
 
   // Like above but accesses an allocator in a mapped shared-memory segment.
@@ -225,6 +231,11 @@ class BASE_EXPORT GlobalActivityAnalyzer {
   // Finds, creates, and indexes analyzers for all known processes and threads.
   void PrepareAllAnalyzers();
 
+  // Creates an analyzer, with the global information added, for each tracker
+  // in |refs|. Entries are null for trackers that are not valid.
+  std::vector<std::unique_ptr<ThreadActivityAnalyzer>> CreateThreadAnalyzers(
+      const std::vector<PersistentMemoryAllocator::Reference>& refs);
+
   // The persistent memory allocator holding all tracking data.
   std::unique_ptr<PersistentMemoryAllocator> allocator_;
 
@@ -232,6 +243,10 @@ class BASE_EXPORT GlobalActivityAnalyzer {
   // process IDs that get reused when analyzing a live system.
   int64_t analysis_stamp_;
 
+  // Whether the memory is known not to change anymore, in which case the
+  // analyzers of threads can be created concurrently.
+  bool offline_ = false;
+
   // The iterator for finding tracking information in the allocator.
   PersistentMemoryAllocator::Iterator allocator_iterator_;
 
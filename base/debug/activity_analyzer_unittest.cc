@@ -542,5 +542,64 @@ TEST_F(ActivityAnalyzerTest, GlobalMultiProcess) {
   EXPECT_EQ(2002, pdata2.at("pid").GetInt());
 }
 
+// An offline file holds enough trackers for them to be analyzed on several
+// threads. Each tracker is given a process of its own so that all of them
+// can be created on this thread.
+TEST_F(ActivityAnalyzerTest, GlobalAnalyzerFromOfflineFile) {
+  constexpr int kTrackers = 500;
+  constexpr int64_t kFirstPid = 1000;
+  LocalPersistentMemoryAllocator allocator(kMemorySize, 0, "");
+  const size_t tracker_size = ThreadActivityTracker::SizeForStackDepth(3);
+  std::vector<std::unique_ptr<ThreadActivityTracker>> trackers;
+  for (int i = 0; i < kTrackers; ++i) {
+    PersistentMemoryAllocator::Reference ref = allocator.Allocate(
+        tracker_size, GlobalActivityTracker::kTypeIdActivityTracker);
+    ASSERT_TRUE(ref);
+    allocator.MakeIterable(ref);
+    trackers.push_back(std::make_unique<ThreadActivityTracker>(
+        allocator.GetAsArray<char>(
+            ref, GlobalActivityTracker::kTypeIdActivityTracker, tracker_size),
+        tracker_size));
+    trackers.back()->SetOwningProcessIdForTesting(kFirstPid + i, 0);
+    trackers.back()->PushActivity(nullptr, Activity::ACT_TASK,
+                                  ActivityData::ForTask(i));
+  }
+
+  // A tracker that was never initialized is skipped rather than initialized
+  // in the read-only mapping.
+  PersistentMemoryAllocator::Reference empty_ref = allocator.Allocate(
+      tracker_size, GlobalActivityTracker::kTypeIdActivityTracker);
+  ASSERT_TRUE(empty_ref);
+  allocator.MakeIterable(empty_ref);
+
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  FilePath file_path = temp_dir.GetPath().AppendASCII("offline.pma");
+  ASSERT_EQ(static_cast<int>(allocator.size()),
+            WriteFile(file_path, static_cast<const char*>(allocator.data()),
+                      allocator.size()));
+
+  std::unique_ptr<GlobalActivityAnalyzer> analyzer =
+      GlobalActivityAnalyzer::CreateWithOfflineFile(file_path);
+  ASSERT_TRUE(analyzer);
+
+  // Processes are returned in the order their trackers were found.
+  int64_t pid = analyzer->GetFirstProcess();
+  for (int i = 0; i < kTrackers; ++i) {
+    ASSERT_EQ(kFirstPid + i, pid);
+    ThreadActivityAnalyzer* thread_analyzer = analyzer->GetFirstAnalyzer(pid);
+    ASSERT_TRUE(thread_analyzer);
+    const ThreadActivityAnalyzer::Snapshot& snapshot =
+        thread_analyzer->activity_snapshot();
+    ASSERT_EQ(1U, snapshot.activity_stack.size());
+    EXPECT_EQ(static_cast<uint64_t>(i),
+              snapshot.activity_stack[0].data.task.sequence_id);
+    EXPECT_EQ(1U, snapshot.user_data_stack.size());
+    EXPECT_FALSE(analyzer->GetNextAnalyzer());
+    pid = analyzer->GetNextProcess();
+  }
+  EXPECT_EQ(0, pid);
+}
+
 }  // namespace debug
 }  // namespace base
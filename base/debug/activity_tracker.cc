@@ -847,21 +847,35 @@ void ThreadActivityTracker::PopActivity(ActivityId id) {
   header_->data_version.fetch_add(1, std::memory_order_release);
 }
 
-std::unique_ptr<ActivityUserData> ThreadActivityTracker::GetUserData(
-    ActivityId id,
-    ActivityTrackerMemoryAllocator* allocator) {
+bool ThreadActivityTracker::CanHaveUserData(ActivityId id) {
+  // User-data is only stored for activities actually held in the stack.
+  if (id >= stack_slots_)
+    return false;
+
   // Don't allow user data for lock acquisition as recursion may occur.
   if (stack_[id].activity_type == Activity::ACT_LOCK_ACQUIRE) {
     NOTREACHED();
-    return std::make_unique<ActivityUserData>();
+    return false;
   }
+  return true;
+}
 
-  // User-data is only stored for activities actually held in the stack.
-  if (id >= stack_slots_)
-    return std::make_unique<ActivityUserData>();
+std::unique_ptr<ActivityUserData> ThreadActivityTracker::SetUserData(
+    ActivityId id,
+    PersistentMemoryAllocator::Reference ref,
+    void* memory,
+    size_t size) {
+  DCHECK(CanHaveUserData(id));
+  DCHECK(ref);
+  DCHECK(memory);
+  Activity* activity = &stack_[id];
+  DCHECK_EQ(0U, activity->user_data_ref);
 
-  // Create and return a real UserData object.
-  return CreateUserDataForActivity(&stack_[id], allocator);
+  std::unique_ptr<ActivityUserData> user_data =
+      std::make_unique<ActivityUserData>(memory, size);
+  activity->user_data_ref = ref;
+  activity->user_data_id = user_data->id();
+  return user_data;
 }
 
 bool ThreadActivityTracker::HasUserData(ActivityId id) {
@@ -869,14 +883,14 @@ bool ThreadActivityTracker::HasUserData(ActivityId id) {
   return (id < stack_slots_ && stack_[id].user_data_ref);
 }
 
-void ThreadActivityTracker::ReleaseUserData(
-    ActivityId id,
-    ActivityTrackerMemoryAllocator* allocator) {
+PersistentMemoryAllocator::Reference ThreadActivityTracker::ReleaseUserData(
+    ActivityId id) {
   // User-data is only stored for activities actually held in the stack.
-  if (id < stack_slots_ && stack_[id].user_data_ref) {
-    allocator->ReleaseObjectReference(stack_[id].user_data_ref);
-    stack_[id].user_data_ref = 0;
-  }
+  if (id >= stack_slots_)
+    return PersistentMemoryAllocator::kReferenceNull;
+  PersistentMemoryAllocator::Reference ref = stack_[id].user_data_ref;
+  stack_[id].user_data_ref = 0;
+  return ref;
 }
 
 void ThreadActivityTracker::RecordExceptionActivity(const void* program_counter,
@@ -1055,26 +1069,6 @@ bool ThreadActivityTracker::CalledOnValidThread() {
 #endif
 }
 
-std::unique_ptr<ActivityUserData>
-ThreadActivityTracker::CreateUserDataForActivity(
-    Activity* activity,
-    ActivityTrackerMemoryAllocator* allocator) {
-  DCHECK_EQ(0U, activity->user_data_ref);
-
-  PersistentMemoryAllocator::Reference ref = allocator->GetObjectReference();
-  void* memory = allocator->GetAsArray<char>(ref, kUserDataSize);
-  if (memory) {
-    std::unique_ptr<ActivityUserData> user_data =
-        std::make_unique<ActivityUserData>(memory, kUserDataSize);
-    activity->user_data_ref = ref;
-    activity->user_data_id = user_data->id();
-    return user_data;
-  }
-
-  // Return a dummy object that will still accept (but ignore) Set() calls.
-  return std::make_unique<ActivityUserData>();
-}
-
 // The instantiation of the GlobalActivityTracker object.
 // The object held here will obviously not be destructed at process exit
 // but that's best since PersistentMemoryAllocator objects (that underlie
@@ -1200,21 +1194,20 @@ GlobalActivityTracker::ScopedThreadActivity::ScopedThreadActivity(
                                             type,
                                             data) {}
 
+// The trackers of threads are all created by CreateTrackerForCurrentThread()
+// and so are ManagedActivityTracker objects.
 GlobalActivityTracker::ScopedThreadActivity::~ScopedThreadActivity() {
   if (tracker_ && tracker_->HasUserData(activity_id_)) {
-    GlobalActivityTracker* global = GlobalActivityTracker::Get();
-    AutoLock lock(global->user_data_allocator_lock_);
-    tracker_->ReleaseUserData(activity_id_, &global->user_data_allocator_);
+    GlobalActivityTracker::Get()->ReleaseUserDataForActivity(
+        static_cast<ManagedActivityTracker*>(tracker_), activity_id_);
   }
 }
 
 ActivityUserData& GlobalActivityTracker::ScopedThreadActivity::user_data() {
   if (!user_data_) {
     if (tracker_) {
-      GlobalActivityTracker* global = GlobalActivityTracker::Get();
-      AutoLock lock(global->user_data_allocator_lock_);
-      user_data_ =
-          tracker_->GetUserData(activity_id_, &global->user_data_allocator_);
+      user_data_ = GlobalActivityTracker::Get()->GetUserDataForActivity(
+          static_cast<ManagedActivityTracker*>(tracker_), activity_id_);
     } else {
       user_data_ = std::make_unique<ActivityUserData>();
     }
@@ -1719,6 +1712,59 @@ void GlobalActivityTracker::ReturnTrackerMemory(
   thread_tracker_allocator_.ReleaseObjectReference(mem_reference);
 }
 
+std::unique_ptr<ActivityUserData>
+GlobalActivityTracker::GetUserDataForActivity(
+    ManagedActivityTracker* tracker,
+    ThreadActivityTracker::ActivityId id) {
+  if (!tracker->CanHaveUserData(id))
+    return std::make_unique<ActivityUserData>();
+
+  // A record of the slab can have been taken by a search of the allocator
+  // for free records, in which case its type doesn't change.
+  PersistentMemoryAllocator::Reference ref = 0;
+  while (!ref && tracker->user_data_slab_used_ > 0) {
+    ref = tracker->user_data_slab_[--tracker->user_data_slab_used_];
+    if (!allocator_->ChangeType(ref, kTypeIdUserDataRecord,
+                                kTypeIdUserDataRecordFree, false)) {
+      ref = 0;
+    }
+  }
+  if (!ref) {
+    AutoLock lock(user_data_allocator_lock_);
+    ref = user_data_allocator_.GetObjectReference();
+  }
+
+  void* memory =
+      allocator_->GetAsArray<char>(ref, kTypeIdUserDataRecord, kUserDataSize);
+  if (!memory) {
+    // Return a dummy object that will still accept (but ignore) Set() calls.
+    return std::make_unique<ActivityUserData>();
+  }
+  return tracker->SetUserData(id, ref, memory, kUserDataSize);
+}
+
+void GlobalActivityTracker::ReleaseUserDataForActivity(
+    ManagedActivityTracker* tracker,
+    ThreadActivityTracker::ActivityId id) {
+  PersistentMemoryAllocator::Reference ref = tracker->ReleaseUserData(id);
+  if (!ref)
+    return;
+
+  if (tracker->user_data_slab_used_ < static_cast<size_t>(kUserDataSlabSize)) {
+    // Mark the record as free, like the allocator would, so that it is
+    // cleared now and found again if this thread exits.
+    bool success = allocator_->ChangeType(ref, kTypeIdUserDataRecordFree,
+                                          kTypeIdUserDataRecord,
+                                          /*clear=*/true);
+    DCHECK(success);
+    tracker->user_data_slab_[tracker->user_data_slab_used_++] = ref;
+    return;
+  }
+
+  AutoLock lock(user_data_allocator_lock_);
+  user_data_allocator_.ReleaseObjectReference(ref);
+}
+
 void GlobalActivityTracker::RecordExceptionImpl(const void* pc,
                                                 const void* origin,
                                                 uint32_t code) {
@@ -682,18 +682,25 @@ class BASE_EXPORT ThreadActivityTracker {
   // Indicates that an activity has completed.
   void PopActivity(ActivityId id);
 
-  // Sets the user-data information for an activity.
-  std::unique_ptr<ActivityUserData> GetUserData(
+  // Returns if an activity can have user-data information. Those beyond the
+  // capacity of the stack can't, and lock acquisitions must not.
+  bool CanHaveUserData(ActivityId id);
+
+  // Sets the user-data information for an activity, which must be able to
+  // have some, to the persistent record |ref| of |size| bytes at |memory|.
+  std::unique_ptr<ActivityUserData> SetUserData(
       ActivityId id,
-      ActivityTrackerMemoryAllocator* allocator);
+      PersistentMemoryAllocator::Reference ref,
+      void* memory,
+      size_t size);
 
   // Returns if there is true use-data associated with a given ActivityId since
   // it's possible than any returned object is just a sink.
   bool HasUserData(ActivityId id);
 
-  // Release the user-data information for an activity.
-  void ReleaseUserData(ActivityId id,
-                       ActivityTrackerMemoryAllocator* allocator);
+  // Release the user-data information for an activity. Returns the reference
+  // of its record, which the caller must free, or null if it had none.
+  PersistentMemoryAllocator::Reference ReleaseUserData(ActivityId id);
 
   // Save an exception. |origin| is the location of the exception.
   void RecordExceptionActivity(const void* program_counter,
@@ -737,10 +744,6 @@ class BASE_EXPORT ThreadActivityTracker {
 
   bool CalledOnValidThread();
 
-  std::unique_ptr<ActivityUserData> CreateUserDataForActivity(
-      Activity* activity,
-      ActivityTrackerMemoryAllocator* allocator);
-
   Header* const header_;        // Pointer to the Header structure.
   Activity* const stack_;       // The stack of activities.
 
@@ -1076,6 +1079,7 @@ class BASE_EXPORT GlobalActivityTracker {
     kMaxThreadCount = 100,
     kCachedThreadMemories = 10,
     kCachedUserDataMemories = 10,
+    kUserDataSlabSize = 4,
   };
 
   // A wrapper around ActivityUserData that is thread-safe and thus can be used
@@ -1158,6 +1162,13 @@ class BASE_EXPORT GlobalActivityTracker {
     // The physical address used for the thread-tracker's memory.
     void* const mem_base_;
 
+    // Free user-data records kept for this thread so that its activities get
+    // and release user data without taking |user_data_allocator_lock_|. Only
+    // accessed by the thread. The records are free in persistent memory so
+    // the global allocator finds them by iteration once the thread exits.
+    PersistentMemoryAllocator::Reference user_data_slab_[kUserDataSlabSize];
+    size_t user_data_slab_used_ = 0;
+
    private:
     DISALLOW_COPY_AND_ASSIGN(ManagedActivityTracker);
   };
@@ -1175,6 +1186,16 @@ class BASE_EXPORT GlobalActivityTracker {
   // It is called during the destruction of a ManagedActivityTracker object.
   void ReturnTrackerMemory(ManagedActivityTracker* tracker);
 
+  // Gets and releases the user data of activity |id| of |tracker|, which is
+  // the tracker of the current thread. Records come from and go back to the
+  // slab of the thread, and only when it's empty or full from the caching
+  // |user_data_allocator_|.
+  std::unique_ptr<ActivityUserData> GetUserDataForActivity(
+      ManagedActivityTracker* tracker,
+      ThreadActivityTracker::ActivityId id);
+  void ReleaseUserDataForActivity(ManagedActivityTracker* tracker,
+                                  ThreadActivityTracker::ActivityId id);
+
   // Records exception information.
   void RecordExceptionImpl(const void* pc, const void* origin, uint32_t code);
 
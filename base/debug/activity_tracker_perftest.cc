@@ -0,0 +1,82 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/debug/activity_tracker.h"
+
+#include <memory>
+
+#include "base/macros.h"
+#include "base/pending_task.h"
+#include "base/synchronization/lock_impl.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+namespace debug {
+
+namespace {
+
+constexpr int kActivities = 1000000;
+constexpr size_t kMemorySize = 1 << 20;  // 1 MiB
+constexpr int kStackDepth = 4;
+
+class ActivityTrackerPerfTest : public testing::Test {
+ protected:
+  ActivityTrackerPerfTest() {
+    GlobalActivityTracker::CreateWithLocalMemory(kMemorySize, 0, "",
+                                                 kStackDepth, 0);
+    // Creating the tracker of the thread takes locks and isn't timed.
+    GlobalActivityTracker::Get()->GetOrCreateTrackerForCurrentThread();
+  }
+
+  ~ActivityTrackerPerfTest() override {
+    GlobalActivityTracker* global_tracker = GlobalActivityTracker::Get();
+    global_tracker->ReleaseTrackerForCurrentThreadForTesting();
+    delete global_tracker;
+  }
+
+  void PrintResult(const std::string& trace, TimeDelta elapsed) {
+    perf_test::PrintResult(
+        "activity_push_pop", "", trace,
+        elapsed.InNanoseconds() / static_cast<double>(kActivities),
+        "ns/activity", true);
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(ActivityTrackerPerfTest);
+};
+
+}  // namespace
+
+TEST_F(ActivityTrackerPerfTest, ScopedTaskRunActivity) {
+  PendingTask task(FROM_HERE, OnceClosure());
+  TimeTicks start_time = TimeTicks::Now();
+  for (int i = 0; i < kActivities; ++i)
+    ScopedTaskRunActivity activity(task);
+  PrintResult("task_run", TimeTicks::Now() - start_time);
+}
+
+TEST_F(ActivityTrackerPerfTest, ScopedLockAcquireActivity) {
+  internal::LockImpl lock;
+  TimeTicks start_time = TimeTicks::Now();
+  for (int i = 0; i < kActivities; ++i)
+    ScopedLockAcquireActivity activity(&lock);
+  PrintResult("lock_acquire", TimeTicks::Now() - start_time);
+}
+
+// Each activity gets a record for its user data from the slab of the thread
+// and clears it when done.
+TEST_F(ActivityTrackerPerfTest, ScopedTaskRunActivityWithUserData) {
+  PendingTask task(FROM_HERE, OnceClosure());
+  TimeTicks start_time = TimeTicks::Now();
+  for (int i = 0; i < kActivities; ++i) {
+    ScopedTaskRunActivity activity(task);
+    activity.user_data().SetInt("sequence", i);
+  }
+  PrintResult("task_run_user_data", TimeTicks::Now() - start_time);
+}
+
+}  // namespace debug
+}  // namespace base
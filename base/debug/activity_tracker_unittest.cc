@@ -85,6 +85,13 @@ class ActivityTrackerTest : public testing::Test {
     return GlobalActivityTracker::Get()->user_data_allocator_.cache_used();
   }
 
+  size_t GetThreadUserDataSlabUsed() {
+    GlobalActivityTracker* global_tracker = GlobalActivityTracker::Get();
+    return static_cast<GlobalActivityTracker::ManagedActivityTracker*>(
+               global_tracker->GetTrackerForCurrentThread())
+        ->user_data_slab_used_;
+  }
+
   void HandleProcessExit(int64_t id,
                          int64_t stamp,
                          int code,
@@ -246,7 +253,40 @@ TEST_F(ActivityTrackerTest, ScopedTaskTest) {
   ASSERT_TRUE(tracker->CreateSnapshot(&snapshot));
   ASSERT_EQ(0U, snapshot.activity_stack_depth);
   ASSERT_EQ(0U, snapshot.activity_stack.size());
-  ASSERT_EQ(2U, GetGlobalUserDataMemoryCacheUsed());
+  // The records of the user data are kept by the thread.
+  ASSERT_EQ(0U, GetGlobalUserDataMemoryCacheUsed());
+  ASSERT_EQ(2U, GetThreadUserDataSlabUsed());
+}
+
+TEST_F(ActivityTrackerTest, UserDataSlabTest) {
+  GlobalActivityTracker::CreateWithLocalMemory(kMemorySize, 0, "", 3, 0);
+  PersistentMemoryAllocator* allocator =
+      GlobalActivityTracker::Get()->allocator();
+  GlobalActivityTracker::Get()->GetOrCreateTrackerForCurrentThread();
+
+  // The first user data of the thread comes from the global allocator.
+  {
+    PendingTask task(FROM_HERE, DoNothing());
+    ScopedTaskRunActivity activity(task);
+    activity.user_data().SetInt("first", 1);
+  }
+  ASSERT_EQ(1U, GetThreadUserDataSlabUsed());
+  const size_t used = allocator->used();
+
+  // Later ones reuse the record of the thread, which is cleared.
+  for (int i = 0; i < 10; ++i) {
+    PendingTask task(FROM_HERE, DoNothing());
+    ScopedTaskRunActivity activity(task);
+    ActivityUserData& user_data = activity.user_data();
+    EXPECT_EQ(0U, GetThreadUserDataSlabUsed());
+    ActivityUserData::Snapshot snapshot;
+    ASSERT_TRUE(user_data.CreateSnapshot(&snapshot));
+    EXPECT_TRUE(snapshot.empty());
+    user_data.SetInt("later", i);
+  }
+  EXPECT_EQ(1U, GetThreadUserDataSlabUsed());
+  EXPECT_EQ(0U, GetGlobalUserDataMemoryCacheUsed());
+  EXPECT_EQ(used, allocator->used());
 }
 
 namespace {
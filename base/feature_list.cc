@@ -28,6 +28,14 @@ FeatureList* g_feature_list_instance = nullptr;
 // Tracks whether the FeatureList instance was initialized via an accessor.
 bool g_initialized_from_accessor = false;
 
+// The generation of the FeatureList instance singleton, which tags the states
+// cached in Feature structs. Incremented whenever the instance changes.
+std::atomic<uint32_t> g_instance_generation(1);
+
+void InvalidateCachedFeatureStates() {
+  g_instance_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
 // An allocator entry for a feature in shared memory. The FeatureEntry is
 // followed by a base::Pickle object that contains the feature and trial name.
 struct FeatureEntry {
@@ -201,7 +209,15 @@ bool FeatureList::IsEnabled(const Feature& feature) {
     g_initialized_from_accessor = true;
     return feature.default_state == FEATURE_ENABLED_BY_DEFAULT;
   }
-  return g_feature_list_instance->IsFeatureEnabled(feature);
+
+  const uint32_t generation =
+      g_instance_generation.load(std::memory_order_relaxed);
+  bool enabled;
+  if (feature.state_cache.Get(generation, &enabled))
+    return enabled;
+  enabled = g_feature_list_instance->IsFeatureEnabled(feature);
+  feature.state_cache.Set(generation, enabled);
+  return enabled;
 }
 
 // static
@@ -262,6 +278,7 @@ void FeatureList::SetInstance(std::unique_ptr<FeatureList> instance) {
 
   // Note: Intentional leak of global singleton.
   g_feature_list_instance = instance.release();
+  InvalidateCachedFeatureStates();
 
 #if DCHECK_IS_CONFIGURABLE
   // Update the behaviour of LOG_DCHECK to match the Feature configuration.
@@ -283,6 +300,7 @@ std::unique_ptr<FeatureList> FeatureList::ClearInstanceForTesting() {
   FeatureList* old_instance = g_feature_list_instance;
   g_feature_list_instance = nullptr;
   g_initialized_from_accessor = false;
+  InvalidateCachedFeatureStates();
   return base::WrapUnique(old_instance);
 }
 
@@ -292,6 +310,7 @@ void FeatureList::RestoreInstanceForTesting(
   DCHECK(!g_feature_list_instance);
   // Note: Intentional leak of global singleton.
   g_feature_list_instance = instance.release();
+  InvalidateCachedFeatureStates();
 }
 
 void FeatureList::FinalizeInitialization() {
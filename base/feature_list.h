@@ -5,6 +5,9 @@
 #ifndef BASE_FEATURE_LIST_H_
 #define BASE_FEATURE_LIST_H_
 
+#include <stdint.h>
+
+#include <atomic>
 #include <map>
 #include <memory>
 #include <string>
@@ -27,6 +30,41 @@ enum FeatureState {
   FEATURE_ENABLED_BY_DEFAULT,
 };
 
+namespace internal {
+
+// The state of a Feature as last resolved by FeatureList::IsEnabled(), along
+// with the generation of the FeatureList instance which resolved it. A copy of
+// a Feature starts without a cached state.
+class FeatureStateCache {
+ public:
+  constexpr FeatureStateCache() : value_(0) {}
+  FeatureStateCache(const FeatureStateCache&) : value_(0) {}
+
+  // Returns whether a state was cached for |generation|, and if so sets
+  // |enabled| to it.
+  bool Get(uint32_t generation, bool* enabled) const {
+    const uint32_t value = value_.load(std::memory_order_relaxed);
+    if (value >> 1 != generation)
+      return false;
+    *enabled = value & 1;
+    return true;
+  }
+
+  void Set(uint32_t generation, bool enabled) const {
+    value_.store(generation << 1 | (enabled ? 1 : 0),
+                 std::memory_order_relaxed);
+  }
+
+ private:
+  // The generation in the high bits and the state in the lowest one. Zero
+  // while nothing is cached, as generations start at one.
+  mutable std::atomic<uint32_t> value_;
+
+  DISALLOW_ASSIGN(FeatureStateCache);
+};
+
+}  // namespace internal
+
 // The Feature struct is used to define the default state for a feature. See
 // comment below for more details. There must only ever be one struct instance
 // for a given feature name - generally defined as a constant global variable or
@@ -41,6 +79,10 @@ struct BASE_EXPORT Feature {
 
   // The default state (i.e. enabled or disabled) for this feature.
   const FeatureState default_state;
+
+  // The state of this feature cached by FeatureList::IsEnabled(). Must not be
+  // initialized by the definition of the feature.
+  internal::FeatureStateCache state_cache;
 };
 
 #if DCHECK_IS_CONFIGURABLE
@@ -166,7 +208,9 @@ class BASE_EXPORT FeatureList {
   // Returns whether the given |feature| is enabled. Must only be called after
   // the singleton instance has been registered via SetInstance(). Additionally,
   // a feature with a given name must only have a single corresponding Feature
-  // struct, which is checked in builds with DCHECKs enabled.
+  // struct, which is checked in builds with DCHECKs enabled. The state is
+  // cached in |feature| until another instance is registered, so that later
+  // calls don't look up the overrides.
   static bool IsEnabled(const Feature& feature);
 
   // Returns the field trial associated with the given |feature|. Must only be
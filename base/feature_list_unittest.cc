@@ -73,6 +73,23 @@ TEST_F(FeatureListTest, DefaultStates) {
   EXPECT_FALSE(FeatureList::IsEnabled(kFeatureOffByDefault));
 }
 
+TEST_F(FeatureListTest, CachedStateIsInvalidatedByNewInstance) {
+  EXPECT_TRUE(FeatureList::IsEnabled(kFeatureOnByDefault));
+  EXPECT_TRUE(FeatureList::IsEnabled(kFeatureOnByDefault));
+
+  std::unique_ptr<FeatureList> feature_list(new FeatureList);
+  feature_list->InitializeFromCommandLine("", kFeatureOnByDefaultName);
+  RegisterFeatureListInstance(std::move(feature_list));
+  EXPECT_FALSE(FeatureList::IsEnabled(kFeatureOnByDefault));
+
+  // Without an instance, the default state is returned and nothing cached.
+  std::unique_ptr<FeatureList> original_feature_list =
+      FeatureList::ClearInstanceForTesting();
+  EXPECT_TRUE(FeatureList::IsEnabled(kFeatureOnByDefault));
+  FeatureList::RestoreInstanceForTesting(std::move(original_feature_list));
+  EXPECT_FALSE(FeatureList::IsEnabled(kFeatureOnByDefault));
+}
+
 TEST_F(FeatureListTest, InitializeFromCommandLine) {
   struct {
     const char* enable_features;
@@ -0,0 +1,523 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_io_uring_linux.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/bind.h"
+#include "base/lazy_instance.h"
+#include "base/location.h"
+#include "base/logging.h"
+#include "base/memory/ptr_util.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/threading/thread_local.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "base/trace_event/trace_event.h"
+
+// The kernel headers of older sysroots, like those of some hosts, predate
+// io_uring, which is then reported as unsupported.
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAS_LINUX_IO_URING_H
+#endif
+#endif
+
+// The io_uring system calls have the same number on all architectures.
+#if !defined(__NR_io_uring_setup)
+#define __NR_io_uring_setup 425
+#endif
+#if !defined(__NR_io_uring_enter)
+#define __NR_io_uring_enter 426
+#endif
+#if !defined(__NR_io_uring_register)
+#define __NR_io_uring_register 427
+#endif
+
+namespace base {
+
+#if defined(HAS_LINUX_IO_URING_H)
+namespace {
+
+// Number of submission queue entries. The kernel sizes the completion queue
+// to twice that.
+constexpr uint32_t kQueueDepth = 64;
+
+LazyInstance<ThreadLocalPointer<FileIOUring>>::Leaky tls_file_io_uring =
+    LAZY_INSTANCE_INITIALIZER;
+
+// Set on threads where the ring could not be set up, so that it isn't tried
+// again on every call.
+LazyInstance<ThreadLocalBoolean>::Leaky tls_file_io_uring_failed =
+    LAZY_INSTANCE_INITIALIZER;
+
+int IOUringSetup(uint32_t entries, io_uring_params* params) {
+  return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int IOUringEnter(int fd,
+                 uint32_t to_submit,
+                 uint32_t min_complete,
+                 uint32_t flags) {
+  return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit,
+                                  min_complete, flags, nullptr, 0));
+}
+
+int IOUringRegister(int fd, uint32_t opcode, void* arg, uint32_t nr_args) {
+  return static_cast<int>(
+      syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+// The ring indices are shared with the kernel, which updates them
+// concurrently.
+uint32_t LoadAcquire(const uint32_t* index) {
+  return static_cast<uint32_t>(subtle::Acquire_Load(
+      reinterpret_cast<volatile const subtle::Atomic32*>(index)));
+}
+
+void StoreRelease(uint32_t* index, uint32_t value) {
+  subtle::Release_Store(reinterpret_cast<volatile subtle::Atomic32*>(index),
+                        static_cast<subtle::Atomic32>(value));
+}
+
+void* MapRing(int fd, size_t size, off_t offset) {
+  void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, offset);
+  return address == MAP_FAILED ? nullptr : address;
+}
+
+template <typename T>
+T* RingField(void* ring, uint32_t offset) {
+  return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+}
+
+}  // namespace
+#endif  // defined(HAS_LINUX_IO_URING_H)
+
+struct FileIOUring::Operation {
+  Operation(PlatformFile file,
+            int64_t offset,
+            char* buffer,
+            int size,
+            bool is_write,
+            CompletionCallback callback)
+      : file(file),
+        offset(offset),
+        buffer(buffer),
+        size(size),
+        is_write(is_write),
+        callback(std::move(callback)) {}
+
+  const PlatformFile file;
+  const int64_t offset;
+  char* const buffer;
+  const int size;
+  const bool is_write;
+  CompletionCallback callback;
+
+  uint64_t id = 0;
+  // Bytes transferred so far.
+  int done = 0;
+  // Handed to the kernel, which may read it until the operation completes.
+  iovec iov = {};
+};
+
+#if defined(HAS_LINUX_IO_URING_H)
+
+FileIOUring::Rings::Rings() = default;
+
+FileIOUring::Rings::~Rings() {
+  if (sqes)
+    munmap(sqes, sqes_size);
+  if (cq_ring && cq_ring != sq_ring)
+    munmap(cq_ring, cq_ring_size);
+  if (sq_ring)
+    munmap(sq_ring, sq_ring_size);
+}
+
+// static
+FileIOUring* FileIOUring::GetForCurrentThread() {
+  FileIOUring* ring = tls_file_io_uring.Get().Get();
+  if (ring)
+    return ring->error_ ? nullptr : ring;
+  if (tls_file_io_uring_failed.Get().Get() ||
+      !MessageLoopCurrentForIO::IsSet() || !IsSupported()) {
+    return nullptr;
+  }
+
+  std::unique_ptr<FileIOUring> new_ring = WrapUnique(new FileIOUring);
+  if (!new_ring->Init()) {
+    tls_file_io_uring_failed.Get().Set(true);
+    return nullptr;
+  }
+  ring = new_ring.release();
+  tls_file_io_uring.Get().Set(ring);
+  MessageLoopCurrentForIO::Get()->AddDestructionObserver(ring);
+  return ring;
+}
+
+// static
+bool FileIOUring::IsSupported() {
+  static const bool is_supported = [] {
+    io_uring_params params = {};
+    ScopedFD fd(IOUringSetup(1, &params));
+    return fd.is_valid();
+  }();
+  return is_supported;
+}
+
+FileIOUring::FileIOUring()
+    : event_fd_controller_(FROM_HERE), weak_factory_(this) {}
+
+FileIOUring::~FileIOUring() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  if (tls_file_io_uring.Get().Get() == this)
+    tls_file_io_uring.Get().Set(nullptr);
+
+  if (!ring_fd_.is_valid())
+    return;
+
+  // The kernel may still access the buffers and iovecs of operations in
+  // flight, so wait for them to complete before dropping them.
+  backlog_.clear();
+  if (to_submit_)
+    Submit();
+  while (!operations_.empty()) {
+    int rv = IOUringEnter(ring_fd_.get(), 0, 1, IORING_ENTER_GETEVENTS);
+    if (rv < 0 && errno != EINTR) {
+      DPLOG(ERROR) << "io_uring_enter";
+      break;
+    }
+    uint32_t head = *rings_.cq_head;
+    uint32_t tail = LoadAcquire(rings_.cq_tail);
+    for (; head != tail; ++head)
+      operations_.erase(rings_.cqes[head & rings_.cq_mask].user_data);
+    StoreRelease(rings_.cq_head, head);
+  }
+}
+
+void FileIOUring::Read(PlatformFile file,
+                       int64_t offset,
+                       char* buffer,
+                       int size,
+                       CompletionCallback callback) {
+  StartOperation(std::make_unique<Operation>(file, offset, buffer, size, false,
+                                             std::move(callback)));
+}
+
+void FileIOUring::Write(PlatformFile file,
+                        int64_t offset,
+                        const char* buffer,
+                        int size,
+                        CompletionCallback callback) {
+  // The buffer is only read from, but shares the Operation layout.
+  StartOperation(std::make_unique<Operation>(file, offset,
+                                             const_cast<char*>(buffer), size,
+                                             true, std::move(callback)));
+}
+
+bool FileIOUring::Init() {
+  io_uring_params params = {};
+  ring_fd_.reset(IOUringSetup(kQueueDepth, &params));
+  if (!ring_fd_.is_valid()) {
+    DPLOG(ERROR) << "io_uring_setup";
+    return false;
+  }
+
+  rings_.sq_ring_size =
+      params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+  rings_.cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  // Since Linux 5.4 both rings live in a single mapping.
+  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    rings_.sq_ring_size = rings_.cq_ring_size =
+        std::max(rings_.sq_ring_size, rings_.cq_ring_size);
+  }
+  rings_.sq_ring =
+      MapRing(ring_fd_.get(), rings_.sq_ring_size, IORING_OFF_SQ_RING);
+  if (!rings_.sq_ring)
+    return false;
+  rings_.cq_ring =
+      single_mmap
+          ? rings_.sq_ring
+          : MapRing(ring_fd_.get(), rings_.cq_ring_size, IORING_OFF_CQ_RING);
+  if (!rings_.cq_ring)
+    return false;
+  rings_.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  rings_.sqes = static_cast<io_uring_sqe*>(
+      MapRing(ring_fd_.get(), rings_.sqes_size, IORING_OFF_SQES));
+  if (!rings_.sqes)
+    return false;
+
+  rings_.sq_head = RingField<uint32_t>(rings_.sq_ring, params.sq_off.head);
+  rings_.sq_tail = RingField<uint32_t>(rings_.sq_ring, params.sq_off.tail);
+  rings_.sq_mask = *RingField<uint32_t>(rings_.sq_ring, params.sq_off.ring_mask);
+  rings_.sq_entries = params.sq_entries;
+  rings_.sq_array = RingField<uint32_t>(rings_.sq_ring, params.sq_off.array);
+  rings_.cq_head = RingField<uint32_t>(rings_.cq_ring, params.cq_off.head);
+  rings_.cq_tail = RingField<uint32_t>(rings_.cq_ring, params.cq_off.tail);
+  rings_.cq_mask = *RingField<uint32_t>(rings_.cq_ring, params.cq_off.ring_mask);
+  rings_.cq_entries = params.cq_entries;
+  rings_.cqes = RingField<io_uring_cqe>(rings_.cq_ring, params.cq_off.cqes);
+  sq_tail_ = *rings_.sq_tail;
+
+  event_fd_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  if (!event_fd_.is_valid()) {
+    DPLOG(ERROR) << "eventfd";
+    return false;
+  }
+  int fd = event_fd_.get();
+  if (IOUringRegister(ring_fd_.get(), IORING_REGISTER_EVENTFD, &fd, 1) < 0) {
+    DPLOG(ERROR) << "io_uring_register";
+    return false;
+  }
+  return MessageLoopCurrentForIO::Get()->WatchFileDescriptor(
+      event_fd_.get(), true, MessagePumpForIO::WATCH_READ,
+      &event_fd_controller_, this);
+}
+
+void FileIOUring::StartOperation(std::unique_ptr<Operation> operation) {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  DCHECK_GE(operation->size, 0);
+  operation->id = next_operation_id_++;
+  if (!error_ && backlog_.empty() &&
+      operations_.size() < rings_.cq_entries) {
+    // A full submission queue is submitted right away, which makes room.
+    if (to_submit_ == rings_.sq_entries)
+      Submit();
+    if (!error_ && QueueOperation(operation.get())) {
+      operations_[operation->id] = std::move(operation);
+      ScheduleSubmit();
+      return;
+    }
+  }
+  if (error_) {
+    FailOperation(std::move(operation), error_);
+    return;
+  }
+  backlog_.push_back(std::move(operation));
+}
+
+bool FileIOUring::QueueOperation(Operation* operation) {
+  if (sq_tail_ - LoadAcquire(rings_.sq_head) >= rings_.sq_entries)
+    return false;
+
+  operation->iov.iov_base = operation->buffer + operation->done;
+  operation->iov.iov_len = operation->size - operation->done;
+
+  uint32_t index = sq_tail_ & rings_.sq_mask;
+  io_uring_sqe* sqe = &rings_.sqes[index];
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = operation->is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+  sqe->fd = operation->file;
+  sqe->off = operation->offset + operation->done;
+  sqe->addr = reinterpret_cast<uint64_t>(&operation->iov);
+  sqe->len = 1;
+  sqe->user_data = operation->id;
+  rings_.sq_array[index] = index;
+  sq_tail_++;
+  to_submit_++;
+  return true;
+}
+
+void FileIOUring::ScheduleSubmit() {
+  if (submit_scheduled_ || !to_submit_)
+    return;
+  submit_scheduled_ = true;
+  ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE,
+      BindOnce(&FileIOUring::Submit, weak_factory_.GetWeakPtr()));
+}
+
+void FileIOUring::Submit() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  submit_scheduled_ = false;
+  if (!to_submit_)
+    return;
+
+  TRACE_EVENT1("base", "FileIOUring::Submit", "operations", to_submit_);
+  StoreRelease(rings_.sq_tail, sq_tail_);
+  int rv = HANDLE_EINTR(IOUringEnter(ring_fd_.get(), to_submit_, 0, 0));
+  submit_count_++;
+  if (rv < 0) {
+    // EAGAIN and EBUSY are transient: retry after the next completions, or
+    // on the next turn of the loop if there is nothing in flight.
+    if (errno == EAGAIN || errno == EBUSY) {
+      ScheduleSubmit();
+      return;
+    }
+    DPLOG(ERROR) << "io_uring_enter";
+    FailUnsubmittedOperations(errno);
+    return;
+  }
+  to_submit_ -= std::min(to_submit_, static_cast<uint32_t>(rv));
+  if (to_submit_)
+    ScheduleSubmit();
+}
+
+void FileIOUring::FailUnsubmittedOperations(int error) {
+  error_ = error;
+
+  // Take back the entries the kernel did not consume, so that it never does.
+  const uint32_t head = LoadAcquire(rings_.sq_head);
+  std::vector<std::unique_ptr<Operation>> failed;
+  for (uint32_t i = head; i != sq_tail_; ++i) {
+    const io_uring_sqe& sqe = rings_.sqes[rings_.sq_array[i & rings_.sq_mask]];
+    auto it = operations_.find(sqe.user_data);
+    DCHECK(it != operations_.end());
+    failed.push_back(std::move(it->second));
+    operations_.erase(it);
+  }
+  sq_tail_ = head;
+  StoreRelease(rings_.sq_tail, sq_tail_);
+  to_submit_ = 0;
+
+  for (std::unique_ptr<Operation>& operation : failed)
+    FailOperation(std::move(operation), error);
+  while (!backlog_.empty()) {
+    FailOperation(std::move(backlog_.front()), error);
+    backlog_.pop_front();
+  }
+}
+
+void FileIOUring::FailOperation(std::unique_ptr<Operation> operation,
+                                int error) {
+  // Posted so that callbacks never run from within Read() or Write().
+  const int result = operation->done > 0 ? operation->done : -error;
+  ThreadTaskRunnerHandle::Get()->PostTask(
+      FROM_HERE, BindOnce(&FileIOUring::RunFailedOperationCallback,
+                          weak_factory_.GetWeakPtr(), std::move(operation),
+                          result));
+}
+
+void FileIOUring::RunFailedOperationCallback(
+    std::unique_ptr<Operation> operation,
+    int result) {
+  std::move(operation->callback).Run(result);
+}
+
+void FileIOUring::ReapCompletions() {
+  DCHECK_CALLED_ON_VALID_THREAD(thread_checker_);
+  uint32_t head = *rings_.cq_head;
+  while (head != LoadAcquire(rings_.cq_tail)) {
+    const io_uring_cqe& cqe = rings_.cqes[head & rings_.cq_mask];
+    uint64_t id = cqe.user_data;
+    int32_t res = cqe.res;
+    StoreRelease(rings_.cq_head, ++head);
+
+    auto it = operations_.find(id);
+    DCHECK(it != operations_.end());
+    Operation* operation = it->second.get();
+    if (res > 0) {
+      operation->done += res;
+      // Continue short transfers, as File::Read() and File::Write() do.
+      if (operation->done < operation->size && !error_) {
+        if (to_submit_ == rings_.sq_entries)
+          Submit();
+        if (!error_ && QueueOperation(operation))
+          continue;
+      }
+      res = operation->done;
+    } else if (res == 0 || operation->done > 0) {
+      res = operation->done;
+    }
+
+    std::unique_ptr<Operation> completed = std::move(it->second);
+    operations_.erase(it);
+    // The callback may start new operations. It cannot destroy the ring,
+    // which only goes away with the MessageLoop.
+    std::move(completed->callback).Run(res);
+  }
+
+  while (!backlog_.empty() && operations_.size() < rings_.cq_entries) {
+    std::unique_ptr<Operation> operation = std::move(backlog_.front());
+    backlog_.pop_front();
+    if (!QueueOperation(operation.get())) {
+      backlog_.push_front(std::move(operation));
+      break;
+    }
+    operations_[operation->id] = std::move(operation);
+  }
+  ScheduleSubmit();
+}
+
+void FileIOUring::OnFileCanReadWithoutBlocking(int fd) {
+  DCHECK_EQ(event_fd_.get(), fd);
+  uint64_t value;
+  // The counter only tells that completions were posted; they are all read
+  // from the ring below.
+  HANDLE_EINTR(read(event_fd_.get(), &value, sizeof(value)));
+  ReapCompletions();
+}
+
+void FileIOUring::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED();
+}
+
+void FileIOUring::WillDestroyCurrentMessageLoop() {
+  delete this;
+}
+
+#else  // defined(HAS_LINUX_IO_URING_H)
+
+// No ring is ever created, so only the accessors do anything.
+
+FileIOUring::Rings::~Rings() = default;
+
+// static
+FileIOUring* FileIOUring::GetForCurrentThread() {
+  return nullptr;
+}
+
+// static
+bool FileIOUring::IsSupported() {
+  return false;
+}
+
+FileIOUring::~FileIOUring() = default;
+
+void FileIOUring::Read(PlatformFile file,
+                       int64_t offset,
+                       char* buffer,
+                       int size,
+                       CompletionCallback callback) {
+  NOTREACHED();
+}
+
+void FileIOUring::Write(PlatformFile file,
+                        int64_t offset,
+                        const char* buffer,
+                        int size,
+                        CompletionCallback callback) {
+  NOTREACHED();
+}
+
+void FileIOUring::OnFileCanReadWithoutBlocking(int fd) {
+  NOTREACHED();
+}
+
+void FileIOUring::OnFileCanWriteWithoutBlocking(int fd) {
+  NOTREACHED();
+}
+
+void FileIOUring::WillDestroyCurrentMessageLoop() {
+  NOTREACHED();
+}
+
+#endif  // defined(HAS_LINUX_IO_URING_H)
+
+}  // namespace base
@@ -0,0 +1,194 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_FILES_FILE_IO_URING_LINUX_H_
+#define BASE_FILES_FILE_IO_URING_LINUX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+
+#include "base/base_export.h"
+#include "base/callback.h"
+#include "base/containers/circular_deque.h"
+#include "base/files/platform_file.h"
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+#include "base/memory/weak_ptr.h"
+#include "base/message_loop/message_loop_current.h"
+#include "base/message_loop/message_pump_for_io.h"
+#include "base/threading/thread_checker.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace base {
+
+// Asynchronous positional file reads and writes using the io_uring(7)
+// interface of Linux 5.1 and later.
+//
+// There is at most one ring per thread. It lives on a MessageLoopForIO and
+// is destroyed with it. Operations queued while a task runs are submitted to
+// the kernel together, with a single system call, once the task is done, and
+// completions are reaped when the pump reports that the ring's eventfd is
+// readable. Completion callbacks thus run on the thread which started the
+// operation, without going through another thread.
+//
+// If the kernel rejects a submission for a reason other than a lack of
+// resources, the operations not submitted yet fail and the ring is no longer
+// used: GetForCurrentThread() returns null from then on.
+class BASE_EXPORT FileIOUring : public MessagePumpForIO::FdWatcher,
+                                public MessageLoopCurrent::DestructionObserver {
+ public:
+  // Receives the number of bytes transferred, or a negative errno value if
+  // the operation failed before transferring anything.
+  using CompletionCallback = OnceCallback<void(int result)>;
+
+  // Returns the ring of the current thread, creating it on first use. Returns
+  // null if the current thread is not running a MessageLoopForIO, if the
+  // kernel does not support io_uring, or if the ring of the current thread
+  // could not be set up or failed.
+  static FileIOUring* GetForCurrentThread();
+
+  // Returns true if the kernel supports io_uring. The result is cached. Always
+  // false if base was built against kernel headers which predate io_uring.
+  static bool IsSupported();
+
+  ~FileIOUring() override;
+
+  // Reads |size| bytes at |offset| of |file| into |buffer|. Like File::Read(),
+  // short reads are continued until |size| bytes were read, the end of the
+  // file is reached or an error occurs. |file| and |buffer| must stay valid
+  // until |callback| runs. |callback| is not run if the ring is destroyed
+  // first (the operation is waited for, then dropped).
+  void Read(PlatformFile file,
+            int64_t offset,
+            char* buffer,
+            int size,
+            CompletionCallback callback);
+
+  // Writes |size| bytes from |buffer| at |offset| of |file|, continuing short
+  // writes like File::Write(). Same requirements as Read().
+  void Write(PlatformFile file,
+             int64_t offset,
+             const char* buffer,
+             int size,
+             CompletionCallback callback);
+
+  // Number of operations started and not completed yet. Exposed for tests.
+  size_t pending_operations() const { return operations_.size(); }
+
+  // Number of io_uring_enter() calls made to submit operations. Exposed for
+  // tests.
+  size_t submit_count() const { return submit_count_; }
+
+ private:
+  struct Operation;
+
+  // Memory shared with the kernel, as described in io_uring_setup(2).
+  struct Rings {
+    Rings();
+    ~Rings();
+
+    void* sq_ring = nullptr;
+    size_t sq_ring_size = 0;
+    void* cq_ring = nullptr;
+    size_t cq_ring_size = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+
+    uint32_t* sq_head = nullptr;
+    uint32_t* sq_tail = nullptr;
+    uint32_t sq_mask = 0;
+    uint32_t sq_entries = 0;
+    uint32_t* sq_array = nullptr;
+
+    uint32_t* cq_head = nullptr;
+    uint32_t* cq_tail = nullptr;
+    uint32_t cq_mask = 0;
+    uint32_t cq_entries = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    DISALLOW_COPY_AND_ASSIGN(Rings);
+  };
+
+  FileIOUring();
+
+  // Risky part of constructor. Returns true on success.
+  bool Init();
+
+  void StartOperation(std::unique_ptr<Operation> operation);
+
+  // Fills a submission queue entry for the remaining part of |operation|.
+  // Returns false if the submission queue is full.
+  bool QueueOperation(Operation* operation);
+
+  // Posts a task to submit the queued entries, unless one is pending.
+  void ScheduleSubmit();
+
+  // Hands the queued submission queue entries to the kernel.
+  void Submit();
+
+  // Fails the operations which were not handed to the kernel with |error|,
+  // and all the operations started later. Operations already submitted
+  // complete normally, without being continued if they are short.
+  void FailUnsubmittedOperations(int error);
+
+  // Posts the completion of |operation| with |error|, or with the number of
+  // bytes it transferred if any.
+  void FailOperation(std::unique_ptr<Operation> operation, int error);
+
+  void RunFailedOperationCallback(std::unique_ptr<Operation> operation,
+                                  int result);
+
+  // Processes all available completions, then queues operations that were
+  // waiting for space in the rings.
+  void ReapCompletions();
+
+  // MessagePumpForIO::FdWatcher:
+  void OnFileCanReadWithoutBlocking(int fd) override;
+  void OnFileCanWriteWithoutBlocking(int fd) override;
+
+  // MessageLoopCurrent::DestructionObserver:
+  void WillDestroyCurrentMessageLoop() override;
+
+  ScopedFD ring_fd_;
+  // Signaled by the kernel when completions are posted.
+  ScopedFD event_fd_;
+  Rings rings_;
+
+  // Local copy of the submission queue tail, published to the kernel on
+  // Submit().
+  uint32_t sq_tail_ = 0;
+  // Number of entries queued since the last Submit().
+  uint32_t to_submit_ = 0;
+  bool submit_scheduled_ = false;
+  // The errno of the submission which failed, after which the ring is not
+  // used anymore.
+  int error_ = 0;
+
+  // Operations handed to the kernel (or queued for it), by user_data.
+  std::unordered_map<uint64_t, std::unique_ptr<Operation>> operations_;
+  // Operations waiting for room in the rings. The number of operations in
+  // flight is bounded by the completion queue size so that it cannot
+  // overflow.
+  circular_deque<std::unique_ptr<Operation>> backlog_;
+  uint64_t next_operation_id_ = 1;
+
+  size_t submit_count_ = 0;
+
+  MessagePumpForIO::FdWatchController event_fd_controller_;
+
+  THREAD_CHECKER(thread_checker_);
+
+  WeakPtrFactory<FileIOUring> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileIOUring);
+};
+
+}  // namespace base
+
+#endif  // BASE_FILES_FILE_IO_URING_LINUX_H_
@@ -0,0 +1,277 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_io_uring_linux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/macros.h"
+#include "base/message_loop/message_loop.h"
+#include "base/run_loop.h"
+#include "base/strings/stringprintf.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+constexpr int kFileSize = 64 * 1024;
+
+char PatternAt(int64_t offset) {
+  return static_cast<char>(offset % 251);
+}
+
+// Replaces the file descriptors of the io_uring instances of the process with
+// /dev/null, on which io_uring_enter() fails with EOPNOTSUPP. Returns false if
+// there are none.
+bool ReplaceIOUringFds() {
+  ScopedFD dev_null(open("/dev/null", O_RDONLY | O_CLOEXEC));
+  if (!dev_null.is_valid())
+    return false;
+  bool replaced = false;
+  for (int fd = 0; fd < 1024; ++fd) {
+    FilePath target;
+    if (ReadSymbolicLink(FilePath(StringPrintf("/proc/self/fd/%d", fd)),
+                         &target) &&
+        target.value() == "anon_inode:[io_uring]") {
+      replaced |= dup2(dev_null.get(), fd) == fd;
+    }
+  }
+  return replaced;
+}
+
+class FileIOUringTest : public testing::Test {
+ public:
+  FileIOUringTest() = default;
+
+  void SetUp() override {
+    ASSERT_TRUE(dir_.CreateUniqueTempDir());
+    FilePath path = dir_.GetPath().AppendASCII("test");
+    std::string data(kFileSize, 0);
+    for (int i = 0; i < kFileSize; ++i)
+      data[i] = PatternAt(i);
+    ASSERT_EQ(kFileSize, WriteFile(path, data.data(), kFileSize));
+    file_.Initialize(path, File::FLAG_OPEN | File::FLAG_READ |
+                               File::FLAG_WRITE);
+    ASSERT_TRUE(file_.IsValid());
+  }
+
+ protected:
+  // Returns a callback which stores the result at |index| of |results_| and
+  // quits |run_loop_| once |expected_| callbacks ran.
+  FileIOUring::CompletionCallback Record(size_t index) {
+    if (results_.size() <= index)
+      results_.resize(index + 1, 1);
+    return BindOnce(&FileIOUringTest::OnComplete, Unretained(this), index);
+  }
+
+  void RunUntilComplete(size_t expected) {
+    expected_ = expected;
+    if (completed_ < expected_)
+      run_loop_.Run();
+  }
+
+  ScopedTempDir dir_;
+  File file_;
+  MessageLoopForIO message_loop_;
+  std::vector<int> results_;
+
+ private:
+  void OnComplete(size_t index, int result) {
+    results_[index] = result;
+    if (++completed_ == expected_)
+      run_loop_.Quit();
+  }
+
+  RunLoop run_loop_;
+  size_t expected_ = 0;
+  size_t completed_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(FileIOUringTest);
+};
+
+}  // namespace
+
+TEST(FileIOUringNoLoopTest, RequiresMessageLoopForIO) {
+  EXPECT_FALSE(FileIOUring::GetForCurrentThread());
+  MessageLoop message_loop;
+  EXPECT_FALSE(FileIOUring::GetForCurrentThread());
+}
+
+TEST_F(FileIOUringTest, ReadAndWrite) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring)
+    return;  // io_uring is not supported by this kernel.
+  EXPECT_EQ(io_uring, FileIOUring::GetForCurrentThread());
+
+  char read_buffer[100];
+  const char kData[] = "hello";
+  io_uring->Read(file_.GetPlatformFile(), 1000, read_buffer,
+                 sizeof(read_buffer), Record(0));
+  io_uring->Write(file_.GetPlatformFile(), 5000, kData, sizeof(kData),
+                  Record(1));
+  EXPECT_EQ(2u, io_uring->pending_operations());
+  RunUntilComplete(2);
+
+  EXPECT_EQ(0u, io_uring->pending_operations());
+  EXPECT_EQ(static_cast<int>(sizeof(read_buffer)), results_[0]);
+  for (size_t i = 0; i < sizeof(read_buffer); ++i)
+    EXPECT_EQ(PatternAt(1000 + i), read_buffer[i]);
+  EXPECT_EQ(static_cast<int>(sizeof(kData)), results_[1]);
+  char written[sizeof(kData)];
+  EXPECT_EQ(static_cast<int>(sizeof(kData)),
+            file_.Read(5000, written, sizeof(written)));
+  EXPECT_STREQ(kData, written);
+}
+
+TEST_F(FileIOUringTest, SubmissionsAreBatched) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring)
+    return;
+
+  constexpr size_t kReads = 16;
+  char buffers[kReads][16];
+  for (size_t i = 0; i < kReads; ++i) {
+    io_uring->Read(file_.GetPlatformFile(), i * 4096, buffers[i],
+                   sizeof(buffers[i]), Record(i));
+  }
+  size_t submit_count = io_uring->submit_count();
+  RunUntilComplete(kReads);
+
+  // All the reads started by a task are submitted together.
+  EXPECT_EQ(submit_count + 1, io_uring->submit_count());
+  for (size_t i = 0; i < kReads; ++i) {
+    EXPECT_EQ(16, results_[i]);
+    EXPECT_EQ(PatternAt(i * 4096), buffers[i][0]);
+  }
+}
+
+TEST_F(FileIOUringTest, MoreOperationsThanRingEntries) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring)
+    return;
+
+  // More than fit in both the submission and the completion queues.
+  constexpr size_t kReads = 1000;
+  std::vector<char> buffer(kReads);
+  for (size_t i = 0; i < kReads; ++i)
+    io_uring->Read(file_.GetPlatformFile(), i * 7, &buffer[i], 1, Record(i));
+  RunUntilComplete(kReads);
+
+  EXPECT_EQ(0u, io_uring->pending_operations());
+  for (size_t i = 0; i < kReads; ++i) {
+    EXPECT_EQ(1, results_[i]);
+    EXPECT_EQ(PatternAt(i * 7), buffer[i]);
+  }
+}
+
+TEST_F(FileIOUringTest, ReadPastEndOfFile) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring)
+    return;
+
+  char buffer[100];
+  io_uring->Read(file_.GetPlatformFile(), kFileSize - 10, buffer,
+                 sizeof(buffer), Record(0));
+  io_uring->Read(file_.GetPlatformFile(), kFileSize + 10, buffer,
+                 sizeof(buffer), Record(1));
+  RunUntilComplete(2);
+
+  EXPECT_EQ(10, results_[0]);
+  EXPECT_EQ(0, results_[1]);
+}
+
+TEST_F(FileIOUringTest, Error) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring)
+    return;
+
+  File read_only(dir_.GetPath().AppendASCII("test"),
+                 File::FLAG_OPEN | File::FLAG_READ);
+  ASSERT_TRUE(read_only.IsValid());
+  const char kData[] = "x";
+  io_uring->Write(read_only.GetPlatformFile(), 0, kData, 1, Record(0));
+  RunUntilComplete(1);
+
+  EXPECT_EQ(-EBADF, results_[0]);
+}
+
+TEST_F(FileIOUringTest, SubmitFailure) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring)
+    return;
+  ASSERT_TRUE(ReplaceIOUringFds());
+
+  char buffer[16];
+  io_uring->Read(file_.GetPlatformFile(), 0, buffer, sizeof(buffer),
+                 Record(0));
+  io_uring->Read(file_.GetPlatformFile(), 100, buffer, sizeof(buffer),
+                 Record(1));
+  RunUntilComplete(2);
+
+  // The operations fail instead of being submitted again and again, and the
+  // ring isn't handed out anymore.
+  EXPECT_EQ(-EOPNOTSUPP, results_[0]);
+  EXPECT_EQ(-EOPNOTSUPP, results_[1]);
+  EXPECT_EQ(0u, io_uring->pending_operations());
+  EXPECT_EQ(1u, io_uring->submit_count());
+  EXPECT_FALSE(FileIOUring::GetForCurrentThread());
+}
+
+TEST_F(FileIOUringTest, CallbackStartsOperation) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring)
+    return;
+
+  char first[8];
+  char second[8];
+  io_uring->Read(
+      file_.GetPlatformFile(), 0, first, sizeof(first),
+      BindOnce(
+          [](FileIOUring* io_uring, PlatformFile file, char* buffer,
+             FileIOUring::CompletionCallback done, int result) {
+            EXPECT_EQ(8, result);
+            io_uring->Read(file, 100, buffer, 8, std::move(done));
+          },
+          io_uring, file_.GetPlatformFile(), second, Record(0)));
+  RunUntilComplete(1);
+
+  EXPECT_EQ(8, results_[0]);
+  EXPECT_EQ(PatternAt(0), first[0]);
+  EXPECT_EQ(PatternAt(100), second[0]);
+}
+
+TEST(FileIOUringDestructionTest, PendingOperationsAreDropped) {
+  ScopedTempDir dir;
+  ASSERT_TRUE(dir.CreateUniqueTempDir());
+  File file(dir.GetPath().AppendASCII("test"),
+            File::FLAG_CREATE | File::FLAG_READ | File::FLAG_WRITE);
+  ASSERT_TRUE(file.IsValid());
+
+  bool ran = false;
+  char buffer[16];
+  {
+    MessageLoopForIO message_loop;
+    FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+    if (!io_uring)
+      return;
+    io_uring->Read(file.GetPlatformFile(), 0, buffer, sizeof(buffer),
+                   BindOnce([](bool* ran, int result) { *ran = true; }, &ran));
+  }
+  EXPECT_FALSE(ran);
+  EXPECT_FALSE(FileIOUring::GetForCurrentThread());
+}
+
+}  // namespace base
@@ -4,6 +4,8 @@
 
 #include "base/files/file_proxy.h"
 
+#include <algorithm>
+#include <memory>
 #include <utility>
 
 #include "base/bind.h"
@@ -14,6 +16,11 @@
 #include "base/macros.h"
 #include "base/task_runner.h"
 #include "base/task_runner_util.h"
+#include "build/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include "base/files/file_io_uring_linux.h"
+#endif
 
 namespace {
 
@@ -192,6 +199,24 @@ class ReadHelper : public FileHelper {
     std::move(callback).Run(error_, buffer_.get(), bytes_read_);
   }
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Deletes |this| once the operation completed.
+  void RunOnIOUring(FileIOUring* io_uring,
+                    int64_t offset,
+                    FileProxy::ReadCallback callback) {
+    io_uring->Read(file_.GetPlatformFile(), offset, buffer_.get(),
+                   bytes_to_read_,
+                   BindOnce(&ReadHelper::DidRunOnIOUring, Owned(this),
+                            std::move(callback)));
+  }
+
+  void DidRunOnIOUring(FileProxy::ReadCallback callback, int result) {
+    bytes_read_ = std::max(result, -1);
+    error_ = (result < 0) ? File::OSErrorToFileError(-result) : File::FILE_OK;
+    Reply(std::move(callback));
+  }
+#endif
+
  private:
   std::unique_ptr<char[]> buffer_;
   int bytes_to_read_;
@@ -222,6 +247,24 @@ class WriteHelper : public FileHelper {
       std::move(callback).Run(error_, bytes_written_);
   }
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Deletes |this| once the operation completed.
+  void RunOnIOUring(FileIOUring* io_uring,
+                    int64_t offset,
+                    FileProxy::WriteCallback callback) {
+    io_uring->Write(file_.GetPlatformFile(), offset, buffer_.get(),
+                    bytes_to_write_,
+                    BindOnce(&WriteHelper::DidRunOnIOUring, Owned(this),
+                             std::move(callback)));
+  }
+
+  void DidRunOnIOUring(FileProxy::WriteCallback callback, int result) {
+    bytes_written_ = std::max(result, -1);
+    error_ = (result < 0) ? File::OSErrorToFileError(-result) : File::FILE_OK;
+    Reply(std::move(callback));
+  }
+#endif
+
  private:
   std::unique_ptr<char[]> buffer_;
   int bytes_to_write_;
@@ -284,6 +327,15 @@ PlatformFile FileProxy::GetPlatformFile() const {
   return file_.GetPlatformFile();
 }
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+bool FileProxy::UseIOUring() {
+  if (!FileIOUring::GetForCurrentThread())
+    return false;
+  use_io_uring_ = true;
+  return true;
+}
+#endif
+
 bool FileProxy::Close(StatusCallback callback) {
   DCHECK(file_.IsValid());
   GenericFileHelper* helper = new GenericFileHelper(this, std::move(file_));
@@ -305,6 +357,16 @@ bool FileProxy::Read(int64_t offset, int bytes_to_read, ReadCallback callback) {
   if (bytes_to_read < 0)
     return false;
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  if (use_io_uring_) {
+    if (FileIOUring* io_uring = FileIOUring::GetForCurrentThread()) {
+      (new ReadHelper(this, std::move(file_), bytes_to_read))
+          ->RunOnIOUring(io_uring, offset, std::move(callback));
+      return true;
+    }
+  }
+#endif
+
   ReadHelper* helper = new ReadHelper(this, std::move(file_), bytes_to_read);
   return task_runner_->PostTaskAndReply(
       FROM_HERE, BindOnce(&ReadHelper::RunWork, Unretained(helper), offset),
@@ -319,6 +381,16 @@ bool FileProxy::Write(int64_t offset,
   if (bytes_to_write <= 0 || buffer == nullptr)
     return false;
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  if (use_io_uring_) {
+    if (FileIOUring* io_uring = FileIOUring::GetForCurrentThread()) {
+      (new WriteHelper(this, std::move(file_), buffer, bytes_to_write))
+          ->RunOnIOUring(io_uring, offset, std::move(callback));
+      return true;
+    }
+  }
+#endif
+
   WriteHelper* helper =
       new WriteHelper(this, std::move(file_), buffer, bytes_to_write);
   return task_runner_->PostTaskAndReply(
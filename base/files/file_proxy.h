@@ -14,6 +14,7 @@
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
 #include "base/memory/weak_ptr.h"
+#include "build/build_config.h"
 
 namespace base {
 
@@ -35,6 +36,9 @@ class Time;
 //   proxy.Write(...);
 //
 // means the second Write will always fail.
+//
+// On Linux, Read() and Write() can instead be performed with io_uring on the
+// calling thread, see UseIOUring().
 class BASE_EXPORT FileProxy : public SupportsWeakPtr<FileProxy> {
  public:
   // This callback is used by methods that report only an error code. It is
@@ -93,6 +97,19 @@ class BASE_EXPORT FileProxy : public SupportsWeakPtr<FileProxy> {
 
   PlatformFile GetPlatformFile() const;
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Makes Read() and Write() submit their operation to the io_uring of the
+  // calling thread (see FileIOUring) rather than post it to |task_runner|.
+  // Submissions made during a task are batched and the callbacks run from the
+  // MessageLoopForIO, without a thread hop. All the other operations still go
+  // through |task_runner|, which also remains in charge of closing the file.
+  //
+  // Must be called on a thread running a MessageLoopForIO, on which Read()
+  // and Write() must then be called. Returns false, and leaves the proxy
+  // unchanged, if io_uring is not available.
+  bool UseIOUring();
+#endif
+
   // Proxies File::Close. The callback can be null.
   // This returns false if task posting to |task_runner| has failed.
   bool Close(StatusCallback callback);
@@ -134,6 +151,9 @@ class BASE_EXPORT FileProxy : public SupportsWeakPtr<FileProxy> {
 
   scoped_refptr<TaskRunner> task_runner_;
   File file_;
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  bool use_io_uring_ = false;
+#endif
   DISALLOW_COPY_AND_ASSIGN(FileProxy);
 };
 
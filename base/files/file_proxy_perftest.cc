@@ -0,0 +1,168 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/files/file_proxy.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "base/bind.h"
+#include "base/files/file.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/macros.h"
+#include "base/message_loop/message_loop.h"
+#include "base/rand_util.h"
+#include "base/run_loop.h"
+#include "base/threading/thread.h"
+#include "base/time/time.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include "base/files/file_io_uring_linux.h"
+#endif
+
+namespace base {
+
+namespace {
+
+constexpr int kBlockSize = 4096;
+constexpr int kBlockCount = 4096;  // 16 MB file.
+constexpr int kReadCount = 20000;
+
+// Measures random 4 KB reads from a file which is in the page cache, so that
+// the cost of getting each read to the kernel and its result back dominates.
+class FileProxyPerfTest : public testing::Test {
+ public:
+  FileProxyPerfTest() : file_thread_("FileProxyPerfTestFileThread") {}
+
+  void SetUp() override {
+    ASSERT_TRUE(dir_.CreateUniqueTempDir());
+    path_ = dir_.GetPath().AppendASCII("test");
+    std::string data(kBlockSize * kBlockCount, 'x');
+    ASSERT_EQ(static_cast<int>(data.size()),
+              WriteFile(path_, data.data(), data.size()));
+    ASSERT_TRUE(file_thread_.Start());
+    for (int i = 0; i < kReadCount; ++i)
+      offsets_.push_back(int64_t{kBlockSize} * RandGenerator(kBlockCount));
+  }
+
+ protected:
+  // Issues the reads one after the other through |proxy|.
+  void RunProxyTest(FileProxy* proxy, const std::string& trace) {
+    proxy->SetFile(File(path_, File::FLAG_OPEN | File::FLAG_READ));
+    ASSERT_TRUE(proxy->IsValid());
+
+    RunLoop run_loop;
+    next_read_ = 0;
+    quit_closure_ = run_loop.QuitClosure();
+    TimeTicks start = TimeTicks::Now();
+    ReadNext(proxy, File::FILE_OK, nullptr, kBlockSize);
+    run_loop.Run();
+    TimeDelta elapsed = TimeTicks::Now() - start;
+
+    perf_test::PrintResult("random_4k_read", "", trace,
+                           elapsed.InMicrosecondsF() / kReadCount,
+                           "us/read", true);
+  }
+
+  ScopedTempDir dir_;
+  FilePath path_;
+  std::vector<int64_t> offsets_;
+  MessageLoopForIO message_loop_;
+  Thread file_thread_;
+
+ private:
+  void ReadNext(FileProxy* proxy,
+                File::Error error,
+                const char* data,
+                int bytes_read) {
+    ASSERT_EQ(File::FILE_OK, error);
+    ASSERT_EQ(kBlockSize, bytes_read);
+    if (next_read_ == offsets_.size()) {
+      std::move(quit_closure_).Run();
+      return;
+    }
+    proxy->Read(offsets_[next_read_++], kBlockSize,
+                BindOnce(&FileProxyPerfTest::ReadNext, Unretained(this),
+                         Unretained(proxy)));
+  }
+
+  size_t next_read_ = 0;
+  OnceClosure quit_closure_;
+
+  DISALLOW_COPY_AND_ASSIGN(FileProxyPerfTest);
+};
+
+}  // namespace
+
+TEST_F(FileProxyPerfTest, RandomReadsOnTaskRunner) {
+  FileProxy proxy(file_thread_.task_runner().get());
+  RunProxyTest(&proxy, "task_runner");
+}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+TEST_F(FileProxyPerfTest, RandomReadsOnIOUring) {
+  FileProxy proxy(file_thread_.task_runner().get());
+  if (!proxy.UseIOUring()) {
+    LOG(WARNING) << "io_uring is not supported, skipping test.";
+    return;
+  }
+  RunProxyTest(&proxy, "io_uring");
+}
+
+// Keeps |kQueueDepth| reads in flight, which FileProxy cannot do, to show
+// the effect of batching submissions.
+TEST_F(FileProxyPerfTest, RandomReadsOnIOUringBatched) {
+  FileIOUring* io_uring = FileIOUring::GetForCurrentThread();
+  if (!io_uring) {
+    LOG(WARNING) << "io_uring is not supported, skipping test.";
+    return;
+  }
+  File file(path_, File::FLAG_OPEN | File::FLAG_READ);
+  ASSERT_TRUE(file.IsValid());
+
+  constexpr int kQueueDepth = 32;
+  std::vector<char> buffers(kQueueDepth * kBlockSize);
+  size_t next_read = 0;
+  int completed = 0;
+  RunLoop run_loop;
+
+  // Each completion issues the next read into the same buffer.
+  RepeatingCallback<void(int, int)> on_read;
+  auto start_read = [&](int slot) {
+    io_uring->Read(file.GetPlatformFile(), offsets_[next_read++],
+                   &buffers[slot * kBlockSize], kBlockSize,
+                   BindOnce(on_read, slot));
+  };
+  on_read = BindRepeating(
+      [](decltype(start_read)* start_read, size_t* next_read, int* completed,
+         RunLoop* run_loop, const std::vector<int64_t>* offsets, int slot,
+         int result) {
+        ASSERT_EQ(kBlockSize, result);
+        if (++*completed == kReadCount)
+          run_loop->Quit();
+        else if (*next_read < offsets->size())
+          (*start_read)(slot);
+      },
+      &start_read, &next_read, &completed, &run_loop, &offsets_);
+
+  TimeTicks start = TimeTicks::Now();
+  for (int slot = 0; slot < kQueueDepth; ++slot)
+    start_read(slot);
+  run_loop.Run();
+  TimeDelta elapsed = TimeTicks::Now() - start;
+
+  perf_test::PrintResult("random_4k_read", "", "io_uring_qd32",
+                         elapsed.InMicrosecondsF() / kReadCount, "us/read",
+                         true);
+}
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
+}  // namespace base
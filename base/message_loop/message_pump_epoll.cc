@@ -0,0 +1,469 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/message_pump_epoll.h"
+
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+#include "base/auto_reset.h"
+#include "base/containers/stack_container.h"
+#include "base/logging.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/stl_util.h"
+#include "base/trace_event/trace_event.h"
+
+// Lifecycle of a registration
+// Each watched fd has an FdEntry in |entries_| which lists the controllers
+// watching it. The kernel registration (one per fd) carries the union of
+// their interests and is tagged with the entry's generation. It is added
+// synchronously by WatchFileDescriptor() so that failures are reported to the
+// caller, then modified lazily: any change marks the entry dirty and
+// FlushUpdates() issues at most one epoll_ctl() per dirty entry before the
+// pump waits again. It is deleted when the last controller stops watching.
+
+namespace base {
+
+namespace {
+
+// Ready events handed to a single epoll_wait() at first. The buffer doubles
+// whenever it fills up.
+constexpr size_t kInitialReadyEvents = 32;
+
+// Generation of the wake-up eventfd's registration. Never used for an fd.
+constexpr uint32_t kWakeUpGeneration = 0;
+
+uint64_t PackEventData(int fd, uint32_t generation) {
+  return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+}
+
+}  // namespace
+
+MessagePumpEpoll::FdWatchController::FdWatchController(
+    const Location& from_here)
+    : FdWatchControllerInterface(from_here) {}
+
+MessagePumpEpoll::FdWatchController::~FdWatchController() {
+  if (pump_)
+    StopWatchingFileDescriptor();
+  if (was_destroyed_) {
+    DCHECK(!*was_destroyed_);
+    *was_destroyed_ = true;
+  }
+}
+
+bool MessagePumpEpoll::FdWatchController::StopWatchingFileDescriptor() {
+  if (registered_)
+    pump_->Unregister(this);
+  fd_ = -1;
+  mode_ = 0;
+  persistent_ = false;
+  edge_triggered_ = false;
+  pump_ = nullptr;
+  watcher_ = nullptr;
+  return true;
+}
+
+MessagePumpEpoll::FdEntry::FdEntry() = default;
+
+MessagePumpEpoll::FdEntry::~FdEntry() = default;
+
+MessagePumpEpoll::MessagePumpEpoll() : ready_events_(kInitialReadyEvents) {
+  if (!Init())
+    NOTREACHED();
+}
+
+MessagePumpEpoll::~MessagePumpEpoll() {
+  // Unlike with libevent, controllers may outlive the pump: they are simply
+  // detached from it.
+  for (auto& fd_and_entry : entries_) {
+    for (FdWatchController* controller : fd_and_entry.second.controllers) {
+      controller->registered_ = false;
+      controller->StopWatchingFileDescriptor();
+    }
+  }
+}
+
+bool MessagePumpEpoll::WatchFileDescriptor(int fd,
+                                           bool persistent,
+                                           int mode,
+                                           FdWatchController* controller,
+                                           FdWatcher* delegate) {
+  return WatchFileDescriptorImpl(fd, persistent, false, mode, controller,
+                                 delegate);
+}
+
+bool MessagePumpEpoll::WatchFileDescriptorEdgeTriggered(
+    int fd,
+    int mode,
+    FdWatchController* controller,
+    FdWatcher* delegate) {
+  return WatchFileDescriptorImpl(fd, true, true, mode, controller, delegate);
+}
+
+bool MessagePumpEpoll::WatchFileDescriptorImpl(int fd,
+                                               bool persistent,
+                                               bool edge_triggered,
+                                               int mode,
+                                               FdWatchController* controller,
+                                               FdWatcher* delegate) {
+  DCHECK_GE(fd, 0);
+  DCHECK(controller);
+  DCHECK(delegate);
+  DCHECK(mode == WATCH_READ || mode == WATCH_WRITE || mode == WATCH_READ_WRITE);
+  // WatchFileDescriptor should be called on the pump thread. It is not
+  // threadsafe, and your watcher may never be registered.
+  DCHECK(watch_file_descriptor_caller_checker_.CalledOnValidThread());
+
+  if (controller->fd_ >= 0) {
+    DCHECK(!controller->pump_ || controller->pump_ == this);
+    // It's illegal to use this function to listen on 2 separate fds with the
+    // same |controller|.
+    if (controller->fd_ != fd) {
+      NOTREACHED() << "FDs don't match" << controller->fd_ << "!=" << fd;
+      return false;
+    }
+    // Combine old/new interests.
+    mode |= controller->mode_;
+    persistent |= controller->persistent_;
+  }
+
+  controller->fd_ = fd;
+  controller->mode_ = mode;
+  controller->persistent_ = persistent;
+  controller->edge_triggered_ = edge_triggered;
+  controller->pump_ = this;
+  controller->watcher_ = delegate;
+
+  FdEntry& entry = entries_[fd];
+  if (!controller->registered_) {
+    entry.controllers.push_back(controller);
+    controller->registered_ = true;
+  }
+
+  if (entry.registered_events) {
+    MarkDirty(fd, &entry);
+    return true;
+  }
+
+  if (!UpdateRegistration(fd, &entry)) {
+    // As with libevent, a failure removes the previous registration, if any.
+    controller->StopWatchingFileDescriptor();
+    return false;
+  }
+  return true;
+}
+
+void MessagePumpEpoll::Unregister(FdWatchController* controller) {
+  DCHECK(controller->registered_);
+  auto it = entries_.find(controller->fd_);
+  DCHECK(it != entries_.end());
+  FdEntry& entry = it->second;
+  controller->registered_ = false;
+  entry.controllers.erase(std::find(entry.controllers.begin(),
+                                    entry.controllers.end(), controller));
+  if (!entry.controllers.empty()) {
+    MarkDirty(it->first, &entry);
+    return;
+  }
+  if (entry.registered_events) {
+    // The fd may already have been closed, which removed it from the epoll
+    // set.
+    epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, it->first, nullptr);
+  }
+  entries_.erase(it);
+}
+
+void MessagePumpEpoll::MarkDirty(int fd, FdEntry* entry) {
+  if (entry->dirty)
+    return;
+  entry->dirty = true;
+  dirty_fds_.push_back(fd);
+}
+
+void MessagePumpEpoll::FlushUpdates() {
+  for (int fd : dirty_fds_) {
+    auto it = entries_.find(fd);
+    if (it == entries_.end() || !it->second.dirty)
+      continue;
+    it->second.dirty = false;
+    UpdateRegistration(fd, &it->second);
+  }
+  dirty_fds_.clear();
+}
+
+bool MessagePumpEpoll::UpdateRegistration(int fd, FdEntry* entry) {
+  if (entry->controllers.empty()) {
+    if (entry->registered_events)
+      epoll_ctl(epoll_fd_.get(), EPOLL_CTL_DEL, fd, nullptr);
+    entries_.erase(fd);
+    return true;
+  }
+
+  uint32_t events = 0;
+  bool all_one_shot = true;
+  bool all_edge_triggered = true;
+  for (const FdWatchController* controller : entry->controllers) {
+    if (controller->mode_ & WATCH_READ)
+      events |= EPOLLIN;
+    if (controller->mode_ & WATCH_WRITE)
+      events |= EPOLLOUT;
+    all_one_shot &= !controller->persistent_;
+    all_edge_triggered &= controller->edge_triggered_;
+  }
+  if (all_one_shot)
+    events |= EPOLLONESHOT;
+  if (all_edge_triggered)
+    events |= EPOLLET;
+
+  if (events == entry->registered_events && !entry->disarmed)
+    return true;
+
+  int op = entry->registered_events ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (op == EPOLL_CTL_ADD) {
+    entry->generation = next_generation_++;
+    if (next_generation_ == kWakeUpGeneration)
+      next_generation_++;
+  }
+  epoll_event event = {};
+  event.events = events;
+  event.data.u64 = PackEventData(fd, entry->generation);
+  int rv = epoll_ctl(epoll_fd_.get(), op, fd, &event);
+  if (rv < 0 && op == EPOLL_CTL_MOD && errno == ENOENT) {
+    // The fd was closed, which removed it from the epoll set, and its number
+    // was reused.
+    entry->generation = next_generation_++;
+    if (next_generation_ == kWakeUpGeneration)
+      next_generation_++;
+    event.data.u64 = PackEventData(fd, entry->generation);
+    rv = epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, fd, &event);
+  }
+  if (rv < 0) {
+    DPLOG(ERROR) << "epoll_ctl failed(fd=" << fd << ")";
+    return false;
+  }
+  entry->registered_events = events;
+  entry->disarmed = false;
+  return true;
+}
+
+// Reentrant!
+void MessagePumpEpoll::Run(Delegate* delegate) {
+  AutoReset<bool> auto_reset_keep_running(&keep_running_, true);
+  AutoReset<bool> auto_reset_in_run(&in_run_, true);
+
+  for (;;) {
+    bool did_work = delegate->DoWork();
+    if (!keep_running_)
+      break;
+
+    did_work |= WaitAndDispatch(0);
+    if (!keep_running_)
+      break;
+
+    did_work |= delegate->DoDelayedWork(&delayed_work_time_);
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    did_work = delegate->DoIdleWork();
+    if (!keep_running_)
+      break;
+
+    if (did_work)
+      continue;
+
+    if (delayed_work_time_.is_null()) {
+      WaitAndDispatch(-1);
+    } else {
+      TimeDelta delay = delayed_work_time_ - TimeTicks::Now();
+      if (delay > TimeDelta()) {
+        // Round up so as not to wake up before |delayed_work_time_| and spin.
+        WaitAndDispatch(static_cast<int>(
+            std::min<int64_t>(delay.InMillisecondsRoundedUp(),
+                              std::numeric_limits<int>::max())));
+      } else {
+        // It looks like delayed_work_time_ indicates a time in the past, so we
+        // need to call DoDelayedWork now.
+        delayed_work_time_ = TimeTicks();
+      }
+    }
+
+    if (!keep_running_)
+      break;
+  }
+}
+
+void MessagePumpEpoll::Quit() {
+  DCHECK(in_run_) << "Quit was called outside of Run!";
+  // Tell both epoll_wait() and Run that they should break out of their loops.
+  keep_running_ = false;
+  ScheduleWork();
+}
+
+void MessagePumpEpoll::ScheduleWork() {
+  // Bump the eventfd counter; unlike a pipe it can't fill up.
+  uint64_t value = 1;
+  int nwrite = HANDLE_EINTR(write(wakeup_fd_.get(), &value, sizeof(value)));
+  DCHECK(nwrite == sizeof(value) || errno == EAGAIN)
+      << "[nwrite:" << nwrite << "] [errno:" << errno << "]";
+}
+
+void MessagePumpEpoll::ScheduleDelayedWork(const TimeTicks& delayed_work_time) {
+  // We know that we can't be blocked in epoll_wait() right now since this
+  // method can only be called on the same thread as Run, so we only need to
+  // update our record of how long to sleep when we do sleep.
+  delayed_work_time_ = delayed_work_time;
+}
+
+bool MessagePumpEpoll::Init() {
+  epoll_fd_.reset(epoll_create1(EPOLL_CLOEXEC));
+  if (!epoll_fd_.is_valid()) {
+    DPLOG(ERROR) << "epoll_create1 failed";
+    return false;
+  }
+  wakeup_fd_.reset(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+  if (!wakeup_fd_.is_valid()) {
+    DPLOG(ERROR) << "eventfd creation failed";
+    return false;
+  }
+
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.u64 = PackEventData(wakeup_fd_.get(), kWakeUpGeneration);
+  if (epoll_ctl(epoll_fd_.get(), EPOLL_CTL_ADD, wakeup_fd_.get(), &event)) {
+    DPLOG(ERROR) << "epoll_ctl failed(wakeup_fd)";
+    return false;
+  }
+  return true;
+}
+
+bool MessagePumpEpoll::WaitAndDispatch(int timeout_ms) {
+  FlushUpdates();
+
+  // A callback may run a nested loop, which must not clobber the events this
+  // loop is dispatching: take the buffer for the duration of the dispatch.
+  std::vector<epoll_event> events;
+  events.swap(ready_events_);
+  if (events.empty())
+    events.resize(kInitialReadyEvents);
+
+  int count = epoll_wait(epoll_fd_.get(), events.data(),
+                         static_cast<int>(events.size()), timeout_ms);
+  if (count < 0) {
+    DPLOG_IF(ERROR, errno != EINTR) << "epoll_wait failed";
+    count = 0;
+  }
+
+  for (int i = 0; i < count; i++)
+    DispatchEvent(events[i]);
+
+  if (static_cast<size_t>(count) == events.size())
+    events.resize(events.size() * 2);
+  if (events.size() >= ready_events_.size())
+    ready_events_.swap(events);
+  return count > 0;
+}
+
+void MessagePumpEpoll::DispatchEvent(const epoll_event& event) {
+  int fd = static_cast<int>(event.data.u64 & 0xffffffff);
+  uint32_t generation = static_cast<uint32_t>(event.data.u64 >> 32);
+
+  if (generation == kWakeUpGeneration) {
+    DCHECK_EQ(wakeup_fd_.get(), fd);
+    // Reset the eventfd counter.
+    uint64_t value;
+    int nread = HANDLE_EINTR(read(fd, &value, sizeof(value)));
+    DCHECK(nread == sizeof(value) || errno == EAGAIN);
+    return;
+  }
+
+  auto it = entries_.find(fd);
+  // The registration may have been replaced by an earlier callback.
+  if (it == entries_.end() || it->second.generation != generation)
+    return;
+  FdEntry* entry = &it->second;
+  if (entry->registered_events & EPOLLONESHOT) {
+    entry->disarmed = true;
+    MarkDirty(fd, entry);
+  }
+
+  // Like libevent, report errors and hang-ups as readiness for both, to
+  // whichever the controllers are interested in.
+  uint32_t events = event.events;
+  if (events & (EPOLLERR | EPOLLHUP))
+    events |= EPOLLIN | EPOLLOUT;
+  const bool can_read = events & EPOLLIN;
+  const bool can_write = events & EPOLLOUT;
+
+  // Callbacks may add, stop or delete controllers, so work on a copy and check
+  // that each one is still registered before notifying it.
+  StackVector<FdWatchController*, 4> controllers;
+  controllers->assign(entry->controllers.begin(), entry->controllers.end());
+  for (FdWatchController* controller : controllers.container()) {
+    it = entries_.find(fd);
+    if (it == entries_.end() || it->second.generation != generation)
+      return;
+    entry = &it->second;
+    if (!ContainsValue(entry->controllers, controller))
+      continue;
+
+    bool controller_can_read = can_read && (controller->mode_ & WATCH_READ);
+    bool controller_can_write = can_write && (controller->mode_ & WATCH_WRITE);
+    if (!controller_can_read && !controller_can_write)
+      continue;
+
+    if (!controller->persistent_) {
+      // One-shot watches are done once notified, as with libevent; keep the
+      // kernel registration for a re-arm from the callback.
+      controller->registered_ = false;
+      controller->pump_ = nullptr;
+      entry->controllers.erase(std::find(entry->controllers.begin(),
+                                         entry->controllers.end(), controller));
+      MarkDirty(fd, entry);
+    }
+    NotifyController(controller, fd, controller_can_read, controller_can_write);
+  }
+}
+
+void MessagePumpEpoll::NotifyController(FdWatchController* controller,
+                                        int fd,
+                                        bool can_read,
+                                        bool can_write) {
+  TRACE_EVENT2("toplevel", "MessagePumpEpoll::NotifyController", "src_file",
+               controller->created_from_location().file_name(), "src_func",
+               controller->created_from_location().function_name());
+  TRACE_HEAP_PROFILER_API_SCOPED_TASK_EXECUTION heap_profiler_scope(
+      controller->created_from_location().file_name());
+
+  if (can_read && can_write) {
+    // Both callbacks will be called. It is necessary to check that
+    // |controller| is not destroyed.
+    bool controller_was_destroyed = false;
+    controller->was_destroyed_ = &controller_was_destroyed;
+    DCHECK(controller->watcher_);
+    controller->watcher_->OnFileCanWriteWithoutBlocking(fd);
+    if (controller_was_destroyed)
+      return;
+    controller->was_destroyed_ = nullptr;
+    // Since OnFileCanWriteWithoutBlocking() gets called first, it can stop
+    // watching the file descriptor.
+    if (controller->watcher_)
+      controller->watcher_->OnFileCanReadWithoutBlocking(fd);
+  } else if (can_write) {
+    DCHECK(controller->watcher_);
+    controller->watcher_->OnFileCanWriteWithoutBlocking(fd);
+  } else {
+    DCHECK(controller->watcher_);
+    controller->watcher_->OnFileCanReadWithoutBlocking(fd);
+  }
+}
+
+}  // namespace base
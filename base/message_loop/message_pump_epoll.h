@@ -0,0 +1,183 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_MESSAGE_LOOP_MESSAGE_PUMP_EPOLL_H_
+#define BASE_MESSAGE_LOOP_MESSAGE_PUMP_EPOLL_H_
+
+#include <stdint.h>
+#include <sys/epoll.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/files/scoped_file.h"
+#include "base/macros.h"
+#include "base/message_loop/message_pump.h"
+#include "base/message_loop/watchable_io_message_pump_posix.h"
+#include "base/threading/thread_checker.h"
+#include "base/time/time.h"
+
+namespace base {
+
+// A MessagePump for I/O built directly on epoll(7). It is a drop-in
+// replacement for MessagePumpLibevent (same FdWatchController semantics) and
+// is used as MessagePumpForIO when USE_MESSAGE_PUMP_EPOLL is defined.
+//
+// Compared to libevent it:
+//  - keeps one kernel registration per file descriptor, shared by all the
+//    controllers watching it, and batches changes to it: they are applied
+//    with a single epoll_ctl() right before the pump waits;
+//  - maps one-shot watches onto EPOLLONESHOT, so re-arming one from its
+//    callback is a single EPOLL_CTL_MOD rather than a delete and an add;
+//  - reuses its ready-list buffer across iterations;
+//  - optionally supports edge-triggered watches.
+class BASE_EXPORT MessagePumpEpoll : public MessagePump,
+                                     public WatchableIOMessagePumpPosix {
+ public:
+  class FdWatchController : public FdWatchControllerInterface {
+   public:
+    explicit FdWatchController(const Location& from_here);
+
+    // Implicitly calls StopWatchingFileDescriptor.
+    ~FdWatchController() override;
+
+    // FdWatchControllerInterface:
+    bool StopWatchingFileDescriptor() override;
+
+   private:
+    friend class MessagePumpEpoll;
+
+    // The file descriptor this controller was last used with, or -1.
+    // Watching it again merges with the previous mode, as with libevent.
+    int fd_ = -1;
+    // Combination of Mode bits.
+    int mode_ = 0;
+    bool persistent_ = false;
+    bool edge_triggered_ = false;
+    // True while registered with |pump_|.
+    bool registered_ = false;
+
+    // The pump this controller is registered with. A one-shot watch is
+    // unregistered when it fires, and detached from the pump, but keeps |fd_|
+    // and |mode_|.
+    MessagePumpEpoll* pump_ = nullptr;
+    FdWatcher* watcher_ = nullptr;
+    // If this pointer is non-NULL, the pointee is set to true in the
+    // destructor.
+    bool* was_destroyed_ = nullptr;
+
+    DISALLOW_COPY_AND_ASSIGN(FdWatchController);
+  };
+
+  MessagePumpEpoll();
+  ~MessagePumpEpoll() override;
+
+  bool WatchFileDescriptor(int fd,
+                           bool persistent,
+                           int mode,
+                           FdWatchController* controller,
+                           FdWatcher* delegate);
+
+  // Like a persistent WatchFileDescriptor(), but |delegate| is only notified
+  // when |fd| becomes ready, not for as long as it is ready. |delegate| must
+  // therefore consume everything that is available (until EAGAIN) each time
+  // it is notified. Saves a notification per read or write on busy fds.
+  bool WatchFileDescriptorEdgeTriggered(int fd,
+                                        int mode,
+                                        FdWatchController* controller,
+                                        FdWatcher* delegate);
+
+  // MessagePump methods:
+  void Run(Delegate* delegate) override;
+  void Quit() override;
+  void ScheduleWork() override;
+  void ScheduleDelayedWork(const TimeTicks& delayed_work_time) override;
+
+ private:
+  friend class MessagePumpEpollTest;
+
+  // Risky part of constructor.  Returns true on success.
+  bool Init();
+
+  // State of one watched file descriptor.
+  struct FdEntry {
+    FdEntry();
+    ~FdEntry();
+
+    // Controllers currently registered for the fd, in registration order.
+    std::vector<FdWatchController*> controllers;
+    // Tags the kernel registration so that events reported for a previous
+    // registration of the same fd number can be told apart.
+    uint32_t generation = 0;
+    // The events of the kernel registration, or 0 if there is none.
+    uint32_t registered_events = 0;
+    // True if an EPOLLONESHOT registration fired and must be re-armed before
+    // it reports anything again.
+    bool disarmed = false;
+    // True if |fd| is queued in |dirty_fds_|.
+    bool dirty = false;
+
+    DISALLOW_COPY_AND_ASSIGN(FdEntry);
+  };
+
+  bool WatchFileDescriptorImpl(int fd,
+                               bool persistent,
+                               bool edge_triggered,
+                               int mode,
+                               FdWatchController* controller,
+                               FdWatcher* delegate);
+
+  // Removes |controller| from the fd it is registered for. If no controller
+  // is left, the kernel registration is dropped right away, as the caller is
+  // likely to close the fd next.
+  void Unregister(FdWatchController* controller);
+
+  // Queues the kernel registration of |fd| to be brought up to date with its
+  // controllers before the next wait.
+  void MarkDirty(int fd, FdEntry* entry);
+
+  // Applies all queued registration changes.
+  void FlushUpdates();
+
+  // Makes the kernel registration of |fd| match its controllers, erasing
+  // |entry| if it has none. Returns false if epoll_ctl() failed.
+  bool UpdateRegistration(int fd, FdEntry* entry);
+
+  // Waits up to |timeout_ms| (-1 for no limit) for events and dispatches them.
+  // Returns true if any events, including wake-ups, were processed.
+  bool WaitAndDispatch(int timeout_ms);
+  void DispatchEvent(const epoll_event& event);
+  void NotifyController(FdWatchController* controller,
+                        int fd,
+                        bool can_read,
+                        bool can_write);
+
+  // This flag is set to false when Run should return.
+  bool keep_running_ = true;
+
+  // This flag is set when inside Run.
+  bool in_run_ = false;
+
+  // The time at which we should call DoDelayedWork.
+  TimeTicks delayed_work_time_;
+
+  ScopedFD epoll_fd_;
+  // eventfd used to implement ScheduleWork().
+  ScopedFD wakeup_fd_;
+
+  std::unordered_map<int, FdEntry> entries_;
+  std::vector<int> dirty_fds_;
+  uint32_t next_generation_ = 1;
+
+  // Ready-list buffer handed to epoll_wait(). Grows when it fills up.
+  std::vector<epoll_event> ready_events_;
+
+  ThreadChecker watch_file_descriptor_caller_checker_;
+  DISALLOW_COPY_AND_ASSIGN(MessagePumpEpoll);
+};
+
+}  // namespace base
+
+#endif  // BASE_MESSAGE_LOOP_MESSAGE_PUMP_EPOLL_H_
@@ -0,0 +1,353 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/message_loop/message_pump_epoll.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+#include <utility>
+
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
+#include "base/memory/ptr_util.h"
+#include "base/message_loop/message_loop.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/run_loop.h"
+#include "base/test/gtest_util.h"
+#include "base/threading/thread_task_runner_handle.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+class MessagePumpEpollTest : public testing::Test {
+ protected:
+  MessagePumpEpollTest()
+      : pump_(new MessagePumpEpoll),
+        loop_(std::make_unique<MessageLoop>(WrapUnique(pump_))) {}
+  ~MessagePumpEpollTest() override = default;
+
+  void SetUp() override {
+    int ret = pipe(pipefds_);
+    ASSERT_EQ(0, ret);
+  }
+
+  void TearDown() override {
+    if (IGNORE_EINTR(close(pipefds_[0])) < 0)
+      PLOG(ERROR) << "close";
+    if (IGNORE_EINTR(close(pipefds_[1])) < 0)
+      PLOG(ERROR) << "close";
+  }
+
+  void WriteByte() {
+    const char buf = 0;
+    ASSERT_TRUE(WriteFileDescriptor(pipefds_[1], &buf, 1));
+  }
+
+  size_t NumWatchedFds() const { return pump_->entries_.size(); }
+
+  int pipefds_[2];
+  MessagePumpEpoll* pump_;  // Owned by |loop_|.
+  std::unique_ptr<MessageLoop> loop_;
+};
+
+namespace {
+
+class CountingWatcher : public MessagePumpEpoll::FdWatcher {
+ public:
+  CountingWatcher() = default;
+  ~CountingWatcher() override = default;
+
+  // MessagePumpEpoll::FdWatcher interface
+  void OnFileCanReadWithoutBlocking(int /* fd */) override { reads_++; }
+  void OnFileCanWriteWithoutBlocking(int /* fd */) override { writes_++; }
+
+  int reads() const { return reads_; }
+  int writes() const { return writes_; }
+
+ private:
+  int reads_ = 0;
+  int writes_ = 0;
+};
+
+// Consumes one byte per notification.
+class ReadByteWatcher : public MessagePumpEpoll::FdWatcher {
+ public:
+  ReadByteWatcher() = default;
+  ~ReadByteWatcher() override = default;
+
+  // MessagePumpEpoll::FdWatcher interface
+  void OnFileCanReadWithoutBlocking(int fd) override {
+    char buf;
+    ASSERT_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    reads_++;
+  }
+  void OnFileCanWriteWithoutBlocking(int /* fd */) override { NOTREACHED(); }
+
+  int reads() const { return reads_; }
+
+ private:
+  int reads_ = 0;
+};
+
+TEST_F(MessagePumpEpollTest, QuitOutsideOfRun) {
+  std::unique_ptr<MessagePumpEpoll> pump(new MessagePumpEpoll);
+  ASSERT_DCHECK_DEATH(pump->Quit());
+}
+
+TEST_F(MessagePumpEpollTest, PersistentWatchIsLevelTriggered) {
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  ReadByteWatcher watcher;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[0], true,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &controller, &watcher));
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, watcher.reads());
+
+  // The fd stays readable, and the watcher keeps being notified, until all
+  // the data is consumed.
+  WriteByte();
+  WriteByte();
+  WriteByte();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(3, watcher.reads());
+
+  EXPECT_TRUE(controller.StopWatchingFileDescriptor());
+  EXPECT_EQ(0u, NumWatchedFds());
+}
+
+TEST_F(MessagePumpEpollTest, OneShotWatchFiresOnce) {
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  CountingWatcher watcher;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[0], false,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &controller, &watcher));
+  WriteByte();
+  RunLoop().RunUntilIdle();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, watcher.reads());
+  EXPECT_EQ(0u, NumWatchedFds());
+
+  // Watching again re-arms it.
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[0], false,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &controller, &watcher));
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(2, watcher.reads());
+}
+
+class RearmWatcher : public MessagePumpEpoll::FdWatcher {
+ public:
+  RearmWatcher(MessagePumpEpoll* pump,
+               MessagePumpEpoll::FdWatchController* controller)
+      : pump_(pump), controller_(controller) {}
+  ~RearmWatcher() override = default;
+
+  // MessagePumpEpoll::FdWatcher interface
+  void OnFileCanReadWithoutBlocking(int fd) override {
+    char buf;
+    ASSERT_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    reads_++;
+    ASSERT_TRUE(pump_->WatchFileDescriptor(fd, false,
+                                           MessagePumpEpoll::WATCH_READ,
+                                           controller_, this));
+  }
+  void OnFileCanWriteWithoutBlocking(int /* fd */) override { NOTREACHED(); }
+
+  int reads() const { return reads_; }
+
+ private:
+  MessagePumpEpoll* const pump_;
+  MessagePumpEpoll::FdWatchController* const controller_;
+  int reads_ = 0;
+};
+
+TEST_F(MessagePumpEpollTest, OneShotWatchRearmedFromCallback) {
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  RearmWatcher watcher(pump_, &controller);
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[0], false,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &controller, &watcher));
+  for (int i = 1; i <= 3; i++) {
+    WriteByte();
+    RunLoop().RunUntilIdle();
+    EXPECT_EQ(i, watcher.reads());
+  }
+}
+
+TEST_F(MessagePumpEpollTest, EdgeTriggeredWatch) {
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  ReadByteWatcher watcher;
+  ASSERT_TRUE(pump_->WatchFileDescriptorEdgeTriggered(
+      pipefds_[0], MessagePumpEpoll::WATCH_READ, &controller, &watcher));
+
+  // Leaving data behind doesn't cause further notifications.
+  WriteByte();
+  WriteByte();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, watcher.reads());
+
+  // New data does.
+  WriteByte();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(2, watcher.reads());
+}
+
+TEST_F(MessagePumpEpollTest, ControllersShareFd) {
+  MessagePumpEpoll::FdWatchController read_controller(FROM_HERE);
+  MessagePumpEpoll::FdWatchController write_controller(FROM_HERE);
+  MessagePumpEpoll::FdWatchController both_controller(FROM_HERE);
+  CountingWatcher read_watcher;
+  CountingWatcher write_watcher;
+  CountingWatcher both_watcher;
+  int fds[2];
+  ASSERT_TRUE(CreateLocalNonBlockingPipe(fds));
+  // The write end of an empty pipe is writable but not readable. Use one-shot
+  // watches, since a writable fd would otherwise keep the loop busy.
+  ASSERT_TRUE(pump_->WatchFileDescriptor(fds[1], false,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &read_controller, &read_watcher));
+  ASSERT_TRUE(pump_->WatchFileDescriptor(fds[1], false,
+                                         MessagePumpEpoll::WATCH_WRITE,
+                                         &write_controller, &write_watcher));
+  ASSERT_TRUE(pump_->WatchFileDescriptor(
+      fds[1], false, MessagePumpEpoll::WATCH_READ_WRITE, &both_controller,
+      &both_watcher));
+  EXPECT_EQ(1u, NumWatchedFds());
+
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(0, read_watcher.reads());
+  EXPECT_EQ(1, write_watcher.writes());
+  EXPECT_EQ(1, both_watcher.writes());
+
+  // Re-arming one controller doesn't re-arm the others.
+  ASSERT_TRUE(pump_->WatchFileDescriptor(
+      fds[1], false, MessagePumpEpoll::WATCH_WRITE, &both_controller,
+      &both_watcher));
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, write_watcher.writes());
+  EXPECT_EQ(2, both_watcher.writes());
+  EXPECT_EQ(0, both_watcher.reads());
+
+  both_controller.StopWatchingFileDescriptor();
+  read_controller.StopWatchingFileDescriptor();
+  EXPECT_EQ(0u, NumWatchedFds());
+  IGNORE_EINTR(close(fds[0]));
+  IGNORE_EINTR(close(fds[1]));
+}
+
+class DeleteWatcher : public MessagePumpEpoll::FdWatcher {
+ public:
+  explicit DeleteWatcher(MessagePumpEpoll::FdWatchController* controller)
+      : controller_(controller) {}
+  ~DeleteWatcher() override { DCHECK(!controller_); }
+
+  // MessagePumpEpoll::FdWatcher interface
+  void OnFileCanReadWithoutBlocking(int /* fd */) override { NOTREACHED(); }
+  void OnFileCanWriteWithoutBlocking(int /* fd */) override {
+    DCHECK(controller_);
+    delete controller_;
+    controller_ = nullptr;
+  }
+
+ private:
+  MessagePumpEpoll::FdWatchController* controller_;
+};
+
+TEST_F(MessagePumpEpollTest, DeleteWatcher) {
+  MessagePumpEpoll::FdWatchController* controller =
+      new MessagePumpEpoll::FdWatchController(FROM_HERE);
+  DeleteWatcher delegate(controller);
+  // Make the write end both readable (hang-up) and writable.
+  IGNORE_EINTR(close(pipefds_[0]));
+  pipefds_[0] = dup(pipefds_[1]);
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[1], false,
+                                         MessagePumpEpoll::WATCH_READ_WRITE,
+                                         controller, &delegate));
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(0u, NumWatchedFds());
+}
+
+class QuitWatcher : public MessagePumpEpoll::FdWatcher {
+ public:
+  explicit QuitWatcher(base::Closure quit_closure)
+      : quit_closure_(std::move(quit_closure)) {}
+
+  // MessagePumpEpoll::FdWatcher interface
+  void OnFileCanReadWithoutBlocking(int /* fd */) override {
+    // Post a closure to the MessageLoop before we quit it.
+    ThreadTaskRunnerHandle::Get()->PostTask(
+        FROM_HERE, BindOnce([] { FAIL() << "Reached fatal closure."; }));
+    quit_closure_.Run();
+  }
+  void OnFileCanWriteWithoutBlocking(int /* fd */) override { NOTREACHED(); }
+
+ private:
+  base::Closure quit_closure_;
+};
+
+// Tests that MessagePumpEpoll quits immediately when it is quit from a
+// watcher.
+TEST_F(MessagePumpEpollTest, QuitWatcher) {
+  RunLoop run_loop;
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  QuitWatcher delegate(run_loop.QuitClosure());
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[0], false,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &controller, &delegate));
+  WriteByte();
+  run_loop.Run();
+}
+
+TEST_F(MessagePumpEpollTest, ControllerOutlivesPump) {
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  CountingWatcher watcher;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[0], true,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &controller, &watcher));
+  loop_.reset();
+  EXPECT_TRUE(controller.StopWatchingFileDescriptor());
+}
+
+TEST_F(MessagePumpEpollTest, FiredOneShotControllerOutlivesPump) {
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  CountingWatcher watcher;
+  ASSERT_TRUE(pump_->WatchFileDescriptor(pipefds_[0], false,
+                                         MessagePumpEpoll::WATCH_READ,
+                                         &controller, &watcher));
+  WriteByte();
+  RunLoop().RunUntilIdle();
+  EXPECT_EQ(1, watcher.reads());
+  std::unique_ptr<MessagePumpEpoll> other_pump(new MessagePumpEpoll);
+  loop_.reset();
+
+  // The controller was detached from the pump when its watch fired, so it
+  // can be used with another one.
+  EXPECT_TRUE(other_pump->WatchFileDescriptor(pipefds_[0], false,
+                                              MessagePumpEpoll::WATCH_READ,
+                                              &controller, &watcher));
+  EXPECT_TRUE(controller.StopWatchingFileDescriptor());
+}
+
+TEST_F(MessagePumpEpollTest, WatchRegularFileFails) {
+  MessagePumpEpoll::FdWatchController controller(FROM_HERE);
+  CountingWatcher watcher;
+  FilePath path;
+  ASSERT_TRUE(CreateTemporaryFile(&path));
+  ScopedFD fd(HANDLE_EINTR(open(path.value().c_str(), O_RDONLY)));
+  ASSERT_TRUE(fd.is_valid());
+  // epoll doesn't support regular files; the failure is reported right away
+  // rather than when the registration is flushed.
+  EXPECT_FALSE(pump_->WatchFileDescriptor(
+      fd.get(), true, MessagePumpEpoll::WATCH_READ, &controller, &watcher));
+  EXPECT_EQ(0u, NumWatchedFds());
+  DeleteFile(path, false);
+}
+
+}  // namespace
+
+}  // namespace base
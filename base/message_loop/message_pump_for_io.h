@@ -7,6 +7,9 @@
 
 // This header is a forwarding header to coalesce the various platform specific
 // types representing MessagePumpForIO.
+//
+// On Linux and Android, defining USE_MESSAGE_PUMP_EPOLL selects
+// MessagePumpEpoll instead of MessagePumpLibevent.
 
 #include "build/build_config.h"
 
@@ -18,6 +21,9 @@
 #include "base/message_loop/message_pump_default.h"
 #elif defined(OS_FUCHSIA)
 #include "base/message_loop/message_pump_fuchsia.h"
+#elif (defined(OS_LINUX) || defined(OS_ANDROID)) && \
+    defined(USE_MESSAGE_PUMP_EPOLL)
+#include "base/message_loop/message_pump_epoll.h"
 #elif defined(OS_POSIX)
 #include "base/message_loop/message_pump_libevent.h"
 #endif
@@ -33,6 +39,9 @@ using MessagePumpForIO = MessagePumpIOSForIO;
 using MessagePumpForIO = MessagePumpDefault;
 #elif defined(OS_FUCHSIA)
 using MessagePumpForIO = MessagePumpFuchsia;
+#elif (defined(OS_LINUX) || defined(OS_ANDROID)) && \
+    defined(USE_MESSAGE_PUMP_EPOLL)
+using MessagePumpForIO = MessagePumpEpoll;
 #elif defined(OS_POSIX)
 using MessagePumpForIO = MessagePumpLibevent;
 #else
@@ -4,12 +4,20 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
 
 #include "base/bind.h"
 #include "base/bind_helpers.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_file.h"
 #include "base/format_macros.h"
 #include "base/memory/ptr_util.h"
 #include "base/message_loop/message_loop.h"
+#include "base/posix/eintr_wrapper.h"
+#include "base/run_loop.h"
 #include "base/single_thread_task_runner.h"
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/condition_variable.h"
@@ -25,6 +33,11 @@
 #include "base/android/java_handler_thread.h"
 #endif
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include "base/message_loop/message_pump_epoll.h"
+#include "base/message_loop/message_pump_libevent.h"
+#endif
+
 namespace base {
 
 class ScheduleWorkTest : public testing::Test {
@@ -240,4 +253,100 @@ TEST_F(ScheduleWorkTest, ThreadTimeToJavaFromFourThreads) {
 }
 #endif
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+
+namespace {
+
+// Reads the byte written to its pipe and, for one-shot watches, re-arms the
+// watch like FileDescriptorWatcher users typically do.
+template <typename Pump>
+class PipeReader : public Pump::FdWatcher {
+ public:
+  PipeReader(Pump* pump, bool persistent)
+      : pump_(pump), persistent_(persistent), controller_(FROM_HERE) {
+    int fds[2];
+    CHECK(CreateLocalNonBlockingPipe(fds));
+    read_fd_.reset(fds[0]);
+    write_fd_.reset(fds[1]);
+    Watch();
+  }
+
+  void Watch() {
+    CHECK(pump_->WatchFileDescriptor(read_fd_.get(), persistent_,
+                                     Pump::WATCH_READ, &controller_, this));
+  }
+
+  void Write() {
+    const char buf = 0;
+    CHECK_EQ(1, HANDLE_EINTR(write(write_fd_.get(), &buf, 1)));
+  }
+
+  // Pump::FdWatcher:
+  void OnFileCanReadWithoutBlocking(int fd) override {
+    char buf;
+    CHECK_EQ(1, HANDLE_EINTR(read(fd, &buf, 1)));
+    if (!persistent_)
+      Watch();
+  }
+  void OnFileCanWriteWithoutBlocking(int fd) override { NOTREACHED(); }
+
+ private:
+  Pump* const pump_;
+  const bool persistent_;
+  ScopedFD read_fd_;
+  ScopedFD write_fd_;
+  typename Pump::FdWatchController controller_;
+
+  DISALLOW_COPY_AND_ASSIGN(PipeReader);
+};
+
+// Measures the time it takes |Pump| to dispatch readiness of |num_pipes|
+// pipes, all of which become readable at once.
+template <typename Pump>
+void RunFdWatchTest(const std::string& pump_name,
+                    size_t num_pipes,
+                    bool persistent) {
+  const size_t kRounds = 1000;
+  Pump* pump = new Pump;
+  MessageLoop loop(WrapUnique(pump));
+  std::vector<std::unique_ptr<PipeReader<Pump>>> readers;
+  for (size_t i = 0; i < num_pipes; i++)
+    readers.push_back(std::make_unique<PipeReader<Pump>>(pump, persistent));
+
+  TimeDelta elapsed;
+  for (size_t round = 0; round < kRounds; round++) {
+    for (auto& reader : readers)
+      reader->Write();
+    TimeTicks start = TimeTicks::Now();
+    RunLoop().RunUntilIdle();
+    elapsed += TimeTicks::Now() - start;
+  }
+
+  perf_test::PrintResult(
+      "fd_watch", "",
+      StringPrintf("%s_%" PRIuS "_pipes_%s", pump_name.c_str(), num_pipes,
+                   persistent ? "persistent" : "one_shot"),
+      elapsed.InNanoseconds() / static_cast<double>(kRounds * num_pipes),
+      "ns/event", true);
+}
+
+void RunFdWatchTests(size_t num_pipes, bool persistent) {
+  RunFdWatchTest<MessagePumpLibevent>("libevent", num_pipes, persistent);
+  RunFdWatchTest<MessagePumpEpoll>("epoll", num_pipes, persistent);
+}
+
+}  // namespace
+
+TEST(MessagePumpFdWatchPerfTest, Persistent) {
+  RunFdWatchTests(1, true);
+  RunFdWatchTests(100, true);
+}
+
+TEST(MessagePumpFdWatchPerfTest, OneShotRearmed) {
+  RunFdWatchTests(1, false);
+  RunFdWatchTests(100, false);
+}
+
+#endif  // defined(OS_LINUX) || defined(OS_ANDROID)
+
 }  // namespace base
@@ -4,8 +4,11 @@
 
 #include "base/metrics/bucket_ranges.h"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 
+#include "base/bits.h"
 #include "base/logging.h"
 
 namespace base {
@@ -92,6 +95,30 @@ BucketRanges::BucketRanges(size_t num_ranges)
 
 BucketRanges::~BucketRanges() = default;
 
+size_t BucketRanges::FindBucket(HistogramBase::Sample value) const {
+  DCHECK_GE(value, ranges_[0]);
+  size_t first;
+  size_t count;
+  if (!buckets_by_bit_length_.empty()) {
+    const size_t bit_length =
+        32 - bits::CountLeadingZeroBits(static_cast<uint32_t>(value));
+    first = buckets_by_bit_length_[bit_length];
+    count = buckets_by_bit_length_[bit_length + 1] - first + 1;
+  } else {
+    first = 0;
+    count = bucket_count();
+  }
+
+  // The comparisons of this binary search compile to conditional moves rather
+  // than to branches, which would often be mispredicted for samples.
+  while (count > 1) {
+    const size_t half = count / 2;
+    first = ranges_[first + half] <= value ? first + half : first;
+    count -= half;
+  }
+  return first;
+}
+
 uint32_t BucketRanges::CalculateChecksum() const {
   // Seed checksum.
   uint32_t checksum = static_cast<uint32_t>(ranges_.size());
@@ -107,6 +134,24 @@ bool BucketRanges::HasValidChecksum() const {
 
 void BucketRanges::ResetChecksum() {
   checksum_ = CalculateChecksum();
+
+  buckets_by_bit_length_.clear();
+  if (ranges_.size() < 2)
+    return;
+  // Samples are never negative, so the bucket of a value is the number of
+  // ranges after the first, but for the last, which aren't above it.
+  buckets_by_bit_length_.resize(33);
+  const auto first = ranges_.begin() + 1;
+  const auto last = ranges_.end() - 1;
+  buckets_by_bit_length_[0] =
+      static_cast<uint32_t>(std::upper_bound(first, last, 0) - first);
+  for (size_t bit_length = 1; bit_length < 32; ++bit_length) {
+    const HistogramBase::Sample smallest = 1 << (bit_length - 1);
+    buckets_by_bit_length_[bit_length] =
+        static_cast<uint32_t>(std::upper_bound(first, last, smallest) - first);
+  }
+  buckets_by_bit_length_[32] = static_cast<uint32_t>(std::upper_bound(
+      first, last, std::numeric_limits<HistogramBase::Sample>::max()) - first);
 }
 
 bool BucketRanges::Equals(const BucketRanges* other) const {
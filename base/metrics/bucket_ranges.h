@@ -44,6 +44,7 @@ class BASE_EXPORT BucketRanges {
     DCHECK_LT(i, ranges_.size());
     DCHECK_GE(value, 0);
     ranges_[i] = value;
+    buckets_by_bit_length_.clear();
   }
   uint32_t checksum() const { return checksum_; }
   void set_checksum(uint32_t checksum) { checksum_ = checksum; }
@@ -54,8 +55,13 @@ class BASE_EXPORT BucketRanges {
   // [0, 1), [1, 3), [3, 7), and [7, INT_MAX).
   size_t bucket_count() const { return ranges_.size() - 1; }
 
+  // Returns the index of the bucket of |value|, which must be within the
+  // ranges.
+  size_t FindBucket(HistogramBase::Sample value) const;
+
   // Checksum methods to verify whether the ranges are corrupted (e.g. bad
-  // memory access).
+  // memory access). ResetChecksum() is called once the ranges are set, so it
+  // also indexes them for FindBucket().
   uint32_t CalculateChecksum() const;
   bool HasValidChecksum() const;
   void ResetChecksum();
@@ -87,6 +93,13 @@ class BASE_EXPORT BucketRanges {
   // noise on UMA dashboard.
   uint32_t checksum_;
 
+  // For each bit length from 0 to 32, the bucket of the smallest value with
+  // that bit length, or of the largest value for 32. The bucket of a value is
+  // then between the entries for its bit length and the next one, which are
+  // only a few buckets apart for exponential ranges. Empty until the ranges
+  // are indexed.
+  std::vector<uint32_t> buckets_by_bit_length_;
+
   // A reference into a global PersistentMemoryAllocator where the ranges
   // information is stored. This allows for the record to be created once and
   // re-used simply by having all histograms with the same ranges use the
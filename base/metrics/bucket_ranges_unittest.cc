@@ -6,6 +6,9 @@
 
 #include <stdint.h>
 
+#include <limits>
+
+#include "base/metrics/histogram.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
@@ -76,6 +79,42 @@ TEST(BucketRangesTest, Checksum) {
 
 // Table was generated similarly to sample code for CRC-32 given on:
 // http://www.w3.org/TR/PNG/#D-CRCAppendix.
+TEST(BucketRangesTest, FindBucket) {
+  BucketRanges ranges(5);
+  ranges.set_range(1, 1);
+  ranges.set_range(2, 3);
+  ranges.set_range(3, 7);
+  ranges.set_range(4, std::numeric_limits<HistogramBase::Sample>::max());
+
+  // Before and after the ranges are indexed.
+  for (int indexed = 0; indexed < 2; ++indexed) {
+    if (indexed)
+      ranges.ResetChecksum();
+    EXPECT_EQ(0u, ranges.FindBucket(0));
+    EXPECT_EQ(1u, ranges.FindBucket(1));
+    EXPECT_EQ(1u, ranges.FindBucket(2));
+    EXPECT_EQ(2u, ranges.FindBucket(3));
+    EXPECT_EQ(2u, ranges.FindBucket(6));
+    EXPECT_EQ(3u, ranges.FindBucket(7));
+    EXPECT_EQ(3u, ranges.FindBucket(1 << 20));
+    EXPECT_EQ(3u, ranges.FindBucket(
+                      std::numeric_limits<HistogramBase::Sample>::max() - 1));
+  }
+}
+
+TEST(BucketRangesTest, FindBucketExhaustive) {
+  const HistogramBase::Sample kMax = 100000;
+  for (size_t bucket_count : {3, 10, 50, 100}) {
+    BucketRanges ranges(bucket_count + 1);
+    Histogram::InitializeBucketRanges(1, kMax, &ranges);
+    for (HistogramBase::Sample value = 0; value < kMax + 10; ++value) {
+      const size_t bucket = ranges.FindBucket(value);
+      ASSERT_LE(ranges.range(bucket), value);
+      ASSERT_GT(ranges.range(bucket + 1), value);
+    }
+  }
+}
+
 TEST(BucketRangesTest, Crc32TableTest) {
   for (int i = 0; i < 256; ++i) {
     uint32_t checksum = i;
@@ -87,6 +87,12 @@ bool DummyHistogram::AddSamplesFromPickle(PickleIterator* iter) {
   return true;
 }
 
+bool DummyHistogram::AddSamplesFromIterator(int64_t sum,
+                                            Count redundant_count,
+                                            SampleCountIterator* iter) {
+  return true;
+}
+
 std::unique_ptr<HistogramSamples> DummyHistogram::SnapshotSamples() const {
   return std::make_unique<DummyHistogramSamples>();
 }
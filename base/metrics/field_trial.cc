@@ -418,7 +418,8 @@ FieldTrial::FieldTrial(const std::string& trial_name,
       forced_(false),
       group_reported_(false),
       trial_registered_(false),
-      ref_(FieldTrialList::FieldTrialAllocator::kReferenceNull) {
+      ref_(FieldTrialList::FieldTrialAllocator::kReferenceNull),
+      shared_params_ref_(FieldTrialList::FieldTrialAllocator::kReferenceNull) {
   DCHECK_GT(total_probability, 0);
   DCHECK(!trial_name_.empty());
   DCHECK(!default_group_name_.empty())
@@ -1090,6 +1091,11 @@ bool FieldTrialList::GetParamsFromSharedMemory(
   if (!field_trial->ref_)
     return false;
 
+  if (field_trial->shared_params_ref_ == field_trial->ref_) {
+    *params = field_trial->shared_params_;
+    return true;
+  }
+
   const FieldTrial::FieldTrialEntry* entry =
       global_->field_trial_allocator_->GetAsObject<FieldTrial::FieldTrialEntry>(
           field_trial->ref_);
@@ -1100,7 +1106,14 @@ bool FieldTrialList::GetParamsFromSharedMemory(
   if (allocated_size < actual_size)
     return false;
 
-  return entry->GetParams(params);
+  if (!entry->GetParams(params))
+    return false;
+
+  // The entry is never changed once written, so its params stay valid until
+  // the trial gets another one.
+  field_trial->shared_params_ = *params;
+  field_trial->shared_params_ref_ = field_trial->ref_;
+  return true;
 }
 
 // static
@@ -274,6 +274,7 @@ class BASE_EXPORT FieldTrial : public RefCounted<FieldTrial> {
   FRIEND_TEST_ALL_PREFIXES(FieldTrialListTest,
                            DoNotAddSimulatedFieldTrialsToAllocator);
   FRIEND_TEST_ALL_PREFIXES(FieldTrialListTest, ClearParamsFromSharedMemory);
+  FRIEND_TEST_ALL_PREFIXES(FieldTrialListTest, AssociateFieldTrialParams);
 
   friend class base::FieldTrialList;
 
@@ -378,6 +379,12 @@ class BASE_EXPORT FieldTrial : public RefCounted<FieldTrial> {
   // Reference to related field trial struct and data in shared memory.
   FieldTrialRef ref_;
 
+  // The params read from shared memory at |shared_params_ref_|, so that they
+  // are only unpickled once as long as that is still |ref_|. Guarded by the
+  // lock of the global FieldTrialList.
+  FieldTrialRef shared_params_ref_;
+  std::map<std::string, std::string> shared_params_;
+
   // When benchmarking is enabled, field trials all revert to the 'default'
   // group.
   static bool enable_benchmarking_;
@@ -646,8 +653,9 @@ class BASE_EXPORT FieldTrialList {
   static size_t GetFieldTrialCount();
 
   // Gets the parameters for |field_trial| from shared memory and stores them in
-  // |params|. This is only exposed for use by FieldTrialParamAssociator and
-  // shouldn't be used by anything else.
+  // |params|. They are unpickled once and then kept by the trial. This is only
+  // exposed for use by FieldTrialParamAssociator and shouldn't be used by
+  // anything else.
   static bool GetParamsFromSharedMemory(
       FieldTrial* field_trial,
       std::map<std::string, std::string>* params);
@@ -1325,6 +1325,14 @@ TEST(FieldTrialListTest, AssociateFieldTrialParams) {
   EXPECT_EQ("value1", new_params["key1"]);
   EXPECT_EQ("value2", new_params["key2"]);
   EXPECT_EQ(2U, new_params.size());
+
+  // Check that the trial keeps the params once fetched from shared memory.
+  FieldTrial* trial = FieldTrialList::Find(trial_name);
+  EXPECT_EQ(trial->ref_, trial->shared_params_ref_);
+  new_params.clear();
+  FieldTrialParamAssociator::GetInstance()->GetFieldTrialParams(trial_name,
+                                                                &new_params);
+  EXPECT_EQ(2U, new_params.size());
 }
 
 #if defined(OS_FUCHSIA)
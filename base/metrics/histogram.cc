@@ -192,13 +192,14 @@ HistogramBase* Histogram::Factory::Build() {
     std::unique_ptr<HistogramBase> tentative_histogram;
     PersistentHistogramAllocator* allocator = GlobalHistogramAllocator::Get();
     if (allocator) {
+      // Samples in persistent memory can't be sharded.
       tentative_histogram = allocator->AllocateHistogram(
           histogram_type_,
           name_,
           minimum_,
           maximum_,
           registered_ranges,
-          flags_,
+          flags_ & ~HistogramBase::kShardedSamples,
           &histogram_ref);
     }
 
@@ -501,7 +502,10 @@ void Histogram::AddCount(int value, int count) {
     NOTREACHED();
     return;
   }
-  unlogged_samples_->Accumulate(value, count);
+  if (flags() & kShardedSamples)
+    GetOrCreateShardedCounts()->Accumulate(value, count);
+  else
+    unlogged_samples_->Accumulate(value, count);
 
   FindAndRunCallback(value);
 }
@@ -527,7 +531,17 @@ std::unique_ptr<HistogramSamples> Histogram::SnapshotDelta() {
   // vector: this way, the next snapshot will include any concurrent updates
   // missed by the current snapshot.
 
-  std::unique_ptr<HistogramSamples> snapshot = SnapshotUnloggedSamples();
+  // The samples of the shards are moved rather than copied, so that the
+  // snapshot below doesn't include later samples which |unlogged_samples_|
+  // wouldn't have.
+  ShardedSampleCounts* sharded_counts = reinterpret_cast<ShardedSampleCounts*>(
+      subtle::Acquire_Load(&sharded_counts_));
+  if (sharded_counts)
+    sharded_counts->MoveTo(unlogged_samples_.get());
+
+  std::unique_ptr<HistogramSamples> snapshot(
+      new SampleVector(unlogged_samples_->id(), bucket_ranges()));
+  snapshot->Add(*unlogged_samples_);
   unlogged_samples_->Subtract(*snapshot);
   logged_samples_->Add(*snapshot);
 
@@ -551,6 +565,12 @@ bool Histogram::AddSamplesFromPickle(PickleIterator* iter) {
   return unlogged_samples_->AddFromPickle(iter);
 }
 
+bool Histogram::AddSamplesFromIterator(int64_t sum,
+                                       Count redundant_count,
+                                       SampleCountIterator* iter) {
+  return unlogged_samples_->AddFromIterator(sum, redundant_count, iter);
+}
+
 // The following methods provide a graphical histogram display.
 void Histogram::WriteHTMLGraph(std::string* output) const {
   // TBD(jar) Write a nice HTML bar chart, with divs an mouse-overs etc.
@@ -608,7 +628,10 @@ Histogram::Histogram(const char* name,
       unlogged_samples_->id(), ranges, logged_meta, logged_counts));
 }
 
-Histogram::~Histogram() = default;
+Histogram::~Histogram() {
+  delete reinterpret_cast<ShardedSampleCounts*>(
+      subtle::NoBarrier_Load(&sharded_counts_));
+}
 
 bool Histogram::PrintEmptyBucket(uint32_t index) const {
   return true;
@@ -672,9 +695,31 @@ std::unique_ptr<SampleVector> Histogram::SnapshotUnloggedSamples() const {
   std::unique_ptr<SampleVector> samples(
       new SampleVector(unlogged_samples_->id(), bucket_ranges()));
   samples->Add(*unlogged_samples_);
+  const ShardedSampleCounts* sharded_counts =
+      reinterpret_cast<ShardedSampleCounts*>(
+          subtle::Acquire_Load(&sharded_counts_));
+  if (sharded_counts)
+    sharded_counts->AddTo(samples.get());
   return samples;
 }
 
+ShardedSampleCounts* Histogram::GetOrCreateShardedCounts() {
+  ShardedSampleCounts* sharded_counts = reinterpret_cast<ShardedSampleCounts*>(
+      subtle::Acquire_Load(&sharded_counts_));
+  if (sharded_counts)
+    return sharded_counts;
+
+  // Racing threads may each create shards; only the first ones are kept.
+  std::unique_ptr<ShardedSampleCounts> new_counts =
+      std::make_unique<ShardedSampleCounts>(bucket_ranges());
+  subtle::AtomicWord existing = subtle::Release_CompareAndSwap(
+      &sharded_counts_, 0,
+      reinterpret_cast<subtle::AtomicWord>(new_counts.get()));
+  if (existing)
+    return reinterpret_cast<ShardedSampleCounts*>(existing);
+  return new_counts.release();
+}
+
 void Histogram::WriteAsciiImpl(bool graph_it,
                                const std::string& newline,
                                std::string* output) const {
@@ -96,6 +96,7 @@ class Pickle;
 class PickleIterator;
 class SampleVector;
 class SampleVectorBase;
+class ShardedSampleCounts;
 
 class BASE_EXPORT Histogram : public HistogramBase {
  public:
@@ -217,6 +218,9 @@ class BASE_EXPORT Histogram : public HistogramBase {
   std::unique_ptr<HistogramSamples> SnapshotFinalDelta() const override;
   void AddSamples(const HistogramSamples& samples) override;
   bool AddSamplesFromPickle(base::PickleIterator* iter) override;
+  bool AddSamplesFromIterator(int64_t sum,
+                              Count redundant_count,
+                              SampleCountIterator* iter) override;
   void WriteHTMLGraph(std::string* output) const override;
   void WriteAscii(std::string* output) const override;
 
@@ -290,6 +294,10 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // Create a copy of unlogged samples.
   std::unique_ptr<SampleVector> SnapshotUnloggedSamples() const;
 
+  // Returns the shards of the samples of a kShardedSamples histogram,
+  // creating them if needed.
+  ShardedSampleCounts* GetOrCreateShardedCounts();
+
   //----------------------------------------------------------------------------
   // Helpers for emitting Ascii graphic.  Each method appends data to output.
 
@@ -326,6 +334,11 @@ class BASE_EXPORT Histogram : public HistogramBase {
   // Accumulation of all samples that have been logged with SnapshotDelta().
   std::unique_ptr<SampleVectorBase> logged_samples_;
 
+  // The ShardedSampleCounts, owned by this histogram, in which a
+  // kShardedSamples histogram accumulates its samples before they are moved
+  // to |unlogged_samples_| by SnapshotDelta(). Created by the first Add().
+  subtle::AtomicWord sharded_counts_ = 0;
+
 #if DCHECK_IS_ON()  // Don't waste memory if it won't be used.
   // Flag to indicate if PrepareFinalDelta has been previously called. It is
   // used to DCHECK that a final delta is not created multiple times.
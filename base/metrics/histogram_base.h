@@ -27,6 +27,7 @@ class HistogramSamples;
 class ListValue;
 class Pickle;
 class PickleIterator;
+class SampleCountIterator;
 
 ////////////////////////////////////////////////////////////////////////////////
 // This enum is used to facilitate deserialization of histograms from other
@@ -131,6 +132,14 @@ class BASE_EXPORT HistogramBase {
     // MemoryAllocator, and that loaded into the Histogram module before this
     // histogram is created.
     kIsPersistent = 0x40,
+
+    // Indicates that the samples of the histogram are accumulated in per-CPU
+    // shards, which are merged when the histogram is snapshotted. This is
+    // for histograms recorded from many threads at high rates, since it
+    // costs a copy of the counts per shard. Only supported by Histogram and
+    // its subclasses, and only while they are not persistent: persistent
+    // samples have to be visible in the shared memory as they are recorded.
+    kShardedSamples = 0x80,
   };
 
   // Histogram data inconsistency types.
@@ -202,6 +211,13 @@ class BASE_EXPORT HistogramBase {
   virtual void AddSamples(const HistogramSamples& samples) = 0;
   virtual bool AddSamplesFromPickle(base::PickleIterator* iter) = 0;
 
+  // Adds the samples of |iter|, whose sum and total count are |sum| and
+  // |redundant_count|, without copying them into a HistogramSamples. Returns
+  // false if they don't fit the buckets of the histogram.
+  virtual bool AddSamplesFromIterator(int64_t sum,
+                                      Count redundant_count,
+                                      SampleCountIterator* iter) = 0;
+
   // Serialize the histogram info into |pickle|.
   // Note: This only serializes the construction arguments of the histogram, but
   // does not serialize the samples.
@@ -4,8 +4,11 @@
 
 #include "base/metrics/histogram_delta_serialization.h"
 
+#include <string.h>
+
 #include "base/logging.h"
 #include "base/metrics/histogram_base.h"
+#include "base/metrics/histogram_samples.h"
 #include "base/metrics/histogram_snapshot_manager.h"
 #include "base/metrics/statistics_recorder.h"
 #include "base/numerics/safe_conversions.h"
@@ -31,6 +34,73 @@ void DeserializeHistogramAndAddSamples(PickleIterator* iter) {
   histogram->AddSamplesFromPickle(iter);
 }
 
+// Bumped when the layout of a batch changes.
+constexpr int kDeltaBatchVersion = 1;
+
+// Appends the values of |column| to |pickle| as one blob.
+template <typename T>
+void WriteColumn(const std::vector<T>& column, Pickle* pickle) {
+  pickle->WriteData(reinterpret_cast<const char*>(column.data()),
+                    checked_cast<int>(column.size() * sizeof(T)));
+}
+
+// Reads a blob written by WriteColumn() into |column|, and sets |size| to its
+// number of values. The blob points into the pickle and may not be aligned.
+template <typename T>
+bool ReadColumn(PickleIterator* iter, const char** column, size_t* size) {
+  int length;
+  if (!iter->ReadData(column, &length) || length % sizeof(T))
+    return false;
+  *size = length / sizeof(T);
+  return true;
+}
+
+template <typename T>
+T GetColumnValue(const char* column, size_t index) {
+  T value;
+  memcpy(&value, column + index * sizeof(T), sizeof(T));
+  return value;
+}
+
+// Iterates over the entries of a histogram in the columns of a batch.
+class BatchSampleCountIterator : public SampleCountIterator {
+ public:
+  BatchSampleCountIterator(const char* mins,
+                           const char* maxes,
+                           const char* counts,
+                           size_t begin,
+                           size_t end)
+      : mins_(mins), maxes_(maxes), counts_(counts), index_(begin), end_(end) {}
+
+  bool Done() const override { return index_ == end_; }
+
+  void Next() override {
+    DCHECK(!Done());
+    ++index_;
+  }
+
+  void Get(HistogramBase::Sample* min,
+           int64_t* max,
+           HistogramBase::Count* count) const override {
+    DCHECK(!Done());
+    if (min)
+      *min = GetColumnValue<HistogramBase::Sample>(mins_, index_);
+    if (max)
+      *max = GetColumnValue<int64_t>(maxes_, index_);
+    if (count)
+      *count = GetColumnValue<HistogramBase::Count>(counts_, index_);
+  }
+
+ private:
+  const char* const mins_;
+  const char* const maxes_;
+  const char* const counts_;
+  size_t index_;
+  const size_t end_;
+
+  DISALLOW_COPY_AND_ASSIGN(BatchSampleCountIterator);
+};
+
 }  // namespace
 
 HistogramDeltaSerialization::HistogramDeltaSerialization(
@@ -54,6 +124,131 @@ void HistogramDeltaSerialization::PrepareAndSerializeDeltas(
   serialized_deltas_ = nullptr;
 }
 
+void HistogramDeltaSerialization::PrepareAndSerializeDeltaBatch(
+    std::string* batch,
+    bool include_persistent) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+
+  batch_definition_count_ = 0;
+  batch_definitions_ = Pickle();
+  batch_name_hashes_.clear();
+  batch_entry_counts_.clear();
+  batch_sums_.clear();
+  batch_redundant_counts_.clear();
+  batch_mins_.clear();
+  batch_maxes_.clear();
+  batch_counts_.clear();
+
+  serializing_batch_ = true;
+  StatisticsRecorder::PrepareDeltas(
+      include_persistent, Histogram::kIPCSerializationSourceFlag,
+      Histogram::kNoFlags, &histogram_snapshot_manager_);
+  serializing_batch_ = false;
+
+  // The definitions are a pickle of their own so that the columns can be
+  // found without parsing them.
+  Pickle pickle;
+  pickle.WriteInt(kDeltaBatchVersion);
+  pickle.WriteInt(batch_definition_count_);
+  pickle.WriteData(static_cast<const char*>(batch_definitions_.data()),
+                   checked_cast<int>(batch_definitions_.size()));
+  WriteColumn(batch_name_hashes_, &pickle);
+  WriteColumn(batch_entry_counts_, &pickle);
+  WriteColumn(batch_sums_, &pickle);
+  WriteColumn(batch_redundant_counts_, &pickle);
+  WriteColumn(batch_mins_, &pickle);
+  WriteColumn(batch_maxes_, &pickle);
+  WriteColumn(batch_counts_, &pickle);
+  batch->assign(static_cast<const char*>(pickle.data()), pickle.size());
+}
+
+void HistogramDeltaSerialization::DeserializeBatchAndAddSamples(
+    const std::string& batch) {
+  DCHECK(thread_checker_.CalledOnValidThread());
+
+  Pickle pickle(batch.data(), checked_cast<int>(batch.size()));
+  PickleIterator iter(pickle);
+  int version;
+  int definition_count;
+  const char* definitions;
+  int definitions_size;
+  if (!iter.ReadInt(&version) || version != kDeltaBatchVersion ||
+      !iter.ReadInt(&definition_count) ||
+      !iter.ReadData(&definitions, &definitions_size) ||
+      definition_count < 0 ||
+      definition_count > definitions_size / static_cast<int>(sizeof(int))) {
+    return;
+  }
+
+  // A definition which doesn't match the local histogram is skipped, and so
+  // are the samples of the histogram.
+  Pickle definitions_pickle(definitions, definitions_size);
+  PickleIterator definitions_iter(definitions_pickle);
+  for (int i = 0; i < definition_count; ++i) {
+    HistogramBase* histogram = DeserializeHistogramInfo(&definitions_iter);
+    if (histogram)
+      received_histograms_[histogram->name_hash()] = histogram;
+  }
+
+  const char* name_hashes;
+  const char* entry_counts;
+  const char* sums;
+  const char* redundant_counts;
+  const char* mins;
+  const char* maxes;
+  const char* counts;
+  size_t histogram_count;
+  size_t entry_counts_size;
+  size_t sums_size;
+  size_t redundant_counts_size;
+  size_t entry_count;
+  size_t maxes_size;
+  size_t counts_size;
+  if (!ReadColumn<uint64_t>(&iter, &name_hashes, &histogram_count) ||
+      !ReadColumn<uint32_t>(&iter, &entry_counts, &entry_counts_size) ||
+      !ReadColumn<int64_t>(&iter, &sums, &sums_size) ||
+      !ReadColumn<HistogramBase::Count>(&iter, &redundant_counts,
+                                        &redundant_counts_size) ||
+      !ReadColumn<HistogramBase::Sample>(&iter, &mins, &entry_count) ||
+      !ReadColumn<int64_t>(&iter, &maxes, &maxes_size) ||
+      !ReadColumn<HistogramBase::Count>(&iter, &counts, &counts_size) ||
+      entry_counts_size != histogram_count || sums_size != histogram_count ||
+      redundant_counts_size != histogram_count || maxes_size != entry_count ||
+      counts_size != entry_count) {
+    return;
+  }
+
+  // Validates the entry counts before adding anything.
+  size_t total_entry_count = 0;
+  for (size_t i = 0; i < histogram_count; ++i) {
+    total_entry_count += GetColumnValue<uint32_t>(entry_counts, i);
+    if (total_entry_count > entry_count)
+      return;
+  }
+  if (total_entry_count != entry_count)
+    return;
+
+  size_t begin = 0;
+  for (size_t i = 0; i < histogram_count; ++i) {
+    const size_t end = begin + GetColumnValue<uint32_t>(entry_counts, i);
+    const auto found =
+        received_histograms_.find(GetColumnValue<uint64_t>(name_hashes, i));
+    if (found == received_histograms_.end()) {
+      // Defined by a batch which wasn't received.
+    } else if (found->second->flags() &
+               HistogramBase::kIPCSerializationSourceFlag) {
+      DVLOG(1) << "Single process mode, histogram observed and not copied: "
+               << found->second->histogram_name();
+    } else {
+      BatchSampleCountIterator samples(mins, maxes, counts, begin, end);
+      found->second->AddSamplesFromIterator(
+          GetColumnValue<int64_t>(sums, i),
+          GetColumnValue<HistogramBase::Count>(redundant_counts, i), &samples);
+    }
+    begin = end;
+  }
+}
+
 // static
 void HistogramDeltaSerialization::DeserializeAndAddSamples(
     const std::vector<std::string>& serialized_deltas) {
@@ -71,6 +266,34 @@ void HistogramDeltaSerialization::RecordDelta(
   DCHECK(thread_checker_.CalledOnValidThread());
   DCHECK_NE(0, snapshot.TotalCount());
 
+  if (serializing_batch_) {
+    const uint64_t name_hash = histogram.name_hash();
+    if (defined_histograms_.insert(name_hash).second) {
+      histogram.SerializeInfo(&batch_definitions_);
+      batch_definition_count_++;
+    }
+
+    uint32_t entry_count = 0;
+    HistogramBase::Sample min;
+    int64_t max;
+    HistogramBase::Count count;
+    for (std::unique_ptr<SampleCountIterator> it = snapshot.Iterator();
+         !it->Done(); it->Next()) {
+      it->Get(&min, &max, &count);
+      if (!count)
+        continue;
+      batch_mins_.push_back(min);
+      batch_maxes_.push_back(max);
+      batch_counts_.push_back(count);
+      ++entry_count;
+    }
+    batch_name_hashes_.push_back(name_hash);
+    batch_entry_counts_.push_back(entry_count);
+    batch_sums_.push_back(snapshot.sum());
+    batch_redundant_counts_.push_back(snapshot.redundant_count());
+    return;
+  }
+
   Pickle pickle;
   histogram.SerializeInfo(&pickle);
   snapshot.Serialize(&pickle);
@@ -5,21 +5,32 @@
 #ifndef BASE_METRICS_HISTOGRAM_DELTA_SERIALIZATION_H_
 #define BASE_METRICS_HISTOGRAM_DELTA_SERIALIZATION_H_
 
+#include <stdint.h>
+
 #include <memory>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "base/base_export.h"
 #include "base/macros.h"
+#include "base/metrics/histogram_base.h"
 #include "base/metrics/histogram_flattener.h"
 #include "base/metrics/histogram_snapshot_manager.h"
+#include "base/pickle.h"
 #include "base/threading/thread_checker.h"
 
 namespace base {
 
-class HistogramBase;
-
 // Serializes and restores histograms deltas.
+//
+// Deltas are serialized either as one string per histogram, or as a single
+// batch with the non-empty buckets of all the histograms in columns. A batch
+// only defines the histograms it has the deltas of the first time, and refers
+// to them by the hash of their name afterwards, so a serializer of batches
+// must only send them to a single deserializer, which remembers the
+// histograms.
 class BASE_EXPORT HistogramDeltaSerialization : public HistogramFlattener {
  public:
   // |caller_name| is string used in histograms for counting inconsistencies.
@@ -40,6 +51,16 @@ class BASE_EXPORT HistogramDeltaSerialization : public HistogramFlattener {
   static void DeserializeAndAddSamples(
       const std::vector<std::string>& serialized_deltas);
 
+  // Like PrepareAndSerializeDeltas() but stores all the deltas in |batch|.
+  void PrepareAndSerializeDeltaBatch(std::string* batch,
+                                     bool include_persistent);
+
+  // Adds the samples of a batch from PrepareAndSerializeDeltaBatch() to the
+  // corresponding histograms, creating them if necessary. Nothing is
+  // allocated for histograms which were defined by earlier batches. Silently
+  // ignores errors in |batch|.
+  void DeserializeBatchAndAddSamples(const std::string& batch);
+
  private:
   // HistogramFlattener implementation.
   void RecordDelta(const HistogramBase& histogram,
@@ -53,6 +74,29 @@ class BASE_EXPORT HistogramDeltaSerialization : public HistogramFlattener {
   // Output buffer for serialized deltas.
   std::vector<std::string>* serialized_deltas_;
 
+  // Whether RecordDelta() adds to the columns of a batch instead.
+  bool serializing_batch_ = false;
+
+  // The definitions and columns of the batch being serialized. Kept between
+  // batches to reuse their memory.
+  int batch_definition_count_ = 0;
+  Pickle batch_definitions_;
+  std::vector<uint64_t> batch_name_hashes_;
+  std::vector<uint32_t> batch_entry_counts_;
+  std::vector<int64_t> batch_sums_;
+  std::vector<HistogramBase::Count> batch_redundant_counts_;
+  std::vector<HistogramBase::Sample> batch_mins_;
+  std::vector<int64_t> batch_maxes_;
+  std::vector<HistogramBase::Count> batch_counts_;
+
+  // The name hashes of the histograms defined by the batches serialized so
+  // far.
+  std::unordered_set<uint64_t> defined_histograms_;
+
+  // The histograms defined by the batches deserialized so far, by the hash of
+  // their name.
+  std::unordered_map<uint64_t, HistogramBase*> received_histograms_;
+
   DISALLOW_COPY_AND_ASSIGN(HistogramDeltaSerialization);
 };
 
@@ -8,6 +8,7 @@
 
 #include "base/metrics/histogram.h"
 #include "base/metrics/histogram_base.h"
+#include "base/metrics/sparse_histogram.h"
 #include "base/metrics/statistics_recorder.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -52,4 +53,63 @@ TEST(HistogramDeltaSerializationTest, DeserializeHistogramAndAddSamples) {
   EXPECT_EQ(2, snapshot2->GetCount(1000));
 }
 
+TEST(HistogramDeltaSerializationTest, DeserializeBatchAndAddSamples) {
+  std::unique_ptr<StatisticsRecorder> statistic_recorder(
+      StatisticsRecorder::CreateTemporaryForTesting());
+  HistogramDeltaSerialization serializer("HistogramDeltaSerializationTest");
+  HistogramDeltaSerialization deserializer("HistogramDeltaSerializationTest");
+  std::string batch;
+  serializer.PrepareAndSerializeDeltaBatch(&batch, true);
+  deserializer.DeserializeBatchAndAddSamples(batch);
+
+  HistogramBase* histogram = Histogram::FactoryGet(
+      "TestHistogram", 1, 1000, 10, HistogramBase::kIPCSerializationSourceFlag);
+  HistogramBase* sparse_histogram = SparseHistogram::FactoryGet(
+      "TestSparseHistogram", HistogramBase::kIPCSerializationSourceFlag);
+  histogram->Add(1);
+  histogram->Add(10);
+  histogram->Add(1000);
+  sparse_histogram->Add(-5);
+  sparse_histogram->Add(7);
+  sparse_histogram->Add(7);
+
+  // The histograms are defined by the first batch with their deltas.
+  serializer.PrepareAndSerializeDeltaBatch(&batch, true);
+  const std::string defining_batch = batch;
+  histogram->Add(10);
+  sparse_histogram->Add(7);
+  serializer.PrepareAndSerializeDeltaBatch(&batch, true);
+  EXPECT_LT(batch.size(), defining_batch.size());
+
+  // The histograms have kIPCSerializationSourceFlag. So samples are ignored.
+  deserializer.DeserializeBatchAndAddSamples(defining_batch);
+  EXPECT_EQ(4, histogram->SnapshotSamples()->TotalCount());
+
+  // Clear kIPCSerializationSourceFlag to emulate multi-process usage.
+  histogram->ClearFlags(HistogramBase::kIPCSerializationSourceFlag);
+  sparse_histogram->ClearFlags(HistogramBase::kIPCSerializationSourceFlag);
+  deserializer.DeserializeBatchAndAddSamples(batch);
+  std::unique_ptr<HistogramSamples> snapshot(histogram->SnapshotSamples());
+  EXPECT_EQ(1, snapshot->GetCount(1));
+  EXPECT_EQ(3, snapshot->GetCount(10));
+  EXPECT_EQ(1, snapshot->GetCount(1000));
+  EXPECT_EQ(1 + 10 + 10 + 1000 + 10, snapshot->sum());
+  std::unique_ptr<HistogramSamples> sparse_snapshot(
+      sparse_histogram->SnapshotSamples());
+  EXPECT_EQ(1, sparse_snapshot->GetCount(-5));
+  EXPECT_EQ(4, sparse_snapshot->GetCount(7));
+  EXPECT_EQ(5, sparse_snapshot->redundant_count());
+
+  // A deserializer which didn't receive the definitions ignores the samples.
+  HistogramDeltaSerialization other_deserializer(
+      "HistogramDeltaSerializationTest");
+  other_deserializer.DeserializeBatchAndAddSamples(batch);
+  EXPECT_EQ(5, histogram->SnapshotSamples()->TotalCount());
+
+  // So does one which receives a truncated batch.
+  deserializer.DeserializeBatchAndAddSamples(
+      batch.substr(0, batch.size() - sizeof(int)));
+  EXPECT_EQ(5, histogram->SnapshotSamples()->TotalCount());
+}
+
 }  // namespace base
@@ -0,0 +1,186 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/histogram.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/metrics/bucket_ranges.h"
+#include "base/metrics/histogram_functions.h"
+#include "base/metrics/histogram_samples.h"
+#include "base/metrics/statistics_recorder.h"
+#include "base/strings/stringprintf.h"
+#include "base/synchronization/waitable_event.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+
+namespace {
+
+constexpr int kSamplesPerThread = 1000000;
+constexpr int kMaxThreads = 64;
+
+// Records latencies like those of requests into a histogram once started.
+class RecordingThread : public SimpleThread {
+ public:
+  RecordingThread(HistogramBase* histogram, WaitableEvent* start)
+      : SimpleThread("HistogramPerfTest"),
+        histogram_(histogram),
+        start_(start) {}
+
+  void Run() override {
+    start_->Wait();
+    for (int i = 0; i < kSamplesPerThread; ++i)
+      histogram_->Add(i % 1000);
+  }
+
+ private:
+  HistogramBase* const histogram_;
+  WaitableEvent* const start_;
+
+  DISALLOW_COPY_AND_ASSIGN(RecordingThread);
+};
+
+class HistogramPerfTest : public testing::Test {
+ protected:
+  HistogramPerfTest()
+      : statistics_recorder_(StatisticsRecorder::CreateTemporaryForTesting()) {}
+
+  // Prints the time per sample of each of |thread_count| threads recording
+  // to the same histogram.
+  void RunRecordingThreads(int32_t flags,
+                           int thread_count,
+                           const std::string& trace) {
+    HistogramBase* histogram = Histogram::FactoryGet(
+        StringPrintf("Latency.%s.%d", trace.c_str(), thread_count), 1, 10000,
+        50, flags);
+    WaitableEvent start(WaitableEvent::ResetPolicy::MANUAL,
+                        WaitableEvent::InitialState::NOT_SIGNALED);
+    std::vector<std::unique_ptr<RecordingThread>> threads;
+    for (int i = 0; i < thread_count; ++i) {
+      threads.push_back(std::make_unique<RecordingThread>(histogram, &start));
+      threads.back()->Start();
+    }
+
+    TimeTicks start_time = TimeTicks::Now();
+    start.Signal();
+    for (const auto& thread : threads)
+      thread->Join();
+    TimeDelta elapsed = TimeTicks::Now() - start_time;
+
+    EXPECT_EQ(thread_count * kSamplesPerThread,
+              histogram->SnapshotSamples()->TotalCount());
+    perf_test::PrintResult(
+        "histogram_add", StringPrintf("_%d_threads", thread_count), trace,
+        elapsed.InNanoseconds() / static_cast<double>(kSamplesPerThread),
+        "ns/sample", true);
+  }
+
+ private:
+  std::unique_ptr<StatisticsRecorder> statistics_recorder_;
+};
+
+}  // namespace
+
+TEST_F(HistogramPerfTest, Add) {
+  for (int threads = 1; threads <= kMaxThreads; threads *= 2)
+    RunRecordingThreads(HistogramBase::kNoFlags, threads, "shared");
+}
+
+TEST_F(HistogramPerfTest, AddSharded) {
+  for (int threads = 1; threads <= kMaxThreads; threads *= 2)
+    RunRecordingThreads(HistogramBase::kShardedSamples, threads, "sharded");
+}
+
+// Creating a histogram computes its ranges, unless another histogram has the
+// same ones.
+TEST_F(HistogramPerfTest, FactoryGet) {
+  constexpr int kHistograms = 1000;
+  std::vector<std::string> names;
+  for (int i = 0; i < kHistograms; ++i)
+    names.push_back(StringPrintf("Latency.Registered.%d", i));
+
+  TimeTicks start_time = TimeTicks::Now();
+  for (int i = 0; i < kHistograms; ++i) {
+    // Distinct maximums so that ranges aren't shared.
+    Histogram::FactoryGet(names[i], 1, 10000 + i, 50, HistogramBase::kNoFlags);
+  }
+  TimeDelta elapsed = TimeTicks::Now() - start_time;
+  perf_test::PrintResult(
+      "histogram_factory_get", "", "create",
+      elapsed.InNanoseconds() / static_cast<double>(kHistograms),
+      "ns/histogram", true);
+
+  start_time = TimeTicks::Now();
+  for (int i = 0; i < kHistograms; ++i)
+    Histogram::FactoryGet(names[i], 1, 10000 + i, 50, HistogramBase::kNoFlags);
+  elapsed = TimeTicks::Now() - start_time;
+  perf_test::PrintResult(
+      "histogram_factory_get", "", "existing",
+      elapsed.InNanoseconds() / static_cast<double>(kHistograms),
+      "ns/histogram", true);
+}
+
+// Times finding the buckets of samples spread over the whole range of an
+// exponential and a linear histogram, and without the index of the ranges.
+TEST_F(HistogramPerfTest, FindBucket) {
+  constexpr int kBucketCount = 100;
+  constexpr HistogramBase::Sample kMax = 1000000;
+  BucketRanges exponential(kBucketCount + 1);
+  Histogram::InitializeBucketRanges(1, kMax, &exponential);
+  BucketRanges linear(kBucketCount + 1);
+  LinearHistogram::InitializeBucketRanges(1, kMax, &linear);
+  // Setting a range drops the index.
+  BucketRanges unindexed(kBucketCount + 1);
+  Histogram::InitializeBucketRanges(1, kMax, &unindexed);
+  unindexed.set_range(0, 0);
+
+  std::vector<HistogramBase::Sample> samples;
+  for (uint32_t i = 0; i < 4096; ++i)
+    samples.push_back((i * 2654435761u) % kMax);
+
+  const std::pair<const BucketRanges*, const char*> cases[] = {
+      {&exponential, "exponential"},
+      {&linear, "linear"},
+      {&unindexed, "exponential_unindexed"}};
+  for (const auto& ranges_and_trace : cases) {
+    const BucketRanges* ranges = ranges_and_trace.first;
+    size_t bucket_sum = 0;
+    TimeTicks start_time = TimeTicks::Now();
+    for (int i = 0; i < kSamplesPerThread; ++i)
+      bucket_sum += ranges->FindBucket(samples[i % samples.size()]);
+    TimeDelta elapsed = TimeTicks::Now() - start_time;
+    EXPECT_GT(bucket_sum, 0u);
+    perf_test::PrintResult(
+        "histogram_find_bucket", "", ranges_and_trace.second,
+        elapsed.InNanoseconds() / static_cast<double>(kSamplesPerThread),
+        "ns/sample", true);
+  }
+}
+
+// Function-style recording looks the histogram up by name for every sample.
+TEST_F(HistogramPerfTest, UmaHistogramFunction) {
+  TimeTicks start_time = TimeTicks::Now();
+  for (int i = 0; i < kSamplesPerThread; ++i)
+    UmaHistogramCounts10000("Latency.Function", i % 1000);
+  TimeDelta elapsed = TimeTicks::Now() - start_time;
+
+  EXPECT_EQ(kSamplesPerThread, StatisticsRecorder::FindHistogram(
+                                   "Latency.Function")
+                                   ->SnapshotSamples()
+                                   ->TotalCount());
+  perf_test::PrintResult(
+      "histogram_add", "_function", "shared",
+      elapsed.InNanoseconds() / static_cast<double>(kSamplesPerThread),
+      "ns/sample", true);
+}
+
+}  // namespace base
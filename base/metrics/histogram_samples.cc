@@ -203,10 +203,15 @@ bool HistogramSamples::AddFromPickle(PickleIterator* iter) {
   if (!iter->ReadInt64(&sum) || !iter->ReadInt(&redundant_count))
     return false;
 
-  IncreaseSumAndCount(sum, redundant_count);
-
   SampleCountPickleIterator pickle_iter(iter);
-  return AddSubtractImpl(&pickle_iter, ADD);
+  return AddFromIterator(sum, redundant_count, &pickle_iter);
+}
+
+bool HistogramSamples::AddFromIterator(int64_t sum,
+                                       HistogramBase::Count redundant_count,
+                                       SampleCountIterator* iter) {
+  IncreaseSumAndCount(sum, redundant_count);
+  return AddSubtractImpl(iter, ADD);
 }
 
 void HistogramSamples::Subtract(const HistogramSamples& other) {
@@ -141,6 +141,12 @@ class BASE_EXPORT HistogramSamples {
   // Add from serialized samples.
   virtual bool AddFromPickle(PickleIterator* iter);
 
+  // Adds the samples of |iter|, whose sum and total count are |sum| and
+  // |redundant_count|.
+  bool AddFromIterator(int64_t sum,
+                       HistogramBase::Count redundant_count,
+                       SampleCountIterator* iter);
+
   virtual void Subtract(const HistogramSamples& other);
 
   virtual std::unique_ptr<SampleCountIterator> Iterator() const = 0;
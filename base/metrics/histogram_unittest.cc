@@ -196,6 +196,42 @@ TEST_P(HistogramTest, DeltaTest) {
   EXPECT_EQ(0, samples->TotalCount());
 }
 
+// Check that the samples of a sharded histogram are snapshotted.
+TEST_P(HistogramTest, ShardedSamplesTest) {
+  HistogramBase* histogram = Histogram::FactoryGet(
+      "ShardedHistogram", 1, 64, 8, HistogramBase::kShardedSamples);
+  // Persistent histograms are never sharded.
+  EXPECT_EQ(!use_persistent_histogram_allocator_,
+            !!(histogram->flags() & HistogramBase::kShardedSamples));
+  histogram->Add(1);
+  histogram->Add(10);
+  histogram->AddCount(50, 2);
+
+  std::unique_ptr<HistogramSamples> samples = histogram->SnapshotSamples();
+  EXPECT_EQ(4, samples->TotalCount());
+  EXPECT_EQ(111, samples->sum());
+
+  samples = histogram->SnapshotDelta();
+  EXPECT_EQ(4, samples->TotalCount());
+  EXPECT_EQ(1, samples->GetCount(1));
+  EXPECT_EQ(1, samples->GetCount(10));
+  EXPECT_EQ(2, samples->GetCount(50));
+  EXPECT_EQ(samples->TotalCount(), samples->redundant_count());
+
+  samples = histogram->SnapshotDelta();
+  EXPECT_EQ(0, samples->TotalCount());
+
+  histogram->Add(10);
+  samples = histogram->SnapshotSamples();
+  EXPECT_EQ(5, samples->TotalCount());
+  EXPECT_EQ(2, samples->GetCount(10));
+
+  samples = histogram->SnapshotFinalDelta();
+  EXPECT_EQ(1, samples->TotalCount());
+  EXPECT_EQ(1, samples->GetCount(10));
+  EXPECT_EQ(10, samples->sum());
+}
+
 // Check that final-delta calculations work correctly.
 TEST_P(HistogramTest, FinalDeltaTest) {
   HistogramBase* histogram =
@@ -14,6 +14,16 @@
 #include <sys/mman.h>
 #endif
 
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+// These may be missing from older system headers.
+#ifndef MADV_HUGEPAGE
+#define MADV_HUGEPAGE 14
+#endif
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23
+#endif
+#endif
+
 #include "base/files/memory_mapped_file.h"
 #include "base/logging.h"
 #include "base/memory/shared_memory.h"
@@ -45,6 +55,14 @@ const uint32_t kBlockCookieQueue = 1;
 const uint32_t kBlockCookieWasted = (uint32_t)-1;
 const uint32_t kBlockCookieAllocated = 0xC8799269;
 
+// Allocations of up to this fraction of the size of a thread region are made
+// from the region. Larger ones would waste too much of its end.
+const uint32_t kThreadRegionShare = 4;
+
+// The usual size of explicit huge pages, which the size of a local segment
+// must be a multiple of for them to be used.
+const size_t kHugePageSize = 2 << 20;  // 2 MiB
+
 // TODO(bcwhite): When acceptable, consider moving flags to std::atomic<char>
 // types rather than combined bitfield.
 
@@ -444,6 +462,10 @@ PersistentMemoryAllocator::~PersistentMemoryAllocator() {
   // some issue with the underlying memory segment. The "Local" allocator
   // makes use of this to allow deletion of the segment on the heap from
   // within its destructor.
+
+  // The regions of other threads are leaked, since they can't be reached.
+  if (thread_regions_)
+    delete static_cast<ThreadRegion*>(thread_regions_->Get());
 }
 
 uint64_t PersistentMemoryAllocator::Id() const {
@@ -488,12 +510,77 @@ void PersistentMemoryAllocator::CreateTrackingHistograms(
       "UMA.PersistentAllocator." + name_string + ".UsedPct", 1, 101, 21,
       HistogramBase::kUmaTargetedHistogramFlag);
 
+  DCHECK(!reusable_histogram_);
+  reusable_histogram_ = LinearHistogram::FactoryGet(
+      "UMA.PersistentAllocator." + name_string + ".ReusablePct", 1, 101, 21,
+      HistogramBase::kUmaTargetedHistogramFlag);
+
   DCHECK(!errors_histogram_);
   errors_histogram_ = SparseHistogram::FactoryGet(
       "UMA.PersistentAllocator." + name_string + ".Errors",
       HistogramBase::kUmaTargetedHistogramFlag);
 }
 
+bool PersistentMemoryAllocator::PrepareMemory(uint32_t options) {
+  if (readonly_ || IsCorrupt())
+    return false;
+  // Heap memory was already realized by zeroing it.
+  if (mem_type_ == MEM_MALLOC)
+    return !(options & PREPARE_HUGE_PAGES);
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // madvise() only accepts whole pages, which an external segment may not
+  // start with.
+  const uintptr_t base = reinterpret_cast<uintptr_t>(mem_base_);
+  const uintptr_t page_mask = ~static_cast<uintptr_t>(vm_page_size_ - 1);
+  const uintptr_t end = (base + mem_size_) & page_mask;
+  bool success = true;
+
+  if (options & PREPARE_HUGE_PAGES) {
+    const uintptr_t begin = (base + vm_page_size_ - 1) & page_mask;
+    if (begin >= end ||
+        madvise(reinterpret_cast<void*>(begin), end - begin,
+                MADV_HUGEPAGE) != 0) {
+      success = false;
+    }
+  }
+
+  if (options & PREPARE_PREFAULT) {
+    // Pages before the free pointer were already touched by allocations.
+    const uintptr_t begin =
+        (base + shared_meta()->freeptr.load(std::memory_order_relaxed)) &
+        page_mask;
+    // Other threads or processes may be allocating from these pages so they
+    // can't be written, even with zeros. MADV_POPULATE_WRITE faults them in
+    // as if they were without changing them. Older kernels don't have it;
+    // reading them at least maps the pages of shared memory and files.
+    if (begin < end &&
+        madvise(reinterpret_cast<void*>(begin), end - begin,
+                MADV_POPULATE_WRITE) != 0) {
+      for (uintptr_t page = begin; page < end; page += vm_page_size_)
+        *reinterpret_cast<volatile const char*>(page);
+    }
+  }
+
+  return success;
+#else
+  // Other systems have no such advice; their segments are prepared enough.
+  return !(options & PREPARE_HUGE_PAGES);
+#endif
+}
+
+void PersistentMemoryAllocator::SetThreadRegionSize(size_t region_size) {
+  DCHECK(!readonly_);
+  // Like any allocation, a region can't cross a page.
+  region_size = std::min<size_t>(region_size, mem_page_);
+  thread_region_size_ =
+      static_cast<uint32_t>(region_size & ~(kAllocAlignment - 1));
+  if (thread_region_size_ && !thread_regions_) {
+    thread_regions_ = std::make_unique<ThreadLocalStorage::Slot>(
+        [](void* region) { delete static_cast<ThreadRegion*>(region); });
+  }
+}
+
 void PersistentMemoryAllocator::Flush(bool sync) {
   FlushPartial(used(), sync);
 }
@@ -614,7 +701,24 @@ bool PersistentMemoryAllocator::ChangeType(Reference ref,
 PersistentMemoryAllocator::Reference PersistentMemoryAllocator::Allocate(
     size_t req_size,
     uint32_t type_id) {
-  Reference ref = AllocateImpl(req_size, type_id);
+  Reference ref = kReferenceNull;
+  FreeList* list = free_list_count_ ? GetFreeList(type_id) : nullptr;
+  if (list && req_size <= list->size) {
+    // A popped block can still be taken by another process which finds it
+    // by iteration, in which case its type doesn't change.
+    while (!ref) {
+      ref = PopFreeBlock(list);
+      if (!ref)
+        break;
+      if (!ChangeType(ref, type_id, list->free_type_id, /*clear=*/true))
+        ref = kReferenceNull;
+    }
+  }
+  if (!ref) {
+    DCHECK(!list || req_size <= list->size);
+    ref = AllocateImpl(
+        list ? std::max<size_t>(req_size, list->size) : req_size, type_id);
+  }
   if (ref) {
     // Success: Record this allocation in usage stats (if active).
     if (allocs_histogram_)
@@ -646,6 +750,65 @@ PersistentMemoryAllocator::Reference PersistentMemoryAllocator::AllocateImpl(
     return kReferenceNull;
   }
 
+  if (thread_region_size_ && size <= thread_region_size_ / kThreadRegionShare)
+    return AllocateFromThreadRegion(size, type_id);
+
+  const Reference ref = ReserveSpan(&size, true);
+  if (!ref)
+    return kReferenceNull;
+  return InitializeBlock(ref, size, type_id);
+}
+
+PersistentMemoryAllocator::Reference
+PersistentMemoryAllocator::AllocateFromThreadRegion(uint32_t size,
+                                                    uint32_t type_id) {
+  ThreadRegion* region = static_cast<ThreadRegion*>(thread_regions_->Get());
+  if (!region) {
+    region = new ThreadRegion;
+    thread_regions_->Set(region);
+  }
+
+  if (region->end - region->next < size) {
+    // Mark what is left of the current region as wasted, like the end of a
+    // page, and reserve a new one. If there isn't enough space left for a
+    // whole region, the allocation reserves its own memory.
+    const uint32_t region_free = region->end - region->next;
+    if (region_free >= sizeof(BlockHeader)) {
+      volatile BlockHeader* const block =
+          GetBlock(region->next, 0, 0, false, true);
+      block->size = region_free;
+      block->cookie = kBlockCookieWasted;
+    }
+    region->next = region->end = 0;
+
+    uint32_t region_size = thread_region_size_;
+    const Reference ref = ReserveSpan(&region_size, false);
+    if (!ref) {
+      if (IsCorrupt())
+        return kReferenceNull;
+      const Reference own_ref = ReserveSpan(&size, true);
+      if (!own_ref)
+        return kReferenceNull;
+      return InitializeBlock(own_ref, size, type_id);
+    }
+    region->next = ref;
+    region->end = ref + region_size;
+  }
+
+  // Like at the end of a page, don't leave a slice too small for anything.
+  if (region->end - region->next - size < sizeof(BlockHeader) + kAllocAlignment)
+    size = region->end - region->next;
+
+  const Reference ref = region->next;
+  region->next += size;
+  return InitializeBlock(ref, size, type_id);
+}
+
+PersistentMemoryAllocator::Reference PersistentMemoryAllocator::ReserveSpan(
+    uint32_t* size_ptr,
+    bool mark_full) {
+  /* const */ uint32_t size = *size_ptr;
+
   // Get the current start of unallocated memory. Other threads may
   // update this at any time and cause us to retry these operations.
   // This value should be treated as "const" to avoid confusion through
@@ -663,7 +826,8 @@ PersistentMemoryAllocator::Reference PersistentMemoryAllocator::AllocateImpl(
       return kReferenceNull;
 
     if (freeptr + size > mem_size_) {
-      SetFlag(&shared_meta()->flags, kFlagFull);
+      if (mark_full)
+        SetFlag(&shared_meta()->flags, kFlagFull);
       return kReferenceNull;
     }
 
@@ -718,50 +882,170 @@ PersistentMemoryAllocator::Reference PersistentMemoryAllocator::AllocateImpl(
       continue;
     }
 
-    // Given that all memory was zeroed before ever being given to an instance
-    // of this class and given that we only allocate in a monotomic fashion
-    // going forward, it must be that the newly allocated block is completely
-    // full of zeros. If we find anything in the block header that is NOT a
-    // zero then something must have previously run amuck through memory,
-    // writing beyond the allocated space and into unallocated space.
-    if (block->size != 0 ||
-        block->cookie != kBlockCookieFree ||
-        block->type_id.load(std::memory_order_relaxed) != 0 ||
-        block->next.load(std::memory_order_relaxed) != 0) {
-      SetCorrupt();
-      return kReferenceNull;
-    }
+    *size_ptr = size;
+    return freeptr;
+  }
+}
 
-    // Make sure the memory exists by writing to the first byte of every memory
-    // page it touches beyond the one containing the block header itself.
-    // As the underlying storage is often memory mapped from disk or shared
-    // space, sometimes things go wrong and those address don't actually exist
-    // leading to a SIGBUS (or Windows equivalent) at some arbitrary location
-    // in the code. This should concentrate all those failures into this
-    // location for easy tracking and, eventually, proper handling.
-    volatile char* mem_end = reinterpret_cast<volatile char*>(block) + size;
-    volatile char* mem_begin = reinterpret_cast<volatile char*>(
-        (reinterpret_cast<uintptr_t>(block) + sizeof(BlockHeader) +
-         (vm_page_size_ - 1)) &
-        ~static_cast<uintptr_t>(vm_page_size_ - 1));
-    for (volatile char* memory = mem_begin; memory < mem_end;
-         memory += vm_page_size_) {
-      // It's required that a memory segment start as all zeros and thus the
-      // newly allocated block is all zeros at this point. Thus, writing a
-      // zero to it allows testing that the memory exists without actually
-      // changing its contents. The compiler doesn't know about the requirement
-      // and so cannot optimize-away these writes.
-      *memory = 0;
+PersistentMemoryAllocator::Reference PersistentMemoryAllocator::InitializeBlock(
+    Reference ref,
+    uint32_t size,
+    uint32_t type_id) {
+  volatile BlockHeader* const block = GetBlock(ref, 0, 0, false, true);
+  if (!block) {
+    SetCorrupt();
+    return kReferenceNull;
+  }
+
+  // Given that all memory was zeroed before ever being given to an instance
+  // of this class and given that we only allocate in a monotomic fashion
+  // going forward, it must be that the newly allocated block is completely
+  // full of zeros. If we find anything in the block header that is NOT a
+  // zero then something must have previously run amuck through memory,
+  // writing beyond the allocated space and into unallocated space.
+  if (block->size != 0 ||
+      block->cookie != kBlockCookieFree ||
+      block->type_id.load(std::memory_order_relaxed) != 0 ||
+      block->next.load(std::memory_order_relaxed) != 0) {
+    SetCorrupt();
+    return kReferenceNull;
+  }
+
+  // Make sure the memory exists by writing to the first byte of every memory
+  // page it touches beyond the one containing the block header itself.
+  // As the underlying storage is often memory mapped from disk or shared
+  // space, sometimes things go wrong and those address don't actually exist
+  // leading to a SIGBUS (or Windows equivalent) at some arbitrary location
+  // in the code. This should concentrate all those failures into this
+  // location for easy tracking and, eventually, proper handling.
+  volatile char* mem_end = reinterpret_cast<volatile char*>(block) + size;
+  volatile char* mem_begin = reinterpret_cast<volatile char*>(
+      (reinterpret_cast<uintptr_t>(block) + sizeof(BlockHeader) +
+       (vm_page_size_ - 1)) &
+      ~static_cast<uintptr_t>(vm_page_size_ - 1));
+  for (volatile char* memory = mem_begin; memory < mem_end;
+       memory += vm_page_size_) {
+    // It's required that a memory segment start as all zeros and thus the
+    // newly allocated block is all zeros at this point. Thus, writing a
+    // zero to it allows testing that the memory exists without actually
+    // changing its contents. The compiler doesn't know about the requirement
+    // and so cannot optimize-away these writes.
+    *memory = 0;
+  }
+
+  // Load information into the block header. There is no "release" of the
+  // data here because this memory can, currently, be seen only by the thread
+  // performing the allocation. When it comes time to share this, the thread
+  // will call MakeIterable() which does the release operation.
+  block->size = size;
+  block->cookie = kBlockCookieAllocated;
+  block->type_id.store(type_id, std::memory_order_relaxed);
+  return ref;
+}
+
+void PersistentMemoryAllocator::EnableReuse(uint32_t type_id,
+                                            uint32_t free_type_id,
+                                            size_t size) {
+  DCHECK(!readonly_);
+  DCHECK(!GetFreeList(type_id));
+  DCHECK_NE(type_id, free_type_id);
+  CHECK_LT(free_list_count_, static_cast<size_t>(kMaxReusableTypes));
+  // The link to the next free block is stored in the data.
+  size = std::max(size, sizeof(uint32_t));
+  CHECK_LE(size, mem_page_ - sizeof(BlockHeader));
+
+  FreeList* list = &free_lists_[free_list_count_];
+  list->type_id = type_id;
+  list->free_type_id = free_type_id;
+  list->size = static_cast<uint32_t>(size);
+
+  Iterator iter(this);
+  for (Reference ref = iter.GetNextOfType(free_type_id); ref;
+       ref = iter.GetNextOfType(free_type_id)) {
+    if (GetAllocSize(ref) >= size)
+      PushFreeBlock(list, ref);
+  }
+  ++free_list_count_;
+}
+
+bool PersistentMemoryAllocator::Free(Reference ref, uint32_t type_id) {
+  DCHECK(!readonly_);
+  FreeList* list = GetFreeList(type_id);
+  DCHECK(list) << "type " << type_id << " isn't reusable";
+  if (!list || GetAllocSize(ref) < list->size)
+    return false;
+  if (!ChangeType(ref, list->free_type_id, type_id, /*clear=*/true))
+    return false;
+  PushFreeBlock(list, ref);
+  return true;
+}
+
+PersistentMemoryAllocator::FreeList* PersistentMemoryAllocator::GetFreeList(
+    uint32_t type_id) {
+  for (size_t i = 0; i < free_list_count_; ++i) {
+    if (free_lists_[i].type_id == type_id)
+      return &free_lists_[i];
+  }
+  return nullptr;
+}
+
+void PersistentMemoryAllocator::PushFreeBlock(FreeList* list, Reference ref) {
+  volatile std::atomic<uint32_t>* const link =
+      reinterpret_cast<volatile std::atomic<uint32_t>*>(
+          GetBlockData(ref, list->free_type_id, sizeof(uint32_t)));
+  if (!link)
+    return;
+
+  uint64_t head = list->head.load(std::memory_order_relaxed);
+  for (;;) {
+    link->store(static_cast<Reference>(head), std::memory_order_relaxed);
+    const uint64_t new_head =
+        ((head >> 32) + 1) << 32 | static_cast<uint64_t>(ref);
+    // Release the link, and the clearing of the block, to the thread which
+    // pops it.
+    if (list->head.compare_exchange_weak(head, new_head,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+      break;
     }
+  }
+  list->length.fetch_add(1, std::memory_order_relaxed);
+}
 
-    // Load information into the block header. There is no "release" of the
-    // data here because this memory can, currently, be seen only by the thread
-    // performing the allocation. When it comes time to share this, the thread
-    // will call MakeIterable() which does the release operation.
-    block->size = size;
-    block->cookie = kBlockCookieAllocated;
-    block->type_id.store(type_id, std::memory_order_relaxed);
-    return freeptr;
+PersistentMemoryAllocator::Reference PersistentMemoryAllocator::PopFreeBlock(
+    FreeList* list) {
+  uint64_t head = list->head.load(std::memory_order_acquire);
+  for (;;) {
+    const Reference ref = static_cast<Reference>(head);
+    if (!ref)
+      return kReferenceNull;
+
+    // The link is trusted only while |ref| is still a free block of this
+    // list. It may have been popped and reused by this process since |head|
+    // was read, in which case the exchange below fails, or taken by another
+    // process that found it through iteration and wrote over the link, in
+    // which case the rest of the list can't be followed and is dropped. The
+    // dropped blocks keep their free type for allocators enabling reuse later.
+    const volatile std::atomic<uint32_t>* const link =
+        reinterpret_cast<const volatile std::atomic<uint32_t>*>(
+            GetBlockData(ref, list->free_type_id, sizeof(uint32_t)));
+    Reference next = link ? link->load(std::memory_order_relaxed) : 0;
+    const bool dropped =
+        !link || (next && !GetBlock(next, list->free_type_id,
+                                    sizeof(uint32_t), false, false));
+    if (dropped)
+      next = kReferenceNull;
+    const uint64_t new_head =
+        ((head >> 32) + 1) << 32 | static_cast<uint64_t>(next);
+    if (list->head.compare_exchange_weak(head, new_head,
+                                         std::memory_order_acquire,
+                                         std::memory_order_acquire)) {
+      if (dropped)
+        list->length.store(0, std::memory_order_relaxed);
+      else
+        list->length.fetch_sub(1, std::memory_order_relaxed);
+      return link ? ref : kReferenceNull;
+    }
   }
 }
 
@@ -941,6 +1225,19 @@ void PersistentMemoryAllocator::UpdateTrackingHistograms() {
         ((meminfo.total - meminfo.free) * 100ULL / meminfo.total));
     used_histogram_->Add(used_percent);
   }
+  if (reusable_histogram_ && free_list_count_) {
+    // The share of the used memory that is waiting in free lists.
+    uint64_t reusable = 0;
+    for (size_t i = 0; i < free_list_count_; ++i) {
+      const FreeList& list = free_lists_[i];
+      reusable += static_cast<uint64_t>(
+                      list.length.load(std::memory_order_relaxed)) *
+                  (list.size + sizeof(BlockHeader));
+    }
+    const size_t used_memory = std::max<size_t>(used(), 1);
+    reusable_histogram_->Add(static_cast<HistogramBase::Sample>(
+        std::min<uint64_t>(reusable * 100 / used_memory, 100)));
+  }
 }
 
 
@@ -950,16 +1247,27 @@ LocalPersistentMemoryAllocator::LocalPersistentMemoryAllocator(
     size_t size,
     uint64_t id,
     base::StringPiece name)
-    : PersistentMemoryAllocator(AllocateLocalMemory(size),
+    : PersistentMemoryAllocator(AllocateLocalMemory(size, 0),
                                 size, 0, id, name, false) {}
 
+LocalPersistentMemoryAllocator::LocalPersistentMemoryAllocator(
+    size_t size,
+    uint64_t id,
+    base::StringPiece name,
+    uint32_t options)
+    : PersistentMemoryAllocator(AllocateLocalMemory(size, options),
+                                size, 0, id, name, false) {
+  PrepareMemory(options);
+}
+
 LocalPersistentMemoryAllocator::~LocalPersistentMemoryAllocator() {
   DeallocateLocalMemory(const_cast<char*>(mem_base_), mem_size_, mem_type_);
 }
 
 // static
 PersistentMemoryAllocator::Memory
-LocalPersistentMemoryAllocator::AllocateLocalMemory(size_t size) {
+LocalPersistentMemoryAllocator::AllocateLocalMemory(size_t size,
+                                                    uint32_t options) {
   void* address;
 
 #if defined(OS_WIN)
@@ -970,6 +1278,17 @@ LocalPersistentMemoryAllocator::AllocateLocalMemory(size_t size) {
   UmaHistogramSparse("UMA.LocalPersistentMemoryAllocator.Failures.Win",
                      ::GetLastError());
 #elif defined(OS_POSIX) || defined(OS_FUCHSIA)
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  // Explicit huge pages only exist if the administrator reserved some, so
+  // fall back to regular memory when there are none.
+  if ((options & PREPARE_HUGE_PAGES) && size % kHugePageSize == 0) {
+    address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_ANON | MAP_SHARED | MAP_HUGETLB, -1, 0);
+    if (address != MAP_FAILED)
+      return Memory(address, MEM_VIRTUAL);
+  }
+#endif
+
   // MAP_ANON is deprecated on Linux but MAP_ANONYMOUS is not universal on Mac.
   // MAP_SHARED is not available on Linux <2.4 but required on Mac.
   address = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
@@ -17,6 +17,7 @@
 #include "base/gtest_prod_util.h"
 #include "base/macros.h"
 #include "base/strings/string_piece.h"
+#include "base/threading/thread_local_storage.h"
 
 namespace base {
 
@@ -119,6 +120,17 @@ class BASE_EXPORT PersistentMemoryAllocator {
     MEMORY_USER_DEFINED = 100,
   };
 
+  // Options for PrepareMemory(), which can be combined.
+  enum MemoryPreparation : uint32_t {
+    // Back the segment with huge pages, to make fewer TLB misses and page
+    // faults.
+    PREPARE_HUGE_PAGES = 1 << 0,
+
+    // Fault in the pages of the unallocated memory now rather than when
+    // allocations first touch them.
+    PREPARE_PREFAULT = 1 << 1,
+  };
+
   // Iterator for going through all iterable memory records in an allocator.
   // Like the allocator itself, iterators are lock-free and thread-secure.
   // That means that multiple threads can share an iterator and the same
@@ -252,6 +264,10 @@ class BASE_EXPORT PersistentMemoryAllocator {
     kSizeAny = 1  // Constant indicating that any array size is acceptable.
   };
 
+  enum : size_t {
+    kMaxReusableTypes = 4  // The number of types EnableReuse() accepts.
+  };
+
   // This is the standard file extension (suitable for being passed to the
   // AddExtension() method of base::FilePath) for dumps of persistent memory.
   static const base::FilePath::CharType kFileExtension[];
@@ -318,8 +334,25 @@ class BASE_EXPORT PersistentMemoryAllocator {
   // with the following histograms:
   //    UMA.PersistentAllocator.name.Errors
   //    UMA.PersistentAllocator.name.UsedPct
+  //    UMA.PersistentAllocator.name.ReusablePct
   void CreateTrackingHistograms(base::StringPiece name);
 
+  // Tells the OS how the memory of the segment is going to be used, as a
+  // combination of MemoryPreparation |options|. This is only advisory: the
+  // contents of the memory don't change, and options that aren't supported
+  // by the OS or the type of memory are ignored. Returns true if all of the
+  // |options| were applied.
+  bool PrepareMemory(uint32_t options);
+
+  // Has each thread carve its small allocations out of a region of
+  // |region_size| bytes which it reserves at once, so that threads creating
+  // objects concurrently don't all contend on the shared free pointer. Any
+  // memory left at the end of a region is wasted once its thread exits or
+  // needs a new region. This must be called before other threads allocate;
+  // a size of zero has all allocations reserve their own memory, which is
+  // the default.
+  void SetThreadRegionSize(size_t region_size);
+
   // Flushes the persistent memory to any backing store. This typically does
   // nothing but is used by the FilePersistentMemoryAllocator to inform the
   // OS that all the data should be sent to the disk immediately. This is
@@ -499,6 +532,23 @@ class BASE_EXPORT PersistentMemoryAllocator {
   // larger and will always be a multiple of 8 bytes (64 bits).
   Reference Allocate(size_t size, uint32_t type_id);
 
+  // Enables the reuse of the blocks of |type_id|, which must then all be
+  // allocated with at most |size| bytes; they get exactly that. Blocks passed
+  // to Free() are retagged as |free_type_id| and kept in a free list, from
+  // which allocations of |type_id| are made before reserving new memory.
+  // Blocks of |free_type_id| already made iterable, such as by an earlier
+  // user of the segment, are reused too. This must be called before other
+  // threads allocate the type, for at most kMaxReusableTypes types.
+  void EnableReuse(uint32_t type_id, uint32_t free_type_id, size_t size);
+
+  // Makes the block |ref| of the reusable |type_id| available to a later
+  // allocation, clearing its memory. The block keeps its position in
+  // iteration. Like ChangeType(), this doesn't invalidate existing pointers
+  // to it: readers which find objects by iteration while others are freed
+  // must check that the type is unchanged after reading one. Returns false
+  // if the block isn't of |type_id| or is smaller than its reusable size.
+  bool Free(Reference ref, uint32_t type_id);
+
   // Allocate and construct an object in persistent memory. The type must have
   // both (size_t) kExpectedInstanceSize and (uint32_t) kPersistentTypeId
   // static constexpr fields that are used to ensure compatibility between
@@ -645,9 +695,52 @@ class BASE_EXPORT PersistentMemoryAllocator {
     return reinterpret_cast<SharedMetadata*>(const_cast<char*>(mem_base_));
   }
 
+  // The region from which a thread makes its allocations. See
+  // SetThreadRegionSize().
+  struct ThreadRegion {
+    Reference next = 0;
+    Reference end = 0;
+  };
+
+  // The free blocks of a reusable type, as a lock-free stack linked through
+  // the first word of their data. See EnableReuse().
+  struct FreeList {
+    uint32_t type_id = 0;
+    uint32_t free_type_id = 0;
+    uint32_t size = 0;
+    // The reference at the top of the stack in the low half and, so that a
+    // top which was popped and pushed again doesn't look unchanged, a count
+    // of the changes in the high half.
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint32_t> length{0};
+  };
+
   // Actual method for doing the allocation.
   Reference AllocateImpl(size_t size, uint32_t type_id);
 
+  // Returns the free list of |type_id|, or null if it isn't reusable.
+  FreeList* GetFreeList(uint32_t type_id);
+
+  // Pushes the free block |ref| to |list| or pops one from it. A popped block
+  // still has the free type.
+  void PushFreeBlock(FreeList* list, Reference ref);
+  Reference PopFreeBlock(FreeList* list);
+
+  // Allocates |size| bytes, already aligned, from the region of the calling
+  // thread, reserving a new region if needed.
+  Reference AllocateFromThreadRegion(uint32_t size, uint32_t type_id);
+
+  // Moves the free pointer past a span of |*size| bytes and returns its
+  // start. |*size| is increased if the rest of the page would be too small
+  // for any allocation. Returns a null reference if the segment is full or
+  // corrupt; the segment is only flagged as full if |mark_full|, since a
+  // smaller span may still fit.
+  Reference ReserveSpan(uint32_t* size, bool mark_full);
+
+  // Checks that the newly reserved span at |ref| is unused, faults in its
+  // memory and writes the header of a block of |size| and |type_id| there.
+  Reference InitializeBlock(Reference ref, uint32_t size, uint32_t type_id);
+
   // Get the block header associated with a specific reference.
   const volatile BlockHeader* GetBlock(Reference ref, uint32_t type_id,
                                        uint32_t size, bool queue_ok,
@@ -680,6 +773,16 @@ class BASE_EXPORT PersistentMemoryAllocator {
   HistogramBase* used_histogram_;    // Histogram recording used space.
   HistogramBase* errors_histogram_;  // Histogram recording errors.
 
+  HistogramBase* reusable_histogram_ = nullptr;  // Records free-listed space.
+
+  // The reusable types; only the first |free_list_count_| are used.
+  FreeList free_lists_[kMaxReusableTypes];
+  size_t free_list_count_ = 0;
+
+  // The ThreadRegion of each thread, while |thread_region_size_| isn't zero.
+  uint32_t thread_region_size_ = 0;
+  std::unique_ptr<ThreadLocalStorage::Slot> thread_regions_;
+
   friend class PersistentMemoryAllocatorTest;
   FRIEND_TEST_ALL_PREFIXES(PersistentMemoryAllocatorTest, AllocateAndIterate);
   DISALLOW_COPY_AND_ASSIGN(PersistentMemoryAllocator);
@@ -695,13 +798,22 @@ class BASE_EXPORT LocalPersistentMemoryAllocator
  public:
   LocalPersistentMemoryAllocator(size_t size, uint64_t id,
                                  base::StringPiece name);
+
+  // Prepares the memory with the MemoryPreparation |options|. With
+  // PREPARE_HUGE_PAGES, explicit huge pages are used if the OS has some
+  // reserved and |size| is a multiple of their size.
+  LocalPersistentMemoryAllocator(size_t size,
+                                 uint64_t id,
+                                 base::StringPiece name,
+                                 uint32_t options);
   ~LocalPersistentMemoryAllocator() override;
 
  private:
   // Allocates a block of local memory of the specified |size|, ensuring that
   // the memory will not be physically allocated until accessed and will read
-  // as zero when that happens.
-  static Memory AllocateLocalMemory(size_t size);
+  // as zero when that happens. The memory is made of explicit huge pages if
+  // |options| has PREPARE_HUGE_PAGES and some are available.
+  static Memory AllocateLocalMemory(size_t size, uint32_t options);
 
   // Deallocates a block of local |memory| of the specified |size|.
   static void DeallocateLocalMemory(void* memory, size_t size, MemoryType type);
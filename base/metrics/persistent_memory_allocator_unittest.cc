@@ -17,6 +17,8 @@
 #include "base/strings/stringprintf.h"
 #include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
+#include "base/test/gtest_util.h"
+#include "base/test/metrics/histogram_tester.h"
 #include "base/threading/simple_thread.h"
 #include "testing/gmock/include/gmock/gmock.h"
 
@@ -365,6 +367,212 @@ TEST_F(PersistentMemoryAllocatorTest, ParallelismTest) {
             t5.iterable());
 }
 
+// A thread that repeatedly allocates small chunks from a shared allocator and
+// makes them iterable until no more can be done.
+class SharedAllocatorThread : public SimpleThread {
+ public:
+  SharedAllocatorThread(const std::string& name,
+                        PersistentMemoryAllocator* allocator)
+      : SimpleThread(name, Options()), count_(0), allocator_(allocator) {}
+
+  void Run() override {
+    for (;;) {
+      Reference block = allocator_->Allocate(RandInt(1, 99), 100);
+      if (!block)
+        break;
+      allocator_->MakeIterable(block);
+      count_++;
+    }
+  }
+
+  unsigned count() { return count_; }
+
+ private:
+  unsigned count_;
+  PersistentMemoryAllocator* const allocator_;
+};
+
+TEST_F(PersistentMemoryAllocatorTest, ThreadRegionTest) {
+  allocator_->SetThreadRegionSize(1024);
+
+  // Small allocations follow each other in the region of the thread.
+  Reference block1 = allocator_->Allocate(24, 1);
+  Reference block2 = allocator_->Allocate(24, 2);
+  ASSERT_NE(0U, block1);
+  EXPECT_EQ(block1 + 24 + 16, block2);
+
+  // Larger ones reserve their own memory, after the region.
+  Reference block3 = allocator_->Allocate(512, 3);
+  EXPECT_LE(block1 + 1024, block3);
+
+  // Filling the region moves to a new one.
+  Reference block4 = 0;
+  for (Reference last = block2; last < block1 + 1024; last = block4)
+    block4 = allocator_->Allocate(24, 4);
+  EXPECT_LT(block3, block4);
+  EXPECT_EQ(4U, allocator_->GetType(block4));
+  EXPECT_FALSE(allocator_->IsCorrupt());
+}
+
+// Near the end of the segment, where a whole region no longer fits, small
+// allocations reserve their own memory without the segment being full.
+TEST_F(PersistentMemoryAllocatorTest, ThreadRegionNearEndTest) {
+  while (allocator_->size() - allocator_->used() >= 2048)
+    ASSERT_NE(0U, allocator_->Allocate(1000, 1));
+  while (allocator_->size() - allocator_->used() >= 1024)
+    ASSERT_NE(0U, allocator_->Allocate(24, 1));
+  allocator_->SetThreadRegionSize(1024);
+
+  Reference block1 = allocator_->Allocate(24, 2);
+  Reference block2 = allocator_->Allocate(24, 3);
+  ASSERT_NE(0U, block1);
+  EXPECT_EQ(block1 + 24 + 16, block2);
+  EXPECT_FALSE(allocator_->IsFull());
+  EXPECT_FALSE(allocator_->IsCorrupt());
+}
+
+// Threads allocating from their own regions never overlap, which would be
+// detected as corruption, and eventually use up the memory.
+TEST_F(PersistentMemoryAllocatorTest, ThreadRegionParallelismTest) {
+  allocator_->SetThreadRegionSize(4096);
+  SharedAllocatorThread t1("t1", allocator_.get());
+  SharedAllocatorThread t2("t2", allocator_.get());
+  SharedAllocatorThread t3("t3", allocator_.get());
+  SharedAllocatorThread t4("t4", allocator_.get());
+
+  t1.Start();
+  t2.Start();
+  t3.Start();
+  t4.Start();
+  t1.Join();
+  t2.Join();
+  t3.Join();
+  t4.Join();
+
+  EXPECT_FALSE(allocator_->IsCorrupt());
+  EXPECT_TRUE(allocator_->IsFull());
+  EXPECT_EQ(CountIterables(),
+            t1.count() + t2.count() + t3.count() + t4.count());
+}
+
+TEST_F(PersistentMemoryAllocatorTest, ReuseTest) {
+  allocator_->EnableReuse(1, 101, 64);
+  Reference block1 = allocator_->Allocate(24, 1);
+  ASSERT_NE(0U, block1);
+  EXPECT_LE(64U, allocator_->GetAllocSize(block1));
+  allocator_->MakeIterable(block1);
+  char* data1 = allocator_->GetAsArray<char>(block1, 1, 24);
+  ASSERT_TRUE(data1);
+  data1[0] = 'x';
+
+  // Only blocks of the reusable type can be freed.
+  Reference block2 = allocator_->Allocate(24, 2);
+  EXPECT_FALSE(allocator_->Free(block2, 1));
+  EXPECT_DCHECK_DEATH(allocator_->Free(block2, 2));
+
+  // A freed block is cleared and reused by the next allocation of its type,
+  // and keeps its position in iteration.
+  EXPECT_TRUE(allocator_->Free(block1, 1));
+  EXPECT_EQ(101U, allocator_->GetType(block1));
+  EXPECT_EQ(0, data1[0]);
+  EXPECT_EQ(block1, allocator_->Allocate(64, 1));
+  EXPECT_EQ(1U, allocator_->GetType(block1));
+  EXPECT_EQ(1U, CountIterables());
+  Reference block3 = allocator_->Allocate(64, 1);
+  EXPECT_LT(block2, block3);
+
+  // Another allocator reuses the iterable blocks freed by the first one.
+  EXPECT_TRUE(allocator_->Free(block1, 1));
+  PersistentMemoryAllocator allocator2(mem_segment_.get(), TEST_MEMORY_SIZE,
+                                       TEST_MEMORY_PAGE, 0, "", false);
+  allocator2.EnableReuse(1, 101, 64);
+  EXPECT_EQ(block1, allocator2.Allocate(64, 1));
+
+  // The first allocator doesn't follow the link of the block taken from its
+  // list, which now holds the data of the second.
+  uint32_t* data2 = allocator2.GetAsArray<uint32_t>(block1, 1, 16);
+  ASSERT_TRUE(data2);
+  data2[0] = 0x7fffff00;
+  Reference block4 = allocator_->Allocate(64, 1);
+  EXPECT_NE(0U, block4);
+  EXPECT_NE(block1, block4);
+  EXPECT_EQ(0x7fffff00U, data2[0]);
+  EXPECT_NE(0U, allocator_->Allocate(64, 1));
+
+  // The space waiting to be reused is reported.
+  HistogramTester histogram_tester;
+  allocator_->CreateTrackingHistograms(allocator_->Name());
+  allocator_->UpdateTrackingHistograms();
+  histogram_tester.ExpectTotalCount(
+      "UMA.PersistentAllocator.TestAllocator.ReusablePct", 1);
+  EXPECT_FALSE(allocator_->IsCorrupt());
+}
+
+// A thread that repeatedly allocates, fills and frees reusable objects.
+class ReusingThread : public SimpleThread {
+ public:
+  ReusingThread(const std::string& name,
+                PersistentMemoryAllocator* allocator,
+                char fill)
+      : SimpleThread(name, Options()),
+        allocator_(allocator),
+        fill_(fill),
+        failures_(0) {}
+
+  void Run() override {
+    for (int i = 0; i < 10000; ++i) {
+      Reference block = allocator_->Allocate(64, 1);
+      char* data = allocator_->GetAsArray<char>(block, 1, 64);
+      if (!data) {
+        failures_++;
+        continue;
+      }
+      allocator_->MakeIterable(block);
+      // Nothing else may use the object while this thread owns it.
+      memset(data, fill_, 64);
+      for (int j = 0; j < 64; ++j) {
+        if (data[j] != fill_)
+          failures_++;
+      }
+      if (!allocator_->Free(block, 1))
+        failures_++;
+    }
+  }
+
+  unsigned failures() { return failures_; }
+
+ private:
+  PersistentMemoryAllocator* const allocator_;
+  const char fill_;
+  unsigned failures_;
+};
+
+// Threads freeing and reusing objects concurrently never share one, and
+// need only about as many as there are threads.
+TEST_F(PersistentMemoryAllocatorTest, ReuseParallelismTest) {
+  allocator_->EnableReuse(1, 101, 64);
+  ReusingThread t1("t1", allocator_.get(), 1);
+  ReusingThread t2("t2", allocator_.get(), 2);
+  ReusingThread t3("t3", allocator_.get(), 3);
+  ReusingThread t4("t4", allocator_.get(), 4);
+
+  t1.Start();
+  t2.Start();
+  t3.Start();
+  t4.Start();
+  t1.Join();
+  t2.Join();
+  t3.Join();
+  t4.Join();
+
+  EXPECT_EQ(0U, t1.failures() + t2.failures() + t3.failures() +
+                    t4.failures());
+  EXPECT_FALSE(allocator_->IsCorrupt());
+  // A block being freed is in neither list nor use, so a thread can need a
+  // second one.
+  EXPECT_GE(8U, CountIterables());
+}
+
 // A simple thread that counts objects by iterating through an allocator.
 class CounterThread : public SimpleThread {
  public:
@@ -609,6 +817,25 @@ TEST(LocalPersistentMemoryAllocatorTest, CreationTest) {
 }
 
 
+TEST(LocalPersistentMemoryAllocatorTest, PrepareMemoryTest) {
+  // Explicit huge pages are used if the system has some, and transparent ones
+  // otherwise.
+  LocalPersistentMemoryAllocator allocator(
+      2 << 20, 42, "",
+      PersistentMemoryAllocator::PREPARE_HUGE_PAGES |
+          PersistentMemoryAllocator::PREPARE_PREFAULT);
+  Reference block = allocator.Allocate(24, 1);
+  char* data = allocator.GetAsArray<char>(block, 1, 24);
+  ASSERT_TRUE(data);
+  strcpy(data, "persistent");
+
+  // Faulting in the rest of the memory changes nothing.
+  allocator.PrepareMemory(PersistentMemoryAllocator::PREPARE_PREFAULT);
+  EXPECT_STREQ("persistent", data);
+  EXPECT_NE(0U, allocator.Allocate(24, 2));
+  EXPECT_FALSE(allocator.IsCorrupt());
+}
+
 //----- SharedPersistentMemoryAllocator ----------------------------------------
 
 TEST(SharedPersistentMemoryAllocatorTest, CreationTest) {
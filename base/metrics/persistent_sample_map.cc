@@ -4,12 +4,13 @@
 
 #include "base/metrics/persistent_sample_map.h"
 
+#include <utility>
+#include <vector>
+
 #include "base/logging.h"
-#include "base/memory/ptr_util.h"
 #include "base/metrics/histogram_macros.h"
 #include "base/metrics/persistent_histogram_allocator.h"
 #include "base/numerics/safe_conversions.h"
-#include "base/stl_util.h"
 
 namespace base {
 
@@ -23,10 +24,8 @@ namespace {
 // Changes here likely need to be duplicated there.
 class PersistentSampleMapIterator : public SampleCountIterator {
  public:
-  typedef std::map<HistogramBase::Sample, HistogramBase::Count*>
-      SampleToCountMap;
-
-  explicit PersistentSampleMapIterator(const SampleToCountMap& sample_counts);
+  explicit PersistentSampleMapIterator(
+      std::vector<SampleCountIndex::Entry> entries);
   ~PersistentSampleMapIterator() override;
 
   // SampleCountIterator:
@@ -39,26 +38,25 @@ class PersistentSampleMapIterator : public SampleCountIterator {
  private:
   void SkipEmptyBuckets();
 
-  SampleToCountMap::const_iterator iter_;
-  const SampleToCountMap::const_iterator end_;
+  const std::vector<SampleCountIndex::Entry> entries_;
+  size_t index_;
 };
 
 PersistentSampleMapIterator::PersistentSampleMapIterator(
-    const SampleToCountMap& sample_counts)
-    : iter_(sample_counts.begin()),
-      end_(sample_counts.end()) {
+    std::vector<SampleCountIndex::Entry> entries)
+    : entries_(std::move(entries)), index_(0) {
   SkipEmptyBuckets();
 }
 
 PersistentSampleMapIterator::~PersistentSampleMapIterator() = default;
 
 bool PersistentSampleMapIterator::Done() const {
-  return iter_ == end_;
+  return index_ == entries_.size();
 }
 
 void PersistentSampleMapIterator::Next() {
   DCHECK(!Done());
-  ++iter_;
+  ++index_;
   SkipEmptyBuckets();
 }
 
@@ -67,16 +65,16 @@ void PersistentSampleMapIterator::Get(Sample* min,
                                       Count* count) const {
   DCHECK(!Done());
   if (min)
-    *min = iter_->first;
+    *min = entries_[index_].first;
   if (max)
-    *max = strict_cast<int64_t>(iter_->first) + 1;
+    *max = strict_cast<int64_t>(entries_[index_].first) + 1;
   if (count)
-    *count = *iter_->second;
+    *count = subtle::NoBarrier_Load(entries_[index_].second);
 }
 
 void PersistentSampleMapIterator::SkipEmptyBuckets() {
-  while (!Done() && *iter_->second == 0) {
-    ++iter_;
+  while (!Done() && subtle::NoBarrier_Load(entries_[index_].second) == 0) {
+    ++index_;
   }
 }
 
@@ -109,52 +107,48 @@ PersistentSampleMap::~PersistentSampleMap() {
 }
 
 void PersistentSampleMap::Accumulate(Sample value, Count count) {
-#if 0  // TODO(bcwhite) Re-enable efficient version after crbug.com/682680.
-  *GetOrCreateSampleCountStorage(value) += count;
-#else
-  Count* local_count_ptr = GetOrCreateSampleCountStorage(value);
+  HistogramBase::AtomicCount* local_count_ptr =
+      GetOrCreateSampleCountStorage(value);
+  Count new_value = subtle::NoBarrier_AtomicIncrement(local_count_ptr, count);
+  // TODO(bcwhite) Remove after crbug.com/682680.
+  Count old_value = new_value - count;
   if (count < 0) {
-    if (*local_count_ptr < -count)
+    if (old_value < -count)
       RecordNegativeSample(SAMPLES_ACCUMULATE_WENT_NEGATIVE, -count);
     else
       RecordNegativeSample(SAMPLES_ACCUMULATE_NEGATIVE_COUNT, -count);
-    *local_count_ptr += count;
-  } else {
-    Sample old_value = *local_count_ptr;
-    Sample new_value = old_value + count;
-    *local_count_ptr = new_value;
-    if ((new_value >= 0) != (old_value >= 0))
-      RecordNegativeSample(SAMPLES_ACCUMULATE_OVERFLOW, count);
+  } else if ((new_value >= 0) != (old_value >= 0)) {
+    RecordNegativeSample(SAMPLES_ACCUMULATE_OVERFLOW, count);
   }
-#endif
   IncreaseSumAndCount(strict_cast<int64_t>(count) * value, count);
 }
 
 Count PersistentSampleMap::GetCount(Sample value) const {
   // Have to override "const" to make sure all samples have been loaded before
   // being able to know what value to return.
-  Count* count_pointer =
+  HistogramBase::AtomicCount* count_pointer =
       const_cast<PersistentSampleMap*>(this)->GetSampleCountStorage(value);
-  return count_pointer ? *count_pointer : 0;
+  return count_pointer ? subtle::NoBarrier_Load(count_pointer) : 0;
 }
 
 Count PersistentSampleMap::TotalCount() const {
-  // Have to override "const" in order to make sure all samples have been
-  // loaded before trying to iterate over the map.
-  const_cast<PersistentSampleMap*>(this)->ImportSamples(-1, true);
+  // Make sure all samples have been loaded before trying to iterate over the
+  // map.
+  ImportAllSamples();
 
   Count count = 0;
-  for (const auto& entry : sample_counts_) {
-    count += *entry.second;
+  for (const auto& entry : sample_counts_.GetEntries()) {
+    count += subtle::NoBarrier_Load(entry.second);
   }
   return count;
 }
 
 std::unique_ptr<SampleCountIterator> PersistentSampleMap::Iterator() const {
-  // Have to override "const" in order to make sure all samples have been
-  // loaded before trying to iterate over the map.
-  const_cast<PersistentSampleMap*>(this)->ImportSamples(-1, true);
-  return WrapUnique(new PersistentSampleMapIterator(sample_counts_));
+  // Make sure all samples have been loaded before trying to iterate over the
+  // map.
+  ImportAllSamples();
+  return std::make_unique<PersistentSampleMapIterator>(
+      sample_counts_.GetEntries());
 }
 
 // static
@@ -203,30 +197,45 @@ bool PersistentSampleMap::AddSubtractImpl(SampleCountIterator* iter,
       continue;
     if (strict_cast<int64_t>(min) + 1 != max)
       return false;  // SparseHistogram only supports bucket with size 1.
-    *GetOrCreateSampleCountStorage(min) +=
-        (op == HistogramSamples::ADD) ? count : -count;
+    subtle::NoBarrier_AtomicIncrement(
+        GetOrCreateSampleCountStorage(min),
+        (op == HistogramSamples::ADD) ? count : -count);
   }
   return true;
 }
 
-Count* PersistentSampleMap::GetSampleCountStorage(Sample value) {
+HistogramBase::AtomicCount* PersistentSampleMap::GetSampleCountStorage(
+    Sample value) {
   // If |value| is already in the map, just return that.
-  auto it = sample_counts_.find(value);
-  if (it != sample_counts_.end())
-    return it->second;
+  HistogramBase::AtomicCount* count_pointer = sample_counts_.Find(value);
+  if (count_pointer)
+    return count_pointer;
 
   // Import any new samples from persistent memory looking for the value.
+  AutoLock lock(lock_);
+  count_pointer = sample_counts_.Find(value);
+  if (count_pointer)
+    return count_pointer;
   return ImportSamples(value, false);
 }
 
-Count* PersistentSampleMap::GetOrCreateSampleCountStorage(Sample value) {
-  // Get any existing count storage.
-  Count* count_pointer = GetSampleCountStorage(value);
+HistogramBase::AtomicCount* PersistentSampleMap::GetOrCreateSampleCountStorage(
+    Sample value) {
+  // Get any existing count storage without taking the lock.
+  HistogramBase::AtomicCount* count_pointer = sample_counts_.Find(value);
+  if (count_pointer)
+    return count_pointer;
+
+  AutoLock lock(lock_);
+  count_pointer = sample_counts_.Find(value);
+  if (count_pointer)
+    return count_pointer;
+  count_pointer = ImportSamples(value, false);
   if (count_pointer)
     return count_pointer;
 
   // Create a new record in persistent memory for the value. |records_| will
-  // have been initialized by the GetSampleCountStorage() call above.
+  // have been initialized by the ImportSamples() call above.
   DCHECK(records_);
   PersistentMemoryAllocator::Reference ref = records_->CreateNew(value);
   if (!ref) {
@@ -234,8 +243,8 @@ Count* PersistentSampleMap::GetOrCreateSampleCountStorage(Sample value) {
     // full or corrupt. Instead, allocate the counter from the heap. This
     // sample will not be persistent, will not be shared, and will leak...
     // but it's better than crashing.
-    count_pointer = new Count(0);
-    sample_counts_[value] = count_pointer;
+    count_pointer = new HistogramBase::AtomicCount(0);
+    sample_counts_.Insert(value, count_pointer);
     return count_pointer;
   }
 
@@ -245,14 +254,18 @@ Count* PersistentSampleMap::GetOrCreateSampleCountStorage(Sample value) {
   // ordering on iterable objects so use the import method to actually add the
   // just-created record. This ensures that all PersistentSampleMap objects
   // will always use the same record, whichever was first made iterable.
-  // Thread-safety within a process where multiple threads use the same
-  // histogram object is delegated to the controlling histogram object which,
-  // for sparse histograms, is a lock object.
+  // Within a process, |lock_| serializes the threads which create records.
   count_pointer = ImportSamples(value, false);
   DCHECK(count_pointer);
   return count_pointer;
 }
 
+void PersistentSampleMap::ImportAllSamples() const {
+  PersistentSampleMap* self = const_cast<PersistentSampleMap*>(this);
+  AutoLock lock(self->lock_);
+  self->ImportSamples(-1, true);
+}
+
 PersistentSampleMapRecords* PersistentSampleMap::GetRecords() {
   // The |records_| pointer is lazily fetched from the |allocator_| only on
   // first use. Sometimes duplicate histograms are created by race conditions
@@ -264,9 +277,11 @@ PersistentSampleMapRecords* PersistentSampleMap::GetRecords() {
   return records_;
 }
 
-Count* PersistentSampleMap::ImportSamples(Sample until_value,
-                                          bool import_everything) {
-  Count* found_count = nullptr;
+HistogramBase::AtomicCount* PersistentSampleMap::ImportSamples(
+    Sample until_value,
+    bool import_everything) {
+  lock_.AssertAcquired();
+  HistogramBase::AtomicCount* found_count = nullptr;
   PersistentMemoryAllocator::Reference ref;
   PersistentSampleMapRecords* records = GetRecords();
   while ((ref = records->GetNext()) != 0) {
@@ -277,9 +292,9 @@ Count* PersistentSampleMap::ImportSamples(Sample until_value,
     DCHECK_EQ(id(), record->id);
 
     // Check if the record's value is already known.
-    if (!ContainsKey(sample_counts_, record->value)) {
+    if (!sample_counts_.Find(record->value)) {
       // No: Add it to map of known values.
-      sample_counts_[record->value] = &record->count;
+      sample_counts_.Insert(record->value, &record->count);
     } else {
       // Yes: Ignore it; it's a duplicate caused by a race condition -- see
       // code & comment in GetOrCreateSampleCountStorage() for details.
@@ -11,7 +11,6 @@
 
 #include <stdint.h>
 
-#include <map>
 #include <memory>
 
 #include "base/compiler_specific.h"
@@ -19,6 +18,8 @@
 #include "base/metrics/histogram_base.h"
 #include "base/metrics/histogram_samples.h"
 #include "base/metrics/persistent_memory_allocator.h"
+#include "base/metrics/sample_count_index.h"
+#include "base/synchronization/lock.h"
 
 namespace base {
 
@@ -27,6 +28,9 @@ class PersistentSampleMapRecords;
 
 // The logic here is similar to that of SampleMap but with different data
 // structures. Changes here likely need to be duplicated there.
+//
+// Samples can be accumulated from any thread: this is lock-free once the
+// sample value has a count which was imported from persistent memory.
 class BASE_EXPORT PersistentSampleMap : public HistogramSamples {
  public:
   // Constructs a persistent sample map using a PersistentHistogramAllocator
@@ -64,14 +68,18 @@ class BASE_EXPORT PersistentSampleMap : public HistogramSamples {
 
   // Gets a pointer to a "count" corresponding to a given |value|. Returns NULL
   // if sample does not exist.
-  HistogramBase::Count* GetSampleCountStorage(HistogramBase::Sample value);
+  HistogramBase::AtomicCount* GetSampleCountStorage(
+      HistogramBase::Sample value);
 
   // Gets a pointer to a "count" corresponding to a given |value|, creating
   // the sample (initialized to zero) if it does not already exists.
-  HistogramBase::Count* GetOrCreateSampleCountStorage(
+  HistogramBase::AtomicCount* GetOrCreateSampleCountStorage(
       HistogramBase::Sample value);
 
  private:
+  // Imports all available samples. See ImportSamples().
+  void ImportAllSamples() const;
+
   // Gets the object that manages persistent records. This returns the
   // |records_| member after first initializing it if necessary.
   PersistentSampleMapRecords* GetRecords();
@@ -82,14 +90,18 @@ class BASE_EXPORT PersistentSampleMap : public HistogramSamples {
   // a pointer to that counter. If that value is not found, null will be
   // returned after all currently available samples have been loaded. Pass
   // true for |import_everything| to force the importing of all available
-  // samples even if a match is found.
-  HistogramBase::Count* ImportSamples(HistogramBase::Sample until_value,
-                                      bool import_everything);
+  // samples even if a match is found. Must be called with |lock_| held.
+  HistogramBase::AtomicCount* ImportSamples(HistogramBase::Sample until_value,
+                                            bool import_everything);
 
   // All created/loaded sample values and their associated counts. The storage
   // for the actual Count numbers is owned by the |records_| object and its
   // underlying allocator.
-  std::map<HistogramBase::Sample, HistogramBase::Count*> sample_counts_;
+  SampleCountIndex sample_counts_;
+
+  // Protects the import and creation of sample records, which are the only
+  // changes to |sample_counts_| and |records_|.
+  Lock lock_;
 
   // The allocator that manages histograms inside persistent memory. This is
   // owned externally and is expected to live beyond the life of this object.
@@ -0,0 +1,126 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/sample_count_index.h"
+
+#include <algorithm>
+
+#include "base/logging.h"
+
+namespace base {
+
+namespace {
+
+// The first table has 2^kInitialCapacityLog2 slots.
+constexpr uint32_t kInitialCapacityLog2 = 3;
+
+}  // namespace
+
+struct SampleCountIndex::Table {
+  // A slot is empty while |count| is null. |value| is stored before |count|
+  // is released so that a lookup which sees the count sees its value.
+  struct Slot {
+    subtle::Atomic32 value;
+    subtle::AtomicWord count;
+  };
+
+  explicit Table(uint32_t capacity_log2)
+      : capacity_log2(capacity_log2),
+        mask((size_t{1} << capacity_log2) - 1),
+        slots(new Slot[mask + 1]()) {}
+
+  size_t capacity() const { return mask + 1; }
+
+  // Fibonacci hashing: the top bits of the product are well mixed even for
+  // consecutive values such as those of an enum.
+  size_t GetFirstIndex(HistogramBase::Sample value) const {
+    return (static_cast<uint32_t>(value) * 0x9E3779B1u) >>
+           (32 - capacity_log2);
+  }
+
+  void Insert(HistogramBase::Sample value, subtle::AtomicWord count) {
+    for (size_t i = GetFirstIndex(value);; i = (i + 1) & mask) {
+      Slot& slot = slots[i];
+      if (subtle::NoBarrier_Load(&slot.count))
+        continue;
+      subtle::NoBarrier_Store(&slot.value, value);
+      subtle::Release_Store(&slot.count, count);
+      return;
+    }
+  }
+
+  const uint32_t capacity_log2;
+  const size_t mask;
+  std::unique_ptr<Slot[]> slots;
+};
+
+SampleCountIndex::SampleCountIndex() = default;
+
+SampleCountIndex::~SampleCountIndex() = default;
+
+HistogramBase::AtomicCount* SampleCountIndex::Find(
+    HistogramBase::Sample value) const {
+  const Table* table = GetTable();
+  if (!table)
+    return nullptr;
+
+  // The table is never more than half full, so there is an empty slot.
+  for (size_t i = table->GetFirstIndex(value);; i = (i + 1) & table->mask) {
+    const Table::Slot& slot = table->slots[i];
+    subtle::AtomicWord count = subtle::Acquire_Load(&slot.count);
+    if (!count)
+      return nullptr;
+    if (subtle::NoBarrier_Load(&slot.value) == value)
+      return reinterpret_cast<HistogramBase::AtomicCount*>(count);
+  }
+}
+
+void SampleCountIndex::Insert(HistogramBase::Sample value,
+                              HistogramBase::AtomicCount* count) {
+  DCHECK(count);
+  DCHECK(!Find(value));
+  Table* table = tables_.empty() ? nullptr : tables_.back().get();
+  if (!table || (size_ + 1) * 2 > table->capacity()) {
+    auto new_table = std::make_unique<Table>(
+        table ? table->capacity_log2 + 1 : kInitialCapacityLog2);
+    if (table) {
+      for (size_t i = 0; i < table->capacity(); ++i) {
+        const Table::Slot& slot = table->slots[i];
+        if (slot.count)
+          new_table->Insert(slot.value, slot.count);
+      }
+    }
+    table = new_table.get();
+    tables_.push_back(std::move(new_table));
+    subtle::Release_Store(&table_, reinterpret_cast<subtle::AtomicWord>(table));
+  }
+
+  table->Insert(value, reinterpret_cast<subtle::AtomicWord>(count));
+  ++size_;
+}
+
+std::vector<SampleCountIndex::Entry> SampleCountIndex::GetEntries() const {
+  std::vector<Entry> entries;
+  const Table* table = GetTable();
+  if (!table)
+    return entries;
+
+  for (size_t i = 0; i < table->capacity(); ++i) {
+    const Table::Slot& slot = table->slots[i];
+    subtle::AtomicWord count = subtle::Acquire_Load(&slot.count);
+    if (!count)
+      continue;
+    entries.emplace_back(subtle::NoBarrier_Load(&slot.value),
+                         reinterpret_cast<HistogramBase::AtomicCount*>(count));
+  }
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.first < b.first; });
+  return entries;
+}
+
+const SampleCountIndex::Table* SampleCountIndex::GetTable() const {
+  return reinterpret_cast<const Table*>(subtle::Acquire_Load(&table_));
+}
+
+}  // namespace base
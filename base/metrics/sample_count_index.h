@@ -0,0 +1,67 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// SampleCountIndex maps the sample values of a sparse histogram to the
+// storage of their counts. It is used by SampleMap and PersistentSampleMap so
+// that recording a sample which already has a count is lock-free.
+
+#ifndef BASE_METRICS_SAMPLE_COUNT_INDEX_H_
+#define BASE_METRICS_SAMPLE_COUNT_INDEX_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "base/atomicops.h"
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/metrics/histogram_base.h"
+
+namespace base {
+
+// An open-addressing hash table from sample values to pointers to their
+// counts. Lookups are lock-free and may run concurrently with an insertion;
+// insertions must be serialized by the owner. Values are never removed, and
+// the count storage must outlive the index.
+//
+// When the table becomes half full, it is replaced by one twice as large.
+// Since a concurrent lookup may still be probing the previous table, that one
+// is only deleted with the index; this at most doubles its memory.
+class BASE_EXPORT SampleCountIndex {
+ public:
+  typedef std::pair<HistogramBase::Sample, HistogramBase::AtomicCount*> Entry;
+
+  SampleCountIndex();
+  ~SampleCountIndex();
+
+  // Returns the count of |value|, or null if it has none.
+  HistogramBase::AtomicCount* Find(HistogramBase::Sample value) const;
+
+  // Maps |value|, which must not be in the index yet, to |count|.
+  void Insert(HistogramBase::Sample value, HistogramBase::AtomicCount* count);
+
+  // Returns the entries, ordered by value.
+  std::vector<Entry> GetEntries() const;
+
+ private:
+  struct Table;
+
+  const Table* GetTable() const;
+
+  // The current table, owned by |tables_|.
+  subtle::AtomicWord table_ = 0;
+
+  // Only accessed by insertions. The last table is the current one.
+  std::vector<std::unique_ptr<Table>> tables_;
+  size_t size_ = 0;
+
+  DISALLOW_COPY_AND_ASSIGN(SampleCountIndex);
+};
+
+}  // namespace base
+
+#endif  // BASE_METRICS_SAMPLE_COUNT_INDEX_H_
@@ -0,0 +1,98 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/metrics/sample_count_index.h"
+
+#include <limits>
+#include <vector>
+
+#include "base/macros.h"
+#include "base/threading/simple_thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace {
+
+TEST(SampleCountIndexTest, InsertAndFind) {
+  SampleCountIndex index;
+  EXPECT_FALSE(index.Find(0));
+  EXPECT_TRUE(index.GetEntries().empty());
+
+  HistogramBase::AtomicCount counts[3] = {};
+  const HistogramBase::Sample kMin = std::numeric_limits<int32_t>::min();
+  index.Insert(0, &counts[0]);
+  index.Insert(kMin, &counts[1]);
+  index.Insert(-5, &counts[2]);
+  EXPECT_EQ(&counts[0], index.Find(0));
+  EXPECT_EQ(&counts[1], index.Find(kMin));
+  EXPECT_EQ(&counts[2], index.Find(-5));
+  EXPECT_FALSE(index.Find(5));
+
+  std::vector<SampleCountIndex::Entry> entries = index.GetEntries();
+  ASSERT_EQ(3u, entries.size());
+  EXPECT_EQ(kMin, entries[0].first);
+  EXPECT_EQ(&counts[1], entries[0].second);
+  EXPECT_EQ(-5, entries[1].first);
+  EXPECT_EQ(0, entries[2].first);
+}
+
+TEST(SampleCountIndexTest, Grow) {
+  constexpr int kValues = 1000;
+  std::vector<HistogramBase::AtomicCount> counts(kValues);
+  SampleCountIndex index;
+  // Values which differ in their high bits, like enum values shifted left.
+  for (int i = 0; i < kValues; ++i)
+    index.Insert(i << 16, &counts[i]);
+  for (int i = 0; i < kValues; ++i)
+    EXPECT_EQ(&counts[i], index.Find(i << 16));
+  EXPECT_FALSE(index.Find(1));
+  EXPECT_EQ(static_cast<size_t>(kValues), index.GetEntries().size());
+}
+
+class FindThread : public DelegateSimpleThread::Delegate {
+ public:
+  FindThread(const SampleCountIndex* index,
+             const std::vector<HistogramBase::AtomicCount>* counts)
+      : index_(index), counts_(counts) {}
+
+  void Run() override {
+    // Values are inserted in order, so once one is found, the previous ones
+    // must be found too.
+    int found = 0;
+    while (found < static_cast<int>(counts_->size())) {
+      HistogramBase::AtomicCount* count = index_->Find(found);
+      if (!count)
+        continue;
+      for (int i = 0; i <= found; ++i) {
+        if (index_->Find(i) != &(*counts_)[i]) {
+          ADD_FAILURE() << "Lost value " << i;
+          return;
+        }
+      }
+      found++;
+    }
+  }
+
+ private:
+  const SampleCountIndex* const index_;
+  const std::vector<HistogramBase::AtomicCount>* const counts_;
+
+  DISALLOW_COPY_AND_ASSIGN(FindThread);
+};
+
+TEST(SampleCountIndexTest, FindWhileInserting) {
+  constexpr int kValues = 300;
+  std::vector<HistogramBase::AtomicCount> counts(kValues);
+  SampleCountIndex index;
+  FindThread delegate(&index, &counts);
+  DelegateSimpleThreadPool pool("SampleCountIndexFind", 4);
+  pool.AddWork(&delegate, 4);
+  pool.Start();
+  for (int i = 0; i < kValues; ++i)
+    index.Insert(i, &counts[i]);
+  pool.JoinAll();
+}
+
+}  // namespace
+}  // namespace base
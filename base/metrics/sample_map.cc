@@ -4,10 +4,11 @@
 
 #include "base/metrics/sample_map.h"
 
+#include <utility>
+#include <vector>
+
 #include "base/logging.h"
-#include "base/memory/ptr_util.h"
 #include "base/numerics/safe_conversions.h"
-#include "base/stl_util.h"
 
 namespace base {
 
@@ -21,10 +22,7 @@ namespace {
 // Changes here likely need to be duplicated there.
 class SampleMapIterator : public SampleCountIterator {
  public:
-  typedef std::map<HistogramBase::Sample, HistogramBase::Count>
-      SampleToCountMap;
-
-  explicit SampleMapIterator(const SampleToCountMap& sample_counts);
+  explicit SampleMapIterator(std::vector<SampleCountIndex::Entry> entries);
   ~SampleMapIterator() override;
 
   // SampleCountIterator:
@@ -37,41 +35,41 @@ class SampleMapIterator : public SampleCountIterator {
  private:
   void SkipEmptyBuckets();
 
-  SampleToCountMap::const_iterator iter_;
-  const SampleToCountMap::const_iterator end_;
+  const std::vector<SampleCountIndex::Entry> entries_;
+  size_t index_;
 };
 
-SampleMapIterator::SampleMapIterator(const SampleToCountMap& sample_counts)
-    : iter_(sample_counts.begin()),
-      end_(sample_counts.end()) {
+SampleMapIterator::SampleMapIterator(
+    std::vector<SampleCountIndex::Entry> entries)
+    : entries_(std::move(entries)), index_(0) {
   SkipEmptyBuckets();
 }
 
 SampleMapIterator::~SampleMapIterator() = default;
 
 bool SampleMapIterator::Done() const {
-  return iter_ == end_;
+  return index_ == entries_.size();
 }
 
 void SampleMapIterator::Next() {
   DCHECK(!Done());
-  ++iter_;
+  ++index_;
   SkipEmptyBuckets();
 }
 
 void SampleMapIterator::Get(Sample* min, int64_t* max, Count* count) const {
   DCHECK(!Done());
   if (min)
-    *min = iter_->first;
+    *min = entries_[index_].first;
   if (max)
-    *max = strict_cast<int64_t>(iter_->first) + 1;
+    *max = strict_cast<int64_t>(entries_[index_].first) + 1;
   if (count)
-    *count = iter_->second;
+    *count = subtle::NoBarrier_Load(entries_[index_].second);
 }
 
 void SampleMapIterator::SkipEmptyBuckets() {
-  while (!Done() && iter_->second == 0) {
-    ++iter_;
+  while (!Done() && subtle::NoBarrier_Load(entries_[index_].second) == 0) {
+    ++index_;
   }
 }
 
@@ -86,27 +84,27 @@ SampleMap::~SampleMap() {
 }
 
 void SampleMap::Accumulate(Sample value, Count count) {
-  sample_counts_[value] += count;
+  subtle::NoBarrier_AtomicIncrement(GetOrCreateCount(value), count);
   IncreaseSumAndCount(strict_cast<int64_t>(count) * value, count);
 }
 
 Count SampleMap::GetCount(Sample value) const {
-  std::map<Sample, Count>::const_iterator it = sample_counts_.find(value);
-  if (it == sample_counts_.end())
+  const HistogramBase::AtomicCount* count = sample_counts_.Find(value);
+  if (!count)
     return 0;
-  return it->second;
+  return subtle::NoBarrier_Load(count);
 }
 
 Count SampleMap::TotalCount() const {
   Count count = 0;
-  for (const auto& entry : sample_counts_) {
-    count += entry.second;
+  for (const auto& entry : sample_counts_.GetEntries()) {
+    count += subtle::NoBarrier_Load(entry.second);
   }
   return count;
 }
 
 std::unique_ptr<SampleCountIterator> SampleMap::Iterator() const {
-  return WrapUnique(new SampleMapIterator(sample_counts_));
+  return std::make_unique<SampleMapIterator>(sample_counts_.GetEntries());
 }
 
 bool SampleMap::AddSubtractImpl(SampleCountIterator* iter, Operator op) {
@@ -118,9 +116,25 @@ bool SampleMap::AddSubtractImpl(SampleCountIterator* iter, Operator op) {
     if (strict_cast<int64_t>(min) + 1 != max)
       return false;  // SparseHistogram only supports bucket with size 1.
 
-    sample_counts_[min] += (op == HistogramSamples::ADD) ? count : -count;
+    subtle::NoBarrier_AtomicIncrement(
+        GetOrCreateCount(min), (op == HistogramSamples::ADD) ? count : -count);
   }
   return true;
 }
 
+HistogramBase::AtomicCount* SampleMap::GetOrCreateCount(Sample value) {
+  HistogramBase::AtomicCount* count = sample_counts_.Find(value);
+  if (count)
+    return count;
+
+  AutoLock lock(lock_);
+  count = sample_counts_.Find(value);
+  if (!count) {
+    counts_.push_back(0);
+    count = &counts_.back();
+    sample_counts_.Insert(value, count);
+  }
+  return count;
+}
+
 }  // namespace base
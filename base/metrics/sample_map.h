@@ -10,18 +10,23 @@
 
 #include <stdint.h>
 
-#include <map>
+#include <deque>
 #include <memory>
 
 #include "base/compiler_specific.h"
 #include "base/macros.h"
 #include "base/metrics/histogram_base.h"
 #include "base/metrics/histogram_samples.h"
+#include "base/metrics/sample_count_index.h"
+#include "base/synchronization/lock.h"
 
 namespace base {
 
 // The logic here is similar to that of PersistentSampleMap but with different
 // data structures. Changes here likely need to be duplicated there.
+//
+// Samples can be accumulated from any thread: this is lock-free once the
+// sample value has a count.
 class BASE_EXPORT SampleMap : public HistogramSamples {
  public:
   SampleMap();
@@ -40,7 +45,17 @@ class BASE_EXPORT SampleMap : public HistogramSamples {
   bool AddSubtractImpl(SampleCountIterator* iter, Operator op) override;
 
  private:
-  std::map<HistogramBase::Sample, HistogramBase::Count> sample_counts_;
+  // Returns the count of |value|, creating it if needed.
+  HistogramBase::AtomicCount* GetOrCreateCount(HistogramBase::Sample value);
+
+  // The counts of the sample values, in |counts_|.
+  SampleCountIndex sample_counts_;
+
+  // Protects the creation of counts.
+  Lock lock_;
+
+  // Elements of a deque don't move when more are added.
+  std::deque<HistogramBase::AtomicCount> counts_;
 
   DISALLOW_COPY_AND_ASSIGN(SampleMap);
 };
@@ -4,13 +4,23 @@
 
 #include "base/metrics/sample_vector.h"
 
+#include <algorithm>
+
+#include "base/bits.h"
 #include "base/lazy_instance.h"
 #include "base/logging.h"
 #include "base/memory/ptr_util.h"
 #include "base/metrics/persistent_memory_allocator.h"
 #include "base/numerics/safe_conversions.h"
 #include "base/synchronization/lock.h"
+#include "base/sys_info.h"
 #include "base/threading/platform_thread.h"
+#include "base/threading/thread_local.h"
+#include "build/build_config.h"
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+#include <sched.h>
+#endif
 
 // This SampleVector makes use of the single-sample embedded in the base
 // HistogramSamples class. If the count is non-zero then there is guaranteed
@@ -23,6 +33,106 @@ namespace base {
 typedef HistogramBase::Count Count;
 typedef HistogramBase::Sample Sample;
 
+namespace {
+
+// Checks that |value| fits in the ranges before finding its bucket.
+size_t FindBucketIndex(const BucketRanges* bucket_ranges, Sample value) {
+  size_t bucket_count = bucket_ranges->bucket_count();
+  CHECK_GE(bucket_count, 1u);
+  CHECK_GE(value, bucket_ranges->range(0));
+  CHECK_LT(value, bucket_ranges->range(bucket_count));
+
+  const size_t index = bucket_ranges->FindBucket(value);
+  DCHECK_LE(bucket_ranges->range(index), value);
+  CHECK_GT(bucket_ranges->range(index + 1), value);
+  return index;
+}
+
+// Shards are aligned to cache lines so that they never share one.
+constexpr size_t kShardAlignment = 64;
+
+size_t GetDefaultShardCount() {
+  size_t shard_count = 1;
+  const size_t processors =
+      static_cast<size_t>(std::max(SysInfo::NumberOfProcessors(), 1));
+  while (shard_count < processors &&
+         shard_count < ShardedSampleCounts::kMaxShards) {
+    shard_count *= 2;
+  }
+  return shard_count;
+}
+
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+// The number of samples a thread records in the shard of the CPU it was last
+// seen on before asking for its CPU again. sched_getcpu() is a system call on
+// some platforms (e.g. arm and arm64), too slow for every sample, and a thread
+// rarely migrates between two samples anyway.
+constexpr uintptr_t kSamplesPerCpuCheck = 64;
+
+// The CPU the current thread was last seen on, shifted by 8 bits, and the
+// number of samples it may still record before checking again in the low 8
+// bits.
+LazyInstance<ThreadLocalPointer<void>>::Leaky g_cpu_hint =
+    LAZY_INSTANCE_INITIALIZER;
+#endif
+
+// The merged counts of the shards of a ShardedSampleCounts, to be added to
+// other samples.
+class ShardedSamplesSnapshot : public HistogramSamples {
+ public:
+  explicit ShardedSamplesSnapshot(const BucketRanges* bucket_ranges)
+      : HistogramSamples(0, new LocalMetadata()),
+        bucket_ranges_(bucket_ranges),
+        counts_(bucket_ranges->bucket_count()) {}
+
+  ~ShardedSamplesSnapshot() override {
+    delete static_cast<LocalMetadata*>(meta());
+  }
+
+  void AddToBucket(size_t bucket_index, Count count) {
+    counts_[bucket_index] += count;
+  }
+
+  void AddSumAndCount(int64_t sum, Count count) {
+    IncreaseSumAndCount(sum, count);
+  }
+
+  // HistogramSamples:
+  void Accumulate(Sample value, Count count) override {
+    AddToBucket(FindBucketIndex(bucket_ranges_, value), count);
+    IncreaseSumAndCount(strict_cast<int64_t>(count) * value, count);
+  }
+
+  Count GetCount(Sample value) const override {
+    return counts_[FindBucketIndex(bucket_ranges_, value)];
+  }
+
+  Count TotalCount() const override {
+    Count count = 0;
+    for (Count bucket_count : counts_)
+      count += bucket_count;
+    return count;
+  }
+
+  std::unique_ptr<SampleCountIterator> Iterator() const override {
+    return std::make_unique<SampleVectorIterator>(&counts_, bucket_ranges_);
+  }
+
+ protected:
+  bool AddSubtractImpl(SampleCountIterator* iter, Operator op) override {
+    NOTREACHED();
+    return false;
+  }
+
+ private:
+  const BucketRanges* const bucket_ranges_;
+  std::vector<HistogramBase::AtomicCount> counts_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedSamplesSnapshot);
+};
+
+}  // namespace
+
 SampleVectorBase::SampleVectorBase(uint64_t id,
                                    Metadata* meta,
                                    const BucketRanges* bucket_ranges)
@@ -212,31 +322,8 @@ bool SampleVectorBase::AddSubtractImpl(SampleCountIterator* iter,
   }
 }
 
-// Use simple binary search.  This is very general, but there are better
-// approaches if we knew that the buckets were linearly distributed.
 size_t SampleVectorBase::GetBucketIndex(Sample value) const {
-  size_t bucket_count = bucket_ranges_->bucket_count();
-  CHECK_GE(bucket_count, 1u);
-  CHECK_GE(value, bucket_ranges_->range(0));
-  CHECK_LT(value, bucket_ranges_->range(bucket_count));
-
-  size_t under = 0;
-  size_t over = bucket_count;
-  size_t mid;
-  do {
-    DCHECK_GE(over, under);
-    mid = under + (over - under)/2;
-    if (mid == under)
-      break;
-    if (bucket_ranges_->range(mid) <= value)
-      under = mid;
-    else
-      over = mid;
-  } while (true);
-
-  DCHECK_LE(bucket_ranges_->range(mid), value);
-  CHECK_GT(bucket_ranges_->range(mid + 1), value);
-  return mid;
+  return FindBucketIndex(bucket_ranges_, value);
 }
 
 void SampleVectorBase::MoveSingleSampleToCounts() {
@@ -361,6 +448,134 @@ PersistentSampleVector::CreateCountsStorageWhileLocked() {
   return static_cast<HistogramBase::AtomicCount*>(mem);
 }
 
+// Each shard starts with its sum and redundant count, followed by its counts.
+struct ShardedSampleCounts::Shard {
+#ifdef ARCH_CPU_64_BITS
+  subtle::Atomic64 sum;
+#else
+  // As in HistogramSamples::Metadata, the sum isn't atomic on 32-bit systems.
+  int64_t sum;
+#endif
+  HistogramBase::AtomicCount redundant_count;
+};
+
+// static
+constexpr size_t ShardedSampleCounts::kMaxShards;
+
+ShardedSampleCounts::ShardedSampleCounts(const BucketRanges* bucket_ranges)
+    : ShardedSampleCounts(bucket_ranges, GetDefaultShardCount()) {}
+
+ShardedSampleCounts::ShardedSampleCounts(const BucketRanges* bucket_ranges,
+                                         size_t shard_count)
+    : bucket_ranges_(bucket_ranges),
+      shard_mask_(shard_count - 1),
+      shard_size_(bits::Align(
+          sizeof(Shard) + bucket_ranges->bucket_count() * sizeof(Count),
+          kShardAlignment)) {
+  DCHECK(bits::IsPowerOfTwo(shard_count));
+  DCHECK_LE(shard_count, kMaxShards);
+  const size_t size = shard_size_ * shard_count;
+  shards_.reset(static_cast<char*>(AlignedAlloc(size, kShardAlignment)));
+  memset(shards_.get(), 0, size);
+}
+
+ShardedSampleCounts::~ShardedSampleCounts() = default;
+
+void ShardedSampleCounts::Accumulate(Sample value, Count count) {
+  const size_t bucket_index = FindBucketIndex(bucket_ranges_, value);
+  const size_t shard_index = GetCurrentShardIndex();
+  Shard* shard = GetShard(shard_index);
+  subtle::NoBarrier_AtomicIncrement(
+      &GetShardCounts(shard_index)[bucket_index], count);
+#ifdef ARCH_CPU_64_BITS
+  subtle::NoBarrier_AtomicIncrement(&shard->sum,
+                                    strict_cast<int64_t>(count) * value);
+#else
+  shard->sum += strict_cast<int64_t>(count) * value;
+#endif
+  subtle::NoBarrier_AtomicIncrement(&shard->redundant_count, count);
+}
+
+void ShardedSampleCounts::AddTo(HistogramSamples* samples) const {
+  CollectTo(samples, /*reset=*/false);
+}
+
+void ShardedSampleCounts::MoveTo(HistogramSamples* samples) {
+  CollectTo(samples, /*reset=*/true);
+}
+
+ShardedSampleCounts::Shard* ShardedSampleCounts::GetShard(
+    size_t index) const {
+  DCHECK_LE(index, shard_mask_);
+  return reinterpret_cast<Shard*>(shards_.get() + index * shard_size_);
+}
+
+HistogramBase::AtomicCount* ShardedSampleCounts::GetShardCounts(
+    size_t index) const {
+  return reinterpret_cast<HistogramBase::AtomicCount*>(
+      reinterpret_cast<char*>(GetShard(index)) + sizeof(Shard));
+}
+
+size_t ShardedSampleCounts::GetCurrentShardIndex() const {
+#if defined(OS_LINUX) || defined(OS_ANDROID)
+  ThreadLocalPointer<void>& tls_hint = g_cpu_hint.Get();
+  uintptr_t hint = reinterpret_cast<uintptr_t>(tls_hint.Get());
+  if (!(hint & 0xff)) {
+    const int cpu = sched_getcpu();
+    hint = cpu >= 0
+               ? (static_cast<uintptr_t>(cpu) << 8) | kSamplesPerCpuCheck
+               : 0;
+  }
+  if (hint) {
+    tls_hint.Set(reinterpret_cast<void*>(hint - 1));
+    return static_cast<size_t>(hint >> 8) & shard_mask_;
+  }
+#endif
+  // Otherwise, spread the threads by the address of their stack. A thread
+  // whose stack crosses a 64 KiB boundary just uses another shard.
+  int stack_variable;
+  const uint64_t stack_block =
+      reinterpret_cast<uintptr_t>(&stack_variable) >> 16;
+  return static_cast<size_t>((stack_block * UINT64_C(0x9E3779B97F4A7C15)) >>
+                             58) &
+         shard_mask_;
+}
+
+void ShardedSampleCounts::CollectTo(HistogramSamples* samples,
+                                    bool reset) const {
+  ShardedSamplesSnapshot snapshot(bucket_ranges_);
+  const size_t bucket_count = bucket_ranges_->bucket_count();
+  int64_t sum = 0;
+  Count redundant_count = 0;
+  for (size_t i = 0; i < shard_count(); ++i) {
+    Shard* shard = GetShard(i);
+    HistogramBase::AtomicCount* counts = GetShardCounts(i);
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+      if (!subtle::NoBarrier_Load(&counts[bucket]))
+        continue;
+      snapshot.AddToBucket(
+          bucket, reset ? subtle::NoBarrier_AtomicExchange(&counts[bucket], 0)
+                        : subtle::NoBarrier_Load(&counts[bucket]));
+    }
+#ifdef ARCH_CPU_64_BITS
+    sum += reset ? subtle::NoBarrier_AtomicExchange(&shard->sum, 0)
+                 : subtle::NoBarrier_Load(&shard->sum);
+#else
+    const int64_t shard_sum = shard->sum;
+    if (reset)
+      shard->sum -= shard_sum;
+    sum += shard_sum;
+#endif
+    redundant_count +=
+        reset ? subtle::NoBarrier_AtomicExchange(&shard->redundant_count, 0)
+              : subtle::NoBarrier_Load(&shard->redundant_count);
+  }
+  if (!redundant_count && !sum && !snapshot.TotalCount())
+    return;
+  snapshot.AddSumAndCount(sum, redundant_count);
+  samples->Add(snapshot);
+}
+
 SampleVectorIterator::SampleVectorIterator(
     const std::vector<HistogramBase::AtomicCount>* counts,
     const BucketRanges* bucket_ranges)
@@ -18,6 +18,7 @@
 #include "base/compiler_specific.h"
 #include "base/gtest_prod_util.h"
 #include "base/macros.h"
+#include "base/memory/aligned_memory.h"
 #include "base/metrics/bucket_ranges.h"
 #include "base/metrics/histogram_base.h"
 #include "base/metrics/histogram_samples.h"
@@ -149,6 +150,56 @@ class BASE_EXPORT PersistentSampleVector : public SampleVectorBase {
   DISALLOW_COPY_AND_ASSIGN(PersistentSampleVector);
 };
 
+// Sample counts of a histogram which is recorded from many threads at high
+// rates, split in per-CPU shards so that the recording threads don't keep
+// stealing the cache lines of shared counts from each other. Each shard has
+// its own bucket counts, sum and redundant count, which are only merged into
+// HistogramSamples when the histogram is snapshotted. See
+// HistogramBase::kShardedSamples.
+class BASE_EXPORT ShardedSampleCounts {
+ public:
+  // The number of shards is the number of processors, rounded up to a power of
+  // two, and at most |kMaxShards|.
+  explicit ShardedSampleCounts(const BucketRanges* bucket_ranges);
+  // |shard_count| must be a power of two.
+  ShardedSampleCounts(const BucketRanges* bucket_ranges, size_t shard_count);
+  ~ShardedSampleCounts();
+
+  // Accumulates |count| samples of |value| in the shard of the current CPU.
+  void Accumulate(HistogramBase::Sample value, HistogramBase::Count count);
+
+  // Adds the samples of all shards to |samples|, which must have the same
+  // buckets.
+  void AddTo(HistogramSamples* samples) const;
+
+  // Moves the samples of all shards to |samples|. Each count is exchanged
+  // atomically so that samples accumulated concurrently are never lost, though
+  // they may be split between this and the next move.
+  void MoveTo(HistogramSamples* samples);
+
+  size_t shard_count() const { return shard_mask_ + 1; }
+
+  static constexpr size_t kMaxShards = 64;
+
+ private:
+  struct Shard;
+
+  Shard* GetShard(size_t index) const;
+  HistogramBase::AtomicCount* GetShardCounts(size_t index) const;
+  size_t GetCurrentShardIndex() const;
+  void CollectTo(HistogramSamples* samples, bool reset) const;
+
+  const BucketRanges* const bucket_ranges_;
+  const size_t shard_mask_;
+
+  // The shards are |shard_size_| bytes apart, a multiple of the cache line
+  // size, in |shards_|.
+  const size_t shard_size_;
+  std::unique_ptr<char, AlignedFreeDeleter> shards_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedSampleCounts);
+};
+
 // An iterator for sample vectors. This could be defined privately in the .cc
 // file but is here for easy testing.
 class BASE_EXPORT SampleVectorIterator : public SampleCountIterator {
@@ -15,6 +15,7 @@
 #include "base/metrics/histogram.h"
 #include "base/metrics/persistent_memory_allocator.h"
 #include "base/test/gtest_util.h"
+#include "base/threading/simple_thread.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
 namespace base {
@@ -542,4 +543,94 @@ TEST_F(SampleVectorTest, PersistentSampleVectorTestWithOutsideAlloc) {
   EXPECT_EQ(200, samples2.GetCount(8));
 }
 
+TEST_F(SampleVectorTest, ShardedSampleCounts) {
+  // Custom buckets: [1, 5) [5, 10)
+  BucketRanges ranges(3);
+  ranges.set_range(0, 1);
+  ranges.set_range(1, 5);
+  ranges.set_range(2, 10);
+  ShardedSampleCounts sharded_counts(&ranges, 4);
+  EXPECT_EQ(4u, sharded_counts.shard_count());
+
+  SampleVector samples(1, &ranges);
+  sharded_counts.AddTo(&samples);
+  EXPECT_EQ(0, samples.TotalCount());
+  EXPECT_EQ(0, samples.redundant_count());
+
+  sharded_counts.Accumulate(1, 200);
+  sharded_counts.Accumulate(6, 100);
+  sharded_counts.AddTo(&samples);
+  EXPECT_EQ(200, samples.GetCount(1));
+  EXPECT_EQ(100, samples.GetCount(5));
+  EXPECT_EQ(800, samples.sum());
+  EXPECT_EQ(300, samples.redundant_count());
+
+  // The samples stay in the shards until they are moved.
+  SampleVector moved(1, &ranges);
+  sharded_counts.MoveTo(&moved);
+  EXPECT_EQ(200, moved.GetCount(1));
+  EXPECT_EQ(100, moved.GetCount(5));
+  EXPECT_EQ(800, moved.sum());
+  EXPECT_EQ(300, moved.redundant_count());
+
+  sharded_counts.MoveTo(&moved);
+  EXPECT_EQ(300, moved.TotalCount());
+  sharded_counts.Accumulate(2, 1);
+  sharded_counts.MoveTo(&moved);
+  EXPECT_EQ(201, moved.GetCount(1));
+  EXPECT_EQ(802, moved.sum());
+  EXPECT_EQ(moved.TotalCount(), moved.redundant_count());
+}
+
+namespace {
+
+class ShardedSampleCountsThread : public DelegateSimpleThread::Delegate {
+ public:
+  ShardedSampleCountsThread(ShardedSampleCounts* sharded_counts,
+                            int samples)
+      : sharded_counts_(sharded_counts), samples_(samples) {}
+
+  void Run() override {
+    for (int i = 0; i < samples_; ++i)
+      sharded_counts_->Accumulate(i % 10, 1);
+  }
+
+ private:
+  ShardedSampleCounts* const sharded_counts_;
+  const int samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(ShardedSampleCountsThread);
+};
+
+}  // namespace
+
+TEST_F(SampleVectorTest, ShardedSampleCountsThreads) {
+  // Custom buckets: [0, 5) [5, 10)
+  BucketRanges ranges(3);
+  ranges.set_range(0, 0);
+  ranges.set_range(1, 5);
+  ranges.set_range(2, 10);
+  ShardedSampleCounts sharded_counts(&ranges);
+
+  constexpr int kThreads = 8;
+  constexpr int kSamples = 10000;
+  ShardedSampleCountsThread delegate(&sharded_counts, kSamples);
+  DelegateSimpleThreadPool pool("ShardedSampleCounts", kThreads);
+  pool.AddWork(&delegate, kThreads);
+  pool.Start();
+
+  // Samples moved while the threads accumulate are neither lost nor
+  // duplicated.
+  SampleVector samples(1, &ranges);
+  for (int i = 0; i < 100; ++i)
+    sharded_counts.MoveTo(&samples);
+  pool.JoinAll();
+  sharded_counts.MoveTo(&samples);
+
+  EXPECT_EQ(kThreads * kSamples / 2, samples.GetCount(0));
+  EXPECT_EQ(kThreads * kSamples / 2, samples.GetCount(5));
+  EXPECT_EQ(kThreads * kSamples, samples.redundant_count());
+  EXPECT_EQ(kThreads * (kSamples / 10) * 45, samples.sum());
+}
+
 }  // namespace base
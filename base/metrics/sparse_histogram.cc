@@ -112,10 +112,8 @@ void SparseHistogram::AddCount(Sample value, int count) {
     NOTREACHED();
     return;
   }
-  {
-    base::AutoLock auto_lock(lock_);
-    unlogged_samples_->Accumulate(value, count);
-  }
+  // The sample maps accumulate without a lock once |value| has a count.
+  unlogged_samples_->Accumulate(value, count);
 
   FindAndRunCallback(value);
 }
@@ -162,6 +160,13 @@ bool SparseHistogram::AddSamplesFromPickle(PickleIterator* iter) {
   return unlogged_samples_->AddFromPickle(iter);
 }
 
+bool SparseHistogram::AddSamplesFromIterator(int64_t sum,
+                                             Count redundant_count,
+                                             SampleCountIterator* iter) {
+  base::AutoLock auto_lock(lock_);
+  return unlogged_samples_->AddFromIterator(sum, redundant_count, iter);
+}
+
 void SparseHistogram::WriteHTMLGraph(std::string* output) const {
   output->append("<PRE>");
   WriteAsciiImpl(true, "<br>", output);
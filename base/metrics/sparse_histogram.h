@@ -51,6 +51,9 @@ class BASE_EXPORT SparseHistogram : public HistogramBase {
   void AddCount(Sample value, int count) override;
   void AddSamples(const HistogramSamples& samples) override;
   bool AddSamplesFromPickle(base::PickleIterator* iter) override;
+  bool AddSamplesFromIterator(int64_t sum,
+                              Count redundant_count,
+                              SampleCountIterator* iter) override;
   std::unique_ptr<HistogramSamples> SnapshotSamples() const override;
   std::unique_ptr<HistogramSamples> SnapshotDelta() override;
   std::unique_ptr<HistogramSamples> SnapshotFinalDelta() const override;
@@ -91,7 +94,8 @@ class BASE_EXPORT SparseHistogram : public HistogramBase {
   // For constuctor calling.
   friend class SparseHistogramTest;
 
-  // Protects access to |samples_|.
+  // Serializes the snapshots of the samples and the additions of samples
+  // from other histograms. Samples are added by AddCount() without it.
   mutable base::Lock lock_;
 
   // Flag to indicate if PrepareFinalDelta has been previously called.
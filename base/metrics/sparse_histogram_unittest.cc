@@ -17,6 +17,7 @@
 #include "base/metrics/statistics_recorder.h"
 #include "base/pickle.h"
 #include "base/strings/stringprintf.h"
+#include "base/threading/simple_thread.h"
 #include "testing/gmock/include/gmock/gmock.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -378,6 +379,51 @@ TEST_P(SparseHistogramTest, ExtremeValues) {
   }
 }
 
+namespace {
+
+class SparseHistogramAddThread : public DelegateSimpleThread::Delegate {
+ public:
+  SparseHistogramAddThread(HistogramBase* histogram, int samples)
+      : histogram_(histogram), samples_(samples) {}
+
+  void Run() override {
+    for (int i = 0; i < samples_; ++i)
+      histogram_->Add(i % 100);
+  }
+
+ private:
+  HistogramBase* const histogram_;
+  const int samples_;
+
+  DISALLOW_COPY_AND_ASSIGN(SparseHistogramAddThread);
+};
+
+}  // namespace
+
+// Samples are added without a lock, concurrently with their first recording
+// and with snapshots.
+TEST_P(SparseHistogramTest, ConcurrentAdd) {
+  HistogramBase* histogram =
+      SparseHistogram::FactoryGet("ConcurrentSparse", HistogramBase::kNoFlags);
+
+  constexpr int kThreads = 8;
+  constexpr int kSamples = 10000;
+  SparseHistogramAddThread delegate(histogram, kSamples);
+  DelegateSimpleThreadPool pool("SparseHistogramAdd", kThreads);
+  pool.AddWork(&delegate, kThreads);
+  pool.Start();
+  SampleMap logged(0);
+  for (int i = 0; i < 100; ++i)
+    logged.Add(*histogram->SnapshotDelta());
+  pool.JoinAll();
+  logged.Add(*histogram->SnapshotDelta());
+
+  EXPECT_EQ(kThreads * kSamples, logged.TotalCount());
+  EXPECT_EQ(kThreads * kSamples, logged.redundant_count());
+  for (int value = 0; value < 100; ++value)
+    EXPECT_EQ(kThreads * kSamples / 100, logged.GetCount(value));
+}
+
 TEST_P(SparseHistogramTest, HistogramNameHash) {
   const char kName[] = "TestName";
   HistogramBase* histogram = SparseHistogram::FactoryGet(
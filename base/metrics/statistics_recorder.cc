@@ -8,6 +8,7 @@
 
 #include "base/at_exit.h"
 #include "base/debug/leak_annotations.h"
+#include "base/hash.h"
 #include "base/json/string_escape.h"
 #include "base/logging.h"
 #include "base/memory/ptr_util.h"
@@ -36,9 +37,126 @@ LazyInstance<Lock>::Leaky StatisticsRecorder::lock_;
 // static
 StatisticsRecorder* StatisticsRecorder::top_ = nullptr;
 
+// static
+subtle::AtomicWord StatisticsRecorder::top_histogram_index_ = 0;
+
 // static
 bool StatisticsRecorder::is_vlog_initialized_ = false;
 
+struct StatisticsRecorder::HistogramIndex::Table {
+  // A slot is empty while |histogram| is null. |hash| is stored before
+  // |histogram| is released so that a lookup which sees the histogram sees its
+  // hash, which spares comparing the names of most other histograms.
+  struct Slot {
+    subtle::Atomic32 hash;
+    subtle::AtomicWord histogram;
+  };
+
+  explicit Table(size_t capacity)
+      : mask(capacity - 1), slots(new Slot[capacity]()) {
+    DCHECK_EQ(0u, capacity & mask);
+  }
+
+  size_t capacity() const { return mask + 1; }
+
+  void Insert(uint32_t hash, subtle::AtomicWord histogram) {
+    for (size_t i = hash & mask;; i = (i + 1) & mask) {
+      Slot& slot = slots[i];
+      if (subtle::NoBarrier_Load(&slot.histogram))
+        continue;
+      subtle::NoBarrier_Store(&slot.hash, static_cast<subtle::Atomic32>(hash));
+      subtle::Release_Store(&slot.histogram, histogram);
+      return;
+    }
+  }
+
+  // Copies the histograms of |other| but |removed|.
+  void InsertAll(const Table& other, subtle::AtomicWord removed) {
+    for (size_t i = 0; i < other.capacity(); ++i) {
+      const Slot& slot = other.slots[i];
+      if (slot.histogram && slot.histogram != removed)
+        Insert(static_cast<uint32_t>(slot.hash), slot.histogram);
+    }
+  }
+
+  const size_t mask;
+  std::unique_ptr<Slot[]> slots;
+};
+
+namespace {
+
+// The first table of a HistogramIndex has this many slots.
+constexpr size_t kInitialHistogramIndexCapacity = 64;
+
+uint32_t HashHistogramName(StringPiece name) {
+  return Hash(name.data(), name.size());
+}
+
+}  // namespace
+
+StatisticsRecorder::HistogramIndex::HistogramIndex() = default;
+
+StatisticsRecorder::HistogramIndex::~HistogramIndex() = default;
+
+HistogramBase* StatisticsRecorder::HistogramIndex::Find(
+    StringPiece name) const {
+  const Table* table =
+      reinterpret_cast<const Table*>(subtle::Acquire_Load(&table_));
+  if (!table)
+    return nullptr;
+
+  // The table is never more than half full, so there is an empty slot.
+  const uint32_t hash = HashHistogramName(name);
+  for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+    const Table::Slot& slot = table->slots[i];
+    HistogramBase* histogram = reinterpret_cast<HistogramBase*>(
+        subtle::Acquire_Load(&slot.histogram));
+    if (!histogram)
+      return nullptr;
+    if (static_cast<uint32_t>(subtle::NoBarrier_Load(&slot.hash)) == hash &&
+        name == histogram->histogram_name()) {
+      return histogram;
+    }
+  }
+}
+
+void StatisticsRecorder::HistogramIndex::Insert(HistogramBase* histogram) {
+  DCHECK(!Find(histogram->histogram_name()));
+  Table* table = tables_.empty() ? nullptr : tables_.back().get();
+  if (!table || (size_ + 1) * 2 > table->capacity()) {
+    auto new_table = std::make_unique<Table>(
+        table ? table->capacity() * 2 : kInitialHistogramIndexCapacity);
+    if (table)
+      new_table->InsertAll(*table, 0);
+    table = new_table.get();
+    Publish(std::move(new_table));
+  }
+
+  table->Insert(HashHistogramName(histogram->histogram_name()),
+                reinterpret_cast<subtle::AtomicWord>(histogram));
+  ++size_;
+}
+
+void StatisticsRecorder::HistogramIndex::Remove(HistogramBase* histogram) {
+  if (Find(histogram->histogram_name()) != histogram)
+    return;
+
+  // Removing from an open-addressing table in place could make a concurrent
+  // lookup miss another histogram, so the remaining ones are copied instead.
+  // This only happens in tests.
+  const Table& table = *tables_.back();
+  auto new_table = std::make_unique<Table>(table.capacity());
+  new_table->InsertAll(table, reinterpret_cast<subtle::AtomicWord>(histogram));
+  Publish(std::move(new_table));
+  --size_;
+}
+
+void StatisticsRecorder::HistogramIndex::Publish(std::unique_ptr<Table> table) {
+  subtle::Release_Store(&table_, reinterpret_cast<subtle::AtomicWord>(
+                                     table.get()));
+  tables_.push_back(std::move(table));
+}
+
 size_t StatisticsRecorder::BucketRangesHash::operator()(
     const BucketRanges* const a) const {
   return a->checksum();
@@ -54,6 +172,11 @@ StatisticsRecorder::~StatisticsRecorder() {
   const AutoLock auto_lock(lock_.Get());
   DCHECK_EQ(this, top_);
   top_ = previous_;
+  subtle::Release_Store(
+      &top_histogram_index_,
+      previous_ ? reinterpret_cast<subtle::AtomicWord>(
+                      &previous_->histogram_index_)
+                : 0);
 }
 
 // static
@@ -79,6 +202,17 @@ void StatisticsRecorder::RegisterHistogramProvider(
 // static
 HistogramBase* StatisticsRecorder::RegisterOrDeleteDuplicate(
     HistogramBase* histogram) {
+  // Histograms are usually registered once, but a histogram created by a race
+  // or imported from persistent memory can be a duplicate of a registered
+  // one. That case doesn't need the lock.
+  HistogramBase* const found =
+      FindHistogramWithoutLock(histogram->histogram_name());
+  if (found) {
+    if (found != histogram)
+      delete histogram;
+    return found;
+  }
+
   // Declared before |auto_lock| to ensure correct destruction order.
   std::unique_ptr<HistogramBase> histogram_deleter;
   const AutoLock auto_lock(lock_.Get());
@@ -101,6 +235,8 @@ HistogramBase* StatisticsRecorder::RegisterOrDeleteDuplicate(
       else
         histogram->ClearFlags(HistogramBase::kCallbackExists);
     }
+    // Indexed once fully registered, since it is found without the lock.
+    top_->histogram_index_.Insert(histogram);
     return histogram;
   }
 
@@ -191,6 +327,11 @@ HistogramBase* StatisticsRecorder::FindHistogram(base::StringPiece name) {
   // will acquire the lock at that time.
   ImportGlobalPersistentHistograms();
 
+  // The index has the same histograms as |histograms_|, so the lock is only
+  // needed if there is no global recorder yet.
+  if (subtle::Acquire_Load(&top_histogram_index_))
+    return FindHistogramWithoutLock(name);
+
   const AutoLock auto_lock(lock_.Get());
   EnsureGlobalRecorderWhileLocked();
 
@@ -198,6 +339,13 @@ HistogramBase* StatisticsRecorder::FindHistogram(base::StringPiece name) {
   return it != top_->histograms_.end() ? it->second : nullptr;
 }
 
+// static
+HistogramBase* StatisticsRecorder::FindHistogramWithoutLock(StringPiece name) {
+  const HistogramIndex* index = reinterpret_cast<const HistogramIndex*>(
+      subtle::Acquire_Load(&top_histogram_index_));
+  return index ? index->Find(name) : nullptr;
+}
+
 // static
 StatisticsRecorder::HistogramProviders
 StatisticsRecorder::GetHistogramProviders() {
@@ -301,6 +449,7 @@ void StatisticsRecorder::ForgetHistogramForTesting(base::StringPiece name) {
     static_cast<Histogram*>(base)->bucket_ranges()->set_persistent_reference(0);
   }
 
+  top_->histogram_index_.Remove(base);
   top_->histograms_.erase(found);
 }
 
@@ -396,6 +545,9 @@ StatisticsRecorder::StatisticsRecorder() {
   lock_.Get().AssertAcquired();
   previous_ = top_;
   top_ = this;
+  subtle::Release_Store(
+      &top_histogram_index_,
+      reinterpret_cast<subtle::AtomicWord>(&histogram_index_));
   InitLogOnShutdownWhileLocked();
 }
 
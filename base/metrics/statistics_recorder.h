@@ -18,6 +18,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "base/atomicops.h"
 #include "base/base_export.h"
 #include "base/callback.h"
 #include "base/gtest_prod_util.h"
@@ -126,7 +127,7 @@ class BASE_EXPORT StatisticsRecorder {
   // Finds a histogram by name. Matches the exact name. Returns a null pointer
   // if a matching histogram is not found.
   //
-  // This method is thread safe.
+  // This method is thread safe and lock-free once the global recorder exists.
   static HistogramBase* FindHistogram(base::StringPiece name);
 
   // Imports histograms from providers.
@@ -227,6 +228,43 @@ class BASE_EXPORT StatisticsRecorder {
   typedef std::unordered_map<StringPiece, HistogramBase*, StringPieceHash>
       HistogramMap;
 
+  // An open-addressing hash table of the registered histograms, by name, for
+  // lookups without the global lock. It is modified with the lock held; a
+  // lookup may run concurrently with a modification.
+  //
+  // A modification which grows the table or removes a histogram publishes a
+  // new table. Since a concurrent lookup may still be probing the previous
+  // one, that one is only deleted with the index.
+  class HistogramIndex {
+   public:
+    HistogramIndex();
+    ~HistogramIndex();
+
+    // Returns the histogram named |name|, or null.
+    HistogramBase* Find(StringPiece name) const;
+
+    // Adds |histogram|, whose name must not be in the index yet.
+    void Insert(HistogramBase* histogram);
+
+    // Removes |histogram|, if it is in the index.
+    void Remove(HistogramBase* histogram);
+
+   private:
+    struct Table;
+
+    // Makes |table| the current table.
+    void Publish(std::unique_ptr<Table> table);
+
+    // The current table, owned by |tables_|.
+    subtle::AtomicWord table_ = 0;
+
+    // Only accessed by modifications. The last table is the current one.
+    std::vector<std::unique_ptr<Table>> tables_;
+    size_t size_ = 0;
+
+    DISALLOW_COPY_AND_ASSIGN(HistogramIndex);
+  };
+
   // We keep a map of callbacks to histograms, so that as histograms are
   // created, we can set the callback properly.
   typedef std::unordered_map<std::string, OnSampleCallback> CallbackMap;
@@ -274,7 +312,13 @@ class BASE_EXPORT StatisticsRecorder {
   // Precondition: The global lock is already acquired.
   static void InitLogOnShutdownWhileLocked();
 
+  // Looks up |name| in the index of the global recorder without the global
+  // lock. Returns null if it isn't found or if there is no global recorder.
+  static HistogramBase* FindHistogramWithoutLock(StringPiece name);
+
   HistogramMap histograms_;
+  // Indexes the values of |histograms_| for FindHistogramWithoutLock().
+  HistogramIndex histogram_index_;
   CallbackMap callbacks_;
   RangesMap ranges_;
   HistogramProviders providers_;
@@ -291,6 +335,10 @@ class BASE_EXPORT StatisticsRecorder {
   // previous global recorder is referenced by top_->previous_.
   static StatisticsRecorder* top_;
 
+  // The |histogram_index_| of |top_|, or null. It changes with |top_|, under
+  // the global lock, but is also read without it.
+  static subtle::AtomicWord top_histogram_index_;
+
   // Tracks whether InitLogOnShutdownWhileLocked() has registered a logging
   // function that will be called when the program finishes.
   static bool is_vlog_initialized_;
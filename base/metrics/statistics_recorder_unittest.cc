@@ -7,6 +7,7 @@
 #include <stddef.h>
 
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -19,6 +20,8 @@
 #include "base/metrics/persistent_histogram_allocator.h"
 #include "base/metrics/record_histogram_checker.h"
 #include "base/metrics/sparse_histogram.h"
+#include "base/strings/stringprintf.h"
+#include "base/threading/simple_thread.h"
 #include "base/values.h"
 #include "testing/gmock/include/gmock/gmock.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -258,6 +261,78 @@ TEST_P(StatisticsRecorderTest, FindHistogram) {
   EXPECT_FALSE(StatisticsRecorder::FindHistogram("TestHistogram"));
 }
 
+TEST_P(StatisticsRecorderTest, FindManyHistograms) {
+  constexpr int kHistograms = 200;
+  // Histograms don't copy their names.
+  std::vector<std::string> names;
+  for (int i = 0; i < kHistograms; ++i)
+    names.push_back(StringPrintf("TestHistogram%d", i));
+  std::vector<HistogramBase*> histograms;
+  for (int i = 0; i < kHistograms; ++i) {
+    Histogram* histogram = CreateHistogram(names[i].c_str(), 1, 100, 5);
+    histograms.push_back(
+        StatisticsRecorder::RegisterOrDeleteDuplicate(histogram));
+    EXPECT_EQ(histogram, histograms.back());
+  }
+  for (int i = 0; i < kHistograms; ++i)
+    EXPECT_EQ(histograms[i], StatisticsRecorder::FindHistogram(names[i]));
+
+  // Forgetting a histogram doesn't hide others.
+  for (int i = 0; i < kHistograms; i += 2)
+    StatisticsRecorder::ForgetHistogramForTesting(names[i]);
+  EXPECT_EQ(static_cast<size_t>(kHistograms / 2),
+            StatisticsRecorder::GetHistogramCount());
+  for (int i = 0; i < kHistograms; ++i) {
+    EXPECT_EQ(i % 2 ? histograms[i] : nullptr,
+              StatisticsRecorder::FindHistogram(names[i]));
+  }
+}
+
+namespace {
+
+constexpr int kConcurrentHistograms = 16;
+
+// Gets the histograms, registering them if needed, and checks that they are
+// found.
+class GetHistogramsThread : public DelegateSimpleThread::Delegate {
+ public:
+  GetHistogramsThread() = default;
+
+  void Run() override {
+    for (int i = 0; i < 100 * kConcurrentHistograms; ++i) {
+      const std::string name =
+          StringPrintf("Concurrent%d", i % kConcurrentHistograms);
+      HistogramBase* histogram =
+          Histogram::FactoryGet(name, 1, 100, 5, HistogramBase::kNoFlags);
+      histogram->Add(1);
+      EXPECT_EQ(histogram, StatisticsRecorder::FindHistogram(name));
+    }
+  }
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(GetHistogramsThread);
+};
+
+}  // namespace
+
+TEST_P(StatisticsRecorderTest, ConcurrentFactoryGet) {
+  constexpr int kThreads = 4;
+  GetHistogramsThread delegate;
+  DelegateSimpleThreadPool pool("StatisticsRecorderTest", kThreads);
+  pool.AddWork(&delegate, kThreads);
+  pool.Start();
+  pool.JoinAll();
+
+  EXPECT_EQ(static_cast<size_t>(kConcurrentHistograms),
+            StatisticsRecorder::GetHistogramCount());
+  for (int i = 0; i < kConcurrentHistograms; ++i) {
+    HistogramBase* histogram = StatisticsRecorder::FindHistogram(
+        StringPrintf("Concurrent%d", i));
+    ASSERT_TRUE(histogram);
+    EXPECT_EQ(100 * kThreads, histogram->SnapshotSamples()->TotalCount());
+  }
+}
+
 TEST_P(StatisticsRecorderTest, WithName) {
   Histogram::FactoryGet("TestHistogram1", 1, 1000, 10, Histogram::kNoFlags);
   Histogram::FactoryGet("TestHistogram2", 1, 1000, 10, Histogram::kNoFlags);
@@ -440,6 +440,22 @@ void SequenceManagerImpl::NotifyWillProcessTask(ExecutingTask* executing_task,
 
   executing_task->task_timing.RecordTaskStart(time_before_task);
 
+  if (TaskAccounting::IsEnabled()) {
+    // Tasks are stamped with the time at which they may run in their queue's
+    // time domain, which is only comparable to |time_before_task| for the
+    // real time domain. The tasks which move delayed tasks posted from other
+    // threads to the main thread aren't stamped.
+    const TimeTicks run_time = executing_task->pending_task.delayed_run_time;
+    const TimeTicks queue_time =
+        executing_task->task_queue->GetTimeDomain() ==
+                    main_thread_only().real_time_domain.get() &&
+                !run_time.is_null()
+            ? run_time
+            : time_before_task->Now();
+    executing_task->task_accounting_timer.Start(queue_time,
+                                                time_before_task->Now());
+  }
+
   if (!executing_task->task_queue->GetShouldNotifyObservers())
     return;
 
@@ -486,6 +502,11 @@ void SequenceManagerImpl::NotifyDidProcessTask(ExecutingTask* executing_task,
 
   executing_task->task_timing.RecordTaskEnd(time_after_task);
 
+  if (executing_task->task_accounting_timer.is_started()) {
+    executing_task->task_accounting_timer.Stop(
+        executing_task->pending_task.posted_from, time_after_task->Now());
+  }
+
   const TaskQueue::TaskTiming& task_timing = executing_task->task_timing;
 
   if (!executing_task->task_queue->GetShouldNotifyObservers())
@@ -32,6 +32,7 @@
 #include "base/task/sequence_manager/task_queue_impl.h"
 #include "base/task/sequence_manager/task_queue_selector.h"
 #include "base/task/sequence_manager/thread_controller.h"
+#include "base/task/task_accounting.h"
 #include "base/threading/thread_checker.h"
 
 namespace base {
@@ -181,6 +182,7 @@ class BASE_EXPORT SequenceManagerImpl
     internal::TaskQueueImpl::Task pending_task;
     internal::TaskQueueImpl* task_queue = nullptr;
     TaskQueue::TaskTiming task_timing;
+    TaskAccounting::TaskTimer task_accounting_timer;
   };
 
   struct MainThreadOnly {
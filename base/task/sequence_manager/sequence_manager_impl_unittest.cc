@@ -26,6 +26,7 @@
 #include "base/task/sequence_manager/thread_controller_with_message_pump_impl.h"
 #include "base/task/sequence_manager/work_queue.h"
 #include "base/task/sequence_manager/work_queue_sets.h"
+#include "base/task/task_accounting.h"
 #include "base/test/simple_test_tick_clock.h"
 #include "base/test/test_mock_time_task_runner.h"
 #include "base/test/test_simple_task_runner.h"
@@ -547,6 +548,69 @@ TEST_P(SequenceManagerTest, DelayedTaskPosting_MultipleTasks_AscendingOrder) {
   EXPECT_THAT(run_order, ElementsAre(1u, 2u, 3u));
 }
 
+TEST_P(SequenceManagerTest, DelayedTaskPosting_TimerWheel) {
+  const TimeDelta kPrecision = TimeDelta::FromMilliseconds(10);
+  runners_.push_back(CreateTaskQueue(
+      TaskQueue::Spec("test").SetDelayedTaskPrecision(kPrecision)));
+
+  std::vector<EnqueueOrder> run_order;
+  runners_[0]->PostDelayedTask(FROM_HERE, BindOnce(&TestTask, 1, &run_order),
+                               TimeDelta::FromMilliseconds(25));
+  runners_[0]->PostDelayedTask(FROM_HERE, BindOnce(&TestTask, 2, &run_order),
+                               TimeDelta::FromMilliseconds(3));
+  runners_[0]->PostDelayedTask(FROM_HERE, BindOnce(&TestTask, 3, &run_order),
+                               TimeDelta::FromMilliseconds(21));
+  runners_[0]->PostDelayedTask(FROM_HERE, BindOnce(&TestTask, 4, &run_order),
+                               TimeDelta::FromMilliseconds(27));
+  EXPECT_EQ(4u, runners_[0]->GetNumberOfPendingTasks());
+
+  // Run times are rounded up to the precision, so nothing runs early.
+  test_task_runner_->FastForwardBy(TimeDelta::FromMilliseconds(2));
+  EXPECT_TRUE(run_order.empty());
+  TimeDelta delay = test_task_runner_->NextPendingTaskDelay();
+  EXPECT_GE(delay, TimeDelta::FromMilliseconds(1));
+  EXPECT_LE(delay, TimeDelta::FromMilliseconds(1) + kPrecision);
+
+  test_task_runner_->FastForwardBy(TimeDelta::FromMilliseconds(1) +
+                                   kPrecision);
+  EXPECT_THAT(run_order, ElementsAre(2u));
+
+  test_task_runner_->FastForwardBy(TimeDelta::FromMilliseconds(25) +
+                                   kPrecision);
+  EXPECT_THAT(run_order, ElementsAre(2u, 3u, 1u, 4u));
+  EXPECT_EQ(0u, runners_[0]->GetNumberOfPendingTasks());
+}
+
+TEST_P(SequenceManagerTest, DelayedTaskPosting_TimerWheel_SharedWakeUp) {
+  runners_.push_back(CreateTaskQueue(
+      TaskQueue::Spec("test").SetDelayedTaskPrecision(
+          TimeDelta::FromSeconds(1))));
+
+  std::vector<EnqueueOrder> run_order;
+  // Align the clock to the wheel's precision.
+  TimeTicks now = GetTickClock()->NowTicks();
+  TimeDelta to_next_second =
+      TimeDelta::FromSeconds(1) -
+      TimeDelta::FromMicroseconds((now - TimeTicks()).InMicroseconds() %
+                                  Time::kMicrosecondsPerSecond);
+  test_task_runner_->FastForwardBy(to_next_second);
+
+  runners_[0]->PostDelayedTask(FROM_HERE, BindOnce(&TestTask, 1, &run_order),
+                               TimeDelta::FromMilliseconds(900));
+  runners_[0]->PostDelayedTask(FROM_HERE, BindOnce(&TestTask, 2, &run_order),
+                               TimeDelta::FromMilliseconds(100));
+  runners_[0]->PostDelayedTask(FROM_HERE, BindOnce(&TestTask, 3, &run_order),
+                               TimeDelta::FromMilliseconds(500));
+
+  // All three tasks share a single wake-up and run in delay order.
+  EXPECT_EQ(TimeDelta::FromSeconds(1),
+            test_task_runner_->NextPendingTaskDelay());
+  test_task_runner_->FastForwardBy(TimeDelta::FromMilliseconds(999));
+  EXPECT_TRUE(run_order.empty());
+  test_task_runner_->FastForwardBy(TimeDelta::FromMilliseconds(1));
+  EXPECT_THAT(run_order, ElementsAre(2u, 3u, 1u));
+}
+
 TEST_P(SequenceManagerTest, PostDelayedTask_SharesUnderlyingDelayedTasks) {
   CreateTaskQueues(1u);
 
@@ -2611,6 +2675,44 @@ TEST_P(SequenceManagerTest, SweepCanceledDelayedTasks) {
   EXPECT_EQ(0u, runners_[0]->GetNumberOfPendingTasks());
 }
 
+TEST_P(SequenceManagerTest, SweepCanceledDelayedTasks_TimerWheel) {
+  runners_.push_back(CreateTaskQueue(
+      TaskQueue::Spec("test").SetDelayedTaskPrecision(
+          TimeDelta::FromMilliseconds(1))));
+
+  CancelableTask task1(GetTickClock());
+  CancelableTask task2(GetTickClock());
+  CancelableTask task3(GetTickClock());
+  std::vector<TimeTicks> run_times;
+  runners_[0]->PostDelayedTask(
+      FROM_HERE,
+      BindOnce(&CancelableTask::RecordTimeTask,
+               task1.weak_factory_.GetWeakPtr(), &run_times),
+      TimeDelta::FromSeconds(5));
+  runners_[0]->PostDelayedTask(
+      FROM_HERE,
+      BindOnce(&CancelableTask::RecordTimeTask,
+               task2.weak_factory_.GetWeakPtr(), &run_times),
+      TimeDelta::FromSeconds(10));
+  runners_[0]->PostDelayedTask(
+      FROM_HERE,
+      BindOnce(&CancelableTask::RecordTimeTask,
+               task3.weak_factory_.GetWeakPtr(), &run_times),
+      TimeDelta::FromHours(1));
+
+  task1.weak_factory_.InvalidateWeakPtrs();
+  task3.weak_factory_.InvalidateWeakPtrs();
+  EXPECT_EQ(3u, runners_[0]->GetNumberOfPendingTasks());
+
+  manager_->SweepCanceledDelayedTasks();
+  EXPECT_EQ(1u, runners_[0]->GetNumberOfPendingTasks());
+
+  test_task_runner_->FastForwardUntilNoTasksRemain();
+  ASSERT_EQ(1u, run_times.size());
+  EXPECT_GE(run_times[0], start_time_ + TimeDelta::FromSeconds(10));
+  EXPECT_LE(run_times[0], start_time_ + TimeDelta::FromMilliseconds(10001));
+}
+
 TEST_P(SequenceManagerTest, DelayTillNextTask) {
   CreateTaskQueues(2u);
 
@@ -2984,6 +3086,53 @@ TEST_P(SequenceManagerTest, ProcessTasksWithTaskTimeObservers) {
   UnsetOnTaskHandlers(runners_[0]);
 }
 
+void PostDelayedNopTask(scoped_refptr<SingleThreadTaskRunner> runner,
+                        const Location& posted_from) {
+  runner->PostDelayedTask(posted_from, BindOnce(&NopTask),
+                          TimeDelta::FromMilliseconds(10));
+}
+
+TEST_P(SequenceManagerTest, TaskAccounting) {
+  TaskAccounting::ResetForTesting();
+  CreateTaskQueues(1u);
+
+  const Location kImmediate = FROM_HERE;
+  const Location kDelayed = FROM_HERE;
+  const Location kDelayedFromThread = FROM_HERE;
+  runners_[0]->PostTask(kImmediate, BindOnce(&NopTask));
+  runners_[0]->PostDelayedTask(kDelayed, BindOnce(&NopTask),
+                               TimeDelta::FromMilliseconds(10));
+  Thread thread("TestThread");
+  thread.Start();
+  thread.task_runner()->PostTask(
+      FROM_HERE,
+      BindOnce(&PostDelayedNopTask, runners_[0], kDelayedFromThread));
+  thread.Stop();
+  test_task_runner_->AdvanceMockTickClock(TimeDelta::FromMilliseconds(4));
+  RunLoop().RunUntilIdle();
+  test_task_runner_->FastForwardUntilNoTasksRemain();
+
+  std::vector<TaskAccounting::Entry> snapshot = TaskAccounting::GetSnapshot();
+  TaskAccounting::ResetForTesting();
+
+  // The tasks above, and the one moving the delayed task posted from
+  // |thread| to the main thread.
+  int64_t count = 0;
+  for (const TaskAccounting::Entry& entry : snapshot) {
+    count += entry.count;
+    // The mock clock does not advance while tasks run.
+    EXPECT_EQ(TimeDelta(), entry.total_wall_time);
+    if (entry.posted_from == kImmediate) {
+      EXPECT_EQ(TimeDelta::FromMilliseconds(4), entry.total_queue_time);
+    } else {
+      // Delayed tasks wait from their scheduled time, and the task moving
+      // one to the main thread isn't accounted as waiting at all.
+      EXPECT_EQ(TimeDelta(), entry.total_queue_time);
+    }
+  }
+  EXPECT_EQ(4, count);
+}
+
 TEST_P(SequenceManagerTest, GracefulShutdown) {
   std::vector<TimeTicks> run_times;
   scoped_refptr<TestTaskQueue> main_tq = CreateTaskQueue();
@@ -129,10 +129,21 @@ class BASE_EXPORT TaskQueue : public SingleThreadTaskRunner {
       return *this;
     }
 
+    // If non-zero, pending delayed tasks are kept in a hierarchical timer
+    // wheel instead of a binary heap, which makes posting O(1). Delayed tasks
+    // may then run up to |precision| late and tasks due within the same
+    // |precision| interval share a wake-up. Intended for queues holding very
+    // large numbers of timeouts.
+    Spec SetDelayedTaskPrecision(TimeDelta precision) {
+      delayed_task_precision = precision;
+      return *this;
+    }
+
     const char* name;
     bool should_monitor_quiescence;
     TimeDomain* time_domain;
     bool should_notify_observers;
+    TimeDelta delayed_task_precision;
   };
 
   // Interface to pass per-task metadata to RendererScheduler.
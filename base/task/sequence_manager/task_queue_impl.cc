@@ -46,7 +46,10 @@ TaskQueueImpl::TaskQueueImpl(SequenceManagerImpl* sequence_manager,
     : name_(spec.name),
       thread_id_(PlatformThread::CurrentId()),
       any_thread_(sequence_manager, time_domain),
-      main_thread_only_(sequence_manager, this, time_domain),
+      main_thread_only_(sequence_manager,
+                        this,
+                        time_domain,
+                        spec.delayed_task_precision),
       should_monitor_quiescence_(spec.should_monitor_quiescence),
       should_notify_observers_(spec.should_notify_observers) {
   DCHECK(time_domain);
@@ -103,6 +106,99 @@ TaskQueueImpl::Task::Task(TaskQueue::PostedTask task,
   sequence_num = static_cast<int>(sequence_number);
 }
 
+TaskQueueImpl::DelayedIncomingQueue::DelayedIncomingQueue(
+    TimeDelta precision) {
+  if (!precision.is_zero()) {
+    wheel_ = std::make_unique<TimerWheel<Task, DelayedTaskRunsBefore>>(
+        precision);
+  }
+}
+
+TaskQueueImpl::DelayedIncomingQueue::~DelayedIncomingQueue() = default;
+
+void TaskQueueImpl::DelayedIncomingQueue::push(Task&& task) {
+  if (wheel_) {
+    TimeTicks delayed_run_time = task.delayed_run_time;
+    wheel_->insert(delayed_run_time, std::move(task));
+  } else {
+    heap_.push(std::move(task));
+  }
+}
+
+bool TaskQueueImpl::DelayedIncomingQueue::empty() const {
+  return wheel_ ? wheel_->empty() : heap_.empty();
+}
+
+size_t TaskQueueImpl::DelayedIncomingQueue::size() const {
+  return wheel_ ? wheel_->size() : heap_.size();
+}
+
+const TaskQueueImpl::Task& TaskQueueImpl::DelayedIncomingQueue::top() const {
+  return wheel_ ? wheel_->Min() : heap_.top();
+}
+
+TimeTicks TaskQueueImpl::DelayedIncomingQueue::top_wake_up_time() const {
+  return wheel_ ? wheel_->MinWakeUpTime() : heap_.top().delayed_run_time;
+}
+
+TaskQueueImpl::Task TaskQueueImpl::DelayedIncomingQueue::TakeTop(
+    TimeTicks now) {
+  DCHECK_LE(top_wake_up_time(), now);
+  if (wheel_)
+    return wheel_->TakeMin(now);
+  Task task = std::move(const_cast<Task&>(heap_.top()));
+  heap_.pop();
+  return task;
+}
+
+void TaskQueueImpl::DelayedIncomingQueue::PopCanceledTopTasks() {
+  while (!heap_.empty() && (!heap_.top().task || heap_.top().task.IsCancelled()))
+    heap_.pop();
+}
+
+void TaskQueueImpl::DelayedIncomingQueue::SweepCanceledTasks() {
+  if (wheel_) {
+    // O(n) without reordering, unlike the heap which has to be rebuilt.
+    wheel_->EraseIf([](const Task& task) { return task.task.IsCancelled(); });
+    return;
+  }
+
+  std::priority_queue<Task> remaining_tasks;
+  while (!heap_.empty()) {
+    if (!heap_.top().task.IsCancelled())
+      remaining_tasks.push(std::move(const_cast<Task&>(heap_.top())));
+    heap_.pop();
+  }
+  heap_ = std::move(remaining_tasks);
+}
+
+void TaskQueueImpl::DelayedIncomingQueue::swap(DelayedIncomingQueue& other) {
+  heap_.swap(other.heap_);
+  wheel_.swap(other.wheel_);
+}
+
+void TaskQueueImpl::DelayedIncomingQueue::AsValueInto(
+    TimeTicks now,
+    trace_event::TracedValue* state) const {
+  if (wheel_) {
+    wheel_->ForEach(
+        [now, state](const Task& task) { TaskAsValueInto(task, now, state); });
+    return;
+  }
+
+  // Remove const to search |heap_| in the destructive manner. Restore the
+  // content from |visited| later.
+  std::priority_queue<Task>* mutable_queue =
+      const_cast<std::priority_queue<Task>*>(&heap_);
+  std::priority_queue<Task> visited;
+  while (!mutable_queue->empty()) {
+    TaskAsValueInto(mutable_queue->top(), now, state);
+    visited.push(std::move(const_cast<Task&>(mutable_queue->top())));
+    mutable_queue->pop();
+  }
+  *mutable_queue = std::move(visited);
+}
+
 TaskQueueImpl::AnyThread::AnyThread(SequenceManagerImpl* sequence_manager,
                                     TimeDomain* time_domain)
     : sequence_manager(sequence_manager), time_domain(time_domain) {}
@@ -112,7 +208,8 @@ TaskQueueImpl::AnyThread::~AnyThread() = default;
 TaskQueueImpl::MainThreadOnly::MainThreadOnly(
     SequenceManagerImpl* sequence_manager,
     TaskQueueImpl* task_queue,
-    TimeDomain* time_domain)
+    TimeDomain* time_domain,
+    TimeDelta delayed_task_precision)
     : sequence_manager(sequence_manager),
       time_domain(time_domain),
       delayed_work_queue(
@@ -120,6 +217,7 @@ TaskQueueImpl::MainThreadOnly::MainThreadOnly(
       immediate_work_queue(new WorkQueue(task_queue,
                                          "immediate",
                                          WorkQueue::QueueType::kImmediate)),
+      delayed_incoming_queue(delayed_task_precision),
       set_index(0),
       is_enabled_refcount(0),
       voter_refcount(0),
@@ -166,7 +264,7 @@ void TaskQueueImpl::UnregisterTaskQueue() {
   // order inversion for tasks that are posted from within a lock, with a
   // destructor that acquires the same lock.
 
-  std::priority_queue<Task> delayed_incoming_queue;
+  DelayedIncomingQueue delayed_incoming_queue((TimeDelta()));
   delayed_incoming_queue.swap(main_thread_only().delayed_incoming_queue);
 
   std::unique_ptr<WorkQueue> immediate_work_queue =
@@ -394,7 +492,7 @@ bool TaskQueueImpl::HasTaskToRunImmediately() const {
   // Tasks on |delayed_incoming_queue| that could run now, count as
   // immediate work.
   if (!main_thread_only().delayed_incoming_queue.empty() &&
-      main_thread_only().delayed_incoming_queue.top().delayed_run_time <=
+      main_thread_only().delayed_incoming_queue.top_wake_up_time() <=
           main_thread_only().time_domain->CreateLazyNow().Now()) {
     return true;
   }
@@ -410,7 +508,10 @@ TaskQueueImpl::GetNextScheduledWakeUpImpl() {
   if (main_thread_only().delayed_incoming_queue.empty() || !IsQueueEnabled())
     return nullopt;
 
-  return main_thread_only().delayed_incoming_queue.top().delayed_wake_up();
+  const DelayedIncomingQueue& delayed_incoming_queue =
+      main_thread_only().delayed_incoming_queue;
+  return DelayedWakeUp{delayed_incoming_queue.top_wake_up_time(),
+                       delayed_incoming_queue.top().sequence_num};
 }
 
 Optional<TimeTicks> TaskQueueImpl::GetNextScheduledWakeUp() {
@@ -423,20 +524,21 @@ Optional<TimeTicks> TaskQueueImpl::GetNextScheduledWakeUp() {
 void TaskQueueImpl::WakeUpForDelayedWork(LazyNow* lazy_now) {
   // Enqueue all delayed tasks that should be running now, skipping any that
   // have been canceled.
-  while (!main_thread_only().delayed_incoming_queue.empty()) {
-    Task& task =
-        const_cast<Task&>(main_thread_only().delayed_incoming_queue.top());
-    if (!task.task || task.task.IsCancelled()) {
-      main_thread_only().delayed_incoming_queue.pop();
-      continue;
-    }
-    if (task.delayed_run_time > lazy_now->Now())
+  DelayedIncomingQueue& delayed_incoming_queue =
+      main_thread_only().delayed_incoming_queue;
+  while (true) {
+    delayed_incoming_queue.PopCanceledTopTasks();
+    if (delayed_incoming_queue.empty() ||
+        delayed_incoming_queue.top_wake_up_time() > lazy_now->Now()) {
       break;
+    }
+    Task task = delayed_incoming_queue.TakeTop(lazy_now->Now());
+    if (!task.task || task.task.IsCancelled())
+      continue;
     ActivateDelayedFenceIfNeeded(task.delayed_run_time);
     task.set_enqueue_order(
         main_thread_only().sequence_manager->GetNextSequenceNumber());
     main_thread_only().delayed_work_queue->Push(std::move(task));
-    main_thread_only().delayed_incoming_queue.pop();
 
     // Normally WakeUpForDelayedWork is called inside DoWork, but it also
     // can be called elsewhere (e.g. tests and fast-path for posting
@@ -547,7 +649,7 @@ void TaskQueueImpl::AsValueInto(TimeTicks now,
     main_thread_only().immediate_work_queue->AsValueInto(now, state);
     state->EndArray();
     state->BeginArray("delayed_incoming_queue");
-    QueueAsValueInto(main_thread_only().delayed_incoming_queue, now, state);
+    main_thread_only().delayed_incoming_queue.AsValueInto(now, state);
     state->EndArray();
   }
   state->SetString("priority", TaskQueue::PriorityToString(GetQueuePriority()));
@@ -731,23 +833,6 @@ void TaskQueueImpl::QueueAsValueInto(const TaskDeque& queue,
   }
 }
 
-// static
-void TaskQueueImpl::QueueAsValueInto(const std::priority_queue<Task>& queue,
-                                     TimeTicks now,
-                                     trace_event::TracedValue* state) {
-  // Remove const to search |queue| in the destructive manner. Restore the
-  // content from |visited| later.
-  std::priority_queue<Task>* mutable_queue =
-      const_cast<std::priority_queue<Task>*>(&queue);
-  std::priority_queue<Task> visited;
-  while (!mutable_queue->empty()) {
-    TaskAsValueInto(mutable_queue->top(), now, state);
-    visited.push(std::move(const_cast<Task&>(mutable_queue->top())));
-    mutable_queue->pop();
-  }
-  *mutable_queue = std::move(visited);
-}
-
 // static
 void TaskQueueImpl::TaskAsValueInto(const Task& task,
                                     TimeTicks now,
@@ -865,17 +950,7 @@ void TaskQueueImpl::SweepCanceledDelayedTasks(TimeTicks now) {
   if (main_thread_only().delayed_incoming_queue.empty())
     return;
 
-  // Remove canceled tasks.
-  std::priority_queue<Task> remaining_tasks;
-  while (!main_thread_only().delayed_incoming_queue.empty()) {
-    if (!main_thread_only().delayed_incoming_queue.top().task.IsCancelled()) {
-      remaining_tasks.push(std::move(
-          const_cast<Task&>(main_thread_only().delayed_incoming_queue.top())));
-    }
-    main_thread_only().delayed_incoming_queue.pop();
-  }
-
-  main_thread_only().delayed_incoming_queue = std::move(remaining_tasks);
+  main_thread_only().delayed_incoming_queue.SweepCanceledTasks();
 
   LazyNow lazy_now(now);
   UpdateDelayedWakeUp(&lazy_now);
@@ -8,6 +8,7 @@
 #include <stddef.h>
 
 #include <memory>
+#include <queue>
 #include <set>
 
 #include "base/callback.h"
@@ -21,6 +22,7 @@
 #include "base/task/sequence_manager/lazily_deallocated_deque.h"
 #include "base/task/sequence_manager/sequenced_task_source.h"
 #include "base/task/sequence_manager/task_queue.h"
+#include "base/task/sequence_manager/timer_wheel.h"
 #include "base/threading/thread_checker.h"
 #include "base/trace_event/trace_event.h"
 #include "base/trace_event/trace_event_argument.h"
@@ -50,7 +52,9 @@ struct IncomingImmediateWorkList {
 //    |immediate_work_queue| - SequenceManager takes immediate tasks here.
 //
 // Delayed tasks
-//    |delayed_incoming_queue| - PostDelayedTask enqueues tasks here.
+//    |delayed_incoming_queue| - PostDelayedTask enqueues tasks here. This is
+//                               a binary heap, or a TimerWheel if the queue
+//                               has a delayed task precision.
 //    |delayed_work_queue| - SequenceManager takes delayed tasks here.
 //
 // The |immediate_incoming_queue| can be accessed from any thread, the other
@@ -333,10 +337,56 @@ class BASE_EXPORT TaskQueueImpl {
     OnNextWakeUpChangedCallback on_next_wake_up_changed_callback;
   };
 
+  // Orders delayed tasks with equal wake-up ticks in the TimerWheel.
+  struct DelayedTaskRunsBefore {
+    bool operator()(const Task& a, const Task& b) const {
+      // PendingTask::operator< is inverted for use with std::priority_queue.
+      return b < a;
+    }
+  };
+
+  // Holds delayed tasks until they are due. Backed by a binary heap, or by a
+  // TimerWheel if |precision| is non-zero, in which case tasks become due
+  // when their run time rounded up to |precision| is reached.
+  class DelayedIncomingQueue {
+   public:
+    explicit DelayedIncomingQueue(TimeDelta precision);
+    ~DelayedIncomingQueue();
+
+    void push(Task&& task);
+    bool empty() const;
+    size_t size() const;
+    const Task& top() const;
+
+    // Returns the time at which top() becomes due.
+    TimeTicks top_wake_up_time() const;
+
+    // Removes and returns top(), which must be due at |now|.
+    Task TakeTop(TimeTicks now);
+
+    // Discards canceled tasks from the top of the heap. The TimerWheel doesn't
+    // support this cheaply, instead it drops canceled tasks when they become
+    // due or are swept.
+    void PopCanceledTopTasks();
+
+    void SweepCanceledTasks();
+
+    void swap(DelayedIncomingQueue& other);
+
+    void AsValueInto(TimeTicks now, trace_event::TracedValue* state) const;
+
+   private:
+    std::priority_queue<Task> heap_;
+    std::unique_ptr<TimerWheel<Task, DelayedTaskRunsBefore>> wheel_;
+
+    DISALLOW_COPY_AND_ASSIGN(DelayedIncomingQueue);
+  };
+
   struct MainThreadOnly {
     MainThreadOnly(SequenceManagerImpl* sequence_manager,
                    TaskQueueImpl* task_queue,
-                   TimeDomain* time_domain);
+                   TimeDomain* time_domain,
+                   TimeDelta delayed_task_precision);
     ~MainThreadOnly();
 
     // Another copy of SequenceManagerImpl, TimeDomain and Observer
@@ -349,7 +399,7 @@ class BASE_EXPORT TaskQueueImpl {
 
     std::unique_ptr<WorkQueue> delayed_work_queue;
     std::unique_ptr<WorkQueue> immediate_work_queue;
-    std::priority_queue<TaskQueueImpl::Task> delayed_incoming_queue;
+    DelayedIncomingQueue delayed_incoming_queue;
     ObserverList<MessageLoop::TaskObserver> task_observers;
     size_t set_index;
     HeapHandle heap_handle;
@@ -399,9 +449,6 @@ class BASE_EXPORT TaskQueueImpl {
   static void QueueAsValueInto(const TaskDeque& queue,
                                TimeTicks now,
                                trace_event::TracedValue* state);
-  static void QueueAsValueInto(const std::priority_queue<Task>& queue,
-                               TimeTicks now,
-                               trace_event::TracedValue* state);
   static void TaskAsValueInto(const Task& task,
                               TimeTicks now,
                               trace_event::TracedValue* state);
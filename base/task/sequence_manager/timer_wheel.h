@@ -0,0 +1,313 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TASK_SEQUENCE_MANAGER_TIMER_WHEEL_H_
+#define BASE_TASK_SEQUENCE_MANAGER_TIMER_WHEEL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "base/bits.h"
+#include "base/logging.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace base {
+namespace sequence_manager {
+namespace internal {
+
+// A hierarchical timing wheel. Elements are keyed by a TimeTicks which is
+// rounded up to a multiple of |precision|, i.e. an element is never reported
+// as due before its time, but may be reported up to |precision| late. Elements
+// whose rounded times are equal share a wake-up.
+//
+// Each level has 64 slots. An element lives on the level given by the highest
+// 6-bit group in which its tick differs from the wheel's cursor, in the slot
+// given by its tick's value in that group. Consequently every element on
+// level n is due before every element on level n + 1, and within a level the
+// slot index orders elements by time. The earliest slot is found with two
+// bit scans and a slot is only re-filed ("cascaded") onto lower levels when
+// its elements are about to become due.
+//
+// Complexity:
+//  - insert: O(1).
+//  - Min: O(1), except for a linear scan of the earliest slot after it has
+//    changed.
+//  - TakeMin: amortized O(number of levels).
+//  - EraseIf, ForEach: O(n).
+//
+// T must be moveable. |Compare| orders elements with equal ticks; Compare(a, b)
+// returns true if |a| should be taken before |b|.
+template <typename T, typename Compare = std::less<T>>
+class TimerWheel {
+ public:
+  explicit TimerWheel(TimeDelta precision)
+      : precision_us_(precision.InMicroseconds()) {
+    DCHECK_GT(precision_us_, 0);
+    std::fill(std::begin(occupied_), std::end(occupied_), 0u);
+  }
+
+  ~TimerWheel() = default;
+
+  bool empty() const { return size_ == 0; }
+
+  size_t size() const { return size_; }
+
+  TimeDelta precision() const {
+    return TimeDelta::FromMicroseconds(precision_us_);
+  }
+
+  void insert(TimeTicks time, T element) {
+    uint64_t tick = TickForTime(time);
+    // A time domain change can hand us a time before the cursor. Such an
+    // element is overdue anyway, so file it at the cursor.
+    if (tick < cursor_)
+      tick = cursor_;
+    size_t level = LevelForTick(tick);
+    size_t slot = SlotForTick(tick, level);
+    std::vector<Entry>& entries = slots_[level][slot];
+    entries.push_back(Entry{tick, std::move(element)});
+    MarkOccupied(level, slot);
+    size_++;
+
+    if (!min_valid_)
+      return;
+    if (level < min_level_ || (level == min_level_ && slot < min_slot_)) {
+      min_level_ = level;
+      min_slot_ = slot;
+      min_index_ = entries.size() - 1;
+      front_sorted_ = entries.size() == 1;
+    } else if (level == min_level_ && slot == min_slot_) {
+      if (compare_(entries.back().element, entries[min_index_].element)) {
+        // Appending the new minimum keeps a sorted slot sorted.
+        min_index_ = entries.size() - 1;
+      } else {
+        front_sorted_ = false;
+      }
+    }
+  }
+
+  // Returns the element which will be taken next.
+  const T& Min() const {
+    DCHECK(!empty());
+    EnsureMin();
+    return slots_[min_level_][min_slot_][min_index_].element;
+  }
+
+  // Returns the time at which Min() becomes due, i.e. its time rounded up to
+  // the wheel's precision.
+  TimeTicks MinWakeUpTime() const {
+    DCHECK(!empty());
+    EnsureMin();
+    return TimeForTick(slots_[min_level_][min_slot_][min_index_].tick);
+  }
+
+  // Removes and returns Min(). |now| must be no earlier than MinWakeUpTime().
+  T TakeMin(TimeTicks now) {
+    DCHECK(!empty());
+    DCHECK_LE(MinWakeUpTime(), now);
+    EnsureMin();
+    while (min_level_ > 0)
+      Cascade(min_level_, min_slot_);
+
+    std::vector<Entry>& entries = slots_[0][min_slot_];
+    cursor_ = entries[min_index_].tick;
+    if (!front_sorted_) {
+      // All the elements of a level 0 slot share a tick, so sort them once
+      // (in reverse) and pop them off the back.
+      std::sort(entries.begin(), entries.end(),
+                [this](const Entry& a, const Entry& b) {
+                  return compare_(b.element, a.element);
+                });
+      front_sorted_ = true;
+    }
+    T element = std::move(entries.back().element);
+    entries.pop_back();
+    size_--;
+    if (entries.empty()) {
+      ClearOccupied(0, min_slot_);
+      min_valid_ = false;
+    } else {
+      min_index_ = entries.size() - 1;
+    }
+    return element;
+  }
+
+  // Removes all elements for which |predicate| returns true. Returns the
+  // number of removed elements.
+  template <typename Predicate>
+  size_t EraseIf(Predicate predicate) {
+    size_t erased = 0;
+    for (size_t level = 0; level < kNumLevels; level++) {
+      uint64_t occupied = occupied_[level];
+      while (occupied) {
+        size_t slot = bits::CountTrailingZeroBits(occupied);
+        occupied &= occupied - 1;
+        std::vector<Entry>& entries = slots_[level][slot];
+        auto new_end =
+            std::remove_if(entries.begin(), entries.end(),
+                           [&predicate](const Entry& entry) {
+                             return predicate(entry.element);
+                           });
+        erased += entries.end() - new_end;
+        entries.erase(new_end, entries.end());
+        if (entries.empty())
+          ClearOccupied(level, slot);
+      }
+    }
+    size_ -= erased;
+    if (erased)
+      min_valid_ = false;
+    return erased;
+  }
+
+  // Calls |function| for every element, in no particular order.
+  template <typename Function>
+  void ForEach(Function function) const {
+    for (size_t level = 0; level < kNumLevels; level++) {
+      uint64_t occupied = occupied_[level];
+      while (occupied) {
+        size_t slot = bits::CountTrailingZeroBits(occupied);
+        occupied &= occupied - 1;
+        for (const Entry& entry : slots_[level][slot])
+          function(entry.element);
+      }
+    }
+  }
+
+  void Clear() {
+    for (size_t level = 0; level < kNumLevels; level++) {
+      for (std::vector<Entry>& entries : slots_[level])
+        std::vector<Entry>().swap(entries);
+      occupied_[level] = 0u;
+    }
+    occupied_levels_ = 0u;
+    size_ = 0;
+    min_valid_ = false;
+  }
+
+ private:
+  static constexpr size_t kBitsPerLevel = 6;
+  static constexpr size_t kSlotsPerLevel = 1u << kBitsPerLevel;
+  // Enough levels to cover every uint64_t tick.
+  static constexpr size_t kNumLevels = (64 + kBitsPerLevel - 1) / kBitsPerLevel;
+
+  struct Entry {
+    uint64_t tick;
+    T element;
+  };
+
+  uint64_t TickForTime(TimeTicks time) const {
+    int64_t us = (time - TimeTicks()).InMicroseconds();
+    if (us <= 0)
+      return 0u;
+    return static_cast<uint64_t>(us / precision_us_ +
+                                 (us % precision_us_ != 0));
+  }
+
+  TimeTicks TimeForTick(uint64_t tick) const {
+    if (tick > static_cast<uint64_t>(std::numeric_limits<int64_t>::max() /
+                                     precision_us_)) {
+      return TimeTicks::Max();
+    }
+    return TimeTicks() + TimeDelta::FromMicroseconds(
+                             static_cast<int64_t>(tick) * precision_us_);
+  }
+
+  size_t LevelForTick(uint64_t tick) const {
+    uint64_t difference = tick ^ cursor_;
+    if (!difference)
+      return 0u;
+    return (63u - bits::CountLeadingZeroBits(difference)) / kBitsPerLevel;
+  }
+
+  static size_t SlotForTick(uint64_t tick, size_t level) {
+    return (tick >> (level * kBitsPerLevel)) & (kSlotsPerLevel - 1);
+  }
+
+  void MarkOccupied(size_t level, size_t slot) {
+    occupied_[level] |= uint64_t{1} << slot;
+    occupied_levels_ |= 1u << level;
+  }
+
+  void ClearOccupied(size_t level, size_t slot) {
+    occupied_[level] &= ~(uint64_t{1} << slot);
+    if (!occupied_[level])
+      occupied_levels_ &= ~(1u << level);
+  }
+
+  void EnsureMin() const {
+    if (min_valid_)
+      return;
+    DCHECK(occupied_levels_);
+    min_level_ = bits::CountTrailingZeroBits(occupied_levels_);
+    min_slot_ = bits::CountTrailingZeroBits(occupied_[min_level_]);
+    const std::vector<Entry>& entries = slots_[min_level_][min_slot_];
+    min_index_ = 0;
+    for (size_t i = 1; i < entries.size(); i++) {
+      if (compare_(entries[i].element, entries[min_index_].element))
+        min_index_ = i;
+    }
+    front_sorted_ = entries.size() == 1;
+    min_valid_ = true;
+  }
+
+  // Moves the cursor to the start of the earliest slot, which must be on
+  // |level| > 0, and re-files its elements onto lower levels.
+  void Cascade(size_t level, size_t slot) {
+    DCHECK_GT(level, 0u);
+    uint64_t low_mask = std::numeric_limits<uint64_t>::max();
+    if ((level + 1) * kBitsPerLevel < 64)
+      low_mask = (uint64_t{1} << ((level + 1) * kBitsPerLevel)) - 1;
+    cursor_ = (cursor_ & ~low_mask) |
+              (static_cast<uint64_t>(slot) << (level * kBitsPerLevel));
+
+    std::vector<Entry> entries;
+    entries.swap(slots_[level][slot]);
+    ClearOccupied(level, slot);
+    size_ -= entries.size();
+    min_valid_ = false;
+    for (Entry& entry : entries) {
+      size_t new_level = LevelForTick(entry.tick);
+      size_t new_slot = SlotForTick(entry.tick, new_level);
+      DCHECK_LT(new_level, level);
+      slots_[new_level][new_slot].push_back(std::move(entry));
+      MarkOccupied(new_level, new_slot);
+      size_++;
+    }
+    EnsureMin();
+  }
+
+  const int64_t precision_us_;
+  Compare compare_;
+  // All elements have ticks at or after |cursor_|.
+  uint64_t cursor_ = 0u;
+  size_t size_ = 0u;
+  uint32_t occupied_levels_ = 0u;
+  uint64_t occupied_[kNumLevels];
+  std::vector<Entry> slots_[kNumLevels][kSlotsPerLevel];
+
+  // Cached position of Min().
+  mutable bool min_valid_ = false;
+  mutable size_t min_level_ = 0u;
+  mutable size_t min_slot_ = 0u;
+  mutable size_t min_index_ = 0u;
+  // True if the slot at the cached position is sorted in reverse order.
+  mutable bool front_sorted_ = false;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerWheel);
+};
+
+}  // namespace internal
+}  // namespace sequence_manager
+}  // namespace base
+
+#endif  // BASE_TASK_SEQUENCE_MANAGER_TIMER_WHEEL_H_
@@ -0,0 +1,130 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/task/sequence_manager/timer_wheel.h"
+
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "base/rand_util.h"
+#include "base/strings/stringprintf.h"
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+namespace sequence_manager {
+namespace internal {
+
+namespace {
+
+// Mirrors the fields of a delayed task that matter for ordering. Timeouts are
+// modeled after per-connection idle timers: most are canceled before they
+// fire.
+struct Timer {
+  TimeTicks run_time;
+  int sequence_num;
+  bool canceled;
+
+  // Inverted, like PendingTask, for std::priority_queue.
+  bool operator<(const Timer& other) const {
+    if (run_time != other.run_time)
+      return run_time > other.run_time;
+    return sequence_num > other.sequence_num;
+  }
+};
+
+struct TimerRunsBefore {
+  bool operator()(const Timer& a, const Timer& b) const { return b < a; }
+};
+
+std::vector<Timer> MakeTimers(size_t count) {
+  std::vector<Timer> timers;
+  timers.reserve(count);
+  TimeTicks start = TimeTicks() + TimeDelta::FromSeconds(1);
+  for (size_t i = 0; i < count; i++) {
+    timers.push_back({start + TimeDelta::FromMilliseconds(RandInt(1, 60000)),
+                      static_cast<int>(i), RandInt(0, 9) != 0});
+  }
+  return timers;
+}
+
+void PrintNsPerTimer(const std::string& trace,
+                     TimeTicks start,
+                     size_t num_timers) {
+  perf_test::PrintResult(
+      "timers", "", trace,
+      (TimeTicks::Now() - start).InNanoseconds() /
+          static_cast<double>(num_timers),
+      "ns/timer", true);
+}
+
+void BenchmarkHeap(size_t num_timers) {
+  std::vector<Timer> timers = MakeTimers(num_timers);
+  std::priority_queue<Timer> heap;
+
+  TimeTicks start = TimeTicks::Now();
+  for (const Timer& timer : timers)
+    heap.push(timer);
+  PrintNsPerTimer(StringPrintf("heap_insert_%zu", num_timers), start,
+                  num_timers);
+
+  start = TimeTicks::Now();
+  std::priority_queue<Timer> remaining;
+  while (!heap.empty()) {
+    if (!heap.top().canceled)
+      remaining.push(heap.top());
+    heap.pop();
+  }
+  heap = std::move(remaining);
+  PrintNsPerTimer(StringPrintf("heap_sweep_%zu", num_timers), start,
+                  num_timers);
+
+  start = TimeTicks::Now();
+  while (!heap.empty())
+    heap.pop();
+  PrintNsPerTimer(StringPrintf("heap_drain_%zu", num_timers), start,
+                  num_timers);
+}
+
+void BenchmarkWheel(size_t num_timers, TimeDelta precision) {
+  std::vector<Timer> timers = MakeTimers(num_timers);
+  TimerWheel<Timer, TimerRunsBefore> wheel(precision);
+  std::string suffix =
+      StringPrintf("%zu_%dms", num_timers,
+                   static_cast<int>(precision.InMilliseconds()));
+
+  TimeTicks start = TimeTicks::Now();
+  for (const Timer& timer : timers)
+    wheel.insert(timer.run_time, timer);
+  PrintNsPerTimer("wheel_insert_" + suffix, start, num_timers);
+
+  start = TimeTicks::Now();
+  wheel.EraseIf([](const Timer& timer) { return timer.canceled; });
+  PrintNsPerTimer("wheel_sweep_" + suffix, start, num_timers);
+
+  start = TimeTicks::Now();
+  while (!wheel.empty())
+    wheel.TakeMin(wheel.MinWakeUpTime());
+  PrintNsPerTimer("wheel_drain_" + suffix, start, num_timers);
+}
+
+}  // namespace
+
+TEST(TimerWheelPerfTest, OneMillionTimers) {
+  BenchmarkHeap(1000000);
+  BenchmarkWheel(1000000, TimeDelta::FromMilliseconds(1));
+  BenchmarkWheel(1000000, TimeDelta::FromMilliseconds(16));
+}
+
+TEST(TimerWheelPerfTest, FourMillionTimers) {
+  BenchmarkHeap(4000000);
+  BenchmarkWheel(4000000, TimeDelta::FromMilliseconds(1));
+  BenchmarkWheel(4000000, TimeDelta::FromMilliseconds(16));
+}
+
+}  // namespace internal
+}  // namespace sequence_manager
+}  // namespace base
@@ -0,0 +1,187 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/task/sequence_manager/timer_wheel.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "base/rand_util.h"
+#include "testing/gmock/include/gmock/gmock.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace sequence_manager {
+namespace internal {
+
+namespace {
+
+struct TestElement {
+  int64_t time_us;
+  int sequence_num;
+
+  bool operator<(const TestElement& other) const {
+    if (time_us != other.time_us)
+      return time_us < other.time_us;
+    return sequence_num < other.sequence_num;
+  }
+};
+
+TimeTicks FromUs(int64_t us) {
+  return TimeTicks() + TimeDelta::FromMicroseconds(us);
+}
+
+void Insert(TimerWheel<TestElement>* wheel, int64_t time_us, int seq) {
+  wheel->insert(FromUs(time_us), {time_us, seq});
+}
+
+}  // namespace
+
+TEST(TimerWheelTest, Basic) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(0u, wheel.size());
+
+  Insert(&wheel, 10, 1);
+  EXPECT_FALSE(wheel.empty());
+  EXPECT_EQ(1u, wheel.size());
+  EXPECT_EQ(10, wheel.Min().time_us);
+  EXPECT_EQ(FromUs(10), wheel.MinWakeUpTime());
+}
+
+TEST(TimerWheelTest, MinAcrossLevels) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+
+  Insert(&wheel, 1000000, 1);
+  Insert(&wheel, 5000, 2);
+  Insert(&wheel, 70, 3);
+  Insert(&wheel, 100000000, 4);
+  EXPECT_EQ(70, wheel.Min().time_us);
+
+  Insert(&wheel, 3, 5);
+  EXPECT_EQ(3, wheel.Min().time_us);
+}
+
+TEST(TimerWheelTest, TakeMinInOrder) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+  std::vector<int64_t> times = {5,     64,      63,      4096,  4095,
+                                1 << 20, 123456, 7,       262144, 999999};
+  for (size_t i = 0; i < times.size(); i++)
+    Insert(&wheel, times[i], static_cast<int>(i));
+
+  std::sort(times.begin(), times.end());
+  for (int64_t time : times) {
+    ASSERT_FALSE(wheel.empty());
+    EXPECT_EQ(FromUs(time), wheel.MinWakeUpTime());
+    EXPECT_EQ(time, wheel.TakeMin(FromUs(time)).time_us);
+  }
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, EqualTicksOrderedByCompare) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+
+  Insert(&wheel, 100, 3);
+  Insert(&wheel, 100, 1);
+  Insert(&wheel, 100, 2);
+
+  EXPECT_EQ(1, wheel.TakeMin(FromUs(100)).sequence_num);
+  // Inserting into the slot being drained keeps ordering.
+  Insert(&wheel, 100, 0);
+  EXPECT_EQ(0, wheel.TakeMin(FromUs(100)).sequence_num);
+  EXPECT_EQ(2, wheel.TakeMin(FromUs(100)).sequence_num);
+  EXPECT_EQ(3, wheel.TakeMin(FromUs(100)).sequence_num);
+  EXPECT_TRUE(wheel.empty());
+}
+
+TEST(TimerWheelTest, PrecisionCoalescesWakeUps) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMilliseconds(1));
+
+  Insert(&wheel, 1001, 1);
+  Insert(&wheel, 1999, 2);
+  Insert(&wheel, 2001, 3);
+
+  // Times are rounded up, never down.
+  EXPECT_EQ(FromUs(2000), wheel.MinWakeUpTime());
+  EXPECT_EQ(1, wheel.TakeMin(FromUs(2000)).sequence_num);
+  EXPECT_EQ(FromUs(2000), wheel.MinWakeUpTime());
+  EXPECT_EQ(2, wheel.TakeMin(FromUs(2000)).sequence_num);
+  EXPECT_EQ(FromUs(3000), wheel.MinWakeUpTime());
+}
+
+TEST(TimerWheelTest, InsertBeforeCursorIsOverdue) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+
+  Insert(&wheel, 5000, 1);
+  EXPECT_EQ(1, wheel.TakeMin(FromUs(5000)).sequence_num);
+
+  Insert(&wheel, 6000, 2);
+  Insert(&wheel, 10, 3);
+  EXPECT_EQ(3, wheel.Min().sequence_num);
+  EXPECT_EQ(FromUs(5000), wheel.MinWakeUpTime());
+}
+
+TEST(TimerWheelTest, EraseIf) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+
+  for (int i = 0; i < 100; i++)
+    Insert(&wheel, i * 1000, i);
+
+  EXPECT_EQ(50u, wheel.EraseIf([](const TestElement& element) {
+    return element.sequence_num % 2 == 0;
+  }));
+  EXPECT_EQ(50u, wheel.size());
+  EXPECT_EQ(1, wheel.Min().sequence_num);
+
+  size_t count = 0;
+  wheel.ForEach([&count](const TestElement& element) {
+    EXPECT_EQ(1, element.sequence_num % 2);
+    count++;
+  });
+  EXPECT_EQ(50u, count);
+}
+
+TEST(TimerWheelTest, Clear) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+
+  Insert(&wheel, 10, 1);
+  Insert(&wheel, 100000, 2);
+  wheel.Clear();
+  EXPECT_TRUE(wheel.empty());
+
+  Insert(&wheel, 20, 3);
+  EXPECT_EQ(3, wheel.Min().sequence_num);
+}
+
+TEST(TimerWheelTest, RandomizedAgainstSort) {
+  TimerWheel<TestElement> wheel(TimeDelta::FromMicroseconds(1));
+  std::vector<TestElement> expected;
+  int64_t now_us = 0;
+  int seq = 0;
+
+  for (int round = 0; round < 50; round++) {
+    for (int i = 0; i < 100; i++) {
+      int64_t time_us = now_us + RandInt(0, 1 << RandInt(0, 24));
+      Insert(&wheel, time_us, seq);
+      expected.push_back({time_us, seq++});
+    }
+    std::sort(expected.begin(), expected.end());
+
+    now_us += RandInt(0, 1 << 20);
+    size_t taken = 0;
+    while (!wheel.empty() && wheel.MinWakeUpTime() <= FromUs(now_us)) {
+      TestElement element = wheel.TakeMin(FromUs(now_us));
+      ASSERT_LT(taken, expected.size());
+      EXPECT_EQ(expected[taken].sequence_num, element.sequence_num);
+      taken++;
+    }
+    expected.erase(expected.begin(), expected.begin() + taken);
+    EXPECT_EQ(expected.size(), wheel.size());
+  }
+}
+
+}  // namespace internal
+}  // namespace sequence_manager
+}  // namespace base
@@ -0,0 +1,286 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/task/task_accounting.h"
+
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "base/logging.h"
+#include "base/metrics/histogram.h"
+#include "base/no_destructor.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local_storage.h"
+
+namespace base {
+
+namespace {
+
+// Entries keyed by the program counter of their Location, which identifies it.
+using EntryMap = std::unordered_map<const void*, TaskAccounting::Entry>;
+
+std::atomic_bool g_enabled{true};
+
+void AddEntry(const TaskAccounting::Entry& from, EntryMap* to) {
+  TaskAccounting::Entry& entry = (*to)[from.posted_from.program_counter()];
+  entry.posted_from = from.posted_from;
+  entry.count += from.count;
+  entry.total_queue_time += from.total_queue_time;
+  entry.max_queue_time = std::max(entry.max_queue_time, from.max_queue_time);
+  entry.total_wall_time += from.total_wall_time;
+  entry.max_wall_time = std::max(entry.max_wall_time, from.max_wall_time);
+  entry.thread_time_samples += from.thread_time_samples;
+  entry.total_thread_time += from.total_thread_time;
+}
+
+}  // namespace
+
+namespace internal {
+
+// The totals of the tasks run on one thread. Only that thread records into it,
+// so |lock_| is only contended while a snapshot is taken.
+class TaskAccountingShard {
+ public:
+  TaskAccountingShard() = default;
+
+  // Returns true once every TaskAccounting::kThreadTimeSamplingInterval calls.
+  // Must be called on the shard's thread.
+  bool ShouldSampleThreadTime() {
+    if (--tasks_until_thread_time_sample_ > 0)
+      return false;
+    tasks_until_thread_time_sample_ =
+        TaskAccounting::kThreadTimeSamplingInterval;
+    return true;
+  }
+
+  void Record(const Location& posted_from,
+              TimeDelta queue_time,
+              TimeDelta wall_time,
+              bool has_thread_time,
+              TimeDelta thread_time) {
+    AutoLock auto_lock(lock_);
+    TaskAccounting::Entry& entry = entries_[posted_from.program_counter()];
+    if (!entry.count)
+      entry.posted_from = posted_from;
+    entry.count++;
+    entry.total_queue_time += queue_time;
+    entry.max_queue_time = std::max(entry.max_queue_time, queue_time);
+    entry.total_wall_time += wall_time;
+    entry.max_wall_time = std::max(entry.max_wall_time, wall_time);
+    if (has_thread_time) {
+      entry.thread_time_samples++;
+      entry.total_thread_time += thread_time;
+    }
+  }
+
+  void MergeInto(EntryMap* entries) {
+    AutoLock auto_lock(lock_);
+    for (const auto& entry : entries_)
+      AddEntry(entry.second, entries);
+  }
+
+  void Clear() {
+    AutoLock auto_lock(lock_);
+    entries_.clear();
+  }
+
+ private:
+  Lock lock_;
+  EntryMap entries_;
+  int tasks_until_thread_time_sample_ = 1;
+
+  DISALLOW_COPY_AND_ASSIGN(TaskAccountingShard);
+};
+
+}  // namespace internal
+
+namespace {
+
+using internal::TaskAccountingShard;
+
+struct Registry {
+  Lock lock;
+  // The shards of the threads which are alive.
+  std::vector<TaskAccountingShard*> shards;
+  // The totals of the threads which exited.
+  EntryMap exited_threads;
+  // The totals as of the last RecordHistograms().
+  EntryMap last_recorded;
+};
+
+Registry& GetRegistry() {
+  static NoDestructor<Registry> registry;
+  return *registry;
+}
+
+void OnThreadExit(void* value) {
+  TaskAccountingShard* shard = static_cast<TaskAccountingShard*>(value);
+  Registry& registry = GetRegistry();
+  {
+    AutoLock auto_lock(registry.lock);
+    auto it = std::find(registry.shards.begin(), registry.shards.end(), shard);
+    DCHECK(it != registry.shards.end());
+    registry.shards.erase(it);
+    shard->MergeInto(&registry.exited_threads);
+  }
+  delete shard;
+}
+
+ThreadLocalStorage::Slot& ShardTLS() {
+  static NoDestructor<ThreadLocalStorage::Slot> tls_shard(&OnThreadExit);
+  return *tls_shard;
+}
+
+TaskAccountingShard* GetShardForCurrentThread() {
+  TaskAccountingShard* shard =
+      static_cast<TaskAccountingShard*>(ShardTLS().Get());
+  if (shard)
+    return shard;
+  shard = new TaskAccountingShard;
+  {
+    Registry& registry = GetRegistry();
+    AutoLock auto_lock(registry.lock);
+    registry.shards.push_back(shard);
+  }
+  ShardTLS().Set(shard);
+  return shard;
+}
+
+// Must be called with |registry.lock| held.
+EntryMap MergeAllShards(Registry* registry) {
+  EntryMap entries = registry->exited_threads;
+  for (TaskAccountingShard* shard : registry->shards)
+    shard->MergeInto(&entries);
+  return entries;
+}
+
+int SaturatedInt(int64_t value) {
+  return static_cast<int>(
+      std::min<int64_t>(value, std::numeric_limits<int>::max()));
+}
+
+void RecordAverage(const char* histogram_name, TimeDelta total, int64_t count) {
+  if (count <= 0)
+    return;
+  HistogramBase* histogram = Histogram::FactoryMicrosecondsTimeGet(
+      histogram_name, TimeDelta::FromMicroseconds(1),
+      TimeDelta::FromSeconds(10), 50, HistogramBase::kUmaTargetedHistogramFlag);
+  histogram->AddCount(SaturatedInt((total / count).InMicroseconds()),
+                      SaturatedInt(count));
+}
+
+}  // namespace
+
+// static
+constexpr int TaskAccounting::kThreadTimeSamplingInterval;
+
+TaskAccounting::Entry::Entry() = default;
+
+TaskAccounting::Entry::Entry(const Entry& other) = default;
+
+TaskAccounting::Entry::~Entry() = default;
+
+TaskAccounting::TaskTimer::TaskTimer() = default;
+
+TaskAccounting::TaskTimer::~TaskTimer() = default;
+
+void TaskAccounting::TaskTimer::Start(TimeTicks queue_time,
+                                      TimeTicks start_time) {
+  DCHECK(!is_started());
+  shard_ = GetShardForCurrentThread();
+  // |queue_time| can be later than |start_time| for delayed tasks which run
+  // before their scheduled time, e.g. on a mock clock.
+  queue_time_ = std::max(TimeDelta(), start_time - queue_time);
+  start_time_ = start_time;
+  start_thread_time_ = ThreadTicks::IsSupported() &&
+                               shard_->ShouldSampleThreadTime()
+                           ? ThreadTicks::Now()
+                           : ThreadTicks();
+}
+
+void TaskAccounting::TaskTimer::Stop(const Location& posted_from,
+                                     TimeTicks end_time) {
+  if (!is_started())
+    return;
+  const bool has_thread_time = !start_thread_time_.is_null();
+  shard_->Record(
+      posted_from, queue_time_, end_time - start_time_, has_thread_time,
+      has_thread_time ? ThreadTicks::Now() - start_thread_time_ : TimeDelta());
+  shard_ = nullptr;
+}
+
+// static
+void TaskAccounting::SetEnabled(bool enabled) {
+  g_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+// static
+bool TaskAccounting::IsEnabled() {
+  return g_enabled.load(std::memory_order_relaxed);
+}
+
+// static
+std::vector<TaskAccounting::Entry> TaskAccounting::GetSnapshot() {
+  EntryMap entries;
+  {
+    Registry& registry = GetRegistry();
+    AutoLock auto_lock(registry.lock);
+    entries = MergeAllShards(&registry);
+  }
+
+  std::vector<Entry> snapshot;
+  snapshot.reserve(entries.size());
+  for (const auto& entry : entries)
+    snapshot.push_back(entry.second);
+  std::sort(snapshot.begin(), snapshot.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.total_wall_time > b.total_wall_time;
+            });
+  return snapshot;
+}
+
+// static
+void TaskAccounting::RecordHistograms() {
+  EntryMap entries;
+  EntryMap previous;
+  {
+    Registry& registry = GetRegistry();
+    AutoLock auto_lock(registry.lock);
+    entries = MergeAllShards(&registry);
+    previous.swap(registry.last_recorded);
+    registry.last_recorded = entries;
+  }
+
+  for (const auto& it : entries) {
+    const Entry& entry = it.second;
+    Entry last;
+    auto last_it = previous.find(it.first);
+    if (last_it != previous.end())
+      last = last_it->second;
+
+    const int64_t count = entry.count - last.count;
+    RecordAverage("TaskAccounting.QueueTime",
+                  entry.total_queue_time - last.total_queue_time, count);
+    RecordAverage("TaskAccounting.WallTime",
+                  entry.total_wall_time - last.total_wall_time, count);
+    RecordAverage("TaskAccounting.ThreadTime",
+                  entry.total_thread_time - last.total_thread_time,
+                  entry.thread_time_samples - last.thread_time_samples);
+  }
+}
+
+// static
+void TaskAccounting::ResetForTesting() {
+  Registry& registry = GetRegistry();
+  AutoLock auto_lock(registry.lock);
+  for (TaskAccountingShard* shard : registry.shards)
+    shard->Clear();
+  registry.exited_threads.clear();
+  registry.last_recorded.clear();
+}
+
+}  // namespace base
@@ -0,0 +1,103 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TASK_TASK_ACCOUNTING_H_
+#define BASE_TASK_TASK_ACCOUNTING_H_
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/location.h"
+#include "base/macros.h"
+#include "base/time/time.h"
+
+namespace base {
+
+namespace internal {
+class TaskAccountingShard;
+}  // namespace internal
+
+// Aggregates, per posting Location, how long tasks waited to run and how much
+// wall and CPU time they took to run. Cheap enough to be left enabled in
+// production: each thread accumulates into its own shard, and the shards are
+// only merged when a snapshot is taken. Thread CPU time, which is expensive to
+// read on some platforms, is measured for one task in
+// |kThreadTimeSamplingInterval| on each thread.
+//
+// Tasks run by TaskScheduler and SequenceManager are accounted for. Recording
+// is enabled by default.
+class BASE_EXPORT TaskAccounting {
+ public:
+  static constexpr int kThreadTimeSamplingInterval = 16;
+
+  // Totals for the tasks posted from one Location.
+  struct BASE_EXPORT Entry {
+    Entry();
+    Entry(const Entry& other);
+    ~Entry();
+
+    Location posted_from;
+    int64_t count = 0;
+    // Time between the moment tasks could have run and the moment they ran.
+    TimeDelta total_queue_time;
+    TimeDelta max_queue_time;
+    TimeDelta total_wall_time;
+    TimeDelta max_wall_time;
+    // Thread time is only measured for |thread_time_samples| of the |count|
+    // tasks.
+    int64_t thread_time_samples = 0;
+    TimeDelta total_thread_time;
+  };
+
+  // Measures one task. Only valid on the thread it is started on.
+  class BASE_EXPORT TaskTimer {
+   public:
+    TaskTimer();
+    ~TaskTimer();
+
+    // Starts measuring a task which became ready to run at |queue_time| and
+    // starts at |start_time|, both read from the same clock. Must only be
+    // called if IsEnabled().
+    void Start(TimeTicks queue_time, TimeTicks start_time);
+
+    // Accounts for the task if Start() was called.
+    void Stop(const Location& posted_from, TimeTicks end_time);
+
+    bool is_started() const { return shard_ != nullptr; }
+
+   private:
+    internal::TaskAccountingShard* shard_ = nullptr;
+    TimeDelta queue_time_;
+    TimeTicks start_time_;
+    ThreadTicks start_thread_time_;
+
+    DISALLOW_COPY_AND_ASSIGN(TaskTimer);
+  };
+
+  static void SetEnabled(bool enabled);
+  static bool IsEnabled();
+
+  // Returns the totals accumulated since the process started (or since
+  // ResetForTesting()), one Entry per Location, sorted by decreasing total
+  // wall time. Tasks running while this is called are not included.
+  static std::vector<Entry> GetSnapshot();
+
+  // Reports the tasks run since the previous call to the
+  // "TaskAccounting.QueueTime", "TaskAccounting.WallTime" and
+  // "TaskAccounting.ThreadTime" histograms. To keep this cheap, the tasks
+  // posted from a Location are recorded as that many samples of their average
+  // duration.
+  static void RecordHistograms();
+
+  static void ResetForTesting();
+
+ private:
+  DISALLOW_IMPLICIT_CONSTRUCTORS(TaskAccounting);
+};
+
+}  // namespace base
+
+#endif  // BASE_TASK_TASK_ACCOUNTING_H_
@@ -0,0 +1,164 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/task/task_accounting.h"
+
+#include <vector>
+
+#include "base/bind.h"
+#include "base/location.h"
+#include "base/test/metrics/histogram_tester.h"
+#include "base/threading/thread.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+
+namespace {
+
+class TaskAccountingTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    TaskAccounting::ResetForTesting();
+    TaskAccounting::SetEnabled(true);
+  }
+
+  void TearDown() override {
+    TaskAccounting::SetEnabled(true);
+    TaskAccounting::ResetForTesting();
+  }
+};
+
+// Accounts for a task posted from |posted_from| which waited |queue_time| and
+// ran for |wall_time|.
+void RecordTask(const Location& posted_from,
+                TimeDelta queue_time,
+                TimeDelta wall_time) {
+  const TimeTicks start = TimeTicks() + TimeDelta::FromSeconds(1);
+  TaskAccounting::TaskTimer timer;
+  timer.Start(start - queue_time, start);
+  EXPECT_TRUE(timer.is_started());
+  timer.Stop(posted_from, start + wall_time);
+  EXPECT_FALSE(timer.is_started());
+}
+
+const TaskAccounting::Entry* FindEntry(
+    const std::vector<TaskAccounting::Entry>& snapshot,
+    const Location& location) {
+  for (const TaskAccounting::Entry& entry : snapshot) {
+    if (entry.posted_from == location)
+      return &entry;
+  }
+  return nullptr;
+}
+
+}  // namespace
+
+TEST_F(TaskAccountingTest, Disabled) {
+  TaskAccounting::SetEnabled(false);
+  EXPECT_FALSE(TaskAccounting::IsEnabled());
+  EXPECT_TRUE(TaskAccounting::GetSnapshot().empty());
+
+  // Stopping a timer which was not started does nothing.
+  TaskAccounting::TaskTimer timer;
+  timer.Stop(FROM_HERE, TimeTicks::Now());
+  EXPECT_TRUE(TaskAccounting::GetSnapshot().empty());
+}
+
+TEST_F(TaskAccountingTest, AggregatesByLocation) {
+  const Location kFirst = FROM_HERE;
+  const Location kSecond = FROM_HERE;
+  RecordTask(kFirst, TimeDelta::FromMilliseconds(1),
+             TimeDelta::FromMilliseconds(10));
+  RecordTask(kFirst, TimeDelta::FromMilliseconds(3),
+             TimeDelta::FromMilliseconds(20));
+  RecordTask(kSecond, TimeDelta::FromMilliseconds(5),
+             TimeDelta::FromMilliseconds(50));
+
+  std::vector<TaskAccounting::Entry> snapshot = TaskAccounting::GetSnapshot();
+  ASSERT_EQ(2u, snapshot.size());
+  // Sorted by decreasing wall time.
+  EXPECT_EQ(kSecond, snapshot[0].posted_from);
+  EXPECT_EQ(kFirst, snapshot[1].posted_from);
+
+  const TaskAccounting::Entry& first = snapshot[1];
+  EXPECT_EQ(2, first.count);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(4), first.total_queue_time);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(3), first.max_queue_time);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(30), first.total_wall_time);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(20), first.max_wall_time);
+  EXPECT_LE(first.thread_time_samples, first.count);
+
+  const TaskAccounting::Entry& second = snapshot[0];
+  EXPECT_EQ(1, second.count);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(5), second.total_queue_time);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(50), second.total_wall_time);
+}
+
+TEST_F(TaskAccountingTest, SamplesThreadTime) {
+  if (!ThreadTicks::IsSupported())
+    return;
+
+  const Location kLocation = FROM_HERE;
+  for (int i = 0; i < 2 * TaskAccounting::kThreadTimeSamplingInterval; ++i)
+    RecordTask(kLocation, TimeDelta(), TimeDelta::FromMilliseconds(1));
+
+  std::vector<TaskAccounting::Entry> snapshot = TaskAccounting::GetSnapshot();
+  ASSERT_EQ(1u, snapshot.size());
+  EXPECT_EQ(2 * TaskAccounting::kThreadTimeSamplingInterval,
+            snapshot[0].count);
+  EXPECT_EQ(2, snapshot[0].thread_time_samples);
+}
+
+TEST_F(TaskAccountingTest, MergesThreads) {
+  const Location kLocation = FROM_HERE;
+  RecordTask(kLocation, TimeDelta(), TimeDelta::FromMilliseconds(1));
+
+  Thread thread("TaskAccountingTest");
+  ASSERT_TRUE(thread.Start());
+  for (int i = 0; i < 3; ++i) {
+    thread.task_runner()->PostTask(
+        FROM_HERE, BindOnce(&RecordTask, kLocation, TimeDelta(),
+                            TimeDelta::FromMilliseconds(2)));
+  }
+  thread.FlushForTesting();
+
+  std::vector<TaskAccounting::Entry> snapshot = TaskAccounting::GetSnapshot();
+  const TaskAccounting::Entry* entry = FindEntry(snapshot, kLocation);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(4, entry->count);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(7), entry->total_wall_time);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(2), entry->max_wall_time);
+
+  // The totals of a thread outlive it.
+  thread.Stop();
+  snapshot = TaskAccounting::GetSnapshot();
+  entry = FindEntry(snapshot, kLocation);
+  ASSERT_TRUE(entry);
+  EXPECT_EQ(4, entry->count);
+  EXPECT_EQ(TimeDelta::FromMilliseconds(7), entry->total_wall_time);
+}
+
+TEST_F(TaskAccountingTest, RecordHistograms) {
+  HistogramTester histogram_tester;
+  const Location kLocation = FROM_HERE;
+  RecordTask(kLocation, TimeDelta::FromMicroseconds(100),
+             TimeDelta::FromMicroseconds(1000));
+  RecordTask(kLocation, TimeDelta::FromMicroseconds(300),
+             TimeDelta::FromMicroseconds(3000));
+
+  TaskAccounting::RecordHistograms();
+  histogram_tester.ExpectTotalCount("TaskAccounting.QueueTime", 2);
+  histogram_tester.ExpectTotalCount("TaskAccounting.WallTime", 2);
+
+  // Only the tasks run since the previous call are reported.
+  RecordTask(kLocation, TimeDelta(), TimeDelta::FromMicroseconds(1000));
+  TaskAccounting::RecordHistograms();
+  histogram_tester.ExpectTotalCount("TaskAccounting.QueueTime", 3);
+  histogram_tester.ExpectTotalCount("TaskAccounting.WallTime", 3);
+
+  TaskAccounting::RecordHistograms();
+  histogram_tester.ExpectTotalCount("TaskAccounting.WallTime", 3);
+}
+
+}  // namespace base
@@ -16,6 +16,7 @@
 #include "base/metrics/histogram_macros.h"
 #include "base/sequence_token.h"
 #include "base/synchronization/condition_variable.h"
+#include "base/task/task_accounting.h"
 #include "base/task_scheduler/scoped_set_task_priority_for_current_thread.h"
 #include "base/threading/sequence_local_storage_map.h"
 #include "base/threading/sequenced_task_runner_handle.h"
@@ -526,7 +527,13 @@ void TaskTracker::RunOrSkipTask(Task task,
             TRACE_EVENT_FLAG_FLOW_IN);
       }
 
+      TaskAccounting::TaskTimer task_accounting_timer;
+      if (TaskAccounting::IsEnabled())
+        task_accounting_timer.Start(task.sequenced_time, TimeTicks::Now());
+
       task_annotator_.RunTask(nullptr, &task);
+
+      task_accounting_timer.Stop(task.posted_from, TimeTicks::Now());
     }
 
     // Make sure the arguments bound to the callback are deleted within the
@@ -47,6 +47,11 @@ SequenceLocalStorageMap& SequenceLocalStorageMap::GetForCurrentThread() {
   return *current_sequence_local_storage;
 }
 
+// static
+bool SequenceLocalStorageMap::IsSetForCurrentThread() {
+  return !!tls_current_sequence_local_storage.Get().Get();
+}
+
 void* SequenceLocalStorageMap::Get(int slot_id) {
   const auto it = sls_map_.find(slot_id);
   if (it == sls_map_.end())
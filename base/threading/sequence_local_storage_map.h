@@ -31,6 +31,10 @@ class BASE_EXPORT SequenceLocalStorageMap {
   // ScopedSetSequenceLocalStorageForCurrentThread.
   static SequenceLocalStorageMap& GetForCurrentThread();
 
+  // Returns true if a SequenceLocalStorageMap is bound to the current thread,
+  // i.e. if GetForCurrentThread() may be called.
+  static bool IsSetForCurrentThread();
+
   // Holds a pointer to a value alongside a destructor for this pointer.
   // Calls the destructor on the value upon destruction.
   class BASE_EXPORT ValueDestructorPair {
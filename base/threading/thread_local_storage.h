@@ -36,6 +36,7 @@ class GlobalActivityTracker;
 
 namespace trace_event {
 class MallocDumpProvider;
+class TraceLog;
 }  // namespace trace_event
 
 namespace internal {
@@ -171,6 +172,7 @@ class BASE_EXPORT ThreadLocalStorage {
   friend class base::SamplingHeapProfiler;
   friend class base::internal::ThreadLocalStorageTestInternal;
   friend class base::trace_event::MallocDumpProvider;
+  friend class base::trace_event::TraceLog;
   friend class debug::GlobalActivityTracker;
   friend class heap_profiling::ScopedAllowAlloc;
   friend class ui::TLSDestructionCheckerForX11;
@@ -14,6 +14,7 @@
 #include "base/threading/platform_thread.h"
 #include "base/threading/sequenced_task_runner_handle.h"
 #include "base/time/tick_clock.h"
+#include "base/timer/timer_coalescer.h"
 
 namespace base {
 
@@ -127,6 +128,12 @@ void Timer::SetTaskRunner(scoped_refptr<SequencedTaskRunner> task_runner) {
   task_runner_.swap(task_runner);
 }
 
+void Timer::SetTolerance(TimeDelta tolerance) {
+  DCHECK(!is_running_);
+  DCHECK_GE(tolerance, TimeDelta());
+  tolerance_ = tolerance;
+}
+
 void Timer::Start(const Location& posted_from,
                   TimeDelta delay,
                   const base::Closure& user_task) {
@@ -146,6 +153,11 @@ void Timer::Stop() {
 
   is_running_ = false;
 
+  // Unlike a posted task, a coalescer registration is cheap to drop and
+  // re-create, so don't leave it behind to be skipped at the next wake-up.
+  if (coalescer_)
+    AbandonScheduledTask();
+
   // It's safe to destroy or restart Timer on another sequence after Stop().
   origin_sequence_checker_.DetachFromSequence();
 
@@ -160,7 +172,7 @@ void Timer::Reset() {
   DCHECK(!user_task_.is_null());
 
   // If there's no pending task, start one up and return.
-  if (!scheduled_task_) {
+  if (!scheduled_task_ && !coalescer_) {
     PostNewScheduledTask(delay_);
     return;
   }
@@ -171,6 +183,17 @@ void Timer::Reset() {
   else
     desired_run_time_ = TimeTicks();
 
+  // A coalesced timer is moved to its new window, so that it doesn't cause a
+  // wake-up of its own when the old one expires. The pending wake-up is kept
+  // if it isn't too late for the new window.
+  if (coalescer_) {
+    is_running_ = true;
+    scheduled_run_time_ = desired_run_time_;
+    coalescer_->Update(this, scheduled_run_time_,
+                       scheduled_run_time_ + tolerance_);
+    return;
+  }
+
   // We can use the existing scheduled task if it arrives before the new
   // |desired_run_time_|.
   if (desired_run_time_ >= scheduled_run_time_) {
@@ -195,7 +218,18 @@ void Timer::PostNewScheduledTask(TimeDelta delay) {
   // RunScheduledTask(): https://crbug.com/587199.
   // DCHECK(origin_sequence_checker_.CalledOnValidSequence());
   DCHECK(!scheduled_task_);
+  DCHECK(!coalescer_);
   is_running_ = true;
+  if (!tolerance_.is_zero() && !task_runner_ &&
+      delay > TimeDelta::FromMicroseconds(0)) {
+    coalescer_ = internal::TimerCoalescer::GetForCurrentSequence(tick_clock_);
+    if (coalescer_) {
+      scheduled_run_time_ = desired_run_time_ = Now() + delay;
+      coalescer_->Add(this, scheduled_run_time_,
+                      scheduled_run_time_ + tolerance_);
+      return;
+    }
+  }
   scheduled_task_ = new BaseTimerTaskInternal(this);
   if (delay > TimeDelta::FromMicroseconds(0)) {
     // TODO(gab): Posting BaseTimerTaskInternal::Run to another sequence makes
@@ -226,6 +260,10 @@ void Timer::AbandonScheduledTask() {
     scheduled_task_->Abandon();
     scheduled_task_ = nullptr;
   }
+  if (coalescer_) {
+    coalescer_->Remove(this);
+    coalescer_ = nullptr;
+  }
 }
 
 void Timer::RunScheduledTask() {
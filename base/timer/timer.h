@@ -78,6 +78,10 @@ namespace base {
 class BaseTimerTaskInternal;
 class TickClock;
 
+namespace internal {
+class TimerCoalescer;
+}
+
 //-----------------------------------------------------------------------------
 // This class wraps TaskRunner::PostDelayedTask to manage delayed and repeating
 // tasks. See meta comment above for thread-safety requirements.
@@ -118,6 +122,15 @@ class BASE_EXPORT Timer {
   // means |user_task_| can run after ~Timer() and should support that).
   virtual void SetTaskRunner(scoped_refptr<SequencedTaskRunner> task_runner);
 
+  // Allows the timer to fire up to |tolerance| after its desired run time, so
+  // that it can share a wake-up with other timers of the current sequence whose
+  // windows overlap instead of posting a delayed task of its own. Zero (the
+  // default) disables coalescing. Ignored if SetTaskRunner() was used, for
+  // zero delays and on sequences without SequenceLocalStorage. This method can
+  // only be called while the timer is not running.
+  void SetTolerance(TimeDelta tolerance);
+  TimeDelta tolerance() const { return tolerance_; }
+
   // Start the timer to run at the given |delay| from now. If the timer is
   // already running, it will be replaced to call the given |user_task|.
   virtual void Start(const Location& posted_from,
@@ -176,10 +189,12 @@ class BASE_EXPORT Timer {
 
  private:
   friend class BaseTimerTaskInternal;
+  friend class internal::TimerCoalescer;
 
   // Allocates a new |scheduled_task_| and posts it on the current sequence with
-  // the given |delay|. |scheduled_task_| must be null. |scheduled_run_time_|
-  // and |desired_run_time_| are reset to Now() + delay.
+  // the given |delay|, or registers with the sequence's TimerCoalescer if the
+  // timer has a tolerance. |scheduled_task_| and |coalescer_| must be null.
+  // |scheduled_run_time_| and |desired_run_time_| are reset to Now() + delay.
   void PostNewScheduledTask(TimeDelta delay);
 
   // Returns the task runner on which the task should be scheduled. If the
@@ -187,17 +202,25 @@ class BASE_EXPORT Timer {
   // sequence is returned.
   scoped_refptr<SequencedTaskRunner> GetTaskRunner();
 
-  // Disable |scheduled_task_| and abandon it so that it no longer refers back
-  // to this object.
+  // Disable |scheduled_task_| and abandon it, or unregister from |coalescer_|,
+  // so that nothing refers back to this object.
   void AbandonScheduledTask();
 
-  // Called by BaseTimerTaskInternal when the delayed task fires.
+  // Called by BaseTimerTaskInternal or TimerCoalescer when the timer fires.
   void RunScheduledTask();
 
   // When non-null, the |scheduled_task_| was posted to call RunScheduledTask()
   // at |scheduled_run_time_|.
   BaseTimerTaskInternal* scheduled_task_;
 
+  // When non-null, this timer is registered with |coalescer_| to fire between
+  // |scheduled_run_time_| and |scheduled_run_time_| + |tolerance_|. At most one
+  // of |scheduled_task_| and |coalescer_| is non-null.
+  internal::TimerCoalescer* coalescer_ = nullptr;
+
+  // See SetTolerance().
+  TimeDelta tolerance_;
+
   // Location in user code.
   Location posted_from_;
   // Delay requested by user.
@@ -0,0 +1,154 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/timer/timer_coalescer.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+
+#include "base/bind.h"
+#include "base/lazy_instance.h"
+#include "base/logging.h"
+#include "base/sequenced_task_runner.h"
+#include "base/threading/sequence_local_storage_map.h"
+#include "base/threading/sequence_local_storage_slot.h"
+#include "base/threading/sequenced_task_runner_handle.h"
+#include "base/time/tick_clock.h"
+#include "base/timer/timer.h"
+#include "base/trace_event/trace_event.h"
+
+namespace base {
+namespace internal {
+
+namespace {
+
+using CoalescerMap =
+    std::map<const TickClock*, std::unique_ptr<TimerCoalescer>>;
+
+LazyInstance<SequenceLocalStorageSlot<CoalescerMap>>::Leaky
+    sls_timer_coalescers = LAZY_INSTANCE_INITIALIZER;
+
+}  // namespace
+
+// static
+TimerCoalescer* TimerCoalescer::GetForCurrentSequence(
+    const TickClock* tick_clock) {
+  if (!SequenceLocalStorageMap::IsSetForCurrentThread() ||
+      !SequencedTaskRunnerHandle::IsSet()) {
+    return nullptr;
+  }
+  std::unique_ptr<TimerCoalescer>& coalescer =
+      sls_timer_coalescers.Get().Get()[tick_clock];
+  if (!coalescer) {
+    coalescer = std::make_unique<TimerCoalescer>(
+        SequencedTaskRunnerHandle::Get(), tick_clock);
+  }
+  return coalescer.get();
+}
+
+TimerCoalescer::TimerCoalescer(scoped_refptr<SequencedTaskRunner> task_runner,
+                               const TickClock* tick_clock)
+    : task_runner_(std::move(task_runner)),
+      tick_clock_(tick_clock),
+      weak_factory_(this) {}
+
+TimerCoalescer::~TimerCoalescer() {
+  CancelWakeUp();
+  while (!windows_.empty()) {
+    Timer* timer = windows_.begin()->first;
+    Remove(timer);
+    timer->coalescer_ = nullptr;
+    timer->AbandonAndStop();
+  }
+}
+
+void TimerCoalescer::Add(Timer* timer, TimeTicks earliest, TimeTicks latest) {
+  DCHECK_LE(earliest, latest);
+  bool inserted = windows_.emplace(timer, Window{earliest, latest}).second;
+  DCHECK(inserted);
+  by_earliest_.emplace(earliest, timer);
+  by_latest_.emplace(latest, timer);
+  ScheduleWakeUp();
+}
+
+void TimerCoalescer::Update(Timer* timer,
+                            TimeTicks earliest,
+                            TimeTicks latest) {
+  DCHECK_LE(earliest, latest);
+  auto it = windows_.find(timer);
+  DCHECK(it != windows_.end());
+  by_earliest_.erase(std::make_pair(it->second.earliest, timer));
+  by_latest_.erase(std::make_pair(it->second.latest, timer));
+  it->second = Window{earliest, latest};
+  by_earliest_.emplace(earliest, timer);
+  by_latest_.emplace(latest, timer);
+  ScheduleWakeUp();
+}
+
+void TimerCoalescer::Remove(Timer* timer) {
+  auto it = windows_.find(timer);
+  DCHECK(it != windows_.end());
+  by_earliest_.erase(std::make_pair(it->second.earliest, timer));
+  by_latest_.erase(std::make_pair(it->second.latest, timer));
+  windows_.erase(it);
+
+  // The pending wake-up is for the earliest window end. If that was |timer|'s
+  // and no other window ends then, it would run with nothing to do.
+  if (scheduled_wake_up_ != TimeTicks::Max() &&
+      (by_latest_.empty() ||
+       by_latest_.begin()->first != scheduled_wake_up_)) {
+    CancelWakeUp();
+    ScheduleWakeUp();
+  }
+}
+
+TimeTicks TimerCoalescer::Now() const {
+  return tick_clock_ ? tick_clock_->NowTicks() : TimeTicks::Now();
+}
+
+void TimerCoalescer::ScheduleWakeUp() {
+  if (by_latest_.empty())
+    return;
+  TimeTicks wake_up = by_latest_.begin()->first;
+  if (wake_up >= scheduled_wake_up_)
+    return;
+  CancelWakeUp();
+  scheduled_wake_up_ = wake_up;
+  task_runner_->PostDelayedTask(
+      FROM_HERE,
+      BindOnce(&TimerCoalescer::OnWakeUp, weak_factory_.GetWeakPtr()),
+      std::max(TimeDelta(), wake_up - Now()));
+}
+
+void TimerCoalescer::CancelWakeUp() {
+  weak_factory_.InvalidateWeakPtrs();
+  scheduled_wake_up_ = TimeTicks::Max();
+}
+
+void TimerCoalescer::OnWakeUp() {
+  scheduled_wake_up_ = TimeTicks::Max();
+  wake_up_count_++;
+
+  TimeTicks now = Now();
+  size_t fired = 0;
+  // Timers are fired one at a time and looked up again after each one, since
+  // a Timer's task may stop, restart or delete other registered Timers.
+  while (!by_earliest_.empty() && by_earliest_.begin()->first <= now) {
+    Timer* timer = by_earliest_.begin()->second;
+    Remove(timer);
+    timer->coalescer_ = nullptr;
+    fired++;
+    timer->RunScheduledTask();
+  }
+
+  TRACE_EVENT_INSTANT1("base", "TimerCoalescer::OnWakeUp",
+                       TRACE_EVENT_SCOPE_THREAD, "timers", fired);
+  TRACE_COUNTER1("base", "CoalescedTimerWakeUps", wake_up_count_);
+
+  ScheduleWakeUp();
+}
+
+}  // namespace internal
+}  // namespace base
@@ -0,0 +1,109 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TIMER_TIMER_COALESCER_H_
+#define BASE_TIMER_TIMER_COALESCER_H_
+
+#include <stddef.h>
+
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/memory/scoped_refptr.h"
+#include "base/memory/weak_ptr.h"
+#include "base/time/time.h"
+
+namespace base {
+
+class SequencedTaskRunner;
+class TickClock;
+class Timer;
+
+namespace internal {
+
+// Schedules the Timers of a sequence which have a non-zero tolerance (see
+// Timer::SetTolerance()). Each Timer registers the window during which it may
+// fire; the coalescer posts a single delayed task for the earliest window end
+// and, when it runs, fires every Timer whose window has opened. Timers with
+// overlapping windows therefore share a wake-up instead of each posting their
+// own delayed task.
+//
+// There is one coalescer per sequence and TickClock. It is owned by the
+// sequence's SequenceLocalStorage and must only be used on that sequence.
+class BASE_EXPORT TimerCoalescer {
+ public:
+  // Returns the coalescer for the current sequence and |tick_clock| (null for
+  // TimeTicks::Now()), creating it if needed. Returns null if the current
+  // sequence has no SequenceLocalStorage, in which case the caller should post
+  // its own task.
+  static TimerCoalescer* GetForCurrentSequence(const TickClock* tick_clock);
+
+  TimerCoalescer(scoped_refptr<SequencedTaskRunner> task_runner,
+                 const TickClock* tick_clock);
+  // Abandons and stops all registered Timers, in the same way as destroying
+  // their posted task would.
+  ~TimerCoalescer();
+
+  // Registers |timer| to fire at some point in [|earliest|, |latest|]. |timer|
+  // must not already be registered.
+  void Add(Timer* timer, TimeTicks earliest, TimeTicks latest);
+
+  // Moves |timer|, which must be registered, to the window [|earliest|,
+  // |latest|]. Unlike Remove() and Add(), this keeps the pending wake-up unless
+  // it is later than |latest|: one that turns out to be early finds nothing to
+  // fire and schedules the next.
+  void Update(Timer* timer, TimeTicks earliest, TimeTicks latest);
+
+  // Unregisters |timer|, which must be registered. The pending wake-up is
+  // moved to the next window end if it was for |timer|'s.
+  void Remove(Timer* timer);
+
+  size_t size() const { return windows_.size(); }
+
+  // Number of wake-ups which ran. Exposed for tests.
+  size_t wake_up_count() const { return wake_up_count_; }
+
+ private:
+  struct Window {
+    TimeTicks earliest;
+    TimeTicks latest;
+  };
+
+  TimeTicks Now() const;
+
+  // Posts a wake-up for the earliest window end unless one is already pending
+  // for that time or earlier. A pending wake-up for a later time is
+  // cancelled.
+  void ScheduleWakeUp();
+
+  // Cancels the pending wake-up, if any.
+  void CancelWakeUp();
+
+  // Fires all Timers whose window has opened.
+  void OnWakeUp();
+
+  const scoped_refptr<SequencedTaskRunner> task_runner_;
+  const TickClock* const tick_clock_;
+
+  std::unordered_map<Timer*, Window> windows_;
+  // Registered Timers ordered by window start and by window end.
+  std::set<std::pair<TimeTicks, Timer*>> by_earliest_;
+  std::set<std::pair<TimeTicks, Timer*>> by_latest_;
+
+  // Time of the pending wake-up task, or TimeTicks::Max() if none.
+  TimeTicks scheduled_wake_up_ = TimeTicks::Max();
+  size_t wake_up_count_ = 0;
+
+  WeakPtrFactory<TimerCoalescer> weak_factory_;
+
+  DISALLOW_COPY_AND_ASSIGN(TimerCoalescer);
+};
+
+}  // namespace internal
+}  // namespace base
+
+#endif  // BASE_TIMER_TIMER_COALESCER_H_
@@ -26,6 +26,7 @@
 #include "base/threading/thread.h"
 #include "base/time/tick_clock.h"
 #include "base/time/time.h"
+#include "base/timer/timer_coalescer.h"
 #include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -719,6 +720,170 @@ TEST(TimerTest, ContinuationReset) {
   }
 }
 
+TEST(TimerTest, ToleranceCoalescesWakeUps) {
+  test::ScopedTaskEnvironment scoped_task_environment(
+      test::ScopedTaskEnvironment::MainThreadType::MOCK_TIME);
+  const TickClock* clock = scoped_task_environment.GetMockTickClock();
+  const int kDelaysMs[] = {10, 12, 30};
+  Receiver receivers[arraysize(kDelaysMs)];
+  std::unique_ptr<OneShotTimer> timers[arraysize(kDelaysMs)];
+  for (size_t i = 0; i < arraysize(kDelaysMs); i++) {
+    timers[i] = std::make_unique<OneShotTimer>(clock);
+    timers[i]->SetTolerance(TimeDelta::FromMilliseconds(5));
+    timers[i]->Start(FROM_HERE, TimeDelta::FromMilliseconds(kDelaysMs[i]),
+                     Bind(&Receiver::OnCalled, Unretained(&receivers[i])));
+  }
+  internal::TimerCoalescer* coalescer =
+      internal::TimerCoalescer::GetForCurrentSequence(clock);
+  ASSERT_TRUE(coalescer);
+  EXPECT_EQ(3u, coalescer->size());
+
+  // Nothing fires before the first window closes.
+  scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(14));
+  EXPECT_FALSE(receivers[0].WasCalled());
+
+  // The first two windows overlap, so both timers share one wake-up.
+  scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(1));
+  EXPECT_TRUE(receivers[0].WasCalled());
+  EXPECT_TRUE(receivers[1].WasCalled());
+  EXPECT_FALSE(receivers[2].WasCalled());
+  EXPECT_FALSE(timers[1]->IsRunning());
+  EXPECT_EQ(1u, coalescer->wake_up_count());
+
+  scoped_task_environment.FastForwardUntilNoTasksRemain();
+  EXPECT_EQ(1, receivers[2].TimesCalled());
+  EXPECT_EQ(2u, coalescer->wake_up_count());
+  EXPECT_EQ(0u, coalescer->size());
+}
+
+TEST(TimerTest, ToleranceStopMovesWakeUp) {
+  test::ScopedTaskEnvironment scoped_task_environment(
+      test::ScopedTaskEnvironment::MainThreadType::MOCK_TIME);
+  const TickClock* clock = scoped_task_environment.GetMockTickClock();
+  Receiver first_receiver;
+  Receiver second_receiver;
+  OneShotTimer first(clock);
+  OneShotTimer second(clock);
+  first.SetTolerance(TimeDelta::FromMilliseconds(5));
+  second.SetTolerance(TimeDelta::FromMilliseconds(5));
+  first.Start(FROM_HERE, TimeDelta::FromMilliseconds(10),
+              Bind(&Receiver::OnCalled, Unretained(&first_receiver)));
+  second.Start(FROM_HERE, TimeDelta::FromMilliseconds(20),
+               Bind(&Receiver::OnCalled, Unretained(&second_receiver)));
+  internal::TimerCoalescer* coalescer =
+      internal::TimerCoalescer::GetForCurrentSequence(clock);
+  ASSERT_TRUE(coalescer);
+  EXPECT_EQ(2u, coalescer->size());
+
+  // The wake-up for the end of the first window goes away with it.
+  first.Stop();
+  EXPECT_EQ(1u, coalescer->size());
+  scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(24));
+  EXPECT_FALSE(second_receiver.WasCalled());
+  EXPECT_EQ(0u, coalescer->wake_up_count());
+
+  scoped_task_environment.FastForwardUntilNoTasksRemain();
+  EXPECT_FALSE(first_receiver.WasCalled());
+  EXPECT_EQ(1, second_receiver.TimesCalled());
+  EXPECT_EQ(1u, coalescer->wake_up_count());
+}
+
+TEST(TimerTest, ToleranceRepeatingTimer) {
+  test::ScopedTaskEnvironment scoped_task_environment(
+      test::ScopedTaskEnvironment::MainThreadType::MOCK_TIME);
+  const TickClock* clock = scoped_task_environment.GetMockTickClock();
+  Receiver receiver;
+  RepeatingTimer timer(clock);
+  timer.SetTolerance(TimeDelta::FromMilliseconds(10));
+  timer.Start(FROM_HERE, TimeDelta::FromMilliseconds(10),
+              Bind(&Receiver::OnCalled, Unretained(&receiver)));
+
+  // Each period ends within the tolerance of the previous one.
+  scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(100));
+  EXPECT_GE(receiver.TimesCalled(), 5);
+  EXPECT_LE(receiver.TimesCalled(), 10);
+  EXPECT_TRUE(timer.IsRunning());
+
+  timer.Stop();
+  EXPECT_EQ(0u, internal::TimerCoalescer::GetForCurrentSequence(clock)->size());
+  int times_called = receiver.TimesCalled();
+  scoped_task_environment.FastForwardUntilNoTasksRemain();
+  EXPECT_EQ(times_called, receiver.TimesCalled());
+}
+
+TEST(TimerTest, ToleranceResetAndDelete) {
+  test::ScopedTaskEnvironment scoped_task_environment(
+      test::ScopedTaskEnvironment::MainThreadType::MOCK_TIME);
+  const TickClock* clock = scoped_task_environment.GetMockTickClock();
+  Receiver receiver;
+  auto deleted_timer = std::make_unique<OneShotTimer>(clock);
+  deleted_timer->SetTolerance(TimeDelta::FromMilliseconds(1));
+  deleted_timer->Start(FROM_HERE, TimeDelta::FromMilliseconds(5),
+                       Bind(&Receiver::OnCalled, Unretained(&receiver)));
+
+  OneShotTimer timer(clock);
+  timer.SetTolerance(TimeDelta::FromMilliseconds(1));
+  timer.Start(FROM_HERE, TimeDelta::FromMilliseconds(10),
+              Bind(&Receiver::OnCalled, Unretained(&receiver)));
+  deleted_timer.reset();
+
+  // Reset() moves the window rather than firing in the old one.
+  scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(8));
+  timer.Reset();
+  scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(8));
+  EXPECT_FALSE(receiver.WasCalled());
+  scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(3));
+  EXPECT_EQ(1, receiver.TimesCalled());
+}
+
+TEST(TimerTest, ToleranceResetKeepsWakeUp) {
+  test::ScopedTaskEnvironment scoped_task_environment(
+      test::ScopedTaskEnvironment::MainThreadType::MOCK_TIME);
+  const TickClock* clock = scoped_task_environment.GetMockTickClock();
+  Receiver receiver;
+  OneShotTimer timer(clock);
+  timer.SetTolerance(TimeDelta::FromMilliseconds(5));
+  timer.Start(FROM_HERE, TimeDelta::FromMilliseconds(10),
+              Bind(&Receiver::OnCalled, Unretained(&receiver)));
+
+  // A timer which keeps being reset, like a watchdog, doesn't post a task each
+  // time: the pending wake-up is kept and finds nothing to fire. Cancelled
+  // tasks aren't pending, so count the times the wake-up moves instead.
+  TimeTicks wake_up = clock->NowTicks() +
+                      scoped_task_environment.NextMainThreadPendingTaskDelay();
+  size_t posted_wake_ups = 1;
+  for (int i = 0; i < 50; i++) {
+    scoped_task_environment.FastForwardBy(TimeDelta::FromMilliseconds(1));
+    timer.Reset();
+    EXPECT_EQ(1u, scoped_task_environment.GetPendingMainThreadTaskCount());
+    TimeTicks next_wake_up =
+        clock->NowTicks() +
+        scoped_task_environment.NextMainThreadPendingTaskDelay();
+    if (next_wake_up != wake_up) {
+      wake_up = next_wake_up;
+      posted_wake_ups++;
+    }
+  }
+  EXPECT_FALSE(receiver.WasCalled());
+  EXPECT_LE(posted_wake_ups, 5u);
+
+  scoped_task_environment.FastForwardUntilNoTasksRemain();
+  EXPECT_EQ(1, receiver.TimesCalled());
+}
+
+TEST(TimerTest, ToleranceIgnoredWithoutSequenceLocalStorage) {
+  scoped_refptr<TestMockTimeTaskRunner> task_runner(
+      new TestMockTimeTaskRunner(Time::Now(), TimeTicks::Now()));
+  TestMockTimeTaskRunner::ScopedContext scoped_context(task_runner);
+  Receiver receiver;
+  OneShotTimer timer(task_runner->GetMockTickClock());
+  timer.SetTolerance(TimeDelta::FromSeconds(1));
+  timer.Start(FROM_HERE, TimeDelta::FromSeconds(1),
+              Bind(&Receiver::OnCalled, Unretained(&receiver)));
+  task_runner->FastForwardBy(TimeDelta::FromSeconds(1));
+  EXPECT_TRUE(receiver.WasCalled());
+}
+
 namespace {
 
 // Fixture for tests requiring ScopedTaskEnvironment. Includes a WaitableEvent
@@ -10,6 +10,7 @@
 
 #include "base/atomicops.h"
 #include "base/debug/leak_annotations.h"
+#include "base/hash.h"
 #include "base/logging.h"
 #include "base/third_party/dynamic_annotations/dynamic_annotations.h"
 #include "base/trace_event/trace_category.h"
@@ -35,6 +36,18 @@ TraceCategory g_categories[kMaxCategories] = {
 
 base::subtle::AtomicWord g_category_index = kNumBuiltinCategories;
 
+// An open addressing hash index over the names of the non-builtin categories,
+// so that looking a category up doesn't scan |g_categories|. A slot holds the
+// index of its category in |g_categories| plus one, or 0 while empty. Like
+// |g_categories|, it is append only: a slot is set once, after its category is
+// initialized, and the readers don't need a lock.
+constexpr size_t kCategoryHashTableSize = 512;
+static_assert((kCategoryHashTableSize & (kCategoryHashTableSize - 1)) == 0,
+              "kCategoryHashTableSize must be a power of two");
+static_assert(kCategoryHashTableSize >= 2 * kMaxCategories,
+              "The category hash table must stay sparse");
+base::subtle::AtomicWord g_category_hash_table[kCategoryHashTableSize];
+
 bool IsValidCategoryPtr(const TraceCategory* category) {
   // If any of these are hit, something has cached a corrupt category pointer.
   uintptr_t ptr = reinterpret_cast<uintptr_t>(category);
@@ -43,6 +56,35 @@ bool IsValidCategoryPtr(const TraceCategory* category) {
          ptr <= reinterpret_cast<uintptr_t>(&g_categories[kMaxCategories - 1]);
 }
 
+// Returns the slot of |g_category_hash_table| which holds the category named
+// |category_name|, setting |category| to it, or the empty slot the category
+// would be added to, setting |category| to null. The table can't be full, so
+// the linear probing always ends.
+size_t FindCategorySlot(const char* category_name, TraceCategory** category) {
+  size_t slot = Hash(category_name, strlen(category_name)) &
+                (kCategoryHashTableSize - 1);
+  while (true) {
+    size_t entry = base::subtle::Acquire_Load(&g_category_hash_table[slot]);
+    if (!entry) {
+      *category = nullptr;
+      return slot;
+    }
+    if (strcmp(g_categories[entry - 1].name(), category_name) == 0) {
+      *category = &g_categories[entry - 1];
+      return slot;
+    }
+    slot = (slot + 1) & (kCategoryHashTableSize - 1);
+  }
+}
+
+TraceCategory* GetBuiltinCategoryByName(const char* category_name) {
+  for (int i = 0; i < kNumBuiltinCategories; ++i) {
+    if (strcmp(g_categories[i].name(), category_name) == 0)
+      return &g_categories[i];
+  }
+  return nullptr;
+}
+
 }  // namespace
 
 // static
@@ -80,16 +122,13 @@ TraceCategory* CategoryRegistry::GetCategoryByName(const char* category_name) {
   DCHECK(!strchr(category_name, '"'))
       << "Category names may not contain double quote";
 
-  // The g_categories is append only, avoid using a lock for the fast path.
-  size_t category_index = base::subtle::Acquire_Load(&g_category_index);
+  TraceCategory* category = GetBuiltinCategoryByName(category_name);
+  if (category)
+    return category;
 
-  // Search for pre-existing category group.
-  for (size_t i = 0; i < category_index; ++i) {
-    if (strcmp(g_categories[i].name(), category_name) == 0) {
-      return &g_categories[i];
-    }
-  }
-  return nullptr;
+  // The hash table is append only, avoid using a lock for the fast path.
+  FindCategorySlot(category_name, &category);
+  return category;
 }
 
 bool CategoryRegistry::GetOrCreateCategoryLocked(
@@ -99,7 +138,10 @@ bool CategoryRegistry::GetOrCreateCategoryLocked(
   // This is the slow path: the lock is not held in the fastpath
   // (GetCategoryByName), so more than one thread could have reached here trying
   // to add the same category.
-  *category = GetCategoryByName(category_name);
+  *category = GetBuiltinCategoryByName(category_name);
+  if (*category)
+    return false;
+  size_t slot = FindCategorySlot(category_name, category);
   if (*category)
     return false;
 
@@ -123,7 +165,9 @@ bool CategoryRegistry::GetOrCreateCategoryLocked(
   (*category)->set_name(category_name_copy);
   category_initializer_fn(*category);
 
-  // Update the max index now.
+  // Publish the category to the lookups, then update the max index.
+  base::subtle::Release_Store(&g_category_hash_table[slot],
+                              category_index + 1);
   base::subtle::Release_Store(&g_category_index, category_index + 1);
   return true;
 }
@@ -4,11 +4,77 @@
 
 #include "base/trace_event/event_name_filter.h"
 
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "base/hash.h"
 #include "base/trace_event/trace_event_impl.h"
 
 namespace base {
 namespace trace_event {
 
+namespace {
+
+// Looks the event names up by their hash in a sorted array of the hashes of
+// the whitelisted names, so that most names are rejected without a string
+// comparison or a copy.
+class EventNameBatchPredicate : public TraceEventFilter::BatchPredicate {
+ public:
+  explicit EventNameBatchPredicate(
+      const EventNameFilter::EventNamesWhitelist& whitelist) {
+    names_.reserve(whitelist.size());
+    for (const std::string& name : whitelist)
+      names_.emplace_back(Hash(name), name);
+    std::sort(names_.begin(), names_.end());
+  }
+
+  void FilterTraceEvents(const TraceEvent* const* events,
+                         size_t count,
+                         bool* accepted) const override {
+    // The events of a batch often have the same name.
+    const char* last_name = nullptr;
+    bool last_accepted = false;
+    for (size_t i = 0; i < count; ++i) {
+      const char* name = events[i]->name();
+      if (name != last_name) {
+        last_name = name;
+        last_accepted = IsWhitelisted(name);
+      }
+      accepted[i] |= last_accepted;
+    }
+  }
+
+ private:
+  using HashedName = std::pair<uint32_t, std::string>;
+
+  bool IsWhitelisted(const char* name) const {
+    const size_t length = strlen(name);
+    const uint32_t hash = Hash(name, length);
+    auto it = std::lower_bound(
+        names_.begin(), names_.end(), hash,
+        [](const HashedName& entry, uint32_t hash) {
+          return entry.first < hash;
+        });
+    for (; it != names_.end() && it->first == hash; ++it) {
+      if (it->second.size() == length &&
+          memcmp(it->second.data(), name, length) == 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  std::vector<HashedName> names_;
+
+  DISALLOW_COPY_AND_ASSIGN(EventNameBatchPredicate);
+};
+
+}  // namespace
+
 // static
 const char EventNameFilter::kName[] = "event_whitelist_predicate";
 
@@ -22,5 +88,10 @@ bool EventNameFilter::FilterTraceEvent(const TraceEvent& trace_event) const {
   return event_names_whitelist_->count(trace_event.name()) != 0;
 }
 
+std::unique_ptr<TraceEventFilter::BatchPredicate>
+EventNameFilter::CreateBatchPredicate() const {
+  return std::make_unique<EventNameBatchPredicate>(*event_names_whitelist_);
+}
+
 }  // namespace trace_event
 }  // namespace base
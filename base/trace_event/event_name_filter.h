@@ -33,6 +33,7 @@ class BASE_EXPORT EventNameFilter : public TraceEventFilter {
 
   // TraceEventFilter implementation.
   bool FilterTraceEvent(const TraceEvent&) const override;
+  std::unique_ptr<BatchPredicate> CreateBatchPredicate() const override;
 
  private:
   std::unique_ptr<const EventNamesWhitelist> event_names_whitelist_;
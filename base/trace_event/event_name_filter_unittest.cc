@@ -4,6 +4,7 @@
 
 #include "base/trace_event/event_name_filter.h"
 
+#include "base/macros.h"
 #include "base/memory/ptr_util.h"
 #include "base/trace_event/trace_event_impl.h"
 #include "testing/gtest/include/gtest/gtest.h"
@@ -38,5 +39,39 @@ TEST(TraceEventNameFilterTest, Whitelist) {
   EXPECT_FALSE(filter->FilterTraceEvent(MakeTraceEvent("foobar")));
 }
 
+TEST(TraceEventNameFilterTest, BatchPredicate) {
+  auto whitelist = std::make_unique<EventNameFilter::EventNamesWhitelist>();
+  whitelist->insert("foo");
+  whitelist->insert("bar");
+  auto filter = std::make_unique<EventNameFilter>(std::move(whitelist));
+  std::unique_ptr<TraceEventFilter::BatchPredicate> predicate =
+      filter->CreateBatchPredicate();
+  ASSERT_TRUE(predicate);
+  // The predicate doesn't refer to the filter.
+  filter.reset();
+
+  const char* const kNames[] = {"foo", "fooz", "afoo", "bar", "bar", "foobar"};
+  const bool kExpected[] = {true, false, false, true, true, false};
+  TraceEvent events[arraysize(kNames)];
+  const TraceEvent* event_ptrs[arraysize(kNames)];
+  for (size_t i = 0; i < arraysize(kNames); ++i) {
+    events[i].Initialize(0, TimeTicks(), ThreadTicks(), 'b', nullptr,
+                         kNames[i], "", 0, 0, 0, nullptr, nullptr, nullptr,
+                         nullptr, 0);
+    event_ptrs[i] = &events[i];
+  }
+
+  bool accepted[arraysize(kNames)] = {};
+  predicate->FilterTraceEvents(event_ptrs, arraysize(kNames), accepted);
+  for (size_t i = 0; i < arraysize(kNames); ++i)
+    EXPECT_EQ(kExpected[i], accepted[i]) << kNames[i];
+
+  // Events accepted by another filter stay accepted.
+  bool all_accepted[] = {true, true};
+  predicate->FilterTraceEvents(event_ptrs + 1, 2, all_accepted);
+  EXPECT_TRUE(all_accepted[0]);
+  EXPECT_TRUE(all_accepted[1]);
+}
+
 }  // namespace trace_event
 }  // namespace base
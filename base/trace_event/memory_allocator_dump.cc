@@ -6,9 +6,15 @@
 
 #include <string.h>
 
+#include <unordered_set>
+#include <utility>
+
 #include "base/format_macros.h"
+#include "base/json/string_escape.h"
 #include "base/memory/ptr_util.h"
+#include "base/no_destructor.h"
 #include "base/strings/stringprintf.h"
+#include "base/synchronization/lock.h"
 #include "base/trace_event/memory_dump_manager.h"
 #include "base/trace_event/memory_dump_provider.h"
 #include "base/trace_event/process_memory_dump.h"
@@ -46,7 +52,12 @@ MemoryAllocatorDump::~MemoryAllocatorDump() = default;
 void MemoryAllocatorDump::AddScalar(const char* name,
                                     const char* units,
                                     uint64_t value) {
-  entries_.emplace_back(name, units, value);
+  entries_.emplace_back();
+  Entry& entry = entries_.back();
+  entry.name = name;
+  entry.units = units;
+  entry.entry_type = Entry::kUint64;
+  entry.value_uint64 = value;
 }
 
 void MemoryAllocatorDump::AddString(const char* name,
@@ -57,7 +68,11 @@ void MemoryAllocatorDump::AddString(const char* name,
     NOTREACHED();
     return;
   }
-  entries_.emplace_back(name, units, value);
+  entries_.emplace_back();
+  Entry& entry = entries_.back();
+  entry.name = name;
+  entry.units = units;
+  entry.value_string = value;
 }
 
 void MemoryAllocatorDump::AsValueInto(TracedValue* value) const {
@@ -90,12 +105,47 @@ void MemoryAllocatorDump::AsValueInto(TracedValue* value) const {
   value->EndDictionary();  // "allocator_name/heap_subheap": { ... }
 }
 
+void MemoryAllocatorDump::AppendAsJSON(std::string* out) const {
+  EscapeJSONString(absolute_name_, true, out);
+  out->append(":{\"guid\":\"");
+  out->append(guid_.ToString());
+  out->append("\",\"attrs\":{");
+  bool first_entry = true;
+  for (const Entry& entry : entries_) {
+    if (!first_entry)
+      out->push_back(',');
+    first_entry = false;
+    EscapeJSONString(entry.name, true, out);
+    out->append(":{\"type\":");
+    switch (entry.entry_type) {
+      case Entry::kUint64:
+        StringAppendF(out, "\"%s\",\"units\":", kTypeScalar);
+        EscapeJSONString(entry.units, true, out);
+        StringAppendF(out, ",\"value\":\"%" PRIx64 "\"}",
+                      entry.value_uint64);
+        break;
+      case Entry::kString:
+        StringAppendF(out, "\"%s\",\"units\":", kTypeString);
+        EscapeJSONString(entry.units, true, out);
+        out->append(",\"value\":");
+        EscapeJSONString(entry.value_string, true, out);
+        out->push_back('}');
+        break;
+    }
+  }
+  out->push_back('}');  // "attrs": { ... }
+  if (flags_)
+    StringAppendF(out, ",\"flags\":%d", flags_);
+  out->push_back('}');  // "allocator_name/heap_subheap": { ... }
+}
+
 uint64_t MemoryAllocatorDump::GetSizeInternal() const {
   if (cached_size_.has_value())
     return *cached_size_;
   for (const auto& entry : entries_) {
-    if (entry.entry_type == Entry::kUint64 && entry.units == kUnitsBytes &&
-        strcmp(entry.name.c_str(), kNameSize) == 0) {
+    if (entry.entry_type == Entry::kUint64 &&
+        strcmp(entry.units, kUnitsBytes) == 0 &&
+        strcmp(entry.name, kNameSize) == 0) {
       cached_size_ = entry.value_uint64;
       return entry.value_uint64;
     }
@@ -103,23 +153,43 @@ uint64_t MemoryAllocatorDump::GetSizeInternal() const {
   return 0;
 };
 
-MemoryAllocatorDump::Entry::Entry() : entry_type(kString), value_uint64() {}
+MemoryAllocatorDump::Entry::Entry()
+    : name(""), units(""), entry_type(kString), value_uint64() {}
 MemoryAllocatorDump::Entry::Entry(MemoryAllocatorDump::Entry&&) noexcept =
     default;
 MemoryAllocatorDump::Entry& MemoryAllocatorDump::Entry::operator=(
     MemoryAllocatorDump::Entry&&) = default;
-MemoryAllocatorDump::Entry::Entry(std::string name,
-                                  std::string units,
+MemoryAllocatorDump::Entry::Entry(StringPiece name,
+                                  StringPiece units,
                                   uint64_t value)
-    : name(name), units(units), entry_type(kUint64), value_uint64(value) {}
-MemoryAllocatorDump::Entry::Entry(std::string name,
-                                  std::string units,
+    : name(InternString(name)),
+      units(InternString(units)),
+      entry_type(kUint64),
+      value_uint64(value) {}
+MemoryAllocatorDump::Entry::Entry(StringPiece name,
+                                  StringPiece units,
                                   std::string value)
-    : name(name), units(units), entry_type(kString), value_string(value) {}
+    : name(InternString(name)),
+      units(InternString(units)),
+      entry_type(kString),
+      value_uint64(),
+      value_string(std::move(value)) {}
+
+// static
+const char* MemoryAllocatorDump::Entry::InternString(StringPiece str) {
+  // The names and units of the entries are a small set of strings, so the
+  // table is leaked.
+  static NoDestructor<Lock> lock;
+  static NoDestructor<std::unordered_set<std::string>> strings;
+  AutoLock auto_lock(*lock);
+  return strings->insert(str.as_string()).first->c_str();
+}
 
 bool MemoryAllocatorDump::Entry::operator==(const Entry& rhs) const {
-  if (!(name == rhs.name && units == rhs.units && entry_type == rhs.entry_type))
+  if (!(strcmp(name, rhs.name) == 0 && strcmp(units, rhs.units) == 0 &&
+        entry_type == rhs.entry_type)) {
     return false;
+  }
   switch (entry_type) {
     case EntryType::kUint64:
       return value_uint64 == rhs.value_uint64;
@@ -16,6 +16,7 @@
 #include "base/logging.h"
 #include "base/macros.h"
 #include "base/optional.h"
+#include "base/strings/string_piece.h"
 #include "base/trace_event/memory_allocator_dump_guid.h"
 #include "base/trace_event/memory_dump_request_args.h"
 #include "base/trace_event/trace_event_argument.h"
@@ -47,19 +48,23 @@ class BASE_EXPORT MemoryAllocatorDump {
       kString,
     };
 
-    // By design name, units and value_string are  always coming from
-    // indefinitely lived const char* strings, the only reason we copy
-    // them into a std::string is to handle Mojo (de)serialization.
-    // TODO(hjd): Investigate optimization (e.g. using StringPiece).
+    // By design name and units are always coming from indefinitely lived
+    // const char* strings, which AddScalar() and AddString() keep as is. The
+    // constructors below, used by Mojo deserialization and tests, intern them
+    // in a process-wide table instead, so that they live as long.
     Entry();  // Only for deserialization.
-    Entry(std::string name, std::string units, uint64_t value);
-    Entry(std::string name, std::string units, std::string value);
+    Entry(StringPiece name, StringPiece units, uint64_t value);
+    Entry(StringPiece name, StringPiece units, std::string value);
     Entry(Entry&& other) noexcept;
     Entry& operator=(Entry&& other);
     bool operator==(const Entry& rhs) const;
 
-    std::string name;
-    std::string units;
+    // Returns an indefinitely lived copy of |str|, which is the same for
+    // equal strings.
+    static const char* InternString(StringPiece str);
+
+    const char* name;
+    const char* units;
 
     EntryType entry_type;
 
@@ -102,6 +107,10 @@ class BASE_EXPORT MemoryAllocatorDump {
   // Called at trace generation time to populate the TracedValue.
   void AsValueInto(TracedValue* value) const;
 
+  // Appends the same "absolute_name": {...} dictionary member as AsValueInto()
+  // to the JSON |out|, without building a TracedValue.
+  void AppendAsJSON(std::string* out) const;
+
   // Get the size for this dump.
   // The size is the value set with AddScalar(kNameSize, kUnitsBytes, size);
   // TODO(hjd): this should return an Optional<uint64_t>.
@@ -151,6 +151,17 @@ TEST(MemoryAllocatorDumpTest, MovingAnEntry) {
   EXPECT_EQ(expected_entry, to_entry);
 }
 
+TEST(MemoryAllocatorDumpTest, InternedEntryStrings) {
+  std::string name = "interned_name";
+  MemoryAllocatorDump::Entry entry1(name, "units", 1);
+  name[0] = 'I';
+  MemoryAllocatorDump::Entry entry2("interned_name", std::string("units"), 1);
+  EXPECT_STREQ("interned_name", entry1.name);
+  EXPECT_EQ(entry1.name, entry2.name);
+  EXPECT_EQ(entry1.units, entry2.units);
+  EXPECT_EQ(entry1, entry2);
+}
+
 // DEATH tests are not supported in Android/iOS/Fuchsia.
 #if !defined(NDEBUG) && !defined(OS_ANDROID) && !defined(OS_IOS) && \
     !defined(OS_FUCHSIA)
@@ -314,16 +314,77 @@ void MemoryDumpManager::CreateProcessDump(
         args, dump_providers_, callback, GetOrCreateBgTaskRunnerLocked()));
   }
 
-  // Start the process dump. This involves task runner hops as specified by the
-  // MemoryDumpProvider(s) in RegisterDumpProvider()).
+  // Start the process dump. The concurrent dump providers are invoked on their
+  // task runners right away, while the others involve task runner hops as
+  // specified by the MemoryDumpProvider(s) in RegisterDumpProvider()).
+  StartConcurrentDumps(pmd_async_state.get());
   ContinueAsyncProcessDump(pmd_async_state.release());
 }
 
+void MemoryDumpManager::StartConcurrentDumps(
+    ProcessMemoryDumpAsyncState* pmd_async_state) {
+  auto dump_provider_groups =
+      std::move(pmd_async_state->concurrent_dump_providers);
+  for (auto& dump_providers : dump_provider_groups) {
+    // The unbound dump providers all run on |dump_thread_|.
+    scoped_refptr<SequencedTaskRunner> task_runner =
+        dump_providers.front()->task_runner;
+    if (!task_runner)
+      task_runner = pmd_async_state->dump_thread_task_runner;
+
+    bool did_post_task = task_runner->PostTask(
+        FROM_HERE,
+        BindOnce(&MemoryDumpManager::InvokeConcurrentDumps, Unretained(this),
+                 Unretained(pmd_async_state), std::move(dump_providers)));
+    if (did_post_task)
+      continue;
+
+    // As in ContinueAsyncProcessDump(), disable the dump providers of a task
+    // runner which is shut down. This is never the last part of the dump,
+    // since the sequential one didn't start yet.
+    if (task_runner != pmd_async_state->dump_thread_task_runner) {
+      AutoLock lock(lock_);
+      for (const auto& mdpinfo : dump_providers)
+        mdpinfo->disabled = true;
+    }
+    FinishProcessDumpPart(pmd_async_state, nullptr);
+  }
+}
+
+void MemoryDumpManager::InvokeConcurrentDumps(
+    ProcessMemoryDumpAsyncState* pmd_async_state,
+    std::vector<scoped_refptr<MemoryDumpProviderInfo>> dump_providers) {
+  HEAP_PROFILER_SCOPED_IGNORE;
+  TraceLog::GetInstance()->InitializeThreadLocalEventBufferIfSupported();
+
+  auto pmd = std::make_unique<ProcessMemoryDump>(
+      pmd_async_state->process_memory_dump->dump_args());
+  for (const auto& mdpinfo : dump_providers)
+    InvokeOnMemoryDump(mdpinfo.get(), pmd.get());
+  FinishProcessDumpPart(pmd_async_state, std::move(pmd));
+}
+
+void MemoryDumpManager::FinishProcessDumpPart(
+    ProcessMemoryDumpAsyncState* pmd_async_state,
+    std::unique_ptr<ProcessMemoryDump> concurrent_dump) {
+  {
+    AutoLock lock(pmd_async_state->parts_lock);
+    if (concurrent_dump)
+      pmd_async_state->concurrent_dumps.push_back(std::move(concurrent_dump));
+    DCHECK_GT(pmd_async_state->pending_parts, 0u);
+    if (--pmd_async_state->pending_parts > 0)
+      return;
+  }
+  FinishAsyncProcessDump(WrapUnique(pmd_async_state));
+}
+
 // Invokes OnMemoryDump() on all MDPs that are next in the pending list and run
 // on the current sequenced task runner. If the next MDP does not run in current
 // sequenced task runner, then switches to that task runner and continues. All
-// OnMemoryDump() invocations are linearized. |lock_| is used in these functions
-// purely to ensure consistency w.r.t. (un)registrations of |dump_providers_|.
+// these OnMemoryDump() invocations are linearized, unlike the ones of the
+// concurrent dump providers (see InvokeConcurrentDumps()). |lock_| is used in
+// these functions purely to ensure consistency w.r.t. (un)registrations of
+// |dump_providers_|.
 void MemoryDumpManager::ContinueAsyncProcessDump(
     ProcessMemoryDumpAsyncState* owned_pmd_async_state) {
   HEAP_PROFILER_SCOPED_IGNORE;
@@ -399,7 +460,7 @@ void MemoryDumpManager::ContinueAsyncProcessDump(
     pmd_async_state->pending_dump_providers.pop_back();
   }
 
-  FinishAsyncProcessDump(std::move(pmd_async_state));
+  FinishProcessDumpPart(pmd_async_state.release(), nullptr);
 }
 
 // This function is called on the right task runner for current MDP. It is
@@ -454,12 +515,47 @@ void MemoryDumpManager::InvokeOnMemoryDump(MemoryDumpProviderInfo* mdpinfo,
   ANNOTATE_BENIGN_RACE(&mdpinfo->disabled, "best-effort race detection");
   CHECK(!is_thread_bound ||
         !*(static_cast<volatile bool*>(&mdpinfo->disabled)));
-  bool dump_successful =
-      mdpinfo->dump_provider->OnMemoryDump(pmd->dump_args(), pmd);
+  bool dump_successful;
+  if (mdpinfo->options.supports_incremental_dumps) {
+    dump_successful = InvokeIncrementalOnMemoryDump(mdpinfo, pmd);
+  } else {
+    dump_successful =
+        mdpinfo->dump_provider->OnMemoryDump(pmd->dump_args(), pmd);
+  }
   mdpinfo->consecutive_failures =
       dump_successful ? 0 : mdpinfo->consecutive_failures + 1;
 }
 
+bool MemoryDumpManager::InvokeIncrementalOnMemoryDump(
+    MemoryDumpProviderInfo* mdpinfo,
+    ProcessMemoryDump* pmd) {
+  MemoryDumpArgs args = pmd->dump_args();
+  std::unique_ptr<ProcessMemoryDump>& last_dump =
+      mdpinfo->last_incremental_dump;
+  // A dump with a different level of detail can't be applied to the previous
+  // one, which is then replaced by a full dump.
+  if (last_dump &&
+      last_dump->dump_args().level_of_detail != args.level_of_detail) {
+    last_dump.reset();
+  }
+  if (last_dump)
+    args.last_dump_guid = last_dump->dump_args().dump_guid;
+
+  ProcessMemoryDump delta(args);
+  if (!mdpinfo->dump_provider->OnMemoryDump(args, &delta)) {
+    last_dump.reset();
+    return false;
+  }
+
+  auto current_dump = std::make_unique<ProcessMemoryDump>(args);
+  if (last_dump)
+    current_dump->TakeAllDumpsFrom(last_dump.get());
+  current_dump->ApplyIncrementalDump(&delta);
+  pmd->CopyAllDumpsFrom(*current_dump);
+  last_dump = std::move(current_dump);
+  return true;
+}
+
 void MemoryDumpManager::FinishAsyncProcessDump(
     std::unique_ptr<ProcessMemoryDumpAsyncState> pmd_async_state) {
   HEAP_PROFILER_SCOPED_IGNORE;
@@ -476,6 +572,12 @@ void MemoryDumpManager::FinishAsyncProcessDump(
 
   TRACE_EVENT0(kTraceCategory, "MemoryDumpManager::FinishAsyncProcessDump");
 
+  for (const auto& concurrent_dump : pmd_async_state->concurrent_dumps) {
+    pmd_async_state->process_memory_dump->TakeAllDumpsFrom(
+        concurrent_dump.get());
+  }
+  pmd_async_state->concurrent_dumps.clear();
+
   if (!pmd_async_state->callback.is_null()) {
     pmd_async_state->callback.Run(
         true /* success */, dump_guid,
@@ -532,8 +634,29 @@ MemoryDumpManager::ProcessMemoryDumpAsyncState::ProcessMemoryDumpAsyncState(
       callback(callback),
       callback_task_runner(ThreadTaskRunnerHandle::Get()),
       dump_thread_task_runner(std::move(dump_thread_task_runner)) {
-  pending_dump_providers.reserve(dump_providers.size());
-  pending_dump_providers.assign(dump_providers.rbegin(), dump_providers.rend());
+  // The concurrent dump providers of a task runner are adjacent in
+  // |dump_providers|, and so are the unbound ones.
+  const MemoryDumpProviderInfo* last_concurrent_mdpinfo = nullptr;
+  for (auto it = dump_providers.rbegin(); it != dump_providers.rend(); ++it) {
+    const scoped_refptr<MemoryDumpProviderInfo>& mdpinfo = *it;
+    if (!mdpinfo->options.supports_concurrent_dumps) {
+      pending_dump_providers.push_back(mdpinfo);
+      continue;
+    }
+    // Only the whitelisted dump providers are invoked in background mode.
+    if (req_args.level_of_detail == MemoryDumpLevelOfDetail::BACKGROUND &&
+        !mdpinfo->whitelisted_for_background_mode) {
+      continue;
+    }
+    if (!last_concurrent_mdpinfo ||
+        last_concurrent_mdpinfo->task_runner != mdpinfo->task_runner) {
+      concurrent_dump_providers.emplace_back();
+    }
+    concurrent_dump_providers.back().push_back(mdpinfo);
+    last_concurrent_mdpinfo = mdpinfo.get();
+  }
+  pending_parts = 1 + concurrent_dump_providers.size();
+
   MemoryDumpArgs args = {req_args.level_of_detail, req_args.dump_guid};
   process_memory_dump = std::make_unique<ProcessMemoryDump>(args);
 }
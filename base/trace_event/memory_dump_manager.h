@@ -152,8 +152,10 @@ class BASE_EXPORT MemoryDumpManager {
 
   // Holds the state of a process memory dump that needs to be carried over
   // across task runners in order to fulfill an asynchronous CreateProcessDump()
-  // request. At any time exactly one task runner owns a
-  // ProcessMemoryDumpAsyncState.
+  // request. The dump is made of parts: the sequential invocation of the
+  // |pending_dump_providers| and one for each group of
+  // |concurrent_dump_providers|. The ProcessMemoryDumpAsyncState is owned by
+  // the part which completes last.
   struct ProcessMemoryDumpAsyncState {
     ProcessMemoryDumpAsyncState(
         MemoryDumpRequestArgs req_args,
@@ -173,6 +175,22 @@ class BASE_EXPORT MemoryDumpManager {
     // and becomes empty at the end, when all dump providers have been invoked.
     std::vector<scoped_refptr<MemoryDumpProviderInfo>> pending_dump_providers;
 
+    // The dump providers which support concurrent dumps, grouped by task
+    // runner. Each group is moved to a task on its task runner when the dump
+    // starts.
+    std::vector<std::vector<scoped_refptr<MemoryDumpProviderInfo>>>
+        concurrent_dump_providers;
+
+    // Protects the fields below, which are accessed by the concurrent parts.
+    Lock parts_lock;
+
+    // The number of parts which didn't complete yet.
+    size_t pending_parts;
+
+    // The ProcessMemoryDump(s) filled by the groups of concurrent dump
+    // providers, merged into |process_memory_dump| at the end.
+    std::vector<std::unique_ptr<ProcessMemoryDump>> concurrent_dumps;
+
     // Callback passed to the initial call to CreateProcessDump().
     ProcessMemoryDumpCallback callback;
 
@@ -210,11 +228,33 @@ class BASE_EXPORT MemoryDumpManager {
   void ContinueAsyncProcessDump(
       ProcessMemoryDumpAsyncState* owned_pmd_async_state);
 
+  // Posts a task for each group of concurrent dump providers of
+  // |pmd_async_state|, which stays owned by the caller.
+  void StartConcurrentDumps(ProcessMemoryDumpAsyncState* pmd_async_state);
+
+  // Invokes InvokeOnMemoryDump() for the concurrent dump providers of a group,
+  // which all belong to the current task runner, into a new ProcessMemoryDump.
+  void InvokeConcurrentDumps(
+      ProcessMemoryDumpAsyncState* pmd_async_state,
+      std::vector<scoped_refptr<MemoryDumpProviderInfo>> dump_providers);
+
+  // Completes a part of the dump, adding |concurrent_dump| (if not null) to
+  // the dump. Calls FinishAsyncProcessDump() if it was the last part, taking
+  // the ownership of |pmd_async_state|.
+  void FinishProcessDumpPart(
+      ProcessMemoryDumpAsyncState* pmd_async_state,
+      std::unique_ptr<ProcessMemoryDump> concurrent_dump);
+
   // Invokes OnMemoryDump() of the given MDP. Should be called on the MDP task
   // runner.
   void InvokeOnMemoryDump(MemoryDumpProviderInfo* mdpinfo,
                           ProcessMemoryDump* pmd);
 
+  // Invokes OnMemoryDump() of an MDP which supports incremental dumps and
+  // adds all its current dumps to |pmd|. Returns whether the dump succeeded.
+  bool InvokeIncrementalOnMemoryDump(MemoryDumpProviderInfo* mdpinfo,
+                                     ProcessMemoryDump* pmd);
+
   void FinishAsyncProcessDump(
       std::unique_ptr<ProcessMemoryDumpAsyncState> pmd_async_state);
 
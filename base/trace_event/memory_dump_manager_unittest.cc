@@ -23,6 +23,7 @@
 #include "base/task_scheduler/post_task.h"
 #include "base/test/scoped_task_environment.h"
 #include "base/test/test_io_thread.h"
+#include "base/test/test_timeouts.h"
 #include "base/threading/platform_thread.h"
 #include "base/threading/sequenced_task_runner_handle.h"
 #include "base/threading/thread.h"
@@ -198,8 +199,11 @@ class MemoryDumpManagerTest : public testing::Test {
   // Blocks the current thread (spinning a nested message loop) until the
   // memory dump is complete. Returns:
   // - return value: the |success| from the CreateProcessDump() callback.
-  bool RequestProcessDumpAndWait(MemoryDumpType dump_type,
-                                 MemoryDumpLevelOfDetail level_of_detail) {
+  // - |result_pmd|: if not null, the ProcessMemoryDump passed to the callback.
+  bool RequestProcessDumpAndWait(
+      MemoryDumpType dump_type,
+      MemoryDumpLevelOfDetail level_of_detail,
+      std::unique_ptr<ProcessMemoryDump>* result_pmd = nullptr) {
     RunLoop run_loop;
     bool success = false;
     static uint64_t test_guid = 1;
@@ -215,15 +219,20 @@ class MemoryDumpManagerTest : public testing::Test {
     // "curried_" prefix) are just passed from the Bind(). This is just to get
     // around the limitation of Bind() in supporting only capture-less lambdas.
     ProcessMemoryDumpCallback callback = Bind(
-        [](bool* curried_success, Closure curried_quit_closure,
-           uint64_t curried_expected_guid, bool success, uint64_t dump_guid,
+        [](bool* curried_success,
+           std::unique_ptr<ProcessMemoryDump>* curried_pmd,
+           Closure curried_quit_closure, uint64_t curried_expected_guid,
+           bool success, uint64_t dump_guid,
            std::unique_ptr<ProcessMemoryDump> pmd) {
           *curried_success = success;
+          if (curried_pmd)
+            *curried_pmd = std::move(pmd);
           EXPECT_EQ(curried_expected_guid, dump_guid);
           ThreadTaskRunnerHandle::Get()->PostTask(FROM_HERE,
                                                   curried_quit_closure);
         },
-        Unretained(&success), run_loop.QuitClosure(), test_guid);
+        Unretained(&success), Unretained(result_pmd), run_loop.QuitClosure(),
+        test_guid);
 
     mdm_->CreateProcessDump(request_args, callback);
     run_loop.Run();
@@ -836,5 +845,161 @@ TEST_F(MemoryDumpManagerTest, NoStackOverflowWithTooManyMDPs) {
                                         MemoryDumpLevelOfDetail::BACKGROUND));
 }
 
+// Checks that the dump providers supporting concurrent dumps are invoked at the
+// same time on their task runners, and that their dumps are merged.
+TEST_F(MemoryDumpManagerTest, ConcurrentDumpers) {
+  MemoryDumpProvider::Options options;
+  options.supports_concurrent_dumps = true;
+  Thread thread1("test thread1");
+  Thread thread2("test thread2");
+  thread1.Start();
+  thread2.Start();
+  MockMemoryDumpProvider mdp1;
+  MockMemoryDumpProvider mdp2;
+  MockMemoryDumpProvider mdp3;
+  RegisterDumpProvider(&mdp1, thread1.task_runner(), options);
+  RegisterDumpProvider(&mdp2, thread2.task_runner(), options);
+  RegisterDumpProvider(&mdp3, ThreadTaskRunnerHandle::Get());
+
+  // Each concurrent provider waits for the other one to be invoked, which
+  // would time out if they were invoked one after the other.
+  WaitableEvent dumping1(WaitableEvent::ResetPolicy::MANUAL,
+                         WaitableEvent::InitialState::NOT_SIGNALED);
+  WaitableEvent dumping2(WaitableEvent::ResetPolicy::MANUAL,
+                         WaitableEvent::InitialState::NOT_SIGNALED);
+  auto concurrent_dump = [](WaitableEvent* dumping,
+                            WaitableEvent* other_dumping, const char* name,
+                            ProcessMemoryDump* pmd) {
+    dumping->Signal();
+    EXPECT_TRUE(other_dumping->TimedWait(TestTimeouts::action_timeout()));
+    pmd->CreateAllocatorDump(name);
+    return true;
+  };
+  EXPECT_CALL(mdp1, OnMemoryDump(_, _))
+      .WillOnce(Invoke([&](const MemoryDumpArgs&, ProcessMemoryDump* pmd) {
+        EXPECT_TRUE(thread1.task_runner()->RunsTasksInCurrentSequence());
+        return concurrent_dump(&dumping1, &dumping2, "mdp1", pmd);
+      }));
+  EXPECT_CALL(mdp2, OnMemoryDump(_, _))
+      .WillOnce(Invoke([&](const MemoryDumpArgs&, ProcessMemoryDump* pmd) {
+        EXPECT_TRUE(thread2.task_runner()->RunsTasksInCurrentSequence());
+        return concurrent_dump(&dumping2, &dumping1, "mdp2", pmd);
+      }));
+  EXPECT_CALL(mdp3, OnMemoryDump(_, _))
+      .WillOnce(Invoke([](const MemoryDumpArgs&, ProcessMemoryDump* pmd) {
+        pmd->CreateAllocatorDump("mdp3");
+        return true;
+      }));
+
+  EnableForTracing();
+  std::unique_ptr<ProcessMemoryDump> pmd;
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::EXPLICITLY_TRIGGERED,
+                                        MemoryDumpLevelOfDetail::DETAILED,
+                                        &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_EQ(3u, pmd->allocator_dumps().size());
+  EXPECT_TRUE(pmd->GetAllocatorDump("mdp1"));
+  EXPECT_TRUE(pmd->GetAllocatorDump("mdp2"));
+  EXPECT_TRUE(pmd->GetAllocatorDump("mdp3"));
+  DisableTracing();
+
+  mdm_->UnregisterDumpProvider(&mdp3);
+  PostTaskAndWait(FROM_HERE, thread1.task_runner().get(),
+                  BindOnce(&MemoryDumpManager::UnregisterDumpProvider,
+                           Unretained(mdm_.get()), Unretained(&mdp1)));
+  PostTaskAndWait(FROM_HERE, thread2.task_runner().get(),
+                  BindOnce(&MemoryDumpManager::UnregisterDumpProvider,
+                           Unretained(mdm_.get()), Unretained(&mdp2)));
+}
+
+// Checks that the changes reported by a dump provider supporting incremental
+// dumps are applied to its previous dumps.
+TEST_F(MemoryDumpManagerTest, IncrementalDumps) {
+  MemoryDumpProvider::Options options;
+  options.supports_incremental_dumps = true;
+  MockMemoryDumpProvider mdp;
+  RegisterDumpProvider(&mdp, ThreadTaskRunnerHandle::Get(), options);
+  EnableForTracing();
+
+  uint64_t last_dump_guid = 0;
+  EXPECT_CALL(mdp, OnMemoryDump(_, _))
+      .WillOnce(Invoke([&](const MemoryDumpArgs& args, ProcessMemoryDump* pmd) {
+        EXPECT_EQ(0u, args.last_dump_guid);
+        pmd->CreateAllocatorDump("mdp/a")->AddScalar(
+            MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes,
+            1);
+        pmd->CreateAllocatorDump("mdp/b")->AddScalar(
+            MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes,
+            2);
+        last_dump_guid = args.dump_guid;
+        return true;
+      }))
+      .WillOnce(Invoke([&](const MemoryDumpArgs& args, ProcessMemoryDump* pmd) {
+        EXPECT_EQ(last_dump_guid, args.last_dump_guid);
+        pmd->MarkAllocatorDumpRemoved("mdp/a");
+        pmd->CreateAllocatorDump("mdp/c")->AddScalar(
+            MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes,
+            3);
+        return false;
+      }))
+      .WillOnce(Invoke([&](const MemoryDumpArgs& args, ProcessMemoryDump* pmd) {
+        // The failed dump wasn't applied, so a full dump is required.
+        EXPECT_EQ(0u, args.last_dump_guid);
+        pmd->CreateAllocatorDump("mdp/a")->AddScalar(
+            MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes,
+            1);
+        pmd->CreateAllocatorDump("mdp/b")->AddScalar(
+            MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes,
+            2);
+        last_dump_guid = args.dump_guid;
+        return true;
+      }))
+      .WillOnce(Invoke([&](const MemoryDumpArgs& args, ProcessMemoryDump* pmd) {
+        EXPECT_EQ(last_dump_guid, args.last_dump_guid);
+        pmd->MarkAllocatorDumpRemoved("mdp/a");
+        pmd->CreateAllocatorDump("mdp/b")->AddScalar(
+            MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes,
+            4);
+        return true;
+      }))
+      .WillOnce(Invoke([&](const MemoryDumpArgs& args, ProcessMemoryDump* pmd) {
+        // The level of detail changed.
+        EXPECT_EQ(0u, args.last_dump_guid);
+        return true;
+      }));
+
+  std::unique_ptr<ProcessMemoryDump> pmd;
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::EXPLICITLY_TRIGGERED,
+                                        MemoryDumpLevelOfDetail::DETAILED,
+                                        &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_EQ(2u, pmd->allocator_dumps().size());
+
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::EXPLICITLY_TRIGGERED,
+                                        MemoryDumpLevelOfDetail::DETAILED,
+                                        &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_FALSE(pmd->GetAllocatorDump("mdp/c"));
+
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::EXPLICITLY_TRIGGERED,
+                                        MemoryDumpLevelOfDetail::DETAILED,
+                                        &pmd));
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::EXPLICITLY_TRIGGERED,
+                                        MemoryDumpLevelOfDetail::DETAILED,
+                                        &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_EQ(1u, pmd->allocator_dumps().size());
+  ASSERT_TRUE(pmd->GetAllocatorDump("mdp/b"));
+  EXPECT_EQ(4u, pmd->GetAllocatorDump("mdp/b")->GetSizeInternal());
+
+  EXPECT_TRUE(RequestProcessDumpAndWait(MemoryDumpType::EXPLICITLY_TRIGGERED,
+                                        MemoryDumpLevelOfDetail::LIGHT, &pmd));
+  ASSERT_TRUE(pmd);
+  EXPECT_TRUE(pmd->allocator_dumps().empty());
+
+  DisableTracing();
+  mdm_->UnregisterDumpProvider(&mdp);
+}
+
 }  // namespace trace_event
 }  // namespace base
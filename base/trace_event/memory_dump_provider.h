@@ -20,12 +20,29 @@ class BASE_EXPORT MemoryDumpProvider {
  public:
   // Optional arguments for MemoryDumpManager::RegisterDumpProvider().
   struct Options {
-    Options() : dumps_on_single_thread_task_runner(false) {}
+    Options()
+        : dumps_on_single_thread_task_runner(false),
+          supports_concurrent_dumps(false),
+          supports_incremental_dumps(false) {}
 
     // |dumps_on_single_thread_task_runner| is true if the dump provider runs on
     // a SingleThreadTaskRunner, which is usually the case. It is faster to run
     // all providers that run on the same thread together without thread hops.
     bool dumps_on_single_thread_task_runner;
+
+    // |supports_concurrent_dumps| is true if OnMemoryDump() can run while the
+    // providers on other task runners are dumping. It is invoked into its own
+    // ProcessMemoryDump which is merged afterwards, so the names of its dumps
+    // must not be used by any other provider.
+    bool supports_concurrent_dumps;
+
+    // |supports_incremental_dumps| is true if OnMemoryDump() only reports the
+    // dumps which were added or changed since the dump with the
+    // MemoryDumpArgs::last_dump_guid, and calls
+    // ProcessMemoryDump::MarkAllocatorDumpRemoved() for the ones that are gone.
+    // The MemoryDumpManager keeps the previous dumps, so that the
+    // ProcessMemoryDump it outputs is still complete.
+    bool supports_incremental_dumps;
   };
 
   virtual ~MemoryDumpProvider() = default;
@@ -18,6 +18,8 @@ class SequencedTaskRunner;
 
 namespace trace_event {
 
+class ProcessMemoryDump;
+
 // Wraps a MemoryDumpProvider (MDP), which is registered via
 // MemoryDumpManager(MDM)::RegisterDumpProvider(), holding the extra information
 // required to deal with it (which task runner it should be invoked onto,
@@ -95,6 +97,11 @@ struct BASE_EXPORT MemoryDumpProviderInfo
   // Flagged either by the auto-disable logic or during unregistration.
   bool disabled;
 
+  // For Options::supports_incremental_dumps: all the dumps of the provider as
+  // of its last successful dump, which its next dump is applied to. Reset to
+  // request a full dump.
+  std::unique_ptr<ProcessMemoryDump> last_incremental_dump;
+
  private:
   friend class base::RefCountedThreadSafe<MemoryDumpProviderInfo>;
   ~MemoryDumpProviderInfo();
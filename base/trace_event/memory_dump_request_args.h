@@ -80,6 +80,11 @@ struct MemoryDumpArgs {
   // local dump with the same guid. This allows the trace importers to
   // reconstruct the global dump.
   uint64_t dump_guid;
+
+  // Only set for dump providers which support incremental dumps: the
+  // |dump_guid| of their last successful dump, which they only need to report
+  // the changes since. 0 if they have to report all their dumps.
+  uint64_t last_dump_guid = 0;
 };
 
 using ProcessMemoryDumpCallback = Callback<
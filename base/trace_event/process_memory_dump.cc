@@ -259,8 +259,9 @@ MemoryAllocatorDump* ProcessMemoryDump::AddAllocatorDumpInternal(
     return GetBlackHoleMad();
   }
 
-  auto insertion_result = allocator_dumps_.insert(
-      std::make_pair(mad->absolute_name(), std::move(mad)));
+  StringPiece absolute_name = mad->absolute_name();
+  auto insertion_result =
+      allocator_dumps_.emplace(absolute_name, std::move(mad));
   MemoryAllocatorDump* inserted_mad = insertion_result.first->second.get();
   DCHECK(insertion_result.second) << "Duplicate name: "
                                   << inserted_mad->absolute_name();
@@ -349,6 +350,7 @@ void ProcessMemoryDump::SetAllEdgesForSerialization(
 void ProcessMemoryDump::Clear() {
   allocator_dumps_.clear();
   allocator_dumps_edges_.clear();
+  removed_allocator_dumps_.clear();
 }
 
 void ProcessMemoryDump::TakeAllDumpsFrom(ProcessMemoryDump* other) {
@@ -364,6 +366,54 @@ void ProcessMemoryDump::TakeAllDumpsFrom(ProcessMemoryDump* other) {
   other->allocator_dumps_edges_.clear();
 }
 
+void ProcessMemoryDump::CopyAllDumpsFrom(const ProcessMemoryDump& other) {
+  for (const auto& it : other.allocator_dumps_) {
+    const MemoryAllocatorDump& mad = *it.second;
+    auto copy = std::make_unique<MemoryAllocatorDump>(
+        mad.absolute_name(), mad.level_of_detail(), mad.guid());
+    copy->set_flags(mad.flags());
+    for (const MemoryAllocatorDump::Entry& entry : mad.entries()) {
+      if (entry.entry_type == MemoryAllocatorDump::Entry::kUint64)
+        copy->AddScalar(entry.name, entry.units, entry.value_uint64);
+      else
+        copy->AddString(entry.name, entry.units, entry.value_string);
+    }
+    AddAllocatorDumpInternal(std::move(copy));
+  }
+  allocator_dumps_edges_.insert(other.allocator_dumps_edges_.begin(),
+                                other.allocator_dumps_edges_.end());
+}
+
+void ProcessMemoryDump::MarkAllocatorDumpRemoved(
+    const std::string& absolute_name) {
+  removed_allocator_dumps_.push_back(absolute_name);
+}
+
+void ProcessMemoryDump::ApplyIncrementalDump(ProcessMemoryDump* delta) {
+  for (const std::string& name : delta->removed_allocator_dumps_) {
+    auto it = allocator_dumps_.find(name);
+    if (it == allocator_dumps_.end())
+      continue;
+    allocator_dumps_edges_.erase(it->second->guid());
+    allocator_dumps_.erase(it);
+  }
+  delta->removed_allocator_dumps_.clear();
+
+  for (auto& it : delta->allocator_dumps_) {
+    auto previous = allocator_dumps_.find(it.first);
+    if (previous != allocator_dumps_.end()) {
+      allocator_dumps_edges_.erase(previous->second->guid());
+      allocator_dumps_.erase(previous);
+    }
+    AddAllocatorDumpInternal(std::move(it.second));
+  }
+  delta->allocator_dumps_.clear();
+
+  for (const auto& it : delta->allocator_dumps_edges_)
+    allocator_dumps_edges_[it.first] = it.second;
+  delta->allocator_dumps_edges_.clear();
+}
+
 void ProcessMemoryDump::SerializeAllocatorDumpsInto(TracedValue* value) const {
   if (allocator_dumps_.size() > 0) {
     value->BeginDictionary("allocators");
@@ -385,6 +435,37 @@ void ProcessMemoryDump::SerializeAllocatorDumpsInto(TracedValue* value) const {
   value->EndArray();
 }
 
+void ProcessMemoryDump::SerializeAllocatorDumpsInto(std::string* out) const {
+  out->push_back('{');
+  if (allocator_dumps_.size() > 0) {
+    out->append("\"allocators\":{");
+    bool first_dump = true;
+    for (const auto& allocator_dump_it : allocator_dumps_) {
+      if (!first_dump)
+        out->push_back(',');
+      first_dump = false;
+      allocator_dump_it.second->AppendAsJSON(out);
+    }
+    out->append("},");
+  }
+
+  out->append("\"allocators_graph\":[");
+  bool first_edge = true;
+  for (const auto& it : allocator_dumps_edges_) {
+    const MemoryAllocatorDumpEdge& edge = it.second;
+    if (!first_edge)
+      out->push_back(',');
+    first_edge = false;
+    StringAppendF(out,
+                  "{\"source\":\"%s\",\"target\":\"%s\",\"importance\":%d,"
+                  "\"type\":\"%s\"}",
+                  edge.source.ToString().c_str(),
+                  edge.target.ToString().c_str(), edge.importance,
+                  kEdgeTypeOwnership);
+  }
+  out->append("]}");
+}
+
 void ProcessMemoryDump::AddOwnershipEdge(const MemoryAllocatorDumpGuid& source,
                                          const MemoryAllocatorDumpGuid& target,
                                          int importance) {
@@ -492,8 +573,14 @@ MemoryAllocatorDump* ProcessMemoryDump::GetBlackHoleMad() {
 
 MemoryAllocatorDumpGuid ProcessMemoryDump::GetDumpId(
     const std::string& absolute_name) {
-  return MemoryAllocatorDumpGuid(StringPrintf(
-      "%s:%s", process_token().ToString().c_str(), absolute_name.c_str()));
+  // Hashes "process_token:absolute_name" without allocating for each dump.
+  if (dump_id_buffer_.empty())
+    dump_id_buffer_ = process_token().ToString() + ":";
+  const size_t prefix_length = dump_id_buffer_.size();
+  dump_id_buffer_.append(absolute_name);
+  MemoryAllocatorDumpGuid guid(dump_id_buffer_);
+  dump_id_buffer_.resize(prefix_length);
+  return guid;
 }
 
 bool ProcessMemoryDump::MemoryAllocatorDumpEdge::operator==(
@@ -8,12 +8,14 @@
 #include <stddef.h>
 
 #include <map>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "base/base_export.h"
 #include "base/macros.h"
 #include "base/memory/ref_counted.h"
+#include "base/strings/string_piece.h"
 #include "base/trace_event/heap_profiler_allocation_context.h"
 #include "base/trace_event/memory_allocator_dump.h"
 #include "base/trace_event/memory_allocator_dump_guid.h"
@@ -50,9 +52,10 @@ class BASE_EXPORT ProcessMemoryDump {
   };
 
   // Maps allocator dumps absolute names (allocator_name/heap/subheap) to
-  // MemoryAllocatorDump instances.
+  // MemoryAllocatorDump instances. The keys point to the absolute_name() of
+  // their dump, so that the names aren't copied.
   using AllocatorDumpsMap =
-      std::map<std::string, std::unique_ptr<MemoryAllocatorDump>>;
+      std::map<StringPiece, std::unique_ptr<MemoryAllocatorDump>>;
 
   // Stores allocator dump edges indexed by source allocator dump GUID.
   using AllocatorDumpEdgesMap =
@@ -222,10 +225,36 @@ class BASE_EXPORT ProcessMemoryDump {
   // of the MemoryDumpProvider::OnMemoryDump(ProcessMemoryDump*) callback.
   void TakeAllDumpsFrom(ProcessMemoryDump* other);
 
+  // Copies all the MemoryAllocatorDump(s) and edges contained in |other| into
+  // this ProcessMemoryDump, checking for duplicates. |other| is left as is.
+  void CopyAllDumpsFrom(const ProcessMemoryDump& other);
+
+  // For dump providers registered with
+  // MemoryDumpProvider::Options::supports_incremental_dumps: records that the
+  // dump named |absolute_name|, reported by a previous dump, doesn't exist
+  // anymore.
+  void MarkAllocatorDumpRemoved(const std::string& absolute_name);
+
+  // Updates this ProcessMemoryDump, which holds all the dumps of an
+  // incremental dump provider, with the changes reported in |delta|: the dumps
+  // marked as removed are erased, along with the edges they are the source of,
+  // and the dumps and edges of |delta| are moved in, replacing the previous
+  // ones with the same names and sources.
+  void ApplyIncrementalDump(ProcessMemoryDump* delta);
+
+  const std::vector<std::string>& removed_allocator_dumps() const {
+    return removed_allocator_dumps_;
+  }
+
   // Populate the traced value with information about the memory allocator
   // dumps.
   void SerializeAllocatorDumpsInto(TracedValue* value) const;
 
+  // Appends the JSON of a TracedValue populated by the method above to |out|,
+  // writing the dumps straight into it. This is much cheaper for processes
+  // with many dumps.
+  void SerializeAllocatorDumpsInto(std::string* out) const;
+
   const MemoryDumpArgs& dump_args() const { return dump_args_; }
 
  private:
@@ -242,6 +271,7 @@ class BASE_EXPORT ProcessMemoryDump {
   const UnguessableToken& process_token() const { return process_token_; }
   void set_process_token_for_testing(UnguessableToken token) {
     process_token_ = token;
+    dump_id_buffer_.clear();
   };
 
   // Returns the Guid of the dump for the given |absolute_name| for
@@ -260,9 +290,16 @@ class BASE_EXPORT ProcessMemoryDump {
   UnguessableToken process_token_;
   AllocatorDumpsMap allocator_dumps_;
 
+  // The "process_token:" prefix of the strings hashed by GetDumpId(), which
+  // appends the dump names to it temporarily.
+  std::string dump_id_buffer_;
+
   // Keeps track of relationships between MemoryAllocatorDump(s).
   AllocatorDumpEdgesMap allocator_dumps_edges_;
 
+  // See MarkAllocatorDumpRemoved().
+  std::vector<std::string> removed_allocator_dumps_;
+
   // Level of detail of the current dump.
   MemoryDumpArgs dump_args_;
 
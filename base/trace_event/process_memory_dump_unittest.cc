@@ -6,6 +6,7 @@
 
 #include <stddef.h>
 
+#include "base/json/json_reader.h"
 #include "base/memory/aligned_memory.h"
 #include "base/memory/ptr_util.h"
 #include "base/memory/shared_memory_tracker.h"
@@ -14,6 +15,7 @@
 #include "base/trace_event/memory_infra_background_whitelist.h"
 #include "base/trace_event/trace_event_argument.h"
 #include "base/trace_event/trace_log.h"
+#include "base/values.h"
 #include "build/build_config.h"
 #include "testing/gtest/include/gtest/gtest.h"
 
@@ -215,6 +217,99 @@ TEST(ProcessMemoryDumpTest, TakeAllDumpsFrom) {
   pmd1.reset();
 }
 
+TEST(ProcessMemoryDumpTest, CopyAllDumpsFrom) {
+  ProcessMemoryDump pmd1(kDetailedDumpArgs);
+  auto* mad1 = pmd1.CreateAllocatorDump("pmd1/mad1");
+  mad1->AddScalar(MemoryAllocatorDump::kNameSize,
+                  MemoryAllocatorDump::kUnitsBytes, 42);
+  mad1->AddString("kitten", "name", "shadow");
+  auto* mad2 = pmd1.CreateWeakSharedGlobalAllocatorDump(
+      MemoryAllocatorDumpGuid(1));
+  pmd1.AddOwnershipEdge(mad1->guid(), mad2->guid());
+
+  ProcessMemoryDump pmd2(kDetailedDumpArgs);
+  pmd2.CopyAllDumpsFrom(pmd1);
+  ASSERT_EQ(2u, pmd1.allocator_dumps().size());
+  ASSERT_EQ(2u, pmd2.allocator_dumps().size());
+  auto* copy1 = pmd2.GetAllocatorDump("pmd1/mad1");
+  ASSERT_TRUE(copy1);
+  EXPECT_NE(mad1, copy1);
+  EXPECT_EQ(mad1->guid(), copy1->guid());
+  EXPECT_EQ(42u, copy1->GetSizeInternal());
+  ASSERT_EQ(2u, copy1->entries().size());
+  EXPECT_EQ(mad1->entries()[1], copy1->entries()[1]);
+  auto* copy2 = pmd2.GetSharedGlobalAllocatorDump(MemoryAllocatorDumpGuid(1));
+  ASSERT_TRUE(copy2);
+  EXPECT_TRUE(MemoryAllocatorDump::Flags::WEAK & copy2->flags());
+  EXPECT_EQ(pmd1.allocator_dumps_edges(), pmd2.allocator_dumps_edges());
+}
+
+TEST(ProcessMemoryDumpTest, ApplyIncrementalDump) {
+  ProcessMemoryDump pmd(kDetailedDumpArgs);
+  auto* mad1 = pmd.CreateAllocatorDump("mad1");
+  auto* mad2 = pmd.CreateAllocatorDump("mad2");
+  auto* mad3 = pmd.CreateAllocatorDump("mad3");
+  pmd.AddOwnershipEdge(mad1->guid(), mad3->guid());
+  pmd.AddOwnershipEdge(mad2->guid(), mad3->guid());
+
+  ProcessMemoryDump delta(kDetailedDumpArgs);
+  delta.MarkAllocatorDumpRemoved("mad1");
+  delta.MarkAllocatorDumpRemoved("not_dumped");
+  delta.CreateAllocatorDump("mad2")->AddScalar(
+      MemoryAllocatorDump::kNameSize, MemoryAllocatorDump::kUnitsBytes, 2);
+  auto* mad4 = delta.CreateAllocatorDump("mad4");
+  delta.AddOwnershipEdge(mad4->guid(), mad3->guid());
+  pmd.ApplyIncrementalDump(&delta);
+
+  EXPECT_TRUE(delta.allocator_dumps().empty());
+  EXPECT_TRUE(delta.allocator_dumps_edges().empty());
+  EXPECT_TRUE(delta.removed_allocator_dumps().empty());
+
+  ASSERT_EQ(3u, pmd.allocator_dumps().size());
+  EXPECT_FALSE(pmd.GetAllocatorDump("mad1"));
+  ASSERT_TRUE(pmd.GetAllocatorDump("mad2"));
+  EXPECT_EQ(2u, pmd.GetAllocatorDump("mad2")->GetSizeInternal());
+  EXPECT_EQ(mad3, pmd.GetAllocatorDump("mad3"));
+  EXPECT_EQ(mad4, pmd.GetAllocatorDump("mad4"));
+  // The edge of the removed dump is gone, and so is the one of the replaced
+  // dump, which the delta didn't report again.
+  ASSERT_EQ(1u, pmd.allocator_dumps_edges().size());
+  EXPECT_EQ(1u, pmd.allocator_dumps_edges().count(mad4->guid()));
+}
+
+TEST(ProcessMemoryDumpTest, SerializeAllocatorDumpsIntoJSON) {
+  ProcessMemoryDump pmd(kDetailedDumpArgs);
+  std::string json;
+  pmd.SerializeAllocatorDumpsInto(&json);
+  std::unique_ptr<Value> empty_dumps = JSONReader::Read(json);
+  ASSERT_TRUE(empty_dumps);
+  EXPECT_FALSE(empty_dumps->FindKey("allocators"));
+
+  auto* mad1 = pmd.CreateAllocatorDump("mad1");
+  mad1->AddScalar(MemoryAllocatorDump::kNameSize,
+                  MemoryAllocatorDump::kUnitsBytes, 0x1234);
+  mad1->AddString("escaped\"name", "units", "escaped\nvalue");
+  auto* mad2 = pmd.CreateAllocatorDump("mad2/with \"quotes\"");
+  mad2->set_flags(MemoryAllocatorDump::Flags::WEAK);
+  pmd.CreateAllocatorDump("mad3");
+  pmd.AddOwnershipEdge(mad1->guid(), mad2->guid(), 2);
+  pmd.AddOwnershipEdge(mad2->guid(), MemoryAllocatorDumpGuid(42));
+
+  TracedValue traced_value;
+  pmd.SerializeAllocatorDumpsInto(&traced_value);
+  std::string traced_value_json;
+  traced_value.AppendAsTraceFormat(&traced_value_json);
+  json.clear();
+  pmd.SerializeAllocatorDumpsInto(&json);
+
+  std::unique_ptr<Value> expected = JSONReader::Read(traced_value_json);
+  std::unique_ptr<Value> actual = JSONReader::Read(json);
+  ASSERT_TRUE(expected);
+  ASSERT_TRUE(actual);
+  EXPECT_EQ(*expected, *actual);
+  EXPECT_EQ(3u, actual->FindKey("allocators")->DictSize());
+}
+
 TEST(ProcessMemoryDumpTest, OverrideOwnershipEdge) {
   std::unique_ptr<ProcessMemoryDump> pmd(
       new ProcessMemoryDump(kDetailedDumpArgs));
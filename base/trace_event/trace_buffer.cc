@@ -251,6 +251,7 @@ TraceBufferChunk::~TraceBufferChunk() = default;
 void TraceBufferChunk::Reset(uint32_t new_seq) {
   for (size_t i = 0; i < next_free_; ++i)
     chunk_[i].Reset();
+  string_arena_.Reset();
   next_free_ = 0;
   seq_ = new_seq;
   cached_overhead_estimate_.reset();
@@ -264,6 +265,9 @@ TraceEvent* TraceBufferChunk::AddTraceEvent(size_t* event_index) {
 
 void TraceBufferChunk::EstimateTraceMemoryOverhead(
     TraceEventMemoryOverhead* overhead) {
+  // Not cached, since it can grow until the chunk is reset.
+  string_arena_.EstimateTraceMemoryOverhead(overhead);
+
   if (!cached_overhead_estimate_) {
     cached_overhead_estimate_.reset(new TraceEventMemoryOverhead);
 
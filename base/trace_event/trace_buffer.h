@@ -39,6 +39,9 @@ class BASE_EXPORT TraceBufferChunk {
     return &chunk_[index];
   }
 
+  // For the strings copied by the events of this chunk.
+  TraceEventStringArena* string_arena() { return &string_arena_; }
+
   void EstimateTraceMemoryOverhead(TraceEventMemoryOverhead* overhead);
 
   // These values must be kept consistent with the numbers of bits of
@@ -51,6 +54,7 @@ class BASE_EXPORT TraceBufferChunk {
   size_t next_free_;
   std::unique_ptr<TraceEventMemoryOverhead> cached_overhead_estimate_;
   TraceEvent chunk_[kTraceBufferChunkSize];
+  TraceEventStringArena string_arena_;
   uint32_t seq_;
 };
 
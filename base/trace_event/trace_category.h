@@ -26,7 +26,11 @@ struct TraceCategory {
     DEPRECATED_ENABLED_FOR_EVENT_CALLBACK = 1 << 2,
 
     ENABLED_FOR_ETW_EXPORT = 1 << 3,
-    ENABLED_FOR_FILTERING = 1 << 4
+    ENABLED_FOR_FILTERING = 1 << 4,
+
+    // Only some of the events of the category are added, see
+    // TraceConfig::CategorySampling. Always set with another flag.
+    ENABLED_FOR_SAMPLING = 1 << 5
   };
 
   static const TraceCategory* FromStatePtr(const uint8_t* state_ptr) {
@@ -77,9 +81,52 @@ struct TraceCategory {
     *const_cast<volatile uint32_t*>(&enabled_filters_) = enabled_filters;
   }
 
+  uint32_t sample_interval() const {
+    return *const_cast<volatile const uint32_t*>(&sample_interval_);
+  }
+
+  uint32_t max_events_per_second() const {
+    return *const_cast<volatile const uint32_t*>(&max_events_per_second_);
+  }
+
+  void set_sampling(uint32_t sample_interval, uint32_t max_events_per_second) {
+    *const_cast<volatile uint32_t*>(&sample_interval_) = sample_interval;
+    *const_cast<volatile uint32_t*>(&max_events_per_second_) =
+        max_events_per_second;
+  }
+
+  // Counts an event and returns true if it is the last of
+  // |sample_interval_| events.
+  bool TakeIntervalSample() {
+    volatile uint32_t* count = const_cast<volatile uint32_t*>(&sample_count_);
+    const uint32_t next = *count + 1;
+    const bool sampled = next >= sample_interval();
+    *count = sampled ? 0 : next;
+    return sampled;
+  }
+
+  // Counts an event in the one-second window |now_in_seconds| and returns
+  // true if it is within |max_events_per_second_|.
+  bool TakeRateLimitedSample(uint32_t now_in_seconds) {
+    volatile uint32_t* window =
+        const_cast<volatile uint32_t*>(&sample_window_);
+    volatile uint32_t* count =
+        const_cast<volatile uint32_t*>(&sample_window_count_);
+    if (*window != now_in_seconds) {
+      *window = now_in_seconds;
+      *count = 0;
+    }
+    const uint32_t next = *count + 1;
+    if (next > max_events_per_second())
+      return false;
+    *count = next;
+    return true;
+  }
+
   void reset_for_testing() {
     set_state(0);
     set_enabled_filters(0);
+    set_sampling(0, 0);
   }
 
   // These fields should not be accessed directly, not even by tracing code.
@@ -101,6 +148,16 @@ struct TraceCategory {
 
   // TraceCategory group names are long lived static strings.
   const char* name_;
+
+  // When ENABLED_FOR_SAMPLING is set, the sampling options of the category
+  // and the counts of its events which are used to sample them. Like
+  // |state_|, the counts are updated without barriers nor atomic increments:
+  // losing a few counts only changes which events are sampled.
+  uint32_t sample_interval_;
+  uint32_t max_events_per_second_;
+  uint32_t sample_count_;
+  uint32_t sample_window_;
+  uint32_t sample_window_count_;
 };
 
 }  // namespace trace_event
@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include <memory>
+#include <string>
 
 #include "base/bind.h"
 #include "base/lazy_instance.h"
@@ -118,6 +119,28 @@ TEST_F(TraceCategoryTest, Basic) {
   ASSERT_TRUE(g_initializer_check);
 }
 
+TEST_F(TraceCategoryTest, LookupByName) {
+  const int kNumCategories = 32;
+  TraceCategory* categories[kNumCategories];
+  std::string names[kNumCategories];
+  for (int i = 0; i < kNumCategories; i++) {
+    names[i] = "__test_lookup_" + std::to_string(i);
+    ASSERT_TRUE(GetOrCreateCategoryByName(names[i].c_str(), &categories[i]));
+    ASSERT_FALSE(CategoryRegistry::IsBuiltinCategory(categories[i]));
+  }
+  for (int i = 0; i < kNumCategories; i++) {
+    // The lookups compare names, not pointers.
+    std::string name = names[i];
+    EXPECT_EQ(categories[i], CategoryRegistry::GetCategoryByName(name.c_str()));
+    TraceCategory* category = nullptr;
+    EXPECT_FALSE(GetOrCreateCategoryByName(name.c_str(), &category));
+    EXPECT_EQ(categories[i], category);
+  }
+  EXPECT_EQ(nullptr, CategoryRegistry::GetCategoryByName("__test_lookup_"));
+  EXPECT_EQ(CategoryRegistry::kCategoryMetadata,
+            CategoryRegistry::GetCategoryByName("__metadata"));
+}
+
 // Tries to cover the case of multiple threads creating the same category
 // simultaneously. Should never end up with distinct entries with the same name.
 #if defined(OS_FUCHSIA)
@@ -11,7 +11,9 @@
 #include "base/json/json_reader.h"
 #include "base/json/json_writer.h"
 #include "base/memory/ptr_util.h"
+#include "base/strings/pattern.h"
 #include "base/strings/string_split.h"
+#include "base/strings/string_tokenizer.h"
 #include "base/trace_event/memory_dump_manager.h"
 #include "base/trace_event/memory_dump_request_args.h"
 #include "base/trace_event/trace_event.h"
@@ -50,6 +52,13 @@ const char kBreakdownThresholdBytes[] = "breakdown_threshold_bytes";
 const char kEventFiltersParam[] = "event_filters";
 const char kFilterPredicateParam[] = "filter_predicate";
 const char kFilterArgsParam[] = "filter_args";
+const char kFilterAtFlushParam[] = "filter_at_flush";
+
+// String parameters used to parse category sampling.
+const char kCategorySamplingParam[] = "category_sampling";
+const char kSamplingCategoryParam[] = "category";
+const char kSampleIntervalParam[] = "sample_interval";
+const char kMaxEventsPerSecondParam[] = "max_events_per_second";
 
 // String parameter used to parse process filter.
 const char kIncludedProcessesParam[] = "included_process_ids";
@@ -185,6 +194,7 @@ TraceConfig::EventFilterConfig& TraceConfig::EventFilterConfig::operator=(
 
   predicate_name_ = rhs.predicate_name_;
   category_filter_ = rhs.category_filter_;
+  filter_at_flush_ = rhs.filter_at_flush_;
 
   if (rhs.args_)
     args_ = rhs.args_->CreateDeepCopy();
@@ -199,6 +209,8 @@ void TraceConfig::EventFilterConfig::InitializeFromConfigDict(
   const base::DictionaryValue* args_dict = nullptr;
   if (event_filter->GetDictionary(kFilterArgsParam, &args_dict))
     args_ = args_dict->CreateDeepCopy();
+
+  event_filter->GetBoolean(kFilterAtFlushParam, &filter_at_flush_);
 }
 
 void TraceConfig::EventFilterConfig::SetCategoryFilter(
@@ -214,6 +226,9 @@ void TraceConfig::EventFilterConfig::ToDict(
 
   if (args_)
     filter_dict->Set(kFilterArgsParam, args_->CreateDeepCopy());
+
+  if (filter_at_flush_)
+    filter_dict->SetBoolean(kFilterAtFlushParam, true);
 }
 
 bool TraceConfig::EventFilterConfig::GetArgAsSet(
@@ -293,6 +308,7 @@ TraceConfig& TraceConfig::operator=(const TraceConfig& rhs) {
   process_filter_config_ = rhs.process_filter_config_;
   memory_dump_config_ = rhs.memory_dump_config_;
   event_filters_ = rhs.event_filters_;
+  category_samplings_ = rhs.category_samplings_;
   return *this;
 }
 
@@ -319,6 +335,24 @@ bool TraceConfig::IsCategoryGroupEnabled(
   return category_filter_.IsCategoryGroupEnabled(category_group_name);
 }
 
+const TraceConfig::CategorySampling* TraceConfig::GetCategorySampling(
+    const StringPiece& category_group_name) const {
+  // Like IsCategoryGroupEnabled(), only used when updating the categories.
+  for (const CategorySampling& sampling : category_samplings_) {
+    if (sampling.sample_interval <= 1 && !sampling.max_events_per_second)
+      continue;
+    CStringTokenizer category_group_tokens(category_group_name.begin(),
+                                           category_group_name.end(), ",");
+    while (category_group_tokens.GetNext()) {
+      if (MatchPattern(category_group_tokens.token_piece(),
+                       sampling.category_pattern)) {
+        return &sampling;
+      }
+    }
+  }
+  return nullptr;
+}
+
 void TraceConfig::Merge(const TraceConfig& config) {
   if (record_mode_ != config.record_mode_
       || enable_systrace_ != config.enable_systrace_
@@ -333,6 +367,9 @@ void TraceConfig::Merge(const TraceConfig& config) {
 
   event_filters_.insert(event_filters_.end(), config.event_filters().begin(),
                         config.event_filters().end());
+  category_samplings_.insert(category_samplings_.end(),
+                             config.category_samplings().begin(),
+                             config.category_samplings().end());
 }
 
 void TraceConfig::Clear() {
@@ -343,6 +380,7 @@ void TraceConfig::Clear() {
   memory_dump_config_.Clear();
   process_filter_config_.Clear();
   event_filters_.clear();
+  category_samplings_.clear();
 }
 
 void TraceConfig::InitializeDefault() {
@@ -378,6 +416,10 @@ void TraceConfig::InitializeFromConfigDict(const DictionaryValue& dict) {
   if (dict.GetList(kEventFiltersParam, &category_event_filters))
     SetEventFiltersFromConfigList(*category_event_filters);
 
+  const base::ListValue* category_samplings = nullptr;
+  if (dict.GetList(kCategorySamplingParam, &category_samplings))
+    SetCategorySamplingsFromConfigList(*category_samplings);
+
   if (category_filter_.IsCategoryEnabled(MemoryDumpManager::kTraceCategory)) {
     // If dump triggers not set, the client is using the legacy with just
     // category enabled. So, use the default periodic dump config.
@@ -529,6 +571,36 @@ void TraceConfig::SetEventFiltersFromConfigList(
   }
 }
 
+void TraceConfig::SetCategorySamplingsFromConfigList(
+    const base::ListValue& category_samplings) {
+  category_samplings_.clear();
+
+  for (const Value& value : category_samplings.GetList()) {
+    const DictionaryValue* sampling_dict = nullptr;
+    if (!value.GetAsDictionary(&sampling_dict))
+      continue;
+
+    CategorySampling sampling;
+    if (!sampling_dict->GetString(kSamplingCategoryParam,
+                                  &sampling.category_pattern)) {
+      continue;
+    }
+    int interval = 1;
+    if (sampling_dict->GetInteger(kSampleIntervalParam, &interval) &&
+        interval > 1) {
+      sampling.sample_interval = static_cast<uint32_t>(interval);
+    }
+    int max_events_per_second = 0;
+    if (sampling_dict->GetInteger(kMaxEventsPerSecondParam,
+                                  &max_events_per_second) &&
+        max_events_per_second > 0) {
+      sampling.max_events_per_second =
+          static_cast<uint32_t>(max_events_per_second);
+    }
+    category_samplings_.push_back(sampling);
+  }
+}
+
 std::unique_ptr<DictionaryValue> TraceConfig::ToDict() const {
   auto dict = std::make_unique<DictionaryValue>();
   dict->SetString(kRecordModeParam,
@@ -550,6 +622,22 @@ std::unique_ptr<DictionaryValue> TraceConfig::ToDict() const {
     dict->Set(kEventFiltersParam, std::move(filter_list));
   }
 
+  if (!category_samplings_.empty()) {
+    auto sampling_list = std::make_unique<ListValue>();
+    for (const CategorySampling& sampling : category_samplings_) {
+      auto sampling_dict = std::make_unique<DictionaryValue>();
+      sampling_dict->SetString(kSamplingCategoryParam,
+                               sampling.category_pattern);
+      sampling_dict->SetInteger(kSampleIntervalParam,
+                                static_cast<int>(sampling.sample_interval));
+      sampling_dict->SetInteger(
+          kMaxEventsPerSecondParam,
+          static_cast<int>(sampling.max_events_per_second));
+      sampling_list->Append(std::move(sampling_dict));
+    }
+    dict->Set(kCategorySamplingParam, std::move(sampling_list));
+  }
+
   if (category_filter_.IsCategoryEnabled(MemoryDumpManager::kTraceCategory)) {
     auto allowed_modes = std::make_unique<ListValue>();
     for (auto dump_mode : memory_dump_config_.allowed_dump_modes)
@@ -139,13 +139,36 @@ class BASE_EXPORT TraceConfig {
       return category_filter_;
     }
 
+    // Whether the events of recorded categories are filtered when the trace
+    // is flushed rather than when they are added, if the filter supports it.
+    // See TraceEventFilter::CreateBatchPredicate(). Set by "filter_at_flush".
+    bool filter_at_flush() const { return filter_at_flush_; }
+    void set_filter_at_flush(bool filter_at_flush) {
+      filter_at_flush_ = filter_at_flush;
+    }
+
    private:
     std::string predicate_name_;
     TraceConfigCategoryFilter category_filter_;
     std::unique_ptr<base::DictionaryValue> args_;
+    bool filter_at_flush_ = false;
   };
   typedef std::vector<EventFilterConfig> EventFilters;
 
+  // Records only some of the events of the categories matching
+  // |category_pattern|, so that a busy category can be traced at a low cost.
+  // Only the complete, instant and counter events are sampled, see
+  // TraceCategory::ENABLED_FOR_SAMPLING.
+  struct CategorySampling {
+    // A category name, possibly with wildcards.
+    std::string category_pattern;
+    // Records 1 of every |sample_interval| events.
+    uint32_t sample_interval = 1;
+    // Records at most this many of the sampled events every second, if not 0.
+    uint32_t max_events_per_second = 0;
+  };
+  typedef std::vector<CategorySampling> CategorySamplings;
+
   static std::string TraceRecordModeToStr(TraceRecordMode record_mode);
 
   TraceConfig();
@@ -201,6 +224,13 @@ class BASE_EXPORT TraceConfig {
   //                             "inc_pattern*",
   //                             "disabled-by-default-memory-infra"],
   //     "excluded_categories": ["excluded", "exc_pattern*"],
+  //     "category_sampling": [
+  //       {
+  //         "category": "inc_pattern*",
+  //         "sample_interval": 100,
+  //         "max_events_per_second": 1000
+  //       }
+  //     ],
   //     "memory_dump_config": {
   //       "triggers": [
   //         {
@@ -274,6 +304,18 @@ class BASE_EXPORT TraceConfig {
     event_filters_ = filter_configs;
   }
 
+  const CategorySamplings& category_samplings() const {
+    return category_samplings_;
+  }
+  void SetCategorySamplings(const CategorySamplings& category_samplings) {
+    category_samplings_ = category_samplings;
+  }
+
+  // Returns the sampling of the first entry matching a category of
+  // |category_group_name|, or null if its events are not sampled.
+  const CategorySampling* GetCategorySampling(
+      const StringPiece& category_group_name) const;
+
  private:
   FRIEND_TEST_ALL_PREFIXES(TraceConfigTest, TraceConfigFromValidLegacyFormat);
   FRIEND_TEST_ALL_PREFIXES(TraceConfigTest,
@@ -299,6 +341,8 @@ class BASE_EXPORT TraceConfig {
   void SetDefaultMemoryDumpConfig();
 
   void SetEventFiltersFromConfigList(const base::ListValue& event_filters);
+  void SetCategorySamplingsFromConfigList(
+      const base::ListValue& category_samplings);
   std::unique_ptr<DictionaryValue> ToDict() const;
 
   std::string ToTraceOptionsString() const;
@@ -313,6 +357,7 @@ class BASE_EXPORT TraceConfig {
   ProcessFilterConfig process_filter_config_;
 
   EventFilters event_filters_;
+  CategorySamplings category_samplings_;
 };
 
 }  // namespace trace_event
@@ -424,6 +424,7 @@ TEST(TraceConfigTest, TraceConfigFromValidString) {
   base::JSONWriter::Write(*event_filter.filter_args(), &json_out);
   EXPECT_STREQ(json_out.c_str(),
                "{\"event_name_whitelist\":[\"a snake\",\"a dog\"]}");
+  EXPECT_FALSE(event_filter.filter_at_flush());
   std::unordered_set<std::string> filter_values;
   EXPECT_TRUE(event_filter.GetArgAsSet("event_name_whitelist", &filter_values));
   EXPECT_EQ(2u, filter_values.size());
@@ -539,6 +540,30 @@ TEST(TraceConfigTest, MergingTraceConfigs) {
                tc.ToString().c_str());
 }
 
+TEST(TraceConfigTest, EventFilterAtFlush) {
+  const char config_string[] =
+      "{"
+      "\"enable_argument_filter\":false,"
+      "\"enable_systrace\":false,"
+      "\"event_filters\":["
+      "{"
+      "\"filter_args\":{\"event_name_whitelist\":[\"a snake\"]},"
+      "\"filter_at_flush\":true,"
+      "\"filter_predicate\":\"event_whitelist_predicate\","
+      "\"included_categories\":[\"*\"]"
+      "}"
+      "],"
+      "\"record_mode\":\"record-until-full\""
+      "}";
+  TraceConfig tc(config_string);
+  ASSERT_EQ(1u, tc.event_filters().size());
+  EXPECT_TRUE(tc.event_filters()[0].filter_at_flush());
+  EXPECT_STREQ(config_string, tc.ToString().c_str());
+
+  TraceConfig tc_copy(tc);
+  EXPECT_TRUE(tc_copy.event_filters()[0].filter_at_flush());
+}
+
 TEST(TraceConfigTest, IsCategoryGroupEnabled) {
   // Enabling a disabled- category does not require all categories to be traced
   // to be included.
@@ -565,6 +590,43 @@ TEST(TraceConfigTest, IsCategoryGroupEnabled) {
   EXPECT_FALSE(tc.IsCategoryGroupEnabled("excluded,disabled-by-default-cc"));
 }
 
+TEST(TraceConfigTest, CategorySampling) {
+  TraceConfig tc(
+      "{"
+        "\"category_sampling\":["
+          "{\"category\":\"sampled\",\"sample_interval\":10},"
+          "{\"category\":\"limited_*\",\"max_events_per_second\":100},"
+          "{\"category\":\"ignored\",\"sample_interval\":1}"
+        "],"
+        "\"included_categories\":[\"*\"]"
+      "}");
+  ASSERT_EQ(3u, tc.category_samplings().size());
+
+  const TraceConfig::CategorySampling* sampling =
+      tc.GetCategorySampling("other,sampled");
+  ASSERT_TRUE(sampling);
+  EXPECT_EQ("sampled", sampling->category_pattern);
+  EXPECT_EQ(10u, sampling->sample_interval);
+  EXPECT_EQ(0u, sampling->max_events_per_second);
+
+  sampling = tc.GetCategorySampling("limited_cat");
+  ASSERT_TRUE(sampling);
+  EXPECT_EQ(1u, sampling->sample_interval);
+  EXPECT_EQ(100u, sampling->max_events_per_second);
+
+  // An entry which doesn't leave out events isn't used.
+  EXPECT_FALSE(tc.GetCategorySampling("ignored"));
+  EXPECT_FALSE(tc.GetCategorySampling("other"));
+
+  TraceConfig copy(tc.ToString());
+  ASSERT_EQ(3u, copy.category_samplings().size());
+  EXPECT_EQ(tc.ToString(), copy.ToString());
+  copy.Merge(TraceConfig());
+  EXPECT_EQ(3u, copy.category_samplings().size());
+  copy.Clear();
+  EXPECT_TRUE(copy.category_samplings().empty());
+}
+
 TEST(TraceConfigTest, IsCategoryNameAllowed) {
   // Test that IsCategoryNameAllowed actually catches categories that are
   // explicitly forbidden. This method is called in a DCHECK to assert that we
@@ -121,6 +121,16 @@ class TraceLog {
             base::trace_event::TraceCategory::ENABLED_FOR_ETW_EXPORT | \
             base::trace_event::TraceCategory::ENABLED_FOR_FILTERING))
 
+// Like INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED(), but also leaves out the
+// events of a sampled category which aren't sampled. Their only cost is one
+// more test of the category state until the category is sampled.
+#define INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED_AND_SAMPLED(phase)     \
+  (INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED() &&                        \
+   (LIKELY(!(*INTERNAL_TRACE_EVENT_UID(category_group_enabled) &           \
+             base::trace_event::TraceCategory::ENABLED_FOR_SAMPLING)) ||   \
+    trace_event_internal::ShouldAddSampledEvent(                           \
+        phase, INTERNAL_TRACE_EVENT_UID(category_group_enabled))))
+
 ////////////////////////////////////////////////////////////////////////////////
 // Implementation specific tracing API definitions.
 
@@ -309,7 +319,7 @@ class TraceLog {
 #define INTERNAL_TRACE_EVENT_ADD(phase, category_group, name, flags, ...)  \
   do {                                                                     \
     INTERNAL_TRACE_EVENT_GET_CATEGORY_INFO(category_group);                \
-    if (INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED()) {                   \
+    if (INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED_AND_SAMPLED(phase)) {  \
       trace_event_internal::AddTraceEvent(                                 \
           phase, INTERNAL_TRACE_EVENT_UID(category_group_enabled), name,   \
           trace_event_internal::kGlobalScope, trace_event_internal::kNoId, \
@@ -323,7 +333,8 @@ class TraceLog {
 #define INTERNAL_TRACE_EVENT_ADD_SCOPED(category_group, name, ...)           \
   INTERNAL_TRACE_EVENT_GET_CATEGORY_INFO(category_group);                    \
   trace_event_internal::ScopedTracer INTERNAL_TRACE_EVENT_UID(tracer);       \
-  if (INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED()) {                       \
+  if (INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED_AND_SAMPLED(               \
+          TRACE_EVENT_PHASE_COMPLETE)) {                                     \
     base::trace_event::TraceEventHandle h =                                  \
         trace_event_internal::AddTraceEvent(                                 \
             TRACE_EVENT_PHASE_COMPLETE,                                      \
@@ -376,7 +387,7 @@ class TraceLog {
                                                 timestamp, flags, ...)       \
   do {                                                                       \
     INTERNAL_TRACE_EVENT_GET_CATEGORY_INFO(category_group);                  \
-    if (INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED()) {                     \
+    if (INTERNAL_TRACE_EVENT_CATEGORY_GROUP_ENABLED_AND_SAMPLED(phase)) {    \
       trace_event_internal::AddTraceEventWithThreadIdAndTimestamp(           \
           phase, INTERNAL_TRACE_EVENT_UID(category_group_enabled), name,     \
           trace_event_internal::kGlobalScope, trace_event_internal::kNoId,   \
@@ -520,6 +531,23 @@ const int kZeroNumArgs = 0;
 const std::nullptr_t kGlobalScope = nullptr;
 const unsigned long long kNoId = 0;
 
+// Counts an event of a category with ENABLED_FOR_SAMPLING and returns whether
+// it is sampled.
+BASE_EXPORT bool SampleEvent(const unsigned char* category_group_enabled);
+
+// Returns whether an event of a category with ENABLED_FOR_SAMPLING is added.
+// The events which are paired with other events, e.g. begin and end events,
+// are all added so that the trace stays consistent.
+inline bool ShouldAddSampledEvent(char phase,
+                                  const unsigned char* category_group_enabled) {
+  if (phase != TRACE_EVENT_PHASE_COMPLETE &&
+      phase != TRACE_EVENT_PHASE_INSTANT &&
+      phase != TRACE_EVENT_PHASE_COUNTER) {
+    return true;
+  }
+  return SampleEvent(category_group_enabled);
+}
+
 // TraceID encapsulates an ID that can either be an integer or pointer. Pointers
 // are by default mangled with the Process ID so that they are unlikely to
 // collide when the same pointer is used on different processes.
@@ -47,7 +47,6 @@ void WriteEvent(
     const char** arg_names,
     const unsigned char* arg_types,
     const TraceEvent::TraceValue* arg_values,
-    const std::unique_ptr<ConvertableToTraceFormat>* convertable_values,
     unsigned int flags) {
   std::string out = StringPrintf("%c|%d|%s", phase, getpid(), name);
   if (flags & TRACE_EVENT_FLAG_HAS_ID)
@@ -62,7 +61,7 @@ void WriteEvent(
     out += '=';
     std::string::size_type value_start = out.length();
     if (arg_types[i] == TRACE_VALUE_TYPE_CONVERTABLE)
-      convertable_values[i]->AppendAsTraceFormat(&out);
+      arg_values[i].as_convertable->AppendAsTraceFormat(&out);
     else
       TraceEvent::AppendValueAsJSON(arg_types[i], arg_values[i], &out);
 
@@ -148,30 +147,26 @@ void TraceEvent::SendToATrace() {
   switch (phase_) {
     case TRACE_EVENT_PHASE_BEGIN:
       WriteEvent('B', category_group, name_, id_,
-                 arg_names_, arg_types_, arg_values_, convertable_values_,
-                 flags_);
+                 arg_names_, arg_types_, arg_values_, flags_);
       break;
 
     case TRACE_EVENT_PHASE_COMPLETE:
       WriteEvent(duration_.ToInternalValue() == -1 ? 'B' : 'E',
                  category_group, name_, id_,
-                 arg_names_, arg_types_, arg_values_, convertable_values_,
-                 flags_);
+                 arg_names_, arg_types_, arg_values_, flags_);
       break;
 
     case TRACE_EVENT_PHASE_END:
       // Though a single 'E' is enough, here append pid, name and
       // category_group etc. So that unpaired events can be found easily.
       WriteEvent('E', category_group, name_, id_,
-                 arg_names_, arg_types_, arg_values_, convertable_values_,
-                 flags_);
+                 arg_names_, arg_types_, arg_values_, flags_);
       break;
 
     case TRACE_EVENT_PHASE_INSTANT:
       // Simulate an instance event with a pair of begin/end events.
       WriteEvent('B', category_group, name_, id_,
-                 arg_names_, arg_types_, arg_values_, convertable_values_,
-                 flags_);
+                 arg_names_, arg_types_, arg_values_, flags_);
       WriteToATrace(g_atrace_fd, "E", 1);
       break;
 
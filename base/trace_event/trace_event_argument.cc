@@ -4,14 +4,15 @@
 
 #include "base/trace_event/trace_event_argument.h"
 
-#include <stdint.h>
+#include <string.h>
 
+#include <algorithm>
 #include <utility>
 
-#include "base/bits.h"
-#include "base/containers/circular_deque.h"
 #include "base/json/string_escape.h"
+#include "base/logging.h"
 #include "base/memory/ptr_util.h"
+#include "base/strings/string_number_conversions.h"
 #include "base/trace_event/trace_event.h"
 #include "base/trace_event/trace_event_impl.h"
 #include "base/trace_event/trace_event_memory_overhead.h"
@@ -25,11 +26,40 @@ const char kTypeStartDict = '{';
 const char kTypeEndDict = '}';
 const char kTypeStartArray = '[';
 const char kTypeEndArray = ']';
-const char kTypeBool = 'b';
+const char kTypeTrue = 't';
+const char kTypeFalse = 'f';
 const char kTypeInt = 'i';
 const char kTypeDouble = 'd';
 const char kTypeString = 's';
-const char kTypeCStr = '*';  // only used for key names
+
+// A dictionary is ended by this in place of the key of a value. The key of an
+// interned name is twice its index, and that of a copied name is odd and
+// greater than this, so the end can't be mistaken for a key.
+constexpr uint64_t kEndDictKey = 1;
+
+// Keys are copied rather than interned past this many, which bounds the
+// search of the interned keys.
+constexpr size_t kMaxInternedKeys = 256;
+
+// Protobuf wire types and the field numbers of the TracedValue message, see
+// trace_event_binary_format.h.
+constexpr uint32_t kWireTypeVarint = 0;
+constexpr uint32_t kWireTypeFixed64 = 1;
+constexpr uint32_t kWireTypeLengthDelimited = 2;
+
+constexpr uint32_t kProtoEntry = 1;
+constexpr uint32_t kProtoEntryName = 1;
+constexpr uint32_t kProtoEntryBool = 2;
+constexpr uint32_t kProtoEntryInt = 3;
+constexpr uint32_t kProtoEntryDouble = 4;
+constexpr uint32_t kProtoEntryString = 5;
+constexpr uint32_t kProtoEntryDict = 6;
+constexpr uint32_t kProtoEntryArray = 7;
+
+// The size of a dictionary or array is only known once it ends, so it is
+// written as a varint padded to this many bytes, which protobuf decoders
+// accept, rather than buffering the container.
+constexpr size_t kPaddedSizeLength = 4;
 
 #ifndef NDEBUG
 const bool kStackTypeDict = false;
@@ -45,39 +75,180 @@ const bool kStackTypeArray = true;
 #define DEBUG_POP_CONTAINER() do {} while (0)
 #endif
 
-inline void WriteKeyNameAsRawPtr(Pickle& pickle, const char* ptr) {
-  pickle.WriteBytes(&kTypeCStr, 1);
-  pickle.WriteUInt64(static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)));
+void AppendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+size_t VarintLength(uint64_t value) {
+  size_t length = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++length;
+  }
+  return length;
+}
+
+uint64_t ZigZagEncode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+void AppendProtoTag(uint32_t field, uint32_t wire_type, std::string* out) {
+  AppendVarint((field << 3) | wire_type, out);
+}
+
+void AppendProtoBytes(uint32_t field, StringPiece value, std::string* out) {
+  AppendProtoTag(field, kWireTypeLengthDelimited, out);
+  AppendVarint(value.size(), out);
+  value.AppendToString(out);
+}
+
+size_t ProtoBytesLength(StringPiece value) {
+  // The field numbers of an Entry fit in a single byte tag.
+  return 1 + VarintLength(value.size()) + value.size();
 }
 
-inline void WriteKeyNameWithCopy(Pickle& pickle, base::StringPiece str) {
-  pickle.WriteBytes(&kTypeString, 1);
-  pickle.WriteString(str);
+// Begins a length-delimited field whose size is written by EndPaddedField().
+// Returns the offset of the size in |out|.
+size_t BeginPaddedField(uint32_t field, std::string* out) {
+  AppendProtoTag(field, kWireTypeLengthDelimited, out);
+  const size_t offset = out->size();
+  out->append(kPaddedSizeLength, '\0');
+  return offset;
 }
 
-std::string ReadKeyName(PickleIterator& pickle_iterator) {
-  const char* type = nullptr;
-  bool res = pickle_iterator.ReadBytes(&type, 1);
-  std::string key_name;
-  if (res && *type == kTypeCStr) {
-    uint64_t ptr_value = 0;
-    res = pickle_iterator.ReadUInt64(&ptr_value);
-    key_name = reinterpret_cast<const char*>(static_cast<uintptr_t>(ptr_value));
-  } else if (res && *type == kTypeString) {
-    res = pickle_iterator.ReadString(&key_name);
+void EndPaddedField(size_t offset, std::string* out) {
+  const size_t size = out->size() - offset - kPaddedSizeLength;
+  CHECK_LT(size, 1u << (7 * kPaddedSizeLength));
+  for (size_t i = 0; i < kPaddedSizeLength; ++i) {
+    const char more = i + 1 < kPaddedSizeLength ? 0x80 : 0;
+    (*out)[offset + i] = static_cast<char>(((size >> (7 * i)) & 0x7f) | more);
   }
-  DCHECK(res);
-  return key_name;
 }
+
 }  // namespace
 
+// Reads the values of a TracedValue in order, as views into its data.
+class TracedValue::Reader {
+ public:
+  struct Item {
+    // One of the kType* tags.
+    char type;
+    // Whether the value is in a dictionary, and so has a key.
+    bool has_key;
+    // The index of the key in |keys_|, or -1 if its name was copied.
+    int key_index;
+    StringPiece key;
+    int64_t int_value;
+    double double_value;
+    StringPiece string_value;
+  };
+
+  explicit Reader(const TracedValue& value)
+      : value_(value),
+        pos_(value.data_.data()),
+        end_(value.data_.data() + value.data_.size()),
+        in_dict_(1, true) {}
+
+  // Reads the next value, or the end of a dictionary or an array, into
+  // |*item|. Returns false once all the values were read.
+  bool Next(Item* item) {
+    if (pos_ == end_)
+      return false;
+    item->has_key = false;
+    if (in_dict_.back()) {
+      const uint64_t key = ReadVarint();
+      if (key == kEndDictKey) {
+        item->type = kTypeEndDict;
+        in_dict_.pop_back();
+        DCHECK(!in_dict_.empty());
+        return true;
+      }
+      item->has_key = true;
+      if (key & 1) {
+        item->key_index = -1;
+        item->key = ReadBytes((key >> 1) - 1);
+      } else {
+        item->key_index = static_cast<int>(key >> 1);
+        item->key = value_.keys_[item->key_index];
+      }
+    } else if (*pos_ == kTypeEndArray) {
+      item->type = *pos_++;
+      in_dict_.pop_back();
+      DCHECK(!in_dict_.empty());
+      return true;
+    }
+
+    item->type = *pos_++;
+    switch (item->type) {
+      case kTypeStartDict:
+        in_dict_.push_back(true);
+        break;
+      case kTypeStartArray:
+        in_dict_.push_back(false);
+        break;
+      case kTypeInt:
+        item->int_value = ZigZagDecode(ReadVarint());
+        break;
+      case kTypeDouble:
+        memcpy(&item->double_value, ReadBytes(sizeof(double)).data(),
+               sizeof(double));
+        break;
+      case kTypeString:
+        item->string_value = ReadBytes(ReadVarint());
+        break;
+      case kTypeTrue:
+      case kTypeFalse:
+        break;
+      default:
+        NOTREACHED();
+    }
+    return true;
+  }
+
+ private:
+  uint64_t ReadVarint() {
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      DCHECK_LT(pos_, end_);
+      const uint8_t byte = static_cast<uint8_t>(*pos_++);
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return value;
+    }
+  }
+
+  StringPiece ReadBytes(size_t size) {
+    DCHECK_LE(size, static_cast<size_t>(end_ - pos_));
+    StringPiece bytes(pos_, size);
+    pos_ += size;
+    return bytes;
+  }
+
+  const TracedValue& value_;
+  const char* pos_;
+  const char* const end_;
+  // Whether each open container, starting with the root, is a dictionary.
+  std::vector<bool> in_dict_;
+
+  DISALLOW_COPY_AND_ASSIGN(Reader);
+};
+
 TracedValue::TracedValue() : TracedValue(0) {
 }
 
 TracedValue::TracedValue(size_t capacity) {
   DEBUG_PUSH_CONTAINER(kStackTypeDict);
   if (capacity)
-    pickle_.Reserve(capacity);
+    data_.reserve(capacity);
 }
 
 TracedValue::~TracedValue() {
@@ -86,70 +257,137 @@ TracedValue::~TracedValue() {
   DCHECK_CONTAINER_STACK_DEPTH_EQ(0u);
 }
 
+void TracedValue::WriteKey(const char* name) {
+  // Fibonacci hashing of the pointer, whose low bits are often the same.
+  const uint64_t hash =
+      static_cast<uint64_t>(reinterpret_cast<uintptr_t>(name)) *
+      UINT64_C(0x9E3779B97F4A7C15);
+  uint32_t& cached_index = key_cache_[(hash >> 32) % kKeyCacheSize];
+
+  size_t index;
+  if (cached_index && keys_[cached_index - 1] == name) {
+    index = cached_index - 1;
+  } else {
+    index = std::find(keys_.begin(), keys_.end(), name) - keys_.begin();
+    if (index == keys_.size()) {
+      if (keys_.size() == kMaxInternedKeys) {
+        WriteCopiedKey(name);
+        return;
+      }
+      keys_.push_back(name);
+    }
+    cached_index = static_cast<uint32_t>(index + 1);
+  }
+  AppendVarint(static_cast<uint64_t>(index) << 1, &data_);
+}
+
+void TracedValue::WriteCopiedKey(base::StringPiece name) {
+  AppendVarint(((static_cast<uint64_t>(name.size()) + 1) << 1) | 1, &data_);
+  name.AppendToString(&data_);
+}
+
+void TracedValue::WriteInteger(int64_t value) {
+  data_.push_back(kTypeInt);
+  AppendVarint(ZigZagEncode(value), &data_);
+}
+
+void TracedValue::WriteDouble(double value) {
+  data_.push_back(kTypeDouble);
+  data_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void TracedValue::WriteString(base::StringPiece value) {
+  data_.push_back(kTypeString);
+  AppendVarint(value.size(), &data_);
+  value.AppendToString(&data_);
+}
+
+void TracedValue::WriteContents(const TracedValue& value) {
+  Reader reader(value);
+  Reader::Item item;
+  while (reader.Next(&item)) {
+    if (item.has_key) {
+      // The keys of |value| are interned again in this value.
+      if (item.key_index >= 0)
+        WriteKey(value.keys_[item.key_index]);
+      else
+        WriteCopiedKey(item.key);
+    }
+    switch (item.type) {
+      case kTypeInt:
+        WriteInteger(item.int_value);
+        break;
+      case kTypeDouble:
+        WriteDouble(item.double_value);
+        break;
+      case kTypeString:
+        WriteString(item.string_value);
+        break;
+      case kTypeEndDict:
+        AppendVarint(kEndDictKey, &data_);
+        break;
+      default:
+        data_.push_back(item.type);
+        break;
+    }
+  }
+}
+
 void TracedValue::SetInteger(const char* name, int value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeInt, 1);
-  pickle_.WriteInt(value);
-  WriteKeyNameAsRawPtr(pickle_, name);
+  WriteKey(name);
+  WriteInteger(value);
 }
 
 void TracedValue::SetIntegerWithCopiedName(base::StringPiece name, int value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeInt, 1);
-  pickle_.WriteInt(value);
-  WriteKeyNameWithCopy(pickle_, name);
+  WriteCopiedKey(name);
+  WriteInteger(value);
 }
 
 void TracedValue::SetDouble(const char* name, double value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeDouble, 1);
-  pickle_.WriteDouble(value);
-  WriteKeyNameAsRawPtr(pickle_, name);
+  WriteKey(name);
+  WriteDouble(value);
 }
 
 void TracedValue::SetDoubleWithCopiedName(base::StringPiece name,
                                           double value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeDouble, 1);
-  pickle_.WriteDouble(value);
-  WriteKeyNameWithCopy(pickle_, name);
+  WriteCopiedKey(name);
+  WriteDouble(value);
 }
 
 void TracedValue::SetBoolean(const char* name, bool value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeBool, 1);
-  pickle_.WriteBool(value);
-  WriteKeyNameAsRawPtr(pickle_, name);
+  WriteKey(name);
+  data_.push_back(value ? kTypeTrue : kTypeFalse);
 }
 
 void TracedValue::SetBooleanWithCopiedName(base::StringPiece name,
                                            bool value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeBool, 1);
-  pickle_.WriteBool(value);
-  WriteKeyNameWithCopy(pickle_, name);
+  WriteCopiedKey(name);
+  data_.push_back(value ? kTypeTrue : kTypeFalse);
 }
 
 void TracedValue::SetString(const char* name, base::StringPiece value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeString, 1);
-  pickle_.WriteString(value);
-  WriteKeyNameAsRawPtr(pickle_, name);
+  WriteKey(name);
+  WriteString(value);
 }
 
 void TracedValue::SetStringWithCopiedName(base::StringPiece name,
                                           base::StringPiece value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeString, 1);
-  pickle_.WriteString(value);
-  WriteKeyNameWithCopy(pickle_, name);
+  WriteCopiedKey(name);
+  WriteString(value);
 }
 
 void TracedValue::SetValue(const char* name, const TracedValue& value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   BeginDictionary(name);
-  pickle_.WriteBytes(value.pickle_.payload(),
-                     static_cast<int>(value.pickle_.payload_size()));
+  WriteContents(value);
   EndDictionary();
 }
 
@@ -157,85 +395,80 @@ void TracedValue::SetValueWithCopiedName(base::StringPiece name,
                                          const TracedValue& value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   BeginDictionaryWithCopiedName(name);
-  pickle_.WriteBytes(value.pickle_.payload(),
-                     static_cast<int>(value.pickle_.payload_size()));
+  WriteContents(value);
   EndDictionary();
 }
 
 void TracedValue::BeginDictionary(const char* name) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   DEBUG_PUSH_CONTAINER(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeStartDict, 1);
-  WriteKeyNameAsRawPtr(pickle_, name);
+  WriteKey(name);
+  data_.push_back(kTypeStartDict);
 }
 
 void TracedValue::BeginDictionaryWithCopiedName(base::StringPiece name) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   DEBUG_PUSH_CONTAINER(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeStartDict, 1);
-  WriteKeyNameWithCopy(pickle_, name);
+  WriteCopiedKey(name);
+  data_.push_back(kTypeStartDict);
 }
 
 void TracedValue::BeginArray(const char* name) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   DEBUG_PUSH_CONTAINER(kStackTypeArray);
-  pickle_.WriteBytes(&kTypeStartArray, 1);
-  WriteKeyNameAsRawPtr(pickle_, name);
+  WriteKey(name);
+  data_.push_back(kTypeStartArray);
 }
 
 void TracedValue::BeginArrayWithCopiedName(base::StringPiece name) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   DEBUG_PUSH_CONTAINER(kStackTypeArray);
-  pickle_.WriteBytes(&kTypeStartArray, 1);
-  WriteKeyNameWithCopy(pickle_, name);
+  WriteCopiedKey(name);
+  data_.push_back(kTypeStartArray);
 }
 
 void TracedValue::EndDictionary() {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   DEBUG_POP_CONTAINER();
-  pickle_.WriteBytes(&kTypeEndDict, 1);
+  AppendVarint(kEndDictKey, &data_);
 }
 
 void TracedValue::AppendInteger(int value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeArray);
-  pickle_.WriteBytes(&kTypeInt, 1);
-  pickle_.WriteInt(value);
+  WriteInteger(value);
 }
 
 void TracedValue::AppendDouble(double value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeArray);
-  pickle_.WriteBytes(&kTypeDouble, 1);
-  pickle_.WriteDouble(value);
+  WriteDouble(value);
 }
 
 void TracedValue::AppendBoolean(bool value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeArray);
-  pickle_.WriteBytes(&kTypeBool, 1);
-  pickle_.WriteBool(value);
+  data_.push_back(value ? kTypeTrue : kTypeFalse);
 }
 
 void TracedValue::AppendString(base::StringPiece value) {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeArray);
-  pickle_.WriteBytes(&kTypeString, 1);
-  pickle_.WriteString(value);
+  WriteString(value);
 }
 
 void TracedValue::BeginArray() {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeArray);
   DEBUG_PUSH_CONTAINER(kStackTypeArray);
-  pickle_.WriteBytes(&kTypeStartArray, 1);
+  data_.push_back(kTypeStartArray);
 }
 
 void TracedValue::BeginDictionary() {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeArray);
   DEBUG_PUSH_CONTAINER(kStackTypeDict);
-  pickle_.WriteBytes(&kTypeStartDict, 1);
+  data_.push_back(kTypeStartDict);
 }
 
 void TracedValue::EndArray() {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeArray);
   DEBUG_POP_CONTAINER();
-  pickle_.WriteBytes(&kTypeEndArray, 1);
+  data_.push_back(kTypeEndArray);
 }
 
 void TracedValue::SetValue(const char* name,
@@ -354,106 +587,52 @@ void TracedValue::AppendBaseValue(const base::Value& value) {
 
 std::unique_ptr<base::Value> TracedValue::ToBaseValue() const {
   base::Value root(base::Value::Type::DICTIONARY);
-  Value* cur_dict = &root;
-  Value* cur_list = nullptr;
-  std::vector<Value*> stack;
-  PickleIterator it(pickle_);
-  const char* type;
-
-  while (it.ReadBytes(&type, 1)) {
-    DCHECK((cur_dict && !cur_list) || (cur_list && !cur_dict));
-    switch (*type) {
-      case kTypeStartDict: {
-        base::Value new_dict(base::Value::Type::DICTIONARY);
-        if (cur_dict) {
-          stack.push_back(cur_dict);
-          cur_dict = cur_dict->SetKey(ReadKeyName(it), std::move(new_dict));
-        } else {
-          cur_list->GetList().push_back(std::move(new_dict));
-          // |new_dict| is invalidated at this point, so |cur_dict| needs to be
-          // reset.
-          cur_dict = &cur_list->GetList().back();
-          stack.push_back(cur_list);
-          cur_list = nullptr;
-        }
-      } break;
-
+  // The open containers. Appending to a list doesn't invalidate them, since
+  // the containers in the list were closed first.
+  std::vector<Value*> stack(1, &root);
+  Reader reader(*this);
+  Reader::Item item;
+
+  while (reader.Next(&item)) {
+    base::Value value;
+    switch (item.type) {
+      case kTypeEndDict:
       case kTypeEndArray:
-      case kTypeEndDict: {
-        if (stack.back()->is_dict()) {
-          cur_dict = stack.back();
-          cur_list = nullptr;
-        } else if (stack.back()->is_list()) {
-          cur_list = stack.back();
-          cur_dict = nullptr;
-        }
         stack.pop_back();
-      } break;
-
-      case kTypeStartArray: {
-        base::Value new_list(base::Value::Type::LIST);
-        if (cur_dict) {
-          stack.push_back(cur_dict);
-          cur_list = cur_dict->SetKey(ReadKeyName(it), std::move(new_list));
-          cur_dict = nullptr;
-        } else {
-          cur_list->GetList().push_back(std::move(new_list));
-          stack.push_back(cur_list);
-          // |cur_list| is invalidated at this point by the Append, so it needs
-          // to be reset.
-          cur_list = &cur_list->GetList().back();
-        }
-      } break;
-
-      case kTypeBool: {
-        bool value;
-        CHECK(it.ReadBool(&value));
-        base::Value new_bool(value);
-        if (cur_dict) {
-          cur_dict->SetKey(ReadKeyName(it), std::move(new_bool));
-        } else {
-          cur_list->GetList().push_back(std::move(new_bool));
-        }
-      } break;
-
-      case kTypeInt: {
-        int value;
-        CHECK(it.ReadInt(&value));
-        base::Value new_int(value);
-        if (cur_dict) {
-          cur_dict->SetKey(ReadKeyName(it), std::move(new_int));
-        } else {
-          cur_list->GetList().push_back(std::move(new_int));
-        }
-      } break;
-
-      case kTypeDouble: {
-        double value;
-        CHECK(it.ReadDouble(&value));
-        base::Value new_double(value);
-        if (cur_dict) {
-          cur_dict->SetKey(ReadKeyName(it), std::move(new_double));
-        } else {
-          cur_list->GetList().push_back(std::move(new_double));
-        }
-      } break;
-
-      case kTypeString: {
-        std::string value;
-        CHECK(it.ReadString(&value));
-        base::Value new_str(std::move(value));
-        if (cur_dict) {
-          cur_dict->SetKey(ReadKeyName(it), std::move(new_str));
-        } else {
-          cur_list->GetList().push_back(std::move(new_str));
-        }
-      } break;
+        continue;
+      case kTypeStartDict:
+        value = base::Value(base::Value::Type::DICTIONARY);
+        break;
+      case kTypeStartArray:
+        value = base::Value(base::Value::Type::LIST);
+        break;
+      case kTypeTrue:
+      case kTypeFalse:
+        value = base::Value(item.type == kTypeTrue);
+        break;
+      case kTypeInt:
+        value = base::Value(static_cast<int>(item.int_value));
+        break;
+      case kTypeDouble:
+        value = base::Value(item.double_value);
+        break;
+      case kTypeString:
+        value = base::Value(item.string_value);
+        break;
+    }
 
-      default:
-        NOTREACHED();
+    Value* container = stack.back();
+    Value* new_value;
+    if (item.has_key) {
+      new_value = container->SetKey(item.key, std::move(value));
+    } else {
+      container->GetList().push_back(std::move(value));
+      new_value = &container->GetList().back();
     }
+    if (item.type == kTypeStartDict || item.type == kTypeStartArray)
+      stack.push_back(new_value);
   }
-  DCHECK(stack.empty());
+  DCHECK_EQ(1u, stack.size());
   return base::Value::ToUniquePtrValue(std::move(root));
 }
 
@@ -461,115 +640,155 @@ void TracedValue::AppendAsTraceFormat(std::string* out) const {
   DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
   DCHECK_CONTAINER_STACK_DEPTH_EQ(1u);
 
-  struct State {
-    enum Type { kTypeDict, kTypeArray };
-    Type type;
-    bool needs_comma;
-  };
-
-  auto maybe_append_key_name = [](State current_state, PickleIterator* it,
-                                  std::string* out) {
-    if (current_state.type == State::kTypeDict) {
-      EscapeJSONString(ReadKeyName(*it), true, out);
-      out->append(":");
-    }
-  };
-
-  base::circular_deque<State> state_stack;
-
-  out->append("{");
-  state_stack.push_back({State::kTypeDict});
+  // Each interned key is only escaped once.
+  std::vector<std::string> escaped_keys(keys_.size());
+  for (size_t i = 0; i < keys_.size(); ++i) {
+    EscapeJSONString(keys_[i], true, &escaped_keys[i]);
+    escaped_keys[i].push_back(':');
+  }
 
-  PickleIterator it(pickle_);
-  for (const char* type; it.ReadBytes(&type, 1);) {
-    switch (*type) {
+  out->push_back('{');
+  bool needs_comma = false;
+  Reader reader(*this);
+  Reader::Item item;
+  while (reader.Next(&item)) {
+    switch (item.type) {
       case kTypeEndDict:
-        out->append("}");
-        state_stack.pop_back();
+        out->push_back('}');
+        needs_comma = true;
         continue;
-
       case kTypeEndArray:
-        out->append("]");
-        state_stack.pop_back();
+        out->push_back(']');
+        needs_comma = true;
         continue;
     }
 
-    // Use an index so it will stay valid across resizes.
-    size_t current_state_index = state_stack.size() - 1;
-    if (state_stack[current_state_index].needs_comma)
-      out->append(",");
+    if (needs_comma)
+      out->push_back(',');
+    needs_comma = true;
+    if (item.has_key && item.key_index >= 0) {
+      out->append(escaped_keys[item.key_index]);
+    } else if (item.has_key) {
+      EscapeJSONString(item.key, true, out);
+      out->push_back(':');
+    }
 
-    switch (*type) {
-      case kTypeStartDict: {
-        maybe_append_key_name(state_stack[current_state_index], &it, out);
-        out->append("{");
-        state_stack.push_back({State::kTypeDict});
+    switch (item.type) {
+      case kTypeStartDict:
+        out->push_back('{');
+        needs_comma = false;
         break;
-      }
-
-      case kTypeStartArray: {
-        maybe_append_key_name(state_stack[current_state_index], &it, out);
-        out->append("[");
-        state_stack.push_back({State::kTypeArray});
+      case kTypeStartArray:
+        out->push_back('[');
+        needs_comma = false;
         break;
-      }
-
-      case kTypeBool: {
-        TraceEvent::TraceValue json_value;
-        CHECK(it.ReadBool(&json_value.as_bool));
-        maybe_append_key_name(state_stack[current_state_index], &it, out);
-        TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_BOOL, json_value, out);
+      case kTypeTrue:
+        out->append("true");
         break;
-      }
-
-      case kTypeInt: {
-        int value;
-        CHECK(it.ReadInt(&value));
-        maybe_append_key_name(state_stack[current_state_index], &it, out);
-        TraceEvent::TraceValue json_value;
-        json_value.as_int = value;
-        TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_INT, json_value, out);
+      case kTypeFalse:
+        out->append("false");
+        break;
+      case kTypeInt:
+        out->append(NumberToString(item.int_value));
         break;
-      }
-
       case kTypeDouble: {
         TraceEvent::TraceValue json_value;
-        CHECK(it.ReadDouble(&json_value.as_double));
-        maybe_append_key_name(state_stack[current_state_index], &it, out);
+        json_value.as_double = item.double_value;
         TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_DOUBLE, json_value, out);
         break;
       }
-
-      case kTypeString: {
-        std::string value;
-        CHECK(it.ReadString(&value));
-        maybe_append_key_name(state_stack[current_state_index], &it, out);
-        TraceEvent::TraceValue json_value;
-        json_value.as_string = value.c_str();
-        TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_STRING, json_value, out);
+      case kTypeString:
+        EscapeJSONString(item.string_value, true, out);
         break;
-      }
-
-      default:
-        NOTREACHED();
     }
-
-    state_stack[current_state_index].needs_comma = true;
   }
+  out->push_back('}');
+}
 
-  out->append("}");
-  state_stack.pop_back();
+bool TracedValue::AppendAsProto(std::string* out) const {
+  DCHECK_CURRENT_CONTAINER_IS(kStackTypeDict);
+  DCHECK_CONTAINER_STACK_DEPTH_EQ(1u);
+
+  // The offsets of the padded sizes of the open containers and their entries.
+  std::vector<size_t> open_fields;
+  Reader reader(*this);
+  Reader::Item item;
+  while (reader.Next(&item)) {
+    if (item.type == kTypeEndDict || item.type == kTypeEndArray) {
+      EndPaddedField(open_fields.back(), out);
+      open_fields.pop_back();
+      EndPaddedField(open_fields.back(), out);
+      open_fields.pop_back();
+      continue;
+    }
 
-  DCHECK(state_stack.empty());
+    if (item.type == kTypeStartDict || item.type == kTypeStartArray) {
+      open_fields.push_back(BeginPaddedField(kProtoEntry, out));
+      if (item.has_key)
+        AppendProtoBytes(kProtoEntryName, item.key, out);
+      open_fields.push_back(BeginPaddedField(
+          item.type == kTypeStartDict ? kProtoEntryDict : kProtoEntryArray,
+          out));
+      continue;
+    }
+
+    // The size of other entries is known upfront.
+    size_t size = item.has_key ? ProtoBytesLength(item.key) : 0;
+    switch (item.type) {
+      case kTypeTrue:
+      case kTypeFalse:
+        size += 2;
+        break;
+      case kTypeInt:
+        size += 1 + VarintLength(ZigZagEncode(item.int_value));
+        break;
+      case kTypeDouble:
+        size += 1 + sizeof(double);
+        break;
+      case kTypeString:
+        size += ProtoBytesLength(item.string_value);
+        break;
+    }
+    AppendProtoTag(kProtoEntry, kWireTypeLengthDelimited, out);
+    AppendVarint(size, out);
+    if (item.has_key)
+      AppendProtoBytes(kProtoEntryName, item.key, out);
+    switch (item.type) {
+      case kTypeTrue:
+      case kTypeFalse:
+        AppendProtoTag(kProtoEntryBool, kWireTypeVarint, out);
+        out->push_back(item.type == kTypeTrue);
+        break;
+      case kTypeInt:
+        AppendProtoTag(kProtoEntryInt, kWireTypeVarint, out);
+        AppendVarint(ZigZagEncode(item.int_value), out);
+        break;
+      case kTypeDouble: {
+        uint64_t bits;
+        memcpy(&bits, &item.double_value, sizeof(bits));
+        AppendProtoTag(kProtoEntryDouble, kWireTypeFixed64, out);
+        for (int i = 0; i < 8; ++i)
+          out->push_back(static_cast<char>(bits >> (8 * i)));
+        break;
+      }
+      case kTypeString:
+        AppendProtoBytes(kProtoEntryString, item.string_value, out);
+        break;
+    }
+  }
+  DCHECK(open_fields.empty());
+  return true;
 }
 
 void TracedValue::EstimateTraceMemoryOverhead(
     TraceEventMemoryOverhead* overhead) {
   overhead->Add(TraceEventMemoryOverhead::kTracedValue,
                 /* allocated size */
-                pickle_.GetTotalAllocatedSize(),
+                sizeof(*this) + data_.capacity() +
+                    keys_.capacity() * sizeof(const char*),
                 /* resident size */
-                pickle_.size());
+                sizeof(*this) + data_.size() +
+                    keys_.size() * sizeof(const char*));
 }
 
 }  // namespace trace_event
@@ -6,13 +6,13 @@
 #define BASE_TRACE_EVENT_TRACE_EVENT_ARGUMENT_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #include <memory>
 #include <string>
 #include <vector>
 
 #include "base/macros.h"
-#include "base/pickle.h"
 #include "base/strings/string_piece.h"
 #include "base/trace_event/trace_event_impl.h"
 
@@ -22,6 +22,10 @@ class Value;
 
 namespace trace_event {
 
+// A structured trace argument. The values are recorded in a compact tagged
+// binary form, in which the "quoted" key names are interned, and converted to
+// JSON or to the protobuf of trace_event_binary_format.h in a single pass
+// when the trace is flushed.
 class BASE_EXPORT TracedValue : public ConvertableToTraceFormat {
  public:
   TracedValue();
@@ -60,6 +64,7 @@ class BASE_EXPORT TracedValue : public ConvertableToTraceFormat {
 
   // ConvertableToTraceFormat implementation.
   void AppendAsTraceFormat(std::string* out) const override;
+  bool AppendAsProto(std::string* out) const override;
 
   void EstimateTraceMemoryOverhead(TraceEventMemoryOverhead* overhead) override;
 
@@ -76,7 +81,28 @@ class BASE_EXPORT TracedValue : public ConvertableToTraceFormat {
   std::unique_ptr<base::Value> ToBaseValue() const;
 
  private:
-  Pickle pickle_;
+  class Reader;
+
+  // Number of slots of |key_cache_|.
+  static constexpr size_t kKeyCacheSize = 16;
+
+  void WriteKey(const char* name);
+  void WriteCopiedKey(base::StringPiece name);
+  void WriteInteger(int64_t value);
+  void WriteDouble(double value);
+  void WriteString(base::StringPiece value);
+  // Appends the contents of |value|, whose keys are interned separately.
+  void WriteContents(const TracedValue& value);
+
+  // The values, each one a type tag followed by its payload. In dictionaries
+  // the tag is preceded by the key: either the index of a pointer in |keys_|
+  // or a copied name. A dictionary ends with a key that is neither.
+  std::string data_;
+  // The interned key names.
+  std::vector<const char*> keys_;
+  // Indices + 1 of recently written keys in |keys_|, by the hash of their
+  // pointer, so that interning a key rarely needs to search |keys_|.
+  uint32_t key_cache_[kKeyCacheSize] = {};
 
 #ifndef NDEBUG
   // In debug builds checks the pairings of {Start,End}{Dictionary,Array}
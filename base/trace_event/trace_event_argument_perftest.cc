@@ -0,0 +1,87 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event_argument.h"
+
+#include <memory>
+#include <string>
+
+#include "base/time/time.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+constexpr int kNumValues = 10000;
+constexpr int kNumLayers = 50;
+
+// Records a TracedValue shaped like the per-frame state of a compositor.
+std::unique_ptr<TracedValue> RecordFrameState(int frame) {
+  auto value = std::make_unique<TracedValue>();
+  value->SetInteger("frame", frame);
+  value->SetString("source", "compositor");
+  value->BeginArray("layers");
+  for (int i = 0; i < kNumLayers; ++i) {
+    value->BeginDictionary();
+    value->SetInteger("layer_id", i);
+    value->SetBoolean("visible", i % 3 != 0);
+    value->SetDouble("opacity", i / static_cast<double>(kNumLayers));
+    value->SetString("name", "cc::PictureLayerImpl");
+    value->BeginArray("bounds");
+    value->AppendInteger(i * 10);
+    value->AppendInteger(i * 20);
+    value->EndArray();
+    value->EndDictionary();
+  }
+  value->EndArray();
+  return value;
+}
+
+void PrintUsPerValue(const std::string& trace, TimeTicks start) {
+  perf_test::PrintResult("traced_value", "", trace,
+                         (TimeTicks::Now() - start).InMicrosecondsF() /
+                             kNumValues,
+                         "us/value", true);
+}
+
+}  // namespace
+
+TEST(TracedValuePerfTest, Record) {
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumValues; ++i)
+    RecordFrameState(i);
+  PrintUsPerValue("record", start);
+}
+
+TEST(TracedValuePerfTest, AppendAsTraceFormat) {
+  std::unique_ptr<TracedValue> value = RecordFrameState(0);
+  std::string json;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumValues; ++i) {
+    json.clear();
+    value->AppendAsTraceFormat(&json);
+  }
+  PrintUsPerValue("append_as_trace_format", start);
+  perf_test::PrintResult("traced_value", "", "json_size", json.size(),
+                         "bytes", true);
+}
+
+TEST(TracedValuePerfTest, AppendAsProto) {
+  std::unique_ptr<TracedValue> value = RecordFrameState(0);
+  std::string proto;
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumValues; ++i) {
+    proto.clear();
+    value->AppendAsProto(&proto);
+  }
+  PrintUsPerValue("append_as_proto", start);
+  perf_test::PrintResult("traced_value", "", "proto_size", proto.size(),
+                         "bytes", true);
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -6,7 +6,9 @@
 
 #include <stddef.h>
 
+#include <string>
 #include <utility>
+#include <vector>
 
 #include "base/memory/ptr_util.h"
 #include "base/values.h"
@@ -161,5 +163,94 @@ TEST(TraceEventArgumentTest, PassTracedValue) {
   EXPECT_EQ("{\"b\":2,\"c\":[\"foo\"],\"f\":3,\"g\":{}}", json);
 }
 
+TEST(TraceEventArgumentTest, InternedAndCopiedNames) {
+  std::unique_ptr<TracedValue> value(new TracedValue());
+  // More keys than are interned.
+  std::vector<std::string> names;
+  for (int i = 0; i < 300; ++i)
+    names.push_back("key" + std::to_string(i));
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    value->BeginDictionary(repeat ? "second" : "first");
+    for (const std::string& name : names)
+      value->SetInteger(name.c_str(), repeat);
+    value->EndDictionary();
+  }
+  value->SetStringWithCopiedName(std::string("copied\"name"), "value");
+
+  std::unique_ptr<Value> base_value = value->ToBaseValue();
+  ASSERT_TRUE(base_value);
+  for (int repeat = 0; repeat < 2; ++repeat) {
+    const Value* dict = base_value->FindKey(repeat ? "second" : "first");
+    ASSERT_TRUE(dict);
+    EXPECT_EQ(names.size(), dict->DictSize());
+    for (const std::string& name : names) {
+      const Value* int_value = dict->FindKey(name);
+      ASSERT_TRUE(int_value);
+      EXPECT_EQ(repeat, int_value->GetInt());
+    }
+  }
+  const Value* copied = base_value->FindKey("copied\"name");
+  ASSERT_TRUE(copied);
+  EXPECT_EQ("value", copied->GetString());
+
+  std::string json;
+  value->AppendAsTraceFormat(&json);
+  EXPECT_NE(std::string::npos, json.find("\"key299\":1}"));
+  EXPECT_NE(std::string::npos, json.find("\"copied\\\"name\":\"value\""));
+}
+
+TEST(TraceEventArgumentTest, ToBaseValue) {
+  std::unique_ptr<TracedValue> value(new TracedValue());
+  value->SetInteger("int", -3);
+  value->SetDouble("double", 2.5);
+  value->BeginArray("array");
+  value->AppendBoolean(true);
+  value->BeginDictionary();
+  value->SetString("string", "foo");
+  value->EndDictionary();
+  value->BeginArray();
+  value->EndArray();
+  value->EndArray();
+
+  std::unique_ptr<Value> base_value = value->ToBaseValue();
+  ASSERT_TRUE(base_value);
+  EXPECT_EQ(-3, base_value->FindKey("int")->GetInt());
+  EXPECT_EQ(2.5, base_value->FindKey("double")->GetDouble());
+  const Value* array = base_value->FindKey("array");
+  ASSERT_TRUE(array);
+  ASSERT_EQ(3u, array->GetList().size());
+  EXPECT_TRUE(array->GetList()[0].GetBool());
+  EXPECT_EQ("foo", array->GetList()[1].FindKey("string")->GetString());
+  EXPECT_TRUE(array->GetList()[2].GetList().empty());
+}
+
+// The key of a copied name must not be mistaken for the end of a dictionary,
+// whatever its length.
+TEST(TraceEventArgumentTest, CopiedNamesOfAllLengths) {
+  for (size_t length = 0; length <= 200; ++length) {
+    const std::string name(length, 'k');
+    std::unique_ptr<TracedValue> value(new TracedValue());
+    value->BeginDictionaryWithCopiedName(name);
+    value->SetIntegerWithCopiedName(name, 1);
+    value->EndDictionary();
+    value->SetIntegerWithCopiedName(name + "!", 2);
+
+    std::string json;
+    value->AppendAsTraceFormat(&json);
+    EXPECT_EQ("{\"" + name + "\":{\"" + name + "\":1},\"" + name + "!\":2}",
+              json)
+        << length;
+
+    std::unique_ptr<Value> base_value = value->ToBaseValue();
+    ASSERT_TRUE(base_value) << length;
+    const Value* dict = base_value->FindKey(name);
+    ASSERT_TRUE(dict) << length;
+    ASSERT_TRUE(dict->FindKey(name)) << length;
+    EXPECT_EQ(1, dict->FindKey(name)->GetInt());
+    ASSERT_TRUE(base_value->FindKey(name + "!")) << length;
+    EXPECT_EQ(2, base_value->FindKey(name + "!")->GetInt());
+  }
+}
+
 }  // namespace trace_event
 }  // namespace base
@@ -0,0 +1,91 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event_batch_filter.h"
+
+#include <utility>
+
+#include "base/logging.h"
+#include "base/trace_event/trace_buffer.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+constexpr size_t kChunkSize = TraceBufferChunk::kTraceBufferChunkSize;
+}  // namespace
+
+TraceEventBatchFilter::TraceEventBatchFilter(Predicates predicates)
+    : predicates_(std::move(predicates)) {
+  DCHECK_LE(predicates_.size(), 32u);
+  for (size_t index = 0; index < predicates_.size(); ++index) {
+    if (predicates_[index])
+      batch_filters_ |= 1u << index;
+  }
+}
+
+TraceEventBatchFilter::~TraceEventBatchFilter() = default;
+
+void TraceEventBatchFilter::SetCategoryFilters(
+    const unsigned char* category_state,
+    uint32_t filters) {
+  DCHECK_EQ(0u, filters & ~batch_filters_);
+  AutoLock lock(lock_);
+  if (filters)
+    category_filters_[category_state] = filters;
+  else
+    category_filters_.erase(category_state);
+}
+
+void TraceEventBatchFilter::FilterChunk(const TraceBufferChunk& chunk,
+                                        bool* keep) const {
+  const size_t size = chunk.size();
+  // The filters of the category of each event, looked up once per chunk.
+  uint32_t event_filters[kChunkSize];
+  uint32_t chunk_filters = 0;
+  {
+    AutoLock lock(lock_);
+    const unsigned char* last_category = nullptr;
+    uint32_t last_filters = 0;
+    for (size_t i = 0; i < size; ++i) {
+      const unsigned char* category =
+          chunk.GetEventAt(i)->category_group_enabled();
+      if (category != last_category) {
+        auto it = category_filters_.find(category);
+        last_filters = it != category_filters_.end() ? it->second : 0;
+        last_category = category;
+      }
+      event_filters[i] = last_filters;
+      keep[i] = !last_filters;
+      chunk_filters |= last_filters;
+    }
+  }
+
+  // Each predicate is evaluated at most once per chunk, over the events it
+  // filters which weren't accepted by another filter yet.
+  const TraceEvent* events[kChunkSize];
+  size_t event_indices[kChunkSize];
+  bool accepted[kChunkSize];
+  for (size_t index = 0; chunk_filters; chunk_filters >>= 1, ++index) {
+    if (!(chunk_filters & 1))
+      continue;
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) {
+      if (!keep[i] && (event_filters[i] & (1u << index))) {
+        events[count] = chunk.GetEventAt(i);
+        event_indices[count] = i;
+        accepted[count] = false;
+        count++;
+      }
+    }
+    if (!count)
+      continue;
+    predicates_[index]->FilterTraceEvents(events, count, accepted);
+    for (size_t j = 0; j < count; ++j)
+      keep[event_indices[j]] = accepted[j];
+  }
+}
+
+}  // namespace trace_event
+}  // namespace base
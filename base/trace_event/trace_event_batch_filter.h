@@ -0,0 +1,74 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TRACE_EVENT_TRACE_EVENT_BATCH_FILTER_H_
+#define BASE_TRACE_EVENT_TRACE_EVENT_BATCH_FILTER_H_
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/trace_event/trace_event_filter.h"
+
+namespace base {
+namespace trace_event {
+
+class TraceBufferChunk;
+
+// Filters the buffered events of a tracing session with the
+// TraceEventFilter::BatchPredicates of the filters which filter at flush time,
+// when the trace is flushed or streamed. The events of the categories which
+// only have such filters are added to the trace buffer unfiltered, so that
+// adding them costs the same whatever the filters.
+//
+// Refcounted so that a flush on a worker thread or the trace stream writer can
+// keep using it once the next tracing session created new filters.
+class BASE_EXPORT TraceEventBatchFilter
+    : public RefCountedThreadSafe<TraceEventBatchFilter> {
+ public:
+  using Predicates =
+      std::vector<std::unique_ptr<TraceEventFilter::BatchPredicate>>;
+
+  // |predicates| are indexed like the filters of
+  // TraceCategory::enabled_filters(), and null for the filters which filter
+  // the events as they are added.
+  explicit TraceEventBatchFilter(Predicates predicates);
+
+  // The bitmap of the filters which have a predicate.
+  uint32_t batch_filters() const { return batch_filters_; }
+
+  // Sets the bitmap of the filters by which the events of the category with
+  // the state |category_state| are filtered. Can be called while chunks are
+  // filtered on other threads.
+  void SetCategoryFilters(const unsigned char* category_state,
+                          uint32_t filters);
+
+  // Sets |keep[i]| to whether the i-th event of |chunk| is kept, i.e. is in a
+  // category without batch filters or is accepted by at least one of them.
+  void FilterChunk(const TraceBufferChunk& chunk, bool* keep) const;
+
+ private:
+  friend class RefCountedThreadSafe<TraceEventBatchFilter>;
+  ~TraceEventBatchFilter();
+
+  const Predicates predicates_;
+  uint32_t batch_filters_ = 0;
+
+  mutable Lock lock_;
+  // Only has the categories with batch filters.
+  std::unordered_map<const unsigned char*, uint32_t> category_filters_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceEventBatchFilter);
+};
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_TRACE_EVENT_BATCH_FILTER_H_
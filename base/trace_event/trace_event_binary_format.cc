@@ -0,0 +1,746 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event_binary_format.h"
+
+#include <string.h>
+
+#include <vector>
+
+#include "base/format_macros.h"
+#include "base/json/string_escape.h"
+#include "base/logging.h"
+#include "base/process/process_handle.h"
+#include "base/strings/stringprintf.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_log.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+// Protobuf wire types.
+enum WireType : uint32_t {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+// Field numbers, see the schema in the header.
+constexpr uint32_t kTracePacket = 1;
+
+constexpr uint32_t kPacketInternedString = 1;
+constexpr uint32_t kPacketEvent = 2;
+
+constexpr uint32_t kInternedStringId = 1;
+constexpr uint32_t kInternedStringValue = 2;
+
+constexpr uint32_t kEventPid = 1;
+constexpr uint32_t kEventTid = 2;
+constexpr uint32_t kEventTimestampDelta = 3;
+constexpr uint32_t kEventPhase = 4;
+constexpr uint32_t kEventCategoryId = 5;
+constexpr uint32_t kEventNameId = 6;
+constexpr uint32_t kEventFlags = 7;
+constexpr uint32_t kEventArg = 8;
+constexpr uint32_t kEventArgsStripped = 9;
+constexpr uint32_t kEventDuration = 10;
+constexpr uint32_t kEventThreadTimestamp = 11;
+constexpr uint32_t kEventThreadDuration = 12;
+constexpr uint32_t kEventScopeId = 13;
+constexpr uint32_t kEventId = 14;
+constexpr uint32_t kEventBindId = 15;
+
+constexpr uint32_t kArgNameId = 1;
+constexpr uint32_t kArgBoolValue = 2;
+constexpr uint32_t kArgUintValue = 3;
+constexpr uint32_t kArgIntValue = 4;
+constexpr uint32_t kArgDoubleValue = 5;
+constexpr uint32_t kArgPointerValue = 6;
+constexpr uint32_t kArgStringValue = 7;
+constexpr uint32_t kArgJsonValue = 8;
+constexpr uint32_t kArgStripped = 9;
+constexpr uint32_t kArgTracedValue = 10;
+
+constexpr uint32_t kTracedValueEntry = 1;
+
+constexpr uint32_t kTracedValueEntryName = 1;
+constexpr uint32_t kTracedValueEntryBool = 2;
+constexpr uint32_t kTracedValueEntryInt = 3;
+constexpr uint32_t kTracedValueEntryDouble = 4;
+constexpr uint32_t kTracedValueEntryString = 5;
+constexpr uint32_t kTracedValueEntryDict = 6;
+constexpr uint32_t kTracedValueEntryArray = 7;
+
+constexpr unsigned int kIdFlags = TRACE_EVENT_FLAG_HAS_ID |
+                                  TRACE_EVENT_FLAG_HAS_LOCAL_ID |
+                                  TRACE_EVENT_FLAG_HAS_GLOBAL_ID;
+constexpr unsigned int kFlowFlags =
+    TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT;
+
+void AppendVarint(uint64_t value, std::string* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+size_t VarintLength(uint64_t value) {
+  size_t length = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    ++length;
+  }
+  return length;
+}
+
+void AppendTag(uint32_t field, WireType wire_type, std::string* out) {
+  AppendVarint((field << 3) | wire_type, out);
+}
+
+void AppendVarintField(uint32_t field, uint64_t value, std::string* out) {
+  AppendTag(field, kVarint, out);
+  AppendVarint(value, out);
+}
+
+// Zigzag-encodes |value| so that small negative values stay short.
+void AppendSignedField(uint32_t field, int64_t value, std::string* out) {
+  AppendVarintField(field,
+                    (static_cast<uint64_t>(value) << 1) ^
+                        static_cast<uint64_t>(value >> 63),
+                    out);
+}
+
+void AppendDoubleField(uint32_t field, double value, std::string* out) {
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  AppendTag(field, kFixed64, out);
+  for (int i = 0; i < 8; ++i)
+    out->push_back(static_cast<char>(bits >> (8 * i)));
+}
+
+void AppendBytesField(uint32_t field, StringPiece value, std::string* out) {
+  AppendTag(field, kLengthDelimited, out);
+  AppendVarint(value.size(), out);
+  value.AppendToString(out);
+}
+
+// Appends |message| as a TracePacket of type |packet_field|.
+void AppendPacket(uint32_t packet_field,
+                  StringPiece message,
+                  std::string* out) {
+  AppendTag(kTracePacket, kLengthDelimited, out);
+  // The tag of the packet's only field is a single byte.
+  AppendVarint(1 + VarintLength(message.size()) + message.size(), out);
+  AppendBytesField(packet_field, message, out);
+}
+
+}  // namespace
+
+TraceEventBinaryWriter::TraceEventBinaryWriter(
+    const ArgumentFilterPredicate& argument_filter_predicate)
+    : argument_filter_predicate_(argument_filter_predicate) {}
+
+TraceEventBinaryWriter::~TraceEventBinaryWriter() = default;
+
+void TraceEventBinaryWriter::AppendEvent(const TraceEvent& event,
+                                         std::string* out) {
+  int process_id;
+  int thread_id;
+  if ((event.flags() & TRACE_EVENT_FLAG_HAS_PROCESS_ID) &&
+      event.thread_id() != kNullProcessId) {
+    // |thread_id_| shares its storage with |process_id_|.
+    process_id = event.thread_id();
+    thread_id = -1;
+  } else {
+    process_id = TraceLog::GetInstance()->process_id();
+    thread_id = event.thread_id();
+  }
+  const char* category_group_name =
+      TraceLog::GetCategoryGroupName(event.category_group_enabled());
+
+  // Intern the strings first, as their packets have to precede the event.
+  const uint32_t category_id = InternString(category_group_name, out);
+  const uint32_t name_id = InternString(event.name(), out);
+
+  event_.clear();
+  AppendSignedField(kEventPid, process_id, &event_);
+  AppendSignedField(kEventTid, thread_id, &event_);
+  const int64_t timestamp = event.timestamp().ToInternalValue();
+  AppendSignedField(kEventTimestampDelta, timestamp - last_timestamp_,
+                    &event_);
+  last_timestamp_ = timestamp;
+  AppendVarintField(kEventPhase, static_cast<unsigned char>(event.phase()),
+                    &event_);
+  AppendVarintField(kEventCategoryId, category_id, &event_);
+  AppendVarintField(kEventNameId, name_id, &event_);
+  if (event.flags())
+    AppendVarintField(kEventFlags, event.flags(), &event_);
+
+  ArgumentNameFilterPredicate argument_name_filter_predicate;
+  const bool strip_args =
+      event.arg_name(0) && !argument_filter_predicate_.is_null() &&
+      !argument_filter_predicate_.Run(category_group_name, event.name(),
+                                      &argument_name_filter_predicate);
+  if (strip_args) {
+    AppendVarintField(kEventArgsStripped, 1, &event_);
+  } else {
+    for (size_t i = 0; i < kTraceMaxNumArgs && event.arg_name(i); ++i) {
+      arg_.clear();
+      AppendVarintField(kArgNameId, InternString(event.arg_name(i), out),
+                        &arg_);
+      const TraceEvent::TraceValue& value = event.arg_value(i);
+      if (!argument_name_filter_predicate.is_null() &&
+          !argument_name_filter_predicate.Run(event.arg_name(i))) {
+        AppendVarintField(kArgStripped, 1, &arg_);
+      } else {
+        switch (event.arg_type(i)) {
+          case TRACE_VALUE_TYPE_BOOL:
+            AppendVarintField(kArgBoolValue, value.as_bool, &arg_);
+            break;
+          case TRACE_VALUE_TYPE_UINT:
+            AppendVarintField(kArgUintValue, value.as_uint, &arg_);
+            break;
+          case TRACE_VALUE_TYPE_INT:
+            AppendSignedField(kArgIntValue, value.as_int, &arg_);
+            break;
+          case TRACE_VALUE_TYPE_DOUBLE:
+            AppendDoubleField(kArgDoubleValue, value.as_double, &arg_);
+            break;
+          case TRACE_VALUE_TYPE_POINTER:
+            AppendVarintField(kArgPointerValue,
+                              reinterpret_cast<uintptr_t>(value.as_pointer),
+                              &arg_);
+            break;
+          case TRACE_VALUE_TYPE_STRING:
+          case TRACE_VALUE_TYPE_COPY_STRING:
+            AppendBytesField(kArgStringValue,
+                             value.as_string ? value.as_string : "NULL",
+                             &arg_);
+            break;
+          case TRACE_VALUE_TYPE_CONVERTABLE:
+            value_.clear();
+            if (event.arg_convertible_value(i)->AppendAsProto(&value_)) {
+              AppendBytesField(kArgTracedValue, value_, &arg_);
+            } else {
+              event.arg_convertible_value(i)->AppendAsTraceFormat(&value_);
+              AppendBytesField(kArgJsonValue, value_, &arg_);
+            }
+            break;
+          default:
+            NOTREACHED() << "Don't know how to write this value";
+            break;
+        }
+      }
+      AppendBytesField(kEventArg, arg_, &event_);
+    }
+  }
+
+  if (event.phase() == TRACE_EVENT_PHASE_COMPLETE) {
+    const int64_t duration = event.duration().ToInternalValue();
+    if (duration != -1)
+      AppendVarintField(kEventDuration, duration, &event_);
+    const int64_t thread_duration = event.thread_duration().ToInternalValue();
+    if (!event.thread_timestamp().is_null() && thread_duration != -1)
+      AppendVarintField(kEventThreadDuration, thread_duration, &event_);
+  }
+  if (!event.thread_timestamp().is_null()) {
+    AppendVarintField(kEventThreadTimestamp,
+                      event.thread_timestamp().ToInternalValue(), &event_);
+  }
+  if (event.flags() & kIdFlags) {
+    if (event.scope() != trace_event_internal::kGlobalScope) {
+      // The packet of a new scope has to precede the event too, which is
+      // fine as |event_| is only appended to |out| below.
+      AppendVarintField(kEventScopeId, InternString(event.scope(), out),
+                        &event_);
+    }
+    AppendVarintField(kEventId, event.id(), &event_);
+  }
+  if (event.flags() & kFlowFlags)
+    AppendVarintField(kEventBindId, event.bind_id(), &event_);
+
+  AppendPacket(kPacketEvent, event_, out);
+}
+
+uint32_t TraceEventBinaryWriter::InternString(StringPiece value,
+                                              std::string* out) {
+  auto it = interned_strings_.find(value);
+  if (it != interned_strings_.end())
+    return it->second;
+
+  // Ids start at 1 so that 0 means "not set".
+  const uint32_t id = static_cast<uint32_t>(interned_strings_.size() + 1);
+  // Copied, since the strings of an event can be released before the writer.
+  interned_string_storage_.push_back(value.as_string());
+  interned_strings_.emplace(interned_string_storage_.back(), id);
+  std::string interned_string;
+  AppendVarintField(kInternedStringId, id, &interned_string);
+  AppendBytesField(kInternedStringValue, value, &interned_string);
+  AppendPacket(kPacketInternedString, interned_string, out);
+  return id;
+}
+
+namespace {
+
+// Reads the fields of a message in the protobuf wire format.
+class ProtoReader {
+ public:
+  explicit ProtoReader(StringPiece data)
+      : pos_(data.data()), end_(data.data() + data.size()) {}
+
+  bool done() const { return pos_ == end_; }
+
+  // Reads the next field, which is in |*bytes| if it is length-delimited and
+  // in |*value| otherwise. Returns false if the data is malformed.
+  bool ReadField(uint32_t* field, uint64_t* value, StringPiece* bytes) {
+    uint64_t tag;
+    if (!ReadVarint(&tag))
+      return false;
+    *field = static_cast<uint32_t>(tag >> 3);
+    switch (tag & 7) {
+      case kVarint:
+        return ReadVarint(value);
+      case kFixed64:
+        return ReadFixed(8, value);
+      case kFixed32:
+        return ReadFixed(4, value);
+      case kLengthDelimited: {
+        uint64_t size;
+        if (!ReadVarint(&size) || size > static_cast<uint64_t>(end_ - pos_))
+          return false;
+        *bytes = StringPiece(pos_, size);
+        pos_ += size;
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  bool ReadVarint(uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && pos_ < end_; shift += 7) {
+      const uint8_t byte = static_cast<uint8_t>(*pos_++);
+      *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  bool ReadFixed(int size, uint64_t* value) {
+    if (end_ - pos_ < size)
+      return false;
+    *value = 0;
+    for (int i = 0; i < size; ++i)
+      *value |= static_cast<uint64_t>(static_cast<uint8_t>(*pos_++)) << (8 * i);
+    return true;
+  }
+
+  const char* pos_;
+  const char* const end_;
+};
+
+int64_t ZigZagDecode(uint64_t value) {
+  return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+}
+
+struct DecodedArg {
+  uint32_t name_id = 0;
+  // A TRACE_VALUE_TYPE_*, or 0 if the value was stripped.
+  unsigned char type = 0;
+  TraceEvent::TraceValue value;
+  StringPiece string_value;
+  // Whether |string_value| is a TracedValue message rather than JSON.
+  bool is_traced_value = false;
+};
+
+struct DecodedEvent {
+  int64_t pid = 0;
+  int64_t tid = 0;
+  int64_t timestamp_delta = 0;
+  char phase = 0;
+  uint32_t category_id = 0;
+  uint32_t name_id = 0;
+  unsigned int flags = 0;
+  std::vector<DecodedArg> args;
+  bool args_stripped = false;
+  bool has_duration = false;
+  int64_t duration = 0;
+  bool has_thread_timestamp = false;
+  int64_t thread_timestamp = 0;
+  bool has_thread_duration = false;
+  int64_t thread_duration = 0;
+  uint32_t scope_id = 0;
+  uint64_t id = 0;
+  uint64_t bind_id = 0;
+};
+
+bool DecodeArg(StringPiece message, DecodedArg* arg) {
+  ProtoReader reader(message);
+  while (!reader.done()) {
+    uint32_t field;
+    uint64_t value = 0;
+    StringPiece bytes;
+    if (!reader.ReadField(&field, &value, &bytes))
+      return false;
+    switch (field) {
+      case kArgNameId:
+        arg->name_id = static_cast<uint32_t>(value);
+        break;
+      case kArgBoolValue:
+        arg->type = TRACE_VALUE_TYPE_BOOL;
+        arg->value.as_bool = value != 0;
+        break;
+      case kArgUintValue:
+        arg->type = TRACE_VALUE_TYPE_UINT;
+        arg->value.as_uint = value;
+        break;
+      case kArgIntValue:
+        arg->type = TRACE_VALUE_TYPE_INT;
+        arg->value.as_int = ZigZagDecode(value);
+        break;
+      case kArgDoubleValue:
+        arg->type = TRACE_VALUE_TYPE_DOUBLE;
+        memcpy(&arg->value.as_double, &value, sizeof(value));
+        break;
+      case kArgPointerValue:
+        arg->type = TRACE_VALUE_TYPE_POINTER;
+        arg->value.as_pointer =
+            reinterpret_cast<const void*>(static_cast<uintptr_t>(value));
+        break;
+      case kArgStringValue:
+        arg->type = TRACE_VALUE_TYPE_STRING;
+        arg->string_value = bytes;
+        break;
+      case kArgJsonValue:
+        arg->type = TRACE_VALUE_TYPE_CONVERTABLE;
+        arg->string_value = bytes;
+        break;
+      case kArgTracedValue:
+        arg->type = TRACE_VALUE_TYPE_CONVERTABLE;
+        arg->string_value = bytes;
+        arg->is_traced_value = true;
+        break;
+      case kArgStripped:
+        arg->type = 0;
+        break;
+    }
+  }
+  return true;
+}
+
+bool DecodeEvent(StringPiece message, DecodedEvent* event) {
+  ProtoReader reader(message);
+  while (!reader.done()) {
+    uint32_t field;
+    uint64_t value = 0;
+    StringPiece bytes;
+    if (!reader.ReadField(&field, &value, &bytes))
+      return false;
+    switch (field) {
+      case kEventPid:
+        event->pid = ZigZagDecode(value);
+        break;
+      case kEventTid:
+        event->tid = ZigZagDecode(value);
+        break;
+      case kEventTimestampDelta:
+        event->timestamp_delta = ZigZagDecode(value);
+        break;
+      case kEventPhase:
+        event->phase = static_cast<char>(value);
+        break;
+      case kEventCategoryId:
+        event->category_id = static_cast<uint32_t>(value);
+        break;
+      case kEventNameId:
+        event->name_id = static_cast<uint32_t>(value);
+        break;
+      case kEventFlags:
+        event->flags = static_cast<unsigned int>(value);
+        break;
+      case kEventArg:
+        event->args.emplace_back();
+        if (!DecodeArg(bytes, &event->args.back()))
+          return false;
+        break;
+      case kEventArgsStripped:
+        event->args_stripped = value != 0;
+        break;
+      case kEventDuration:
+        event->has_duration = true;
+        event->duration = static_cast<int64_t>(value);
+        break;
+      case kEventThreadTimestamp:
+        event->has_thread_timestamp = true;
+        event->thread_timestamp = static_cast<int64_t>(value);
+        break;
+      case kEventThreadDuration:
+        event->has_thread_duration = true;
+        event->thread_duration = static_cast<int64_t>(value);
+        break;
+      case kEventScopeId:
+        event->scope_id = static_cast<uint32_t>(value);
+        break;
+      case kEventId:
+        event->id = value;
+        break;
+      case kEventBindId:
+        event->bind_id = value;
+        break;
+    }
+  }
+  return true;
+}
+
+// Appends the entries of the TracedValue message |message| as the JSON
+// dictionary or array which TracedValue::AppendAsTraceFormat() would have
+// appended. Returns false if |message| is malformed.
+bool AppendTracedValueAsJSON(StringPiece message,
+                             bool is_dict,
+                             std::string* out) {
+  out->push_back(is_dict ? '{' : '[');
+  ProtoReader reader(message);
+  for (bool first = true; !reader.done(); first = false) {
+    uint32_t field;
+    uint64_t value = 0;
+    StringPiece entry;
+    if (!reader.ReadField(&field, &value, &entry) ||
+        field != kTracedValueEntry) {
+      return false;
+    }
+    if (!first)
+      out->push_back(',');
+
+    ProtoReader entry_reader(entry);
+    while (!entry_reader.done()) {
+      StringPiece bytes;
+      if (!entry_reader.ReadField(&field, &value, &bytes))
+        return false;
+      TraceEvent::TraceValue json_value;
+      switch (field) {
+        case kTracedValueEntryName:
+          if (is_dict) {
+            EscapeJSONString(bytes, true, out);
+            out->push_back(':');
+          }
+          break;
+        case kTracedValueEntryBool:
+          json_value.as_bool = value != 0;
+          TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_BOOL, json_value,
+                                        out);
+          break;
+        case kTracedValueEntryInt:
+          json_value.as_int = ZigZagDecode(value);
+          TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_INT, json_value,
+                                        out);
+          break;
+        case kTracedValueEntryDouble:
+          memcpy(&json_value.as_double, &value, sizeof(value));
+          TraceEvent::AppendValueAsJSON(TRACE_VALUE_TYPE_DOUBLE, json_value,
+                                        out);
+          break;
+        case kTracedValueEntryString:
+          EscapeJSONString(bytes, true, out);
+          break;
+        case kTracedValueEntryDict:
+        case kTracedValueEntryArray:
+          if (!AppendTracedValueAsJSON(
+                  bytes, field == kTracedValueEntryDict, out)) {
+            return false;
+          }
+          break;
+      }
+    }
+  }
+  out->push_back(is_dict ? '}' : ']');
+  return true;
+}
+
+// Appends |event| as TraceEvent::AppendAsJSON() would have. Returns false if
+// it refers to strings which weren't interned.
+bool AppendEventAsJSON(const DecodedEvent& event,
+                       int64_t timestamp,
+                       const std::vector<StringPiece>& strings,
+                       std::string* out) {
+  auto lookup = [&strings](uint32_t id, StringPiece* value) {
+    if (!id || id > strings.size())
+      return false;
+    *value = strings[id - 1];
+    return true;
+  };
+  StringPiece category;
+  StringPiece name;
+  if (!lookup(event.category_id, &category) || !lookup(event.name_id, &name))
+    return false;
+
+  StringAppendF(out, "{\"pid\":%" PRId64 ",\"tid\":%" PRId64 ",\"ts\":%" PRId64
+                     ",\"ph\":\"%c\",\"cat\":\"",
+                event.pid, event.tid, timestamp, event.phase);
+  category.AppendToString(out);
+  *out += "\",\"name\":";
+  EscapeJSONString(name, true, out);
+  *out += ",\"args\":";
+
+  if (event.args_stripped) {
+    *out += "\"__stripped__\"";
+  } else {
+    *out += "{";
+    for (size_t i = 0; i < event.args.size(); ++i) {
+      const DecodedArg& arg = event.args[i];
+      StringPiece arg_name;
+      if (!lookup(arg.name_id, &arg_name))
+        return false;
+      if (i > 0)
+        *out += ",";
+      *out += "\"";
+      arg_name.AppendToString(out);
+      *out += "\":";
+      switch (arg.type) {
+        case 0:
+          *out += "\"__stripped__\"";
+          break;
+        case TRACE_VALUE_TYPE_STRING:
+          EscapeJSONString(arg.string_value, true, out);
+          break;
+        case TRACE_VALUE_TYPE_CONVERTABLE:
+          if (!arg.is_traced_value)
+            arg.string_value.AppendToString(out);
+          else if (!AppendTracedValueAsJSON(arg.string_value, true, out))
+            return false;
+          break;
+        default:
+          TraceEvent::AppendValueAsJSON(arg.type, arg.value, out);
+          break;
+      }
+    }
+    *out += "}";
+  }
+
+  if (event.has_duration)
+    StringAppendF(out, ",\"dur\":%" PRId64, event.duration);
+  if (event.has_thread_duration)
+    StringAppendF(out, ",\"tdur\":%" PRId64, event.thread_duration);
+  if (event.has_thread_timestamp)
+    StringAppendF(out, ",\"tts\":%" PRId64, event.thread_timestamp);
+  if (event.flags & TRACE_EVENT_FLAG_ASYNC_TTS)
+    StringAppendF(out, ", \"use_async_tts\":1");
+
+  const unsigned int id_flags = event.flags & kIdFlags;
+  if (id_flags) {
+    StringPiece scope;
+    if (event.scope_id) {
+      if (!lookup(event.scope_id, &scope))
+        return false;
+      *out += ",\"scope\":\"";
+      scope.AppendToString(out);
+      *out += "\"";
+    }
+    switch (id_flags) {
+      case TRACE_EVENT_FLAG_HAS_ID:
+        StringAppendF(out, ",\"id\":\"0x%" PRIx64 "\"", event.id);
+        break;
+      case TRACE_EVENT_FLAG_HAS_LOCAL_ID:
+        StringAppendF(out, ",\"id2\":{\"local\":\"0x%" PRIx64 "\"}", event.id);
+        break;
+      case TRACE_EVENT_FLAG_HAS_GLOBAL_ID:
+        StringAppendF(out, ",\"id2\":{\"global\":\"0x%" PRIx64 "\"}",
+                      event.id);
+        break;
+      default:
+        return false;
+    }
+  }
+
+  if (event.flags & TRACE_EVENT_FLAG_BIND_TO_ENCLOSING)
+    StringAppendF(out, ",\"bp\":\"e\"");
+  if (event.flags & kFlowFlags)
+    StringAppendF(out, ",\"bind_id\":\"0x%" PRIx64 "\"", event.bind_id);
+  if (event.flags & TRACE_EVENT_FLAG_FLOW_IN)
+    StringAppendF(out, ",\"flow_in\":true");
+  if (event.flags & TRACE_EVENT_FLAG_FLOW_OUT)
+    StringAppendF(out, ",\"flow_out\":true");
+
+  if (event.phase == TRACE_EVENT_PHASE_INSTANT) {
+    char scope = '?';
+    switch (event.flags & TRACE_EVENT_FLAG_SCOPE_MASK) {
+      case TRACE_EVENT_SCOPE_GLOBAL:
+        scope = TRACE_EVENT_SCOPE_NAME_GLOBAL;
+        break;
+      case TRACE_EVENT_SCOPE_PROCESS:
+        scope = TRACE_EVENT_SCOPE_NAME_PROCESS;
+        break;
+      case TRACE_EVENT_SCOPE_THREAD:
+        scope = TRACE_EVENT_SCOPE_NAME_THREAD;
+        break;
+    }
+    StringAppendF(out, ",\"s\":\"%c\"", scope);
+  }
+
+  *out += "}";
+  return true;
+}
+
+}  // namespace
+
+bool ConvertBinaryTraceToJSON(StringPiece binary, std::string* json) {
+  std::vector<StringPiece> strings;
+  int64_t timestamp = 0;
+  bool first_event = true;
+  ProtoReader trace_reader(binary);
+  while (!trace_reader.done()) {
+    uint32_t field;
+    uint64_t value;
+    StringPiece packet;
+    if (!trace_reader.ReadField(&field, &value, &packet))
+      return false;
+    if (field != kTracePacket)
+      continue;
+
+    ProtoReader packet_reader(packet);
+    while (!packet_reader.done()) {
+      StringPiece message;
+      if (!packet_reader.ReadField(&field, &value, &message))
+        return false;
+
+      if (field == kPacketInternedString) {
+        uint64_t id = 0;
+        StringPiece string_value;
+        ProtoReader reader(message);
+        while (!reader.done()) {
+          StringPiece bytes;
+          if (!reader.ReadField(&field, &value, &bytes))
+            return false;
+          if (field == kInternedStringId)
+            id = value;
+          else if (field == kInternedStringValue)
+            string_value = bytes;
+        }
+        // Ids are allocated sequentially.
+        if (id != strings.size() + 1)
+          return false;
+        strings.push_back(string_value);
+      } else if (field == kPacketEvent) {
+        DecodedEvent event;
+        if (!DecodeEvent(message, &event))
+          return false;
+        timestamp += event.timestamp_delta;
+        if (!first_event)
+          json->append(",\n");
+        first_event = false;
+        if (!AppendEventAsJSON(event, timestamp, strings, json))
+          return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -0,0 +1,130 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TRACE_EVENT_TRACE_EVENT_BINARY_FORMAT_H_
+#define BASE_TRACE_EVENT_TRACE_EVENT_BINARY_FORMAT_H_
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+#include "base/base_export.h"
+#include "base/macros.h"
+#include "base/strings/string_piece.h"
+#include "base/trace_event/trace_event_impl.h"
+
+namespace base {
+namespace trace_event {
+
+// A compact alternative to the JSON trace format, used by
+// TraceLog::Flush(..., TraceLog::FlushFormat::kBinary). A flush produces a
+// stream of packets encoded in the protobuf wire format:
+//
+//   message TracePacket {
+//     oneof data {
+//       InternedString interned_string = 1;
+//       Event event = 2;
+//     }
+//   }
+//   message InternedString {
+//     uint32 id = 1;
+//     string value = 2;
+//   }
+//   message Event {
+//     sint32 pid = 1;
+//     sint32 tid = 2;
+//     sint64 timestamp_delta = 3;  // Since the previous event of the stream.
+//     uint32 phase = 4;
+//     uint32 category_id = 5;      // InternedString ids.
+//     uint32 name_id = 6;
+//     uint32 flags = 7;            // TRACE_EVENT_FLAG_*.
+//     repeated Arg arg = 8;
+//     bool args_stripped = 9;
+//     int64 duration = 10;
+//     int64 thread_timestamp = 11;
+//     int64 thread_duration = 12;
+//     uint32 scope_id = 13;
+//     uint64 id = 14;
+//     uint64 bind_id = 15;
+//   }
+//   message Arg {
+//     uint32 name_id = 1;
+//     oneof value {
+//       bool bool_value = 2;
+//       uint64 uint_value = 3;
+//       sint64 int_value = 4;
+//       double double_value = 5;
+//       uint64 pointer_value = 6;
+//       string string_value = 7;
+//       string json_value = 8;  // ConvertableToTraceFormat output.
+//       bool stripped = 9;
+//       TracedValue traced_value = 10;
+//     }
+//   }
+//   message TracedValue {  // A dictionary or an array.
+//     message Entry {
+//       string name = 1;  // Only in dictionaries.
+//       oneof value {
+//         bool bool_value = 2;
+//         sint64 int_value = 3;
+//         double double_value = 4;
+//         string string_value = 5;
+//         TracedValue dict_value = 6;
+//         TracedValue array_value = 7;
+//       }
+//     }
+//     repeated Entry entry = 1;
+//   }
+//
+// Each packet is written as field 1 of an enclosing message, so the stream is
+// itself a serialized "message Trace { repeated TracePacket packet = 1; }".
+// Times are in microseconds. Strings are interned: the first event of a flush
+// which uses a category, name, argument name or id scope is preceded by an
+// InternedString packet, and later events only refer to its id. Because of
+// the interned strings and the timestamp deltas, the chunks passed to the
+// OutputCallback must be concatenated in order before being decoded.
+// Arguments which implement ConvertableToTraceFormat::AppendAsProto(), such
+// as TracedValue, are written as a TracedValue message rather than as JSON.
+class BASE_EXPORT TraceEventBinaryWriter {
+ public:
+  // Arguments are stripped according to |argument_filter_predicate|, if not
+  // null, as in TraceEvent::AppendAsJSON().
+  explicit TraceEventBinaryWriter(
+      const ArgumentFilterPredicate& argument_filter_predicate);
+  ~TraceEventBinaryWriter();
+
+  // Appends the packets for |event| to |out|.
+  void AppendEvent(const TraceEvent& event, std::string* out);
+
+ private:
+  // Returns the id of |value|, first appending an InternedString packet to
+  // |out| if |value| wasn't seen before.
+  uint32_t InternString(StringPiece value, std::string* out);
+
+  const ArgumentFilterPredicate argument_filter_predicate_;
+  std::unordered_map<StringPiece, uint32_t, StringPieceHash> interned_strings_;
+  // The keys of |interned_strings_|.
+  std::deque<std::string> interned_string_storage_;
+  int64_t last_timestamp_ = 0;
+  // Scratch space for the messages being written, which can only be appended
+  // to the output once their length is known.
+  std::string event_;
+  std::string arg_;
+  std::string value_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceEventBinaryWriter);
+};
+
+// Converts the concatenated output of a binary flush to the output of a JSON
+// flush, i.e. the comma-separated events that TraceResultBuffer expects.
+// Returns false if |binary| is malformed.
+BASE_EXPORT bool ConvertBinaryTraceToJSON(StringPiece binary,
+                                          std::string* json);
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_TRACE_EVENT_BINARY_FORMAT_H_
@@ -0,0 +1,332 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event_binary_format.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/json/json_reader.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/strings/pattern.h"
+#include "base/time/time.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_argument.h"
+#include "base/values.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+struct EventArgs {
+  const char* names[kTraceMaxNumArgs] = {};
+  unsigned char types[kTraceMaxNumArgs] = {};
+  unsigned long long values[kTraceMaxNumArgs] = {};
+  std::unique_ptr<ConvertableToTraceFormat> convertables[kTraceMaxNumArgs];
+  int count = 0;
+
+  void Add(const char* name, unsigned char type, unsigned long long value) {
+    names[count] = name;
+    types[count] = type;
+    values[count] = value;
+    count++;
+  }
+};
+
+bool IsArgNameWhitelisted(const char* arg_name) {
+  return MatchPattern(arg_name, "kept*");
+}
+
+bool FilterArgs(const char* category_group_name,
+                const char* event_name,
+                ArgumentNameFilterPredicate* arg_filter) {
+  if (MatchPattern(event_name, "stripped"))
+    return false;
+  if (MatchPattern(event_name, "granular"))
+    *arg_filter = Bind(&IsArgNameWhitelisted);
+  return true;
+}
+
+class TraceEventBinaryFormatTest : public testing::Test {
+ public:
+  void SetUp() override { TraceLog::ResetForTesting(); }
+  void TearDown() override { TraceLog::ResetForTesting(); }
+
+ protected:
+  TraceEvent* AddEvent(
+      const char* category,
+      const char* name,
+      char phase,
+      unsigned int flags,
+      EventArgs* args = nullptr,
+      const char* scope = trace_event_internal::kGlobalScope,
+      unsigned long long id = trace_event_internal::kNoId,
+      unsigned long long bind_id = trace_event_internal::kNoId) {
+    EventArgs no_args;
+    if (!args)
+      args = &no_args;
+    events_.push_back(std::make_unique<TraceEvent>());
+    TraceEvent* event = events_.back().get();
+    const TimeTicks timestamp =
+        TimeTicks() + TimeDelta::FromMicroseconds(1000 + 10 * events_.size());
+    event->Initialize(1234, timestamp, ThreadTicks(), phase,
+                      TraceLog::GetCategoryGroupEnabled(category), name, scope,
+                      id, bind_id, args->count, args->names, args->types,
+                      args->values, args->convertables, flags);
+    return event;
+  }
+
+  // Checks that each event converts to the JSON it would have been flushed
+  // as in the JSON format.
+  void ExpectSameJSON(
+      const ArgumentFilterPredicate& argument_filter_predicate) {
+    std::string expected;
+    TraceEventBinaryWriter writer(argument_filter_predicate);
+    std::string binary;
+    for (const auto& event : events_) {
+      if (!expected.empty())
+        expected += ",\n";
+      event->AppendAsJSON(&expected, argument_filter_predicate);
+      writer.AppendEvent(*event, &binary);
+    }
+
+    std::string json;
+    ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+    EXPECT_EQ(expected, json);
+    EXPECT_LT(binary.size(), expected.size());
+  }
+
+  std::vector<std::unique_ptr<TraceEvent>> events_;
+
+ private:
+  ShadowingAtExitManager at_exit_manager_;
+};
+
+}  // namespace
+
+TEST_F(TraceEventBinaryFormatTest, ConvertsToSameJSON) {
+  EventArgs args;
+  args.Add("bool", TRACE_VALUE_TYPE_BOOL, 1);
+  args.Add("int", TRACE_VALUE_TYPE_INT, static_cast<unsigned long long>(-42));
+  AddEvent("cat", "begin", TRACE_EVENT_PHASE_BEGIN, TRACE_EVENT_FLAG_NONE,
+           &args);
+
+  EventArgs more_args;
+  more_args.Add("uint", TRACE_VALUE_TYPE_UINT, 1ull << 63);
+  TraceEvent::TraceValue double_value;
+  double_value.as_double = -0.25;
+  more_args.Add("double", TRACE_VALUE_TYPE_DOUBLE, double_value.as_uint);
+  AddEvent("cat,other", "name\\with\\backslashes", TRACE_EVENT_PHASE_INSTANT,
+           TRACE_EVENT_SCOPE_THREAD, &more_args);
+
+  EventArgs string_args;
+  TraceEvent::TraceValue string_value;
+  string_value.as_string = "tab\tand\\slash";
+  string_args.Add("string", TRACE_VALUE_TYPE_COPY_STRING,
+                  string_value.as_uint);
+  string_args.Add("pointer", TRACE_VALUE_TYPE_POINTER, 0xdeadbeef);
+  AddEvent("cat", "copied", TRACE_EVENT_PHASE_COMPLETE, TRACE_EVENT_FLAG_COPY,
+           &string_args)
+      ->UpdateDuration(TimeTicks() + TimeDelta::FromMicroseconds(2000),
+                       ThreadTicks());
+
+  EventArgs convertable_args;
+  std::unique_ptr<TracedValue> traced_value(new TracedValue);
+  traced_value->SetInteger("answer", 42);
+  traced_value->SetString("string", "value");
+  convertable_args.Add("data", TRACE_VALUE_TYPE_CONVERTABLE, 0);
+  convertable_args.convertables[0] = std::move(traced_value);
+  AddEvent("cat", "convertable", TRACE_EVENT_PHASE_INSTANT,
+           TRACE_EVENT_SCOPE_GLOBAL, &convertable_args);
+
+  AddEvent("cat", "async", TRACE_EVENT_PHASE_ASYNC_BEGIN,
+           TRACE_EVENT_FLAG_HAS_ID | TRACE_EVENT_FLAG_ASYNC_TTS, nullptr,
+           "scope", 0x1234);
+  AddEvent("cat", "local", TRACE_EVENT_PHASE_NESTABLE_ASYNC_BEGIN,
+           TRACE_EVENT_FLAG_HAS_LOCAL_ID, nullptr,
+           trace_event_internal::kGlobalScope, 5);
+  AddEvent("cat", "global", TRACE_EVENT_PHASE_NESTABLE_ASYNC_END,
+           TRACE_EVENT_FLAG_HAS_GLOBAL_ID | TRACE_EVENT_FLAG_BIND_TO_ENCLOSING,
+           nullptr, "scope", 6);
+  AddEvent("cat", "flow", TRACE_EVENT_PHASE_COMPLETE,
+           TRACE_EVENT_FLAG_FLOW_IN | TRACE_EVENT_FLAG_FLOW_OUT, nullptr,
+           trace_event_internal::kGlobalScope, trace_event_internal::kNoId,
+           0xabcdef);
+  AddEvent("cat", "other_process", TRACE_EVENT_PHASE_INSTANT,
+           TRACE_EVENT_FLAG_HAS_PROCESS_ID | TRACE_EVENT_SCOPE_PROCESS);
+
+  ExpectSameJSON(ArgumentFilterPredicate());
+}
+
+// TracedValues are written as a TracedValue message, other convertables as
+// their JSON.
+TEST_F(TraceEventBinaryFormatTest, ConvertableArgs) {
+  auto traced_value = std::make_unique<TracedValue>();
+  traced_value->SetInteger("negative", -7);
+  traced_value->SetDouble("double", 1.5);
+  traced_value->SetBooleanWithCopiedName(std::string("copied"), false);
+  traced_value->BeginArray("array");
+  traced_value->AppendString("quoted\"string");
+  traced_value->BeginDictionary();
+  traced_value->SetString("key", "value");
+  traced_value->BeginArray("empty_array");
+  traced_value->EndArray();
+  traced_value->EndDictionary();
+  traced_value->BeginArray();
+  traced_value->AppendDouble(-0.5);
+  traced_value->EndArray();
+  traced_value->EndArray();
+  traced_value->BeginDictionary("empty_dict");
+  traced_value->EndDictionary();
+  std::string long_string(1000, 'x');
+  traced_value->SetString("long_string", long_string);
+
+  std::string traced_value_json;
+  traced_value->AppendAsTraceFormat(&traced_value_json);
+  std::string proto;
+  ASSERT_TRUE(traced_value->AppendAsProto(&proto));
+  EXPECT_EQ(std::string::npos, proto.find("{"));
+
+  class JSONConvertable : public ConvertableToTraceFormat {
+   public:
+    void AppendAsTraceFormat(std::string* out) const override {
+      *out += "{\"json\":[1]}";
+    }
+  };
+
+  EventArgs args;
+  args.Add("traced_value", TRACE_VALUE_TYPE_CONVERTABLE, 0);
+  args.convertables[0] = std::move(traced_value);
+  args.Add("json", TRACE_VALUE_TYPE_CONVERTABLE, 0);
+  args.convertables[1] = std::make_unique<JSONConvertable>();
+  AddEvent("cat", "convertables", TRACE_EVENT_PHASE_INSTANT,
+           TRACE_EVENT_SCOPE_THREAD, &args);
+  ExpectSameJSON(ArgumentFilterPredicate());
+
+  std::string binary;
+  TraceEventBinaryWriter writer((ArgumentFilterPredicate()));
+  writer.AppendEvent(*events_.back(), &binary);
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  EXPECT_NE(std::string::npos, json.find(traced_value_json));
+  EXPECT_NE(std::string::npos, binary.find("{\"json\":[1]}"));
+}
+
+TEST_F(TraceEventBinaryFormatTest, ArgumentFilter) {
+  EventArgs args;
+  args.Add("arg", TRACE_VALUE_TYPE_INT, 1);
+  AddEvent("cat", "stripped", TRACE_EVENT_PHASE_INSTANT,
+           TRACE_EVENT_SCOPE_THREAD, &args);
+
+  EventArgs granular_args;
+  granular_args.Add("kept", TRACE_VALUE_TYPE_INT, 2);
+  granular_args.Add("dropped", TRACE_VALUE_TYPE_INT, 3);
+  AddEvent("cat", "granular", TRACE_EVENT_PHASE_INSTANT,
+           TRACE_EVENT_SCOPE_THREAD, &granular_args);
+
+  EventArgs kept_args;
+  kept_args.Add("arg", TRACE_VALUE_TYPE_INT, 4);
+  AddEvent("cat", "kept", TRACE_EVENT_PHASE_INSTANT, TRACE_EVENT_SCOPE_THREAD,
+           &kept_args);
+
+  ExpectSameJSON(Bind(&FilterArgs));
+}
+
+TEST_F(TraceEventBinaryFormatTest, StringsAreInternedOnce) {
+  EventArgs args;
+  args.Add("some_argument_name", TRACE_VALUE_TYPE_INT, 1);
+  TraceEventBinaryWriter writer((ArgumentFilterPredicate()));
+  std::string binary;
+  for (int i = 0; i < 100; ++i) {
+    writer.AppendEvent(*AddEvent("some_category", "some_event_name",
+                                 TRACE_EVENT_PHASE_INSTANT,
+                                 TRACE_EVENT_SCOPE_THREAD, &args),
+                       &binary);
+  }
+
+  for (const char* string :
+       {"some_category", "some_event_name", "some_argument_name"}) {
+    size_t first = binary.find(string);
+    EXPECT_NE(std::string::npos, first);
+    EXPECT_EQ(std::string::npos, binary.find(string, first + 1));
+  }
+
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  std::unique_ptr<Value> events = JSONReader::Read("[" + json + "]");
+  ASSERT_TRUE(events);
+  EXPECT_EQ(100u, events->GetList().size());
+}
+
+TEST_F(TraceEventBinaryFormatTest, MalformedInput) {
+  TraceEvent* event = AddEvent("cat", "name", TRACE_EVENT_PHASE_INSTANT,
+                               TRACE_EVENT_SCOPE_THREAD);
+  TraceEventBinaryWriter writer((ArgumentFilterPredicate()));
+  std::string first;
+  writer.AppendEvent(*event, &first);
+  std::string second;
+  writer.AppendEvent(*event, &second);
+
+  std::string json;
+  EXPECT_TRUE(ConvertBinaryTraceToJSON(StringPiece(), &json));
+  EXPECT_TRUE(json.empty());
+  EXPECT_TRUE(ConvertBinaryTraceToJSON(first + second, &json));
+  // Truncated.
+  EXPECT_FALSE(ConvertBinaryTraceToJSON(
+      StringPiece(first.data(), first.size() - 1), &json));
+  // Refers to strings interned by the first event.
+  EXPECT_FALSE(ConvertBinaryTraceToJSON(second, &json));
+}
+
+// Flushes enough events to get several chunks and checks they convert back to
+// the events.
+TEST_F(TraceEventBinaryFormatTest, Flush) {
+  TraceLog::GetInstance()->SetEnabled(TraceConfig("cat", ""),
+                                      TraceLog::RECORDING_MODE);
+  constexpr int kNumEvents = 20000;
+  for (int i = 0; i < kNumEvents; ++i)
+    TRACE_EVENT_INSTANT1("cat", "event", TRACE_EVENT_SCOPE_THREAD, "i", i);
+  TraceLog::GetInstance()->SetDisabled();
+
+  std::string binary;
+  int num_chunks = 0;
+  bool done = false;
+  TraceLog::GetInstance()->Flush(
+      BindRepeating(
+          [](std::string* binary, int* num_chunks, bool* done,
+             const scoped_refptr<RefCountedString>& chunk,
+             bool has_more_events) {
+            binary->append(chunk->data());
+            (*num_chunks)++;
+            *done = !has_more_events;
+          },
+          &binary, &num_chunks, &done),
+      false, TraceLog::FlushFormat::kBinary);
+  ASSERT_TRUE(done);
+  EXPECT_GT(num_chunks, 1);
+
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  std::unique_ptr<Value> events = JSONReader::Read("[" + json + "]");
+  ASSERT_TRUE(events);
+  int next = 0;
+  for (const Value& event : events->GetList()) {
+    const Value* name = event.FindKey("name");
+    if (!name || name->GetString() != "event")
+      continue;
+    const Value* i = event.FindPathOfType({"args", "i"}, Value::Type::INTEGER);
+    ASSERT_TRUE(i);
+    EXPECT_EQ(next++, i->GetInt());
+  }
+  EXPECT_EQ(kNumEvents, next);
+}
+
+}  // namespace trace_event
+}  // namespace base
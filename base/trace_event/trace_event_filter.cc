@@ -13,5 +13,10 @@ TraceEventFilter::~TraceEventFilter() = default;
 void TraceEventFilter::EndEvent(const char* category_name,
                                 const char* event_name) const {}
 
+std::unique_ptr<TraceEventFilter::BatchPredicate>
+TraceEventFilter::CreateBatchPredicate() const {
+  return nullptr;
+}
+
 }  // namespace trace_event
 }  // namespace base
@@ -5,6 +5,8 @@
 #ifndef BASE_TRACE_EVENT_TRACE_EVENT_FILTER_H_
 #define BASE_TRACE_EVENT_TRACE_EVENT_FILTER_H_
 
+#include <stddef.h>
+
 #include <memory>
 
 #include "base/base_export.h"
@@ -29,6 +31,20 @@ class TraceEvent;
 // different threads.
 class BASE_EXPORT TraceEventFilter {
  public:
+  // A compiled form of FilterTraceEvent() which is evaluated over many
+  // buffered events at once, see CreateBatchPredicate(). Like the filters,
+  // predicates must be thread-safe.
+  class BASE_EXPORT BatchPredicate {
+   public:
+    virtual ~BatchPredicate() = default;
+
+    // Sets |accepted[i]| to true for each of the |count| |events| which the
+    // filter accepts, and leaves the others unchanged.
+    virtual void FilterTraceEvents(const TraceEvent* const* events,
+                                   size_t count,
+                                   bool* accepted) const = 0;
+  };
+
   TraceEventFilter();
   virtual ~TraceEventFilter();
 
@@ -41,6 +57,15 @@ class BASE_EXPORT TraceEventFilter {
   virtual void EndEvent(const char* category_name,
                         const char* event_name) const;
 
+  // Returns a predicate which decides like FilterTraceEvent() but doesn't
+  // refer to this filter, or null if the filter has to see the events as they
+  // are added, e.g. to implement EndEvent(). This is used for the filters
+  // configured to filter at flush time (see TraceConfig::EventFilterConfig):
+  // the events of the recorded categories which only have such filters are
+  // added to the trace buffer unfiltered, and filtered in batches when the
+  // trace is flushed, so that adding them costs the same whatever the filters.
+  virtual std::unique_ptr<BatchPredicate> CreateBatchPredicate() const;
+
  private:
   DISALLOW_COPY_AND_ASSIGN(TraceEventFilter);
 };
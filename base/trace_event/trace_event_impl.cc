@@ -41,23 +41,76 @@ void CopyTraceEventParameter(char** buffer,
 
 }  // namespace
 
+// static
+constexpr size_t TraceEventStringArena::kBlockSize;
+
+TraceEventStringArena::TraceEventStringArena()
+    : used_in_last_block_(kBlockSize), large_blocks_size_(0) {}
+
+TraceEventStringArena::~TraceEventStringArena() = default;
+
+char* TraceEventStringArena::Allocate(size_t size) {
+  if (size > kBlockSize / 4) {
+    large_blocks_.push_back(std::unique_ptr<char[]>(new char[size]));
+    large_blocks_size_ += size;
+    return large_blocks_.back().get();
+  }
+  if (kBlockSize - used_in_last_block_ < size) {
+    blocks_.push_back(std::unique_ptr<char[]>(new char[kBlockSize]));
+    used_in_last_block_ = 0;
+  }
+  char* result = blocks_.back().get() + used_in_last_block_;
+  used_in_last_block_ += size;
+  return result;
+}
+
+void TraceEventStringArena::Reset() {
+  if (blocks_.size() > 1)
+    blocks_.resize(1);
+  used_in_last_block_ = blocks_.empty() ? kBlockSize : 0;
+  large_blocks_.clear();
+  large_blocks_size_ = 0;
+}
+
+void TraceEventStringArena::EstimateTraceMemoryOverhead(
+    TraceEventMemoryOverhead* overhead) {
+  overhead->Add(TraceEventMemoryOverhead::kTraceBufferChunk,
+                blocks_.size() * kBlockSize + large_blocks_size_);
+}
+
+#if defined(ARCH_CPU_64_BITS)
+static_assert(sizeof(TraceEvent) <= 128,
+              "TraceEvent should fit in two cache lines");
+#endif
+
 TraceEvent::TraceEvent()
     : duration_(TimeDelta::FromInternalValue(-1)),
       scope_(trace_event_internal::kGlobalScope),
       id_(0u),
       category_group_enabled_(nullptr),
       name_(nullptr),
+      parameter_copy_storage_(nullptr),
       thread_id_(0),
       flags_(0),
-      phase_(TRACE_EVENT_PHASE_BEGIN) {
-  for (int i = 0; i < kTraceMaxNumArgs; ++i)
+      parameter_copy_storage_size_(0),
+      phase_(TRACE_EVENT_PHASE_BEGIN),
+      owns_parameter_copy_storage_(false) {
+  for (int i = 0; i < kTraceMaxNumArgs; ++i) {
     arg_names_[i] = nullptr;
+    arg_types_[i] = TRACE_VALUE_TYPE_UINT;
+  }
   memset(arg_values_, 0, sizeof(arg_values_));
 }
 
-TraceEvent::~TraceEvent() = default;
+TraceEvent::~TraceEvent() {
+  ResetConvertableValues();
+  ResetParameterCopyStorage();
+}
 
 void TraceEvent::MoveFrom(std::unique_ptr<TraceEvent> other) {
+  ResetConvertableValues();
+  ResetParameterCopyStorage();
+
   timestamp_ = other->timestamp_;
   thread_timestamp_ = other->thread_timestamp_;
   duration_ = other->duration_;
@@ -71,13 +124,19 @@ void TraceEvent::MoveFrom(std::unique_ptr<TraceEvent> other) {
     thread_id_ = other->thread_id_;
   phase_ = other->phase_;
   flags_ = other->flags_;
-  parameter_copy_storage_ = std::move(other->parameter_copy_storage_);
+  parameter_copy_storage_ = other->parameter_copy_storage_;
+  parameter_copy_storage_size_ = other->parameter_copy_storage_size_;
+  owns_parameter_copy_storage_ = other->owns_parameter_copy_storage_;
+  other->parameter_copy_storage_ = nullptr;
+  other->parameter_copy_storage_size_ = 0;
+  other->owns_parameter_copy_storage_ = false;
 
   for (int i = 0; i < kTraceMaxNumArgs; ++i) {
     arg_names_[i] = other->arg_names_[i];
     arg_types_[i] = other->arg_types_[i];
     arg_values_[i] = other->arg_values_[i];
-    convertable_values_[i] = std::move(other->convertable_values_[i]);
+    if (arg_types_[i] == TRACE_VALUE_TYPE_CONVERTABLE)
+      other->arg_values_[i].as_convertable = nullptr;
   }
 }
 
@@ -96,7 +155,11 @@ void TraceEvent::Initialize(
     const unsigned char* arg_types,
     const unsigned long long* arg_values,
     std::unique_ptr<ConvertableToTraceFormat>* convertable_values,
-    unsigned int flags) {
+    unsigned int flags,
+    TraceEventStringArena* string_arena) {
+  ResetConvertableValues();
+  ResetParameterCopyStorage();
+
   timestamp_ = timestamp;
   thread_timestamp_ = thread_timestamp;
   duration_ = TimeDelta::FromInternalValue(-1);
@@ -116,17 +179,14 @@ void TraceEvent::Initialize(
     arg_names_[i] = arg_names[i];
     arg_types_[i] = arg_types[i];
 
-    if (arg_types[i] == TRACE_VALUE_TYPE_CONVERTABLE) {
-      convertable_values_[i] = std::move(convertable_values[i]);
-    } else {
+    if (arg_types[i] == TRACE_VALUE_TYPE_CONVERTABLE)
+      arg_values_[i].as_convertable = convertable_values[i].release();
+    else
       arg_values_[i].as_uint = arg_values[i];
-      convertable_values_[i].reset();
-    }
   }
   for (; i < kTraceMaxNumArgs; ++i) {
     arg_names_[i] = nullptr;
     arg_values_[i].as_uint = 0u;
-    convertable_values_[i].reset();
     arg_types_[i] = TRACE_VALUE_TYPE_UINT;
   }
 
@@ -154,9 +214,15 @@ void TraceEvent::Initialize(
   }
 
   if (alloc_size) {
-    parameter_copy_storage_.reset(new std::string);
-    parameter_copy_storage_->resize(alloc_size);
-    char* ptr = base::data(*parameter_copy_storage_);
+    char* ptr = nullptr;
+    if (string_arena) {
+      ptr = string_arena->Allocate(alloc_size);
+    } else {
+      ptr = new char[alloc_size];
+      owns_parameter_copy_storage_ = true;
+    }
+    parameter_copy_storage_ = ptr;
+    parameter_copy_storage_size_ = static_cast<uint32_t>(alloc_size);
     const char* end = ptr + alloc_size;
     if (copy) {
       CopyTraceEventParameter(&ptr, &name_, end);
@@ -179,9 +245,32 @@ void TraceEvent::Reset() {
   // Only reset fields that won't be initialized in Initialize(), or that may
   // hold references to other objects.
   duration_ = TimeDelta::FromInternalValue(-1);
-  parameter_copy_storage_.reset();
-  for (int i = 0; i < kTraceMaxNumArgs; ++i)
-    convertable_values_[i].reset();
+  ResetParameterCopyStorage();
+  ResetConvertableValues();
+}
+
+void TraceEvent::ResetConvertableValues() {
+  for (int i = 0; i < kTraceMaxNumArgs; ++i) {
+    if (arg_types_[i] == TRACE_VALUE_TYPE_CONVERTABLE) {
+      delete arg_values_[i].as_convertable;
+      arg_values_[i].as_convertable = nullptr;
+    }
+  }
+}
+
+void TraceEvent::ResetParameterCopyStorage() {
+  if (owns_parameter_copy_storage_)
+    delete[] parameter_copy_storage_;
+  parameter_copy_storage_ = nullptr;
+  parameter_copy_storage_size_ = 0;
+  owns_parameter_copy_storage_ = false;
+}
+
+const ConvertableToTraceFormat* TraceEvent::arg_convertible_value(
+    size_t index) const {
+  return arg_types_[index] == TRACE_VALUE_TYPE_CONVERTABLE
+             ? arg_values_[index].as_convertable
+             : nullptr;
 }
 
 void TraceEvent::UpdateDuration(const TimeTicks& now,
@@ -199,12 +288,15 @@ void TraceEvent::EstimateTraceMemoryOverhead(
     TraceEventMemoryOverhead* overhead) {
   overhead->Add(TraceEventMemoryOverhead::kTraceEvent, sizeof(*this));
 
-  if (parameter_copy_storage_)
-    overhead->AddString(*parameter_copy_storage_);
+  // Storage in a TraceEventStringArena is accounted for by its owner.
+  if (owns_parameter_copy_storage_) {
+    overhead->Add(TraceEventMemoryOverhead::kStdString,
+                  parameter_copy_storage_size_);
+  }
 
   for (size_t i = 0; i < kTraceMaxNumArgs; ++i) {
     if (arg_types_[i] == TRACE_VALUE_TYPE_CONVERTABLE)
-      convertable_values_[i]->EstimateTraceMemoryOverhead(overhead);
+      arg_values_[i].as_convertable->EstimateTraceMemoryOverhead(overhead);
   }
 }
 
@@ -324,7 +416,7 @@ void TraceEvent::AppendAsJSON(
       if (argument_name_filter_predicate.is_null() ||
           argument_name_filter_predicate.Run(arg_names_[i])) {
         if (arg_types_[i] == TRACE_VALUE_TYPE_CONVERTABLE)
-          convertable_values_[i]->AppendAsTraceFormat(out);
+          arg_values_[i].as_convertable->AppendAsTraceFormat(out);
         else
           AppendValueAsJSON(arg_types_[i], arg_values_[i], out);
       } else {
@@ -436,7 +528,7 @@ void TraceEvent::AppendPrettyPrinted(std::ostringstream* out) const {
       std::string value_as_text;
 
       if (arg_types_[i] == TRACE_VALUE_TYPE_CONVERTABLE)
-        convertable_values_[i]->AppendAsTraceFormat(&value_as_text);
+        arg_values_[i].as_convertable->AppendAsTraceFormat(&value_as_text);
       else
         AppendValueAsJSON(arg_types_[i], arg_values_[i], &value_as_text);
 
@@ -19,6 +19,7 @@
 #include "base/macros.h"
 #include "base/observer_list.h"
 #include "base/single_thread_task_runner.h"
+#include "base/strings/string_piece.h"
 #include "base/strings/string_util.h"
 #include "base/synchronization/condition_variable.h"
 #include "base/synchronization/lock.h"
@@ -49,6 +50,11 @@ class BASE_EXPORT ConvertableToTraceFormat {
   // appended.
   virtual void AppendAsTraceFormat(std::string* out) const = 0;
 
+  // Appends the class info to |out| as a TracedValue message of the binary
+  // trace format, see trace_event_binary_format.h. Returns false, without
+  // appending anything, if the class can only be converted to JSON.
+  virtual bool AppendAsProto(std::string* out) const;
+
   virtual void EstimateTraceMemoryOverhead(TraceEventMemoryOverhead* overhead);
 
   std::string ToString() const {
@@ -72,6 +78,34 @@ struct TraceEventHandle {
   unsigned event_index : 6;
 };
 
+// Bump allocator for the strings which TraceEvent copies, i.e. the names of
+// TRACE_EVENT_COPY_* events and the copied string arguments, so that adding
+// an event to a TraceBufferChunk doesn't allocate. The memory is released
+// all at once by Reset(), when the events which point to it are reset.
+class BASE_EXPORT TraceEventStringArena {
+ public:
+  TraceEventStringArena();
+  ~TraceEventStringArena();
+
+  char* Allocate(size_t size);
+
+  // Releases all the allocations, but keeps the first block for reuse.
+  void Reset();
+
+  void EstimateTraceMemoryOverhead(TraceEventMemoryOverhead* overhead);
+
+  // Allocations larger than a quarter of a block get their own block.
+  static constexpr size_t kBlockSize = 4096;
+
+ private:
+  std::vector<std::unique_ptr<char[]>> blocks_;
+  size_t used_in_last_block_;
+  std::vector<std::unique_ptr<char[]>> large_blocks_;
+  size_t large_blocks_size_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceEventStringArena);
+};
+
 class BASE_EXPORT TraceEvent {
  public:
   union TraceValue {
@@ -81,6 +115,8 @@ class BASE_EXPORT TraceEvent {
     double as_double;
     const void* as_pointer;
     const char* as_string;
+    // Owned by the TraceEvent, for TRACE_VALUE_TYPE_CONVERTABLE.
+    ConvertableToTraceFormat* as_convertable;
   };
 
   TraceEvent();
@@ -88,6 +124,9 @@ class BASE_EXPORT TraceEvent {
 
   void MoveFrom(std::unique_ptr<TraceEvent> other);
 
+  // The copied strings are allocated from |string_arena| if not null, which
+  // must outlive the event or its next Reset(). Otherwise they are allocated
+  // on the heap and owned by the event.
   void Initialize(int thread_id,
                   TimeTicks timestamp,
                   ThreadTicks thread_timestamp,
@@ -102,7 +141,8 @@ class BASE_EXPORT TraceEvent {
                   const unsigned char* arg_types,
                   const unsigned long long* arg_values,
                   std::unique_ptr<ConvertableToTraceFormat>* convertable_values,
-                  unsigned int flags);
+                  unsigned int flags,
+                  TraceEventStringArena* string_arena = nullptr);
 
   void Reset();
 
@@ -132,8 +172,8 @@ class BASE_EXPORT TraceEvent {
   unsigned long long bind_id() const { return bind_id_; }
   // Exposed for unittesting:
 
-  const std::string* parameter_copy_storage() const {
-    return parameter_copy_storage_.get();
+  StringPiece parameter_copy_storage() const {
+    return StringPiece(parameter_copy_storage_, parameter_copy_storage_size_);
   }
 
   const unsigned char* category_group_enabled() const {
@@ -146,16 +186,18 @@ class BASE_EXPORT TraceEvent {
   const char* arg_name(size_t index) const { return arg_names_[index]; }
   const TraceValue& arg_value(size_t index) const { return arg_values_[index]; }
 
-  const ConvertableToTraceFormat* arg_convertible_value(size_t index) const {
-    return convertable_values_[index].get();
-  }
+  const ConvertableToTraceFormat* arg_convertible_value(size_t index) const;
 
 #if defined(OS_ANDROID)
   void SendToATrace();
 #endif
 
  private:
-  // Note: these are ordered by size (largest first) for optimal packing.
+  void ResetConvertableValues();
+  void ResetParameterCopyStorage();
+
+  // Note: these are ordered by size (largest first) for optimal packing, so
+  // that an event fits in two cache lines on 64-bit platforms.
   TimeTicks timestamp_;
   ThreadTicks thread_timestamp_;
   TimeDelta duration_;
@@ -165,11 +207,12 @@ class BASE_EXPORT TraceEvent {
   unsigned long long id_;
   TraceValue arg_values_[kTraceMaxNumArgs];
   const char* arg_names_[kTraceMaxNumArgs];
-  std::unique_ptr<ConvertableToTraceFormat>
-      convertable_values_[kTraceMaxNumArgs];
   const unsigned char* category_group_enabled_;
   const char* name_;
-  std::unique_ptr<std::string> parameter_copy_storage_;
+  // The copied strings, in a TraceEventStringArena unless
+  // |owns_parameter_copy_storage_|.
+  char* parameter_copy_storage_;
+  unsigned long long bind_id_;
   // Depending on TRACE_EVENT_FLAG_HAS_PROCESS_ID the event will have either:
   //  tid: thread_id_, pid: current_process_id (default case).
   //  tid: -1, pid: process_id_ (when flags_ & TRACE_EVENT_FLAG_HAS_PROCESS_ID).
@@ -178,9 +221,10 @@ class BASE_EXPORT TraceEvent {
     int process_id_;
   };
   unsigned int flags_;
-  unsigned long long bind_id_;
+  uint32_t parameter_copy_storage_size_;
   unsigned char arg_types_[kTraceMaxNumArgs];
   char phase_;
+  bool owns_parameter_copy_storage_;
 
   DISALLOW_COPY_AND_ASSIGN(TraceEvent);
 };
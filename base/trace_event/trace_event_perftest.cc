@@ -0,0 +1,106 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_event.h"
+
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/time/time.h"
+#include "base/trace_event/trace_buffer.h"
+#include "testing/gtest/include/gtest/gtest.h"
+#include "testing/perf/perf_test.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+constexpr int kNumEvents = 1000000;
+
+class TraceEventPerfTest : public testing::Test {
+ public:
+  void SetUp() override {
+    TraceLog::ResetForTesting();
+    // A ring buffer, so that the chunks and their string arenas are reused as
+    // they would be in a long trace.
+    TraceLog::GetInstance()->SetEnabled(
+        TraceConfig("perf", RECORD_CONTINUOUSLY), TraceLog::RECORDING_MODE);
+  }
+
+  void TearDown() override {
+    TraceLog::GetInstance()->SetDisabled();
+    TraceLog::ResetForTesting();
+  }
+
+  void PrintNsPerEvent(const std::string& trace, TimeTicks start) {
+    perf_test::PrintResult(
+        "trace_event", "", trace,
+        (TimeTicks::Now() - start).InNanoseconds() /
+            static_cast<double>(kNumEvents),
+        "ns/event", true);
+  }
+
+ private:
+  ShadowingAtExitManager at_exit_manager_;
+};
+
+}  // namespace
+
+TEST_F(TraceEventPerfTest, Size) {
+  perf_test::PrintResult("trace_event", "", "sizeof_TraceEvent",
+                         sizeof(TraceEvent), "bytes", true);
+}
+
+TEST_F(TraceEventPerfTest, Instant) {
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumEvents; ++i) {
+    TRACE_EVENT_INSTANT1("perf", "event", TRACE_EVENT_SCOPE_THREAD, "i", i);
+  }
+  PrintNsPerEvent("instant", start);
+}
+
+TEST_F(TraceEventPerfTest, CopyInstant) {
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumEvents; ++i) {
+    TRACE_EVENT_COPY_INSTANT1("perf", "copied_event", TRACE_EVENT_SCOPE_THREAD,
+                              "copied_arg", i);
+  }
+  PrintNsPerEvent("copy_instant", start);
+}
+
+TEST_F(TraceEventPerfTest, StringArgument) {
+  const std::string value = "a string argument which is copied";
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumEvents; ++i) {
+    TRACE_EVENT_INSTANT1("perf", "event", TRACE_EVENT_SCOPE_THREAD, "value",
+                         value);
+  }
+  PrintNsPerEvent("string_argument", start);
+}
+
+TEST_F(TraceEventPerfTest, SampledScoped) {
+  TraceLog::GetInstance()->SetDisabled();
+  TraceLog::GetInstance()->SetEnabled(
+      TraceConfig("{\"included_categories\": [\"perf\"],"
+                  " \"category_sampling\": [{\"category\": \"perf\","
+                  " \"sample_interval\": 100}]}"),
+      TraceLog::RECORDING_MODE);
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumEvents; ++i) {
+    TRACE_EVENT0("perf", "scoped");
+  }
+  PrintNsPerEvent("sampled_scoped_1_of_100", start);
+}
+
+TEST_F(TraceEventPerfTest, Scoped) {
+  TimeTicks start = TimeTicks::Now();
+  for (int i = 0; i < kNumEvents; ++i) {
+    TRACE_EVENT0("perf", "scoped");
+  }
+  PrintNsPerEvent("scoped", start);
+}
+
+}  // namespace trace_event
+}  // namespace base
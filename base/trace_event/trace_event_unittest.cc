@@ -1680,10 +1680,10 @@ TEST_F(TraceEventTestFixture, StaticStringVsString) {
     ASSERT_TRUE(event2);
     EXPECT_STREQ("name1", event1->name());
     EXPECT_STREQ("name2", event2->name());
-    EXPECT_TRUE(event1->parameter_copy_storage() != nullptr);
-    EXPECT_TRUE(event2->parameter_copy_storage() != nullptr);
-    EXPECT_GT(event1->parameter_copy_storage()->size(), 0u);
-    EXPECT_GT(event2->parameter_copy_storage()->size(), 0u);
+    EXPECT_FALSE(event1->parameter_copy_storage().empty());
+    EXPECT_FALSE(event2->parameter_copy_storage().empty());
+    EXPECT_STREQ("argval", event1->arg_value(0).as_string);
+    EXPECT_STREQ("argval", event2->arg_value(1).as_string);
     EndTraceAndFlush();
   }
 
@@ -1713,8 +1713,8 @@ TEST_F(TraceEventTestFixture, StaticStringVsString) {
     ASSERT_TRUE(event2);
     EXPECT_STREQ("name1", event1->name());
     EXPECT_STREQ("name2", event2->name());
-    EXPECT_TRUE(event1->parameter_copy_storage() == nullptr);
-    EXPECT_TRUE(event2->parameter_copy_storage() == nullptr);
+    EXPECT_TRUE(event1->parameter_copy_storage().empty());
+    EXPECT_TRUE(event2->parameter_copy_storage().empty());
     EndTraceAndFlush();
   }
 }
@@ -2810,22 +2810,15 @@ TEST_F(TraceEventTestFixture, ThreadOnceBlocking) {
       BindOnce(&BlockUntilStopped, &task_start_event, &task_stop_event));
   task_start_event.Wait();
 
-  // The thread will timeout in this flush.
+  // The events of the blocked thread are flushed without running a task on
+  // it.
   EndTraceAndFlushInThreadWithMessageLoop();
+  ValidateAllTraceMacrosCreatedData(trace_parsed_);
   Clear();
 
   // Let the thread's message loop continue to spin.
   task_stop_event.Signal();
 
-  // The following sequence ensures that the FlushCurrentThread task has been
-  // executed in the thread before continuing.
-  thread.task_runner()->PostTask(
-      FROM_HERE,
-      BindOnce(&BlockUntilStopped, &task_start_event, &task_stop_event));
-  task_start_event.Wait();
-  task_stop_event.Signal();
-  Clear();
-
   // TraceLog should discover the generation mismatch and recover the thread
   // local buffer for the thread without any error.
   BeginTrace();
@@ -2836,6 +2829,52 @@ TEST_F(TraceEventTestFixture, ThreadOnceBlocking) {
   ValidateAllTraceMacrosCreatedData(trace_parsed_);
 }
 
+// Traces events on a thread without a message loop, then blocks until
+// |stop_event| is signaled.
+class TraceWithoutMessageLoopDelegate : public PlatformThread::Delegate {
+ public:
+  TraceWithoutMessageLoopDelegate(int num_events,
+                                  WaitableEvent* task_complete_event,
+                                  WaitableEvent* stop_event)
+      : num_events_(num_events),
+        task_complete_event_(task_complete_event),
+        stop_event_(stop_event) {}
+
+  void ThreadMain() override {
+    TraceManyInstantEvents(0, num_events_, task_complete_event_);
+    stop_event_->Wait();
+  }
+
+ private:
+  const int num_events_;
+  WaitableEvent* const task_complete_event_;
+  WaitableEvent* const stop_event_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceWithoutMessageLoopDelegate);
+};
+
+TEST_F(TraceEventTestFixture, DataCapturedOnThreadWithoutMessageLoop) {
+  BeginTrace();
+
+  const int kNumEvents = 4000;
+  WaitableEvent task_complete_event(WaitableEvent::ResetPolicy::AUTOMATIC,
+                                    WaitableEvent::InitialState::NOT_SIGNALED);
+  WaitableEvent stop_event(WaitableEvent::ResetPolicy::AUTOMATIC,
+                           WaitableEvent::InitialState::NOT_SIGNALED);
+  TraceWithoutMessageLoopDelegate delegate(kNumEvents, &task_complete_event,
+                                           &stop_event);
+  PlatformThreadHandle handle;
+  ASSERT_TRUE(PlatformThread::Create(0, &delegate, &handle));
+  task_complete_event.Wait();
+
+  // The thread is still running and holds its last chunk.
+  EndTraceAndFlush();
+  ValidateInstantEventPresentOnEveryThread(trace_parsed_, 1, kNumEvents);
+
+  stop_event.Signal();
+  PlatformThread::Join(handle);
+}
+
 std::string* g_log_buffer = nullptr;
 bool MockLogMessageHandler(int, const char*, int, size_t,
                            const std::string& str) {
@@ -3117,6 +3156,67 @@ TEST_F(TraceEventTestFixture, EventWhitelistFiltering) {
   EXPECT_FALSE(FindMatchingValue("name", "a pony"));
 }
 
+// The whitelist filter supports filtering at flush time, unlike the heap
+// profiler filter which has to see the events as they are added.
+TEST_F(TraceEventTestFixture, EventFilteringAtFlush) {
+  std::string config_json = StringPrintf(
+      "{"
+      "  \"included_categories\": ["
+      "    \"filtered_cat\","
+      "    \"heap_cat\","
+      "    \"unfiltered_cat\"],"
+      "  \"event_filters\": ["
+      "     {"
+      "       \"filter_predicate\": \"%s\", "
+      "       \"included_categories\": [\"filtered_cat\"], "
+      "       \"filter_args\": {"
+      "           \"event_name_whitelist\": [\"a snake\", \"a dog\"]"
+      "         },"
+      "       \"filter_at_flush\": true"
+      "     },"
+      "     {"
+      "       \"filter_predicate\": \"%s\", "
+      "       \"included_categories\": [\"heap_cat\"], "
+      "       \"filter_at_flush\": true"
+      "     }"
+      "  ]"
+      "}",
+      EventNameFilter::kName, HeapProfilerEventFilter::kName);
+
+  TraceConfig trace_config(config_json);
+  TraceLog::GetInstance()->SetEnabled(
+      trace_config, TraceLog::RECORDING_MODE | TraceLog::FILTERING_MODE);
+  EXPECT_TRUE(TraceLog::GetInstance()->IsEnabled());
+  EXPECT_EQ(TraceCategory::ENABLED_FOR_RECORDING,
+            *TraceLog::GetCategoryGroupEnabled("filtered_cat"));
+  EXPECT_EQ(TraceCategory::ENABLED_FOR_RECORDING |
+                TraceCategory::ENABLED_FOR_FILTERING,
+            *TraceLog::GetCategoryGroupEnabled("heap_cat"));
+
+  // Several chunks of events.
+  constexpr int kNumEvents = 200;
+  for (int i = 0; i < kNumEvents; ++i) {
+    TRACE_EVENT_INSTANT0("filtered_cat", "a snake", TRACE_EVENT_SCOPE_THREAD);
+    TRACE_EVENT_INSTANT0("filtered_cat", "a mushroom",
+                         TRACE_EVENT_SCOPE_THREAD);
+    TRACE_EVENT_COPY_INSTANT0("filtered_cat", std::string("a dog").c_str(),
+                              TRACE_EVENT_SCOPE_THREAD);
+  }
+  TRACE_EVENT0("unfiltered_cat", "a cat");
+  TRACE_EVENT0("heap_cat", "a pony");
+
+  EndTraceAndFlush();
+
+  EXPECT_EQ(static_cast<size_t>(kNumEvents),
+            FindTraceEntries(trace_parsed_, "a snake").size());
+  EXPECT_EQ(static_cast<size_t>(kNumEvents),
+            FindTraceEntries(trace_parsed_, "a dog").size());
+  EXPECT_FALSE(FindMatchingValue("name", "a mushroom"));
+  EXPECT_TRUE(FindMatchingValue("name", "a cat"));
+  EXPECT_TRUE(FindMatchingValue("name", "a pony"));
+  EXPECT_TRUE(FindMatchingValue("name", "num_cpus"));
+}
+
 TEST_F(TraceEventTestFixture, HeapProfilerFiltering) {
   std::string config_json = StringPrintf(
       "{"
@@ -3158,6 +3258,93 @@ TEST_F(TraceEventTestFixture, HeapProfilerFiltering) {
   EXPECT_TRUE(FindMatchingValue("name", "a pony"));
 }
 
+TEST_F(TraceEventTestFixture, CategorySampling) {
+  TraceConfig trace_config(
+      "{"
+      "  \"included_categories\": [\"sampled\", \"limited\", \"other\"],"
+      "  \"category_sampling\": ["
+      "    {\"category\": \"sampled\", \"sample_interval\": 10},"
+      "    {\"category\": \"limited\", \"max_events_per_second\": 5}"
+      "  ]"
+      "}");
+  TraceLog::GetInstance()->SetEnabled(trace_config, TraceLog::RECORDING_MODE);
+
+  for (int i = 0; i < 100; ++i) {
+    TRACE_EVENT_INSTANT0("sampled", "instant", TRACE_EVENT_SCOPE_THREAD);
+    TRACE_EVENT0("sampled", "complete");
+    TRACE_EVENT_BEGIN0("sampled", "begin_end");
+    TRACE_EVENT_END0("sampled", "begin_end");
+    TRACE_EVENT_INSTANT0("limited", "instant", TRACE_EVENT_SCOPE_THREAD);
+    TRACE_EVENT_INSTANT0("other", "instant", TRACE_EVENT_SCOPE_THREAD);
+  }
+  EndTraceAndFlush();
+
+  auto count = [this](const char* category, const char* name,
+                      const char* phase) {
+    size_t count = 0;
+    for (const Value& value : trace_parsed_.GetList()) {
+      const Value* event_category = value.FindKey("cat");
+      const Value* event_name = value.FindKey("name");
+      const Value* event_phase = value.FindKey("ph");
+      if (event_category && event_category->GetString() == category &&
+          event_name && event_name->GetString() == name && event_phase &&
+          event_phase->GetString() == phase) {
+        count++;
+      }
+    }
+    return count;
+  };
+  // The interval counts all the sampled events of the category.
+  EXPECT_EQ(20u, count("sampled", "instant", "I") +
+                     count("sampled", "complete", "X"));
+  // The paired events aren't sampled.
+  EXPECT_EQ(100u, count("sampled", "begin_end", "B"));
+  EXPECT_EQ(100u, count("sampled", "begin_end", "E"));
+  // At most 5 per second, but the loop can span two seconds.
+  EXPECT_GE(count("limited", "instant", "I"), 5u);
+  EXPECT_LE(count("limited", "instant", "I"), 10u);
+  EXPECT_EQ(100u, count("other", "instant", "I"));
+}
+
+TEST_F(TraceEventTestFixture, CategorySamplingOnlyAppliesToRecording) {
+  const char config_json[] =
+      "{"
+      "  \"included_categories\": [\"recorded_cat\"],"
+      "  \"event_filters\": ["
+      "     {"
+      "       \"filter_predicate\": \"testing_predicate\", "
+      "       \"included_categories\": [\"filtered_cat\"]"
+      "     }"
+      "  ],"
+      "  \"category_sampling\": ["
+      "    {\"category\": \"*_cat\", \"sample_interval\": 10}"
+      "  ]"
+      "}";
+
+  TestEventFilter::HitsCounter filter_hits_counter;
+  TestEventFilter::set_filter_return_value(true);
+  TraceLog::GetInstance()->SetFilterFactoryForTesting(TestEventFilter::Factory);
+
+  TraceLog::GetInstance()->SetEnabled(
+      TraceConfig(config_json),
+      TraceLog::RECORDING_MODE | TraceLog::FILTERING_MODE);
+  for (int i = 0; i < 100; ++i) {
+    TRACE_EVENT_INSTANT0("recorded_cat", "instant", TRACE_EVENT_SCOPE_THREAD);
+    TRACE_EVENT_INSTANT0("filtered_cat", "instant", TRACE_EVENT_SCOPE_THREAD);
+  }
+  EndTraceAndFlush();
+
+  // The filter sees all the events of the category it alone enables.
+  EXPECT_EQ(100u, filter_hits_counter.filter_trace_event_hit_count);
+  size_t recorded = 0;
+  for (const Value& value : trace_parsed_.GetList()) {
+    const Value* category = value.FindKey("cat");
+    if (category && category->GetString() == "recorded_cat")
+      recorded++;
+  }
+  EXPECT_EQ(10u, recorded);
+}
+
 TEST_F(TraceEventTestFixture, ClockSyncEventsAreAlwaysAddedToTrace) {
   BeginSpecificTrace("-*");
   TRACE_EVENT_CLOCK_SYNC_RECEIVER(1);
@@ -3165,5 +3352,72 @@ TEST_F(TraceEventTestFixture, ClockSyncEventsAreAlwaysAddedToTrace) {
   EXPECT_TRUE(FindNamePhase("clock_sync", "c"));
 }
 
+TEST(TraceEventStringArenaTest, CopiesIntoChunk) {
+  TraceBufferChunk chunk(1);
+  const unsigned char* category_group_enabled =
+      TraceLog::GetCategoryGroupEnabled("cat");
+  const char* arg_name = "arg";
+  const unsigned char arg_type = TRACE_VALUE_TYPE_COPY_STRING;
+  const std::string long_value(TraceEventStringArena::kBlockSize, 'x');
+
+  // Fill the chunk, with enough strings to need several blocks, and check
+  // that the earlier strings aren't moved by the later allocations.
+  std::vector<std::string> values;
+  for (size_t i = 0; i < chunk.capacity(); ++i)
+    values.push_back(i % 8 ? std::string(100, 'a' + i % 26) : long_value);
+  for (size_t i = 0; i < chunk.capacity(); ++i) {
+    size_t event_index;
+    TraceEvent* event = chunk.AddTraceEvent(&event_index);
+    TraceEvent::TraceValue value;
+    value.as_string = values[i].c_str();
+    event->Initialize(0, TimeTicks(), ThreadTicks(), TRACE_EVENT_PHASE_INSTANT,
+                      category_group_enabled, "name",
+                      trace_event_internal::kGlobalScope,
+                      trace_event_internal::kNoId, trace_event_internal::kNoId,
+                      1, &arg_name, &arg_type, &value.as_uint, nullptr,
+                      TRACE_EVENT_FLAG_COPY, chunk.string_arena());
+    EXPECT_FALSE(event->parameter_copy_storage().empty());
+  }
+  for (size_t i = 0; i < chunk.capacity(); ++i) {
+    const TraceEvent* event = chunk.GetEventAt(i);
+    EXPECT_STREQ("name", event->name());
+    EXPECT_STREQ("arg", event->arg_name(0));
+    EXPECT_EQ(values[i], event->arg_value(0).as_string);
+  }
+
+  // The storage in the arena is accounted for by the chunk, not the events.
+  TraceEventMemoryOverhead event_overhead;
+  chunk.GetEventAt(1)->EstimateTraceMemoryOverhead(&event_overhead);
+  EXPECT_EQ(0u, event_overhead.GetCount(TraceEventMemoryOverhead::kStdString));
+
+  chunk.Reset(2);
+  EXPECT_EQ(0u, chunk.size());
+}
+
+TEST(TraceEventStringArenaTest, HeapStorageWithoutArena) {
+  const char* arg_name = "arg";
+  const unsigned char arg_type = TRACE_VALUE_TYPE_COPY_STRING;
+  TraceEvent::TraceValue value;
+  value.as_string = "value";
+  std::unique_ptr<TraceEvent> event(new TraceEvent);
+  event->Initialize(0, TimeTicks(), ThreadTicks(), TRACE_EVENT_PHASE_INSTANT,
+                    TraceLog::GetCategoryGroupEnabled("cat"), "name",
+                    trace_event_internal::kGlobalScope,
+                    trace_event_internal::kNoId, trace_event_internal::kNoId, 1,
+                    &arg_name, &arg_type, &value.as_uint, nullptr,
+                    TRACE_EVENT_FLAG_NONE);
+  EXPECT_EQ(sizeof("value"), event->parameter_copy_storage().size());
+
+  TraceEventMemoryOverhead overhead;
+  event->EstimateTraceMemoryOverhead(&overhead);
+  EXPECT_EQ(1u, overhead.GetCount(TraceEventMemoryOverhead::kStdString));
+
+  // The storage moves along with the event.
+  TraceEvent moved;
+  moved.MoveFrom(std::move(event));
+  EXPECT_STREQ("value", moved.arg_value(0).as_string);
+  EXPECT_EQ(sizeof("value"), moved.parameter_copy_storage().size());
+}
+
 }  // namespace trace_event
 }  // namespace base
@@ -17,9 +17,8 @@
 #include "base/macros.h"
 #include "base/memory/ptr_util.h"
 #include "base/memory/ref_counted_memory.h"
-#include "base/message_loop/message_loop.h"
-#include "base/message_loop/message_loop_current.h"
 #include "base/no_destructor.h"
+#include "base/optional.h"
 #include "base/process/process_info.h"
 #include "base/process/process_metrics.h"
 #include "base/stl_util.h"
@@ -30,7 +29,6 @@
 #include "base/sys_info.h"
 #include "base/task_scheduler/post_task.h"
 #include "base/threading/platform_thread.h"
-#include "base/threading/sequenced_task_runner_handle.h"
 #include "base/threading/thread_id_name_manager.h"
 #include "base/threading/thread_task_runner_handle.h"
 #include "base/time/time.h"
@@ -44,6 +42,9 @@
 #include "base/trace_event/process_memory_dump.h"
 #include "base/trace_event/trace_buffer.h"
 #include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_batch_filter.h"
+#include "base/trace_event/trace_event_binary_format.h"
+#include "base/trace_event/trace_stream_writer.h"
 #include "build/build_config.h"
 
 #if defined(OS_WIN)
@@ -80,7 +81,6 @@ const size_t kTraceEventRingBufferChunks = kTraceEventVectorBufferChunks / 4;
 const size_t kEchoToConsoleTraceEventBufferChunks = 256;
 
 const size_t kTraceEventBufferSizeInBytes = 100 * 1024;
-const int kThreadFlushTimeoutMs = 3000;
 
 TraceLog* g_trace_log_for_testing = nullptr;
 
@@ -196,16 +196,28 @@ class TraceLog::OptionalAutoLock {
   DISALLOW_COPY_AND_ASSIGN(OptionalAutoLock);
 };
 
-class TraceLog::ThreadLocalEventBuffer
-    : public MessageLoopCurrent::DestructionObserver,
-      public MemoryDumpProvider {
+// Holds the chunk that the events of one thread are added to, so that
+// recording doesn't contend on TraceLog::lock_. Every thread which records
+// events has one, whether it has a message loop or not. The chunk is returned
+// to the TraceBuffer when it is full, when the thread exits and when Flush()
+// collects it from another thread, which |lock_| protects against.
+class TraceLog::ThreadLocalEventBuffer {
  public:
   explicit ThreadLocalEventBuffer(TraceLog* trace_log);
-  ~ThreadLocalEventBuffer() override;
+  ~ThreadLocalEventBuffer();
 
-  TraceEvent* AddTraceEvent(TraceEventHandle* handle);
+  // The destructor of the TLS slot which owns the buffers.
+  static void OnThreadExit(void* buffer);
 
+  // Must be called on the buffer's thread, with lock() held while the
+  // returned event is written. Sets |*check_buffer_is_full| when a new chunk
+  // was taken from the TraceBuffer.
+  TraceEvent* AddTraceEvent(TraceEventHandle* handle,
+                            bool* check_buffer_is_full);
+
+  // Must be called with lock() held.
   TraceEvent* GetEventByHandle(TraceEventHandle handle) {
+    lock_.AssertAcquired();
     if (!chunk_ || handle.chunk_seq != chunk_->seq() ||
         handle.chunk_index != chunk_index_) {
       return nullptr;
@@ -214,25 +226,29 @@ class TraceLog::ThreadLocalEventBuffer
     return chunk_->GetEventAt(handle.event_index);
   }
 
-  int generation() const { return generation_; }
-
- private:
-  // MessageLoopCurrent::DestructionObserver
-  void WillDestroyCurrentMessageLoop() override;
-
-  // MemoryDumpProvider implementation.
-  bool OnMemoryDump(const MemoryDumpArgs& args,
-                    ProcessMemoryDump* pmd) override;
+  // The arena of the chunk the last event was added to. Must be called with
+  // lock() held.
+  TraceEventStringArena* string_arena() {
+    lock_.AssertAcquired();
+    return chunk_->string_arena();
+  }
 
+  // Returns the chunk to the TraceBuffer. Can be called on any thread, with
+  // lock() and TraceLog::lock_ held.
   void FlushWhileLocked();
 
-  void CheckThisIsCurrentBuffer() const {
-    DCHECK(trace_log_->thread_local_event_buffer_.Get() == this);
-  }
+  void EstimateTraceMemoryOverhead(TraceEventMemoryOverhead* overhead);
+
+  Lock& lock() { return lock_; }
+  PlatformThreadId thread_id() const { return thread_id_; }
 
+ private:
   // Since TraceLog is a leaky singleton, trace_log_ will always be valid
   // as long as the thread exists.
   TraceLog* trace_log_;
+  const PlatformThreadId thread_id_;
+  // Only contended while another thread flushes the chunk.
+  Lock lock_;
   std::unique_ptr<TraceBufferChunk> chunk_;
   size_t chunk_index_;
   int generation_;
@@ -242,47 +258,55 @@ class TraceLog::ThreadLocalEventBuffer
 
 TraceLog::ThreadLocalEventBuffer::ThreadLocalEventBuffer(TraceLog* trace_log)
     : trace_log_(trace_log),
+      thread_id_(PlatformThread::CurrentId()),
       chunk_index_(0),
       generation_(trace_log->generation()) {
-  // ThreadLocalEventBuffer is created only if the thread has a message loop, so
-  // the following message_loop won't be NULL.
-  MessageLoop* message_loop = MessageLoop::current();
-  message_loop->AddDestructionObserver(this);
-
-  // This is to report the local memory usage when memory-infra is enabled.
-  MemoryDumpManager::GetInstance()->RegisterDumpProvider(
-      this, "ThreadLocalEventBuffer", ThreadTaskRunnerHandle::Get());
-
-  AutoLock lock(trace_log->lock_);
-  trace_log->thread_message_loops_.insert(message_loop);
+  AutoLock lock(trace_log->thread_local_event_buffers_lock_);
+  trace_log->thread_local_event_buffers_.push_back(this);
 }
 
 TraceLog::ThreadLocalEventBuffer::~ThreadLocalEventBuffer() {
-  CheckThisIsCurrentBuffer();
-  MessageLoop::current()->RemoveDestructionObserver(this);
-  MemoryDumpManager::GetInstance()->UnregisterDumpProvider(this);
+  AutoLock buffers_lock(trace_log_->thread_local_event_buffers_lock_);
+  auto& buffers = trace_log_->thread_local_event_buffers_;
+  auto it = std::find(buffers.begin(), buffers.end(), this);
+  if (it != buffers.end())
+    buffers.erase(it);
 
-  {
-    AutoLock lock(trace_log_->lock_);
-    FlushWhileLocked();
-    trace_log_->thread_message_loops_.erase(MessageLoop::current());
-  }
-  trace_log_->thread_local_event_buffer_.Set(nullptr);
+  AutoLock lock(lock_);
+  AutoLock trace_log_lock(trace_log_->lock_);
+  FlushWhileLocked();
+}
+
+// static
+void TraceLog::ThreadLocalEventBuffer::OnThreadExit(void* buffer) {
+  ThreadLocalEventBuffer* thread_local_event_buffer =
+      static_cast<ThreadLocalEventBuffer*>(buffer);
+  TraceLog* trace_log = thread_local_event_buffer->trace_log_;
+  // The events of other TLS destructors go to the thread shared chunk.
+  trace_log->thread_is_exiting_.Set(true);
+  trace_log->thread_local_event_buffer_.Set(nullptr);
+  delete thread_local_event_buffer;
 }
 
 TraceEvent* TraceLog::ThreadLocalEventBuffer::AddTraceEvent(
-    TraceEventHandle* handle) {
-  CheckThisIsCurrentBuffer();
+    TraceEventHandle* handle,
+    bool* check_buffer_is_full) {
+  DCHECK_EQ(thread_id_, PlatformThread::CurrentId());
+  lock_.AssertAcquired();
 
+  if (chunk_ && !trace_log_->CheckGeneration(generation_)) {
+    // The TraceBuffer this chunk was taken from has been flushed.
+    chunk_.reset();
+  }
   if (chunk_ && chunk_->IsFull()) {
     AutoLock lock(trace_log_->lock_);
     FlushWhileLocked();
-    chunk_.reset();
   }
   if (!chunk_) {
     AutoLock lock(trace_log_->lock_);
     chunk_ = trace_log_->logged_events_->GetChunk(&chunk_index_);
-    trace_log_->CheckIfBufferIsFullWhileLocked();
+    generation_ = trace_log_->generation();
+    *check_buffer_is_full = true;
   }
   if (!chunk_)
     return nullptr;
@@ -295,23 +319,15 @@ TraceEvent* TraceLog::ThreadLocalEventBuffer::AddTraceEvent(
   return trace_event;
 }
 
-void TraceLog::ThreadLocalEventBuffer::WillDestroyCurrentMessageLoop() {
-  delete this;
-}
-
-bool TraceLog::ThreadLocalEventBuffer::OnMemoryDump(const MemoryDumpArgs& args,
-                                                    ProcessMemoryDump* pmd) {
-  if (!chunk_)
-    return true;
-  std::string dump_base_name = StringPrintf(
-      "tracing/thread_%d", static_cast<int>(PlatformThread::CurrentId()));
-  TraceEventMemoryOverhead overhead;
-  chunk_->EstimateTraceMemoryOverhead(&overhead);
-  overhead.DumpInto(dump_base_name.c_str(), pmd);
-  return true;
+void TraceLog::ThreadLocalEventBuffer::EstimateTraceMemoryOverhead(
+    TraceEventMemoryOverhead* overhead) {
+  AutoLock lock(lock_);
+  if (chunk_)
+    chunk_->EstimateTraceMemoryOverhead(overhead);
 }
 
 void TraceLog::ThreadLocalEventBuffer::FlushWhileLocked() {
+  lock_.AssertAcquired();
   if (!chunk_)
     return;
 
@@ -319,9 +335,9 @@ void TraceLog::ThreadLocalEventBuffer::FlushWhileLocked() {
   if (trace_log_->CheckGeneration(generation_)) {
     // Return the chunk to the buffer only if the generation matches.
     trace_log_->logged_events_->ReturnChunk(chunk_index_, std::move(chunk_));
+  } else {
+    chunk_.reset();
   }
-  // Otherwise this method may be called from the destructor, or TraceLog will
-  // find the generation mismatch and delete this buffer soon.
 }
 
 void TraceLog::SetAddTraceEventOverride(
@@ -367,9 +383,11 @@ TraceLog::TraceLog()
       process_id_(0),
       trace_options_(kInternalRecordUntilFull),
       trace_config_(TraceConfig()),
+      thread_local_event_buffer_slot_(&ThreadLocalEventBuffer::OnThreadExit),
       thread_shared_chunk_index_(0),
       generation_(0),
       use_worker_thread_(false),
+      flush_format_(FlushFormat::kJSON),
       trace_event_override_(0),
       filter_factory_for_testing_(nullptr) {
   CategoryRegistry::Initialize();
@@ -396,27 +414,34 @@ TraceLog::TraceLog()
   g_trace_log_for_testing = this;
 }
 
-TraceLog::~TraceLog() = default;
+TraceLog::~TraceLog() {
+  // Only reached from ResetForTesting(). The buffers of the threads which are
+  // still running can't be reached through |thread_local_event_buffer_slot_|
+  // anymore.
+  std::vector<ThreadLocalEventBuffer*> thread_local_event_buffers;
+  {
+    AutoLock lock(thread_local_event_buffers_lock_);
+    thread_local_event_buffers.swap(thread_local_event_buffers_);
+  }
+  for (ThreadLocalEventBuffer* thread_local_event_buffer :
+       thread_local_event_buffers) {
+    delete thread_local_event_buffer;
+  }
+}
 
 void TraceLog::InitializeThreadLocalEventBufferIfSupported() {
-  // A ThreadLocalEventBuffer needs the message loop
-  // - to know when the thread exits;
-  // - to handle the final flush.
-  // For a thread without a message loop or the message loop may be blocked, the
-  // trace events will be added into the main buffer directly.
-  if (thread_blocks_message_loop_.Get() || !MessageLoopCurrent::IsSet())
+  // Once the thread's buffer was deleted on thread exit, its events are added
+  // into the main buffer directly.
+  if (thread_is_exiting_.Get() || thread_local_event_buffer_.Get() ||
+      ThreadLocalStorage::HasBeenDestroyed()) {
     return;
-  HEAP_PROFILER_SCOPED_IGNORE;
-  auto* thread_local_event_buffer = thread_local_event_buffer_.Get();
-  if (thread_local_event_buffer &&
-      !CheckGeneration(thread_local_event_buffer->generation())) {
-    delete thread_local_event_buffer;
-    thread_local_event_buffer = nullptr;
-  }
-  if (!thread_local_event_buffer) {
-    thread_local_event_buffer = new ThreadLocalEventBuffer(this);
-    thread_local_event_buffer_.Set(thread_local_event_buffer);
   }
+  HEAP_PROFILER_SCOPED_IGNORE;
+  ThreadLocalEventBuffer* thread_local_event_buffer =
+      new ThreadLocalEventBuffer(this);
+  thread_local_event_buffer_.Set(thread_local_event_buffer);
+  // The slot owns the buffer, so that it is deleted when the thread exits.
+  thread_local_event_buffer_slot_.Set(thread_local_event_buffer);
 }
 
 bool TraceLog::OnMemoryDump(const MemoryDumpArgs& args,
@@ -435,6 +460,18 @@ bool TraceLog::OnMemoryDump(const MemoryDumpArgs& args,
   }
   overhead.AddSelf();
   overhead.DumpInto("tracing/main_trace_log", pmd);
+
+  AutoLock lock(thread_local_event_buffers_lock_);
+  for (ThreadLocalEventBuffer* thread_local_event_buffer :
+       thread_local_event_buffers_) {
+    TraceEventMemoryOverhead thread_overhead;
+    thread_local_event_buffer->EstimateTraceMemoryOverhead(&thread_overhead);
+    thread_overhead.DumpInto(
+        StringPrintf("tracing/thread_%d",
+                     static_cast<int>(thread_local_event_buffer->thread_id()))
+            .c_str(),
+        pmd);
+  }
   return true;
 }
 
@@ -504,7 +541,39 @@ void TraceLog::UpdateCategoryState(TraceCategory* category) {
       break;
     }
   }
+
+  // The events of the recorded categories whose filters all filter at flush
+  // time are added unfiltered. The metadata events are never filtered. The
+  // batch filter keeps the filters of the categories when recording stops,
+  // as they are used by the flush.
+  if (batch_filter_ && (state_flags & TraceCategory::ENABLED_FOR_RECORDING) &&
+      category != CategoryRegistry::kCategoryMetadata) {
+    const bool filter_at_flush =
+        enabled_filters_bitmap &&
+        !(enabled_filters_bitmap & ~batch_filter_->batch_filters());
+    batch_filter_->SetCategoryFilters(
+        category->state_ptr(), filter_at_flush ? enabled_filters_bitmap : 0);
+    if (filter_at_flush) {
+      state_flags &= ~TraceCategory::ENABLED_FOR_FILTERING;
+      enabled_filters_bitmap = 0;
+    }
+  }
   category->set_enabled_filters(enabled_filters_bitmap);
+
+  // The sampling is set before the state, which the macros check first. Only
+  // recorded events are sampled, so that filters and ETW see all of them.
+  const TraceConfig::CategorySampling* sampling =
+      (state_flags & TraceCategory::ENABLED_FOR_RECORDING) &&
+              category != CategoryRegistry::kCategoryMetadata
+          ? trace_config_.GetCategorySampling(category->name())
+          : nullptr;
+  if (sampling) {
+    category->set_sampling(sampling->sample_interval,
+                           sampling->max_events_per_second);
+    state_flags |= TraceCategory::ENABLED_FOR_SAMPLING;
+  } else {
+    category->set_sampling(0, 0);
+  }
   category->set_state(state_flags);
 }
 
@@ -525,6 +594,8 @@ void TraceLog::CreateFiltersForTraceConfig() {
   if (GetCategoryGroupFilters().size())
     return;
 
+  TraceEventBatchFilter::Predicates batch_predicates;
+  bool has_batch_predicates = false;
   for (auto& filter_config : enabled_event_filters_) {
     if (GetCategoryGroupFilters().size() >= MAX_TRACE_EVENT_FILTERS) {
       NOTREACHED()
@@ -545,8 +616,16 @@ void TraceLog::CreateFiltersForTraceConfig() {
         new_filter = filter_factory_for_testing_(predicate_name);
       CHECK(new_filter) << "Unknown trace filter " << predicate_name;
     }
+    batch_predicates.push_back(filter_config.filter_at_flush()
+                                   ? new_filter->CreateBatchPredicate()
+                                   : nullptr);
+    has_batch_predicates |= !!batch_predicates.back();
     GetCategoryGroupFilters().push_back(std::move(new_filter));
   }
+  if (has_batch_predicates) {
+    batch_filter_ =
+        MakeRefCounted<TraceEventBatchFilter>(std::move(batch_predicates));
+  }
 }
 
 void TraceLog::GetKnownCategoryGroups(
@@ -566,9 +645,6 @@ void TraceLog::SetEnabled(const TraceConfig& trace_config,
   {
     AutoLock lock(lock_);
 
-    // Can't enable tracing when Flush() is in progress.
-    DCHECK(!flush_task_runner_);
-
     InternalTraceOptions new_options =
         GetInternalOptionsFromTraceConfig(trace_config);
 
@@ -584,8 +660,10 @@ void TraceLog::SetEnabled(const TraceConfig& trace_config,
     // Clear all filters from previous tracing session. These filters are not
     // cleared at the end of tracing because some threads which hit trace event
     // when disabling, could try to use the filters.
-    if (!enabled_modes_)
+    if (!enabled_modes_) {
       GetCategoryGroupFilters().clear();
+      batch_filter_ = nullptr;
+    }
 
     // Update trace config for recording.
     const bool already_recording = enabled_modes_ & RECORDING_MODE;
@@ -620,7 +698,7 @@ void TraceLog::SetEnabled(const TraceConfig& trace_config,
     if (!(modes_to_enable & RECORDING_MODE) || already_recording)
       return;
 
-    if (new_options != old_options) {
+    if (new_options != old_options || stream_writer_) {
       subtle::NoBarrier_Store(&trace_options_, new_options);
       UseNextTraceBuffer();
     }
@@ -824,29 +902,35 @@ void TraceLog::CheckIfBufferIsFullWhileLocked() {
 }
 
 // Flush() works as the following:
-// 1. Flush() is called in thread A whose task runner is saved in
-//    flush_task_runner_;
-// 2. If thread_message_loops_ is not empty, thread A posts task to each message
-//    loop to flush the thread local buffers; otherwise finish the flush;
-// 3. FlushCurrentThread() deletes the thread local event buffer:
-//    - The last batch of events of the thread are flushed into the main buffer;
-//    - The message loop will be removed from thread_message_loops_;
-//    If this is the last message loop, finish the flush;
-// 4. If any thread hasn't finish its flush in time, finish the flush.
+// 1. The chunk of each ThreadLocalEventBuffer is returned to the main buffer
+//    under the buffer's lock, so that no thread has to run a task for it and
+//    threads which are blocked or have no message loop are flushed as well;
+// 2. The thread shared chunk is returned to the main buffer;
+// 3. FinishFlush() converts the main buffer and runs the callback, on a worker
+//    thread if requested.
 void TraceLog::Flush(const TraceLog::OutputCallback& cb,
-                     bool use_worker_thread) {
-  FlushInternal(cb, use_worker_thread, false);
+                     bool use_worker_thread,
+                     FlushFormat format) {
+  FlushInternal(cb, use_worker_thread, format, false);
 }
 
 void TraceLog::CancelTracing(const OutputCallback& cb) {
   SetDisabled();
-  FlushInternal(cb, false, true);
+  FlushInternal(cb, false, FlushFormat::kJSON, true);
+}
+
+void TraceLog::SetStreamingOutput(std::unique_ptr<TraceStreamWriter> writer) {
+  AutoLock lock(lock_);
+  DCHECK(!(enabled_modes_ & RECORDING_MODE));
+  stream_writer_ = std::move(writer);
 }
 
 void TraceLog::FlushInternal(const TraceLog::OutputCallback& cb,
                              bool use_worker_thread,
+                             FlushFormat format,
                              bool discard_events) {
   use_worker_thread_ = use_worker_thread;
+  flush_format_ = format;
   if (IsEnabled()) {
     // Can't flush when tracing is enabled because otherwise PostTask would
     // - generate more trace events;
@@ -860,39 +944,24 @@ void TraceLog::FlushInternal(const TraceLog::OutputCallback& cb,
   }
 
   int gen = generation();
-  // Copy of thread_message_loops_ to be used without locking.
-  std::vector<scoped_refptr<SingleThreadTaskRunner>>
-      thread_message_loop_task_runners;
+  {
+    AutoLock buffers_lock(thread_local_event_buffers_lock_);
+    for (ThreadLocalEventBuffer* thread_local_event_buffer :
+         thread_local_event_buffers_) {
+      AutoLock buffer_lock(thread_local_event_buffer->lock());
+      AutoLock lock(lock_);
+      thread_local_event_buffer->FlushWhileLocked();
+    }
+  }
+
   {
     AutoLock lock(lock_);
-    DCHECK(!flush_task_runner_);
-    flush_task_runner_ = SequencedTaskRunnerHandle::IsSet()
-                             ? SequencedTaskRunnerHandle::Get()
-                             : nullptr;
-    DCHECK(thread_message_loops_.empty() || flush_task_runner_);
     flush_output_callback_ = cb;
 
     if (thread_shared_chunk_) {
       logged_events_->ReturnChunk(thread_shared_chunk_index_,
                                   std::move(thread_shared_chunk_));
     }
-
-    for (MessageLoop* loop : thread_message_loops_)
-      thread_message_loop_task_runners.push_back(loop->task_runner());
-  }
-
-  if (!thread_message_loop_task_runners.empty()) {
-    for (auto& task_runner : thread_message_loop_task_runners) {
-      task_runner->PostTask(
-          FROM_HERE, BindOnce(&TraceLog::FlushCurrentThread, Unretained(this),
-                              gen, discard_events));
-    }
-    flush_task_runner_->PostDelayedTask(
-        FROM_HERE,
-        BindOnce(&TraceLog::OnFlushTimeout, Unretained(this), gen,
-                 discard_events),
-        TimeDelta::FromMilliseconds(kThreadFlushTimeoutMs));
-    return;
   }
 
   FinishFlush(gen, discard_events);
@@ -902,28 +971,46 @@ void TraceLog::FlushInternal(const TraceLog::OutputCallback& cb,
 void TraceLog::ConvertTraceEventsToTraceFormat(
     std::unique_ptr<TraceBuffer> logged_events,
     const OutputCallback& flush_output_callback,
-    const ArgumentFilterPredicate& argument_filter_predicate) {
+    const ArgumentFilterPredicate& argument_filter_predicate,
+    scoped_refptr<TraceEventBatchFilter> batch_filter,
+    FlushFormat format) {
   if (flush_output_callback.is_null())
     return;
 
   HEAP_PROFILER_SCOPED_IGNORE;
+  // The binary writer keeps the strings it interned for the whole flush, as
+  // they are only written once.
+  std::unique_ptr<TraceEventBinaryWriter> binary_writer;
+  if (format == FlushFormat::kBinary)
+    binary_writer.reset(new TraceEventBinaryWriter(argument_filter_predicate));
+
   // The callback need to be called at least once even if there is no events
   // to let the caller know the completion of flush.
   scoped_refptr<RefCountedString> json_events_str_ptr = new RefCountedString();
   const size_t kReserveCapacity = kTraceEventBufferSizeInBytes * 5 / 4;
   json_events_str_ptr->data().reserve(kReserveCapacity);
+  bool keep[TraceBufferChunk::kTraceBufferChunkSize];
   while (const TraceBufferChunk* chunk = logged_events->NextChunk()) {
+    if (batch_filter)
+      batch_filter->FilterChunk(*chunk, keep);
     for (size_t j = 0; j < chunk->size(); ++j) {
+      if (batch_filter && !keep[j])
+        continue;
       size_t size = json_events_str_ptr->size();
       if (size > kTraceEventBufferSizeInBytes) {
         flush_output_callback.Run(json_events_str_ptr, true);
         json_events_str_ptr = new RefCountedString();
         json_events_str_ptr->data().reserve(kReserveCapacity);
-      } else if (size) {
+      } else if (size && !binary_writer) {
         json_events_str_ptr->data().append(",\n");
       }
-      chunk->GetEventAt(j)->AppendAsJSON(&(json_events_str_ptr->data()),
-                                         argument_filter_predicate);
+      const TraceEvent* event = chunk->GetEventAt(j);
+      if (binary_writer) {
+        binary_writer->AppendEvent(*event, &(json_events_str_ptr->data()));
+      } else {
+        event->AppendAsJSON(&(json_events_str_ptr->data()),
+                            argument_filter_predicate);
+      }
     }
   }
   flush_output_callback.Run(json_events_str_ptr, false);
@@ -933,6 +1020,7 @@ void TraceLog::FinishFlush(int generation, bool discard_events) {
   std::unique_ptr<TraceBuffer> previous_logged_events;
   OutputCallback flush_output_callback;
   ArgumentFilterPredicate argument_filter_predicate;
+  scoped_refptr<TraceEventBatchFilter> batch_filter;
 
   if (!CheckGeneration(generation))
     return;
@@ -942,9 +1030,7 @@ void TraceLog::FinishFlush(int generation, bool discard_events) {
 
     previous_logged_events.swap(logged_events_);
     UseNextTraceBuffer();
-    thread_message_loops_.clear();
 
-    flush_task_runner_ = nullptr;
     flush_output_callback = flush_output_callback_;
     flush_output_callback_.Reset();
 
@@ -952,6 +1038,7 @@ void TraceLog::FinishFlush(int generation, bool discard_events) {
       CHECK(!argument_filter_predicate_.is_null());
       argument_filter_predicate = argument_filter_predicate_;
     }
+    batch_filter = batch_filter_;
   }
 
   if (discard_events) {
@@ -969,65 +1056,14 @@ void TraceLog::FinishFlush(int generation, bool discard_events) {
          TaskShutdownBehavior::CONTINUE_ON_SHUTDOWN},
         BindOnce(&TraceLog::ConvertTraceEventsToTraceFormat,
                  std::move(previous_logged_events), flush_output_callback,
-                 argument_filter_predicate));
+                 argument_filter_predicate, std::move(batch_filter),
+                 flush_format_));
     return;
   }
 
-  ConvertTraceEventsToTraceFormat(std::move(previous_logged_events),
-                                  flush_output_callback,
-                                  argument_filter_predicate);
-}
-
-// Run in each thread holding a local event buffer.
-void TraceLog::FlushCurrentThread(int generation, bool discard_events) {
-  {
-    AutoLock lock(lock_);
-    if (!CheckGeneration(generation) || !flush_task_runner_) {
-      // This is late. The corresponding flush has finished.
-      return;
-    }
-  }
-
-  // This will flush the thread local buffer.
-  delete thread_local_event_buffer_.Get();
-
-  // Scheduler uses TRACE_EVENT macros when posting a task, which can lead
-  // to acquiring a tracing lock. Given that posting a task requires grabbing
-  // a scheduler lock, we need to post this task outside tracing lock to avoid
-  // deadlocks.
-  scoped_refptr<SequencedTaskRunner> cached_flush_task_runner;
-  {
-    AutoLock lock(lock_);
-    cached_flush_task_runner = flush_task_runner_;
-    if (!CheckGeneration(generation) || !flush_task_runner_ ||
-        !thread_message_loops_.empty())
-      return;
-  }
-  cached_flush_task_runner->PostTask(
-      FROM_HERE, BindOnce(&TraceLog::FinishFlush, Unretained(this), generation,
-                          discard_events));
-}
-
-void TraceLog::OnFlushTimeout(int generation, bool discard_events) {
-  {
-    AutoLock lock(lock_);
-    if (!CheckGeneration(generation) || !flush_task_runner_) {
-      // Flush has finished before timeout.
-      return;
-    }
-
-    LOG(WARNING)
-        << "The following threads haven't finished flush in time. "
-           "If this happens stably for some thread, please call "
-           "TraceLog::GetInstance()->SetCurrentThreadBlocksMessageLoop() from "
-           "the thread to avoid its trace events from being lost.";
-    for (hash_set<MessageLoop*>::const_iterator it =
-             thread_message_loops_.begin();
-         it != thread_message_loops_.end(); ++it) {
-      LOG(WARNING) << "Thread: " << (*it)->GetThreadName();
-    }
-  }
-  FinishFlush(generation, discard_events);
+  ConvertTraceEventsToTraceFormat(
+      std::move(previous_logged_events), flush_output_callback,
+      argument_filter_predicate, std::move(batch_filter), flush_format_);
 }
 
 void TraceLog::UseNextTraceBuffer() {
@@ -1206,8 +1242,7 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
 
   ThreadLocalEventBuffer* thread_local_event_buffer = nullptr;
   if (*category_group_enabled & RECORDING_MODE) {
-    // |thread_local_event_buffer_| can be null if the current thread doesn't
-    // have a message loop or the message loop is blocked.
+    // |thread_local_event_buffer_| is null while the thread exits.
     InitializeThreadLocalEventBufferIfSupported();
     thread_local_event_buffer = thread_local_event_buffer_.Get();
   }
@@ -1299,16 +1334,28 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
 
   // If enabled for recording, the event should be added only if one of the
   // filters indicates or category is not enabled for filtering.
+  bool check_buffer_is_full = false;
   if ((*category_group_enabled & TraceCategory::ENABLED_FOR_RECORDING) &&
       !disabled_by_filters) {
+    // Held while the event is written so that Flush() on another thread
+    // doesn't take the chunk before the event is complete.
+    Optional<AutoLock> buffer_lock;
     OptionalAutoLock lock(&lock_);
 
     TraceEvent* trace_event = nullptr;
+    // The copied strings of the event live in its chunk.
+    TraceEventStringArena* string_arena = nullptr;
     if (thread_local_event_buffer) {
-      trace_event = thread_local_event_buffer->AddTraceEvent(&handle);
+      buffer_lock.emplace(thread_local_event_buffer->lock());
+      trace_event = thread_local_event_buffer->AddTraceEvent(
+          &handle, &check_buffer_is_full);
+      if (trace_event)
+        string_arena = thread_local_event_buffer->string_arena();
     } else {
       lock.EnsureAcquired();
       trace_event = AddEventToThreadSharedChunkWhileLocked(&handle, true);
+      if (trace_event)
+        string_arena = thread_shared_chunk_->string_arena();
     }
 
     if (trace_event) {
@@ -1318,7 +1365,8 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
         trace_event->Initialize(thread_id, offset_event_timestamp, thread_now,
                                 phase, category_group_enabled, name, scope, id,
                                 bind_id, num_args, arg_names, arg_types,
-                                arg_values, convertable_values, flags);
+                                arg_values, convertable_values, flags,
+                                string_arena);
       }
 
 #if defined(OS_ANDROID)
@@ -1333,6 +1381,13 @@ TraceEventHandle TraceLog::AddTraceEventWithThreadIdAndTimestamp(
     }
   }
 
+  // Not done while the buffer lock is held, since disabling the recording
+  // notifies observers which may flush.
+  if (check_buffer_is_full) {
+    AutoLock lock(lock_);
+    CheckIfBufferIsFullWhileLocked();
+  }
+
   if (!console_message.empty())
     LOG(ERROR) << console_message;
 
@@ -1483,6 +1538,9 @@ void TraceLog::UpdateTraceEventDurationExplicit(
       return;
     }
 
+    Optional<AutoLock> buffer_lock;
+    if (thread_local_event_buffer_.Get())
+      buffer_lock.emplace(thread_local_event_buffer_.Get()->lock());
     OptionalAutoLock lock(&lock_);
 
     TraceEvent* trace_event = GetEventByHandleInternal(handle, &lock);
@@ -1604,6 +1662,9 @@ void TraceLog::AddMetadataEventsWhileLocked() {
 }
 
 TraceEvent* TraceLog::GetEventByHandle(TraceEventHandle handle) {
+  Optional<AutoLock> buffer_lock;
+  if (thread_local_event_buffer_.Get())
+    buffer_lock.emplace(thread_local_event_buffer_.Get()->lock());
   return GetEventByHandleInternal(handle, nullptr);
 }
 
@@ -1616,6 +1677,7 @@ TraceEvent* TraceLog::GetEventByHandleInternal(TraceEventHandle handle,
   DCHECK(handle.chunk_index <= TraceBufferChunk::kMaxChunkIndex);
   DCHECK(handle.event_index <= TraceBufferChunk::kTraceBufferChunkSize - 1);
 
+  // The caller holds the lock of the current thread's buffer, if any.
   if (thread_local_event_buffer_.Get()) {
     TraceEvent* trace_event =
         thread_local_event_buffer_.Get()->GetEventByHandle(handle);
@@ -1681,14 +1743,20 @@ size_t TraceLog::GetObserverCountForTest() const {
 }
 
 void TraceLog::SetCurrentThreadBlocksMessageLoop() {
-  thread_blocks_message_loop_.Set(true);
-  // This will flush the thread local buffer.
-  delete thread_local_event_buffer_.Get();
+  // Flush() no longer runs tasks on the threads which have a local event
+  // buffer, so there is nothing to do.
 }
 
 TraceBuffer* TraceLog::CreateTraceBuffer() {
   HEAP_PROFILER_SCOPED_IGNORE;
   InternalTraceOptions options = trace_options();
+  if (stream_writer_) {
+    return TraceStreamWriter::CreateTraceBuffer(
+        std::move(stream_writer_),
+        options & kInternalEnableArgumentFilter ? argument_filter_predicate_
+                                                : ArgumentFilterPredicate(),
+        batch_filter_);
+  }
   if (options & kInternalRecordContinuously) {
     return TraceBuffer::CreateTraceBufferRingBuffer(
         kTraceEventRingBufferChunks);
@@ -1732,6 +1800,10 @@ void ConvertableToTraceFormat::EstimateTraceMemoryOverhead(
                 sizeof(*this));
 }
 
+bool ConvertableToTraceFormat::AppendAsProto(std::string* out) const {
+  return false;
+}
+
 void TraceLog::AddAsyncEnabledStateObserver(
     WeakPtr<AsyncEnabledStateObserver> listener) {
   AutoLock lock(lock_);
@@ -1756,6 +1828,20 @@ bool TraceLog::HasAsyncEnabledStateObserver(
 
 namespace trace_event_internal {
 
+bool SampleEvent(const unsigned char* category_group_enabled) {
+  // The state is the first field of the category, see TraceCategory.
+  using base::trace_event::TraceCategory;
+  TraceCategory* category = const_cast<TraceCategory*>(
+      TraceCategory::FromStatePtr(category_group_enabled));
+  if (category->sample_interval() > 1 && !category->TakeIntervalSample())
+    return false;
+  // The clock is only read for the events which passed the interval.
+  if (!category->max_events_per_second())
+    return true;
+  return category->TakeRateLimitedSample(static_cast<uint32_t>(
+      (TRACE_TIME_TICKS_NOW() - base::TimeTicks()).InSeconds()));
+}
+
 ScopedTraceBinaryEfficient::ScopedTraceBinaryEfficient(
     const char* category_group,
     const char* name) {
@@ -17,6 +17,10 @@
 #include "base/containers/stack.h"
 #include "base/gtest_prod_util.h"
 #include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/thread_local.h"
+#include "base/threading/thread_local_storage.h"
 #include "base/time/time_override.h"
 #include "base/trace_event/memory_dump_provider.h"
 #include "base/trace_event/trace_config.h"
@@ -25,7 +29,6 @@
 
 namespace base {
 
-class MessageLoop;
 class RefCountedString;
 
 template <typename T>
@@ -36,7 +39,9 @@ namespace trace_event {
 struct TraceCategory;
 class TraceBuffer;
 class TraceBufferChunk;
+class TraceStreamWriter;
 class TraceEvent;
+class TraceEventBatchFilter;
 class TraceEventFilter;
 class TraceEventMemoryOverhead;
 
@@ -69,7 +74,7 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   TraceConfig GetCurrentTraceConfig() const;
 
   // Initializes the thread-local event buffer, if not already initialized and
-  // if the current thread supports that (has a message loop).
+  // if the current thread isn't exiting.
   void InitializeThreadLocalEventBufferIfSupported();
 
   // See TraceConfig comments for details on how to control which categories
@@ -161,23 +166,42 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   void SetArgumentFilterPredicate(
       const ArgumentFilterPredicate& argument_filter_predicate);
 
+  enum class FlushFormat {
+    // Comma-separated JSON events, see TraceEvent::AppendAsJSON().
+    kJSON,
+    // The much more compact format of trace_event_binary_format.h, which
+    // ConvertBinaryTraceToJSON() converts offline.
+    kBinary,
+  };
+
   // Flush all collected events to the given output callback. The callback will
   // be called one or more times either synchronously or asynchronously from
   // the current thread with IPC-bite-size chunks. The string format is
   // undefined. Use TraceResultBuffer to convert one or more trace strings to
   // JSON. The callback can be null if the caller doesn't want any data.
-  // Due to the implementation of thread-local buffers, flush can't be
-  // done when tracing is enabled. If called when tracing is enabled, the
+  // The thread-local buffers of all threads are flushed synchronously, without
+  // running tasks on their threads. Flush can't be done when tracing is
+  // enabled. If called when tracing is enabled, the
   // callback will be called directly with (empty_string, false) to indicate
   // the end of this unsuccessful flush. Flush does the serialization
   // on the same thread if the caller doesn't set use_worker_thread explicitly.
+  // With FlushFormat::kBinary, the chunks are only meaningful once
+  // concatenated.
   typedef base::Callback<void(const scoped_refptr<base::RefCountedString>&,
                               bool has_more_events)> OutputCallback;
-  void Flush(const OutputCallback& cb, bool use_worker_thread = false);
+  void Flush(const OutputCallback& cb,
+             bool use_worker_thread = false,
+             FlushFormat format = FlushFormat::kJSON);
 
   // Cancels tracing and discards collected data.
   void CancelTracing(const OutputCallback& cb);
 
+  // Streams the events recorded from the next SetEnabled() with |writer| as
+  // their chunks fill up, instead of keeping them until Flush(). The next
+  // Flush() completes the stream, and its callback only gets an empty result.
+  // Must be called while recording is disabled.
+  void SetStreamingOutput(std::unique_ptr<TraceStreamWriter> writer);
+
   typedef void (*AddTraceEventOverrideCallback)(const TraceEvent&);
   // The callback will be called up until the point where the flush is
   // finished, i.e. must be callable until OutputCallback is called with
@@ -338,9 +362,9 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
 
   size_t GetObserverCountForTest() const;
 
-  // Call this method if the current thread may block the message loop to
-  // prevent the thread from using the thread-local buffer because the thread
-  // may not handle the flush request in time causing lost of unflushed events.
+  // Deprecated: Flush() doesn't depend on the message loops of the threads
+  // anymore, so the events of threads which block are no longer lost. This is
+  // a no-op.
   void SetCurrentThreadBlocksMessageLoop();
 
 #if defined(OS_WIN)
@@ -417,18 +441,19 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
 
   void FlushInternal(const OutputCallback& cb,
                      bool use_worker_thread,
+                     FlushFormat format,
                      bool discard_events);
 
-  // |generation| is used in the following callbacks to check if the callback
-  // is called for the flush of the current |logged_events_|.
-  void FlushCurrentThread(int generation, bool discard_events);
   // Usually it runs on a different thread.
   static void ConvertTraceEventsToTraceFormat(
       std::unique_ptr<TraceBuffer> logged_events,
       const TraceLog::OutputCallback& flush_output_callback,
-      const ArgumentFilterPredicate& argument_filter_predicate);
+      const ArgumentFilterPredicate& argument_filter_predicate,
+      scoped_refptr<TraceEventBatchFilter> batch_filter,
+      FlushFormat format);
+  // |generation| is used to check if the flush is for the current
+  // |logged_events_|.
   void FinishFlush(int generation, bool discard_events);
-  void OnFlushTimeout(int generation, bool discard_events);
 
   int generation() const {
     return static_cast<int>(subtle::NoBarrier_Load(&generation_));
@@ -496,28 +521,37 @@ class BASE_EXPORT TraceLog : public MemoryDumpProvider {
   TraceConfig::EventFilters enabled_event_filters_;
 
   ThreadLocalPointer<ThreadLocalEventBuffer> thread_local_event_buffer_;
-  ThreadLocalBoolean thread_blocks_message_loop_;
+  // Owns the thread-local buffers, and deletes them when their thread exits.
+  // |thread_local_event_buffer_| is used for the lookups since it can still
+  // be read while the TLS slots are destroyed.
+  ThreadLocalStorage::Slot thread_local_event_buffer_slot_;
+  ThreadLocalBoolean thread_is_exiting_;
   ThreadLocalBoolean thread_is_in_trace_event_;
 
-  // Contains the message loops of threads that have had at least one event
-  // added into the local event buffer. Not using SingleThreadTaskRunner
-  // because we need to know the life time of the message loops.
-  hash_set<MessageLoop*> thread_message_loops_;
+  // The buffers of all threads, which Flush() returns the chunks of. Acquired
+  // before the lock of a buffer, which is acquired before |lock_|.
+  Lock thread_local_event_buffers_lock_;
+  std::vector<ThreadLocalEventBuffer*> thread_local_event_buffers_;
 
   // For events which can't be added into the thread local buffer, e.g. events
-  // from threads without a message loop.
+  // from exiting threads and metadata events.
   std::unique_ptr<TraceBufferChunk> thread_shared_chunk_;
   size_t thread_shared_chunk_index_;
 
   // Set when asynchronous Flush is in progress.
   OutputCallback flush_output_callback_;
-  scoped_refptr<SequencedTaskRunner> flush_task_runner_;
   ArgumentFilterPredicate argument_filter_predicate_;
   subtle::AtomicWord generation_;
   bool use_worker_thread_;
+  FlushFormat flush_format_;
+  // Used by the next trace buffer, see SetStreamingOutput().
+  std::unique_ptr<TraceStreamWriter> stream_writer_;
   subtle::AtomicWord trace_event_override_;
 
   FilterFactoryForTesting filter_factory_for_testing_;
+  // Filters the events of the categories whose filters all filter at flush
+  // time, if any, see TraceEventBatchFilter.
+  scoped_refptr<TraceEventBatchFilter> batch_filter_;
 
   DISALLOW_COPY_AND_ASSIGN(TraceLog);
 };
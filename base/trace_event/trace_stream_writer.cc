@@ -0,0 +1,286 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_stream_writer.h"
+
+#include <utility>
+
+#include "base/logging.h"
+#include "base/trace_event/category_registry.h"
+#include "base/trace_event/heap_profiler.h"
+#include "base/trace_event/trace_buffer.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_batch_filter.h"
+#include "base/trace_event/trace_event_binary_format.h"
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+// Hands the chunks returned by TraceLog to a TraceStreamWriter instead of
+// keeping them. Since the events are gone once their chunk is returned, the
+// buffer is never full and its handles can't be resolved.
+class TraceBufferStreaming : public TraceBuffer {
+ public:
+  explicit TraceBufferStreaming(std::unique_ptr<TraceStreamWriter> writer)
+      : writer_(std::move(writer)),
+        next_chunk_index_(0),
+        next_chunk_seq_(1),
+        finished_(false) {}
+
+  ~TraceBufferStreaming() override { writer_->Finish(); }
+
+  std::unique_ptr<TraceBufferChunk> GetChunk(size_t* index) override {
+    HEAP_PROFILER_SCOPED_IGNORE;
+    *index = next_chunk_index_;
+    next_chunk_index_ =
+        (next_chunk_index_ + 1) % (TraceBufferChunk::kMaxChunkIndex + 1);
+
+    std::unique_ptr<TraceBufferChunk> chunk = writer_->TakeWrittenChunk();
+    if (chunk)
+      chunk->Reset(next_chunk_seq_++);
+    else
+      chunk.reset(new TraceBufferChunk(next_chunk_seq_++));
+    return chunk;
+  }
+
+  void ReturnChunk(size_t index,
+                   std::unique_ptr<TraceBufferChunk> chunk) override {
+    writer_->Write(std::move(chunk));
+  }
+
+  bool IsFull() const override { return false; }
+
+  size_t Size() const override {
+    return writer_->GetPendingChunkCount() *
+           TraceBufferChunk::kTraceBufferChunkSize;
+  }
+
+  size_t Capacity() const override {
+    return writer_->max_pending_chunks() *
+           TraceBufferChunk::kTraceBufferChunkSize;
+  }
+
+  TraceEvent* GetEventByHandle(TraceEventHandle handle) override {
+    return nullptr;
+  }
+
+  // The stream is finished by the first iteration, which is done by Flush()
+  // once every chunk was returned, so that the output is complete when the
+  // flush callback runs.
+  const TraceBufferChunk* NextChunk() override {
+    if (!finished_) {
+      finished_ = true;
+      writer_->Finish();
+    }
+    return nullptr;
+  }
+
+  void EstimateTraceMemoryOverhead(
+      TraceEventMemoryOverhead* overhead) override {
+    overhead->Add(TraceEventMemoryOverhead::kTraceBuffer,
+                  sizeof(*this) + sizeof(TraceStreamWriter) +
+                      writer_->GetPendingChunkCount() *
+                          sizeof(TraceBufferChunk));
+  }
+
+ private:
+  std::unique_ptr<TraceStreamWriter> writer_;
+  size_t next_chunk_index_;
+  uint32_t next_chunk_seq_;
+  bool finished_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceBufferStreaming);
+};
+
+}  // namespace
+
+// static
+constexpr size_t TraceStreamWriter::kDefaultMaxPendingChunks;
+
+TraceStreamWriter::TraceStreamWriter(File file,
+                                     TraceLog::FlushFormat format,
+                                     size_t max_pending_chunks)
+    : file_(std::move(file)),
+      format_(format),
+      max_pending_chunks_(max_pending_chunks),
+      pending_chunk_or_finish_(&lock_) {
+  DCHECK_GT(max_pending_chunks_, 0u);
+}
+
+TraceStreamWriter::~TraceStreamWriter() {
+  Finish();
+}
+
+// static
+TraceBuffer* TraceStreamWriter::CreateTraceBuffer(
+    std::unique_ptr<TraceStreamWriter> writer,
+    const ArgumentFilterPredicate& argument_filter_predicate,
+    scoped_refptr<TraceEventBatchFilter> batch_filter) {
+  // If the thread can't be started, every chunk is dropped and counted.
+  if (!writer->Start(argument_filter_predicate, std::move(batch_filter)))
+    DLOG(ERROR) << "Failed to start the trace stream writer";
+  return new TraceBufferStreaming(std::move(writer));
+}
+
+bool TraceStreamWriter::Start(
+    const ArgumentFilterPredicate& argument_filter_predicate,
+    scoped_refptr<TraceEventBatchFilter> batch_filter) {
+  argument_filter_predicate_ = argument_filter_predicate;
+  batch_filter_ = std::move(batch_filter);
+  AutoLock lock(lock_);
+  DCHECK(!started_);
+  if (finishing_ || !file_.IsValid())
+    return false;
+  started_ = PlatformThread::Create(0, this, &thread_handle_);
+  return started_;
+}
+
+void TraceStreamWriter::Write(std::unique_ptr<TraceBufferChunk> chunk) {
+  // Destroyed without |lock_|, if not reused.
+  std::unique_ptr<TraceBufferChunk> dropped_chunk;
+  AutoLock lock(lock_);
+  if (started_ && !finishing_ &&
+      pending_chunks_.size() < max_pending_chunks_) {
+    pending_chunks_.push_back(std::move(chunk));
+    pending_chunk_or_finish_.Signal();
+    return;
+  }
+
+  // Don't block the traced threads when the writer is behind.
+  stats_.chunks_dropped++;
+  stats_.events_dropped += chunk->size();
+  if (written_chunks_.size() < max_pending_chunks_)
+    written_chunks_.push_back(std::move(chunk));
+  else
+    dropped_chunk = std::move(chunk);
+}
+
+std::unique_ptr<TraceBufferChunk> TraceStreamWriter::TakeWrittenChunk() {
+  AutoLock lock(lock_);
+  if (written_chunks_.empty())
+    return nullptr;
+  std::unique_ptr<TraceBufferChunk> chunk = std::move(written_chunks_.back());
+  written_chunks_.pop_back();
+  return chunk;
+}
+
+void TraceStreamWriter::Finish() {
+  {
+    AutoLock lock(lock_);
+    finishing_ = true;
+    if (!started_)
+      return;
+    started_ = false;
+    pending_chunk_or_finish_.Signal();
+  }
+  PlatformThread::Join(thread_handle_);
+
+  const Stats stats = GetStats();
+  LOG_IF(WARNING, stats.events_dropped)
+      << "The trace stream dropped " << stats.events_dropped << " events";
+}
+
+TraceStreamWriter::Stats TraceStreamWriter::GetStats() const {
+  AutoLock lock(lock_);
+  return stats_;
+}
+
+size_t TraceStreamWriter::GetPendingChunkCount() const {
+  AutoLock lock(lock_);
+  return pending_chunks_.size();
+}
+
+void TraceStreamWriter::ThreadMain() {
+  // Nothing on this thread may add trace events: the streaming TraceBuffer
+  // can finish the stream while holding TraceLog's lock.
+  PlatformThread::SetName("TraceStreamWriter");
+  if (format_ == TraceLog::FlushFormat::kBinary) {
+    binary_writer_.reset(
+        new TraceEventBinaryWriter(argument_filter_predicate_));
+  } else {
+    output_ = "[";
+  }
+
+  while (true) {
+    std::unique_ptr<TraceBufferChunk> chunk;
+    {
+      AutoLock lock(lock_);
+      while (pending_chunks_.empty() && !finishing_)
+        pending_chunk_or_finish_.Wait();
+      if (pending_chunks_.empty())
+        break;
+      chunk = std::move(pending_chunks_.front());
+      pending_chunks_.pop_front();
+    }
+
+    WriteChunk(*chunk);
+    // Releases the arguments and copied strings of the events here rather
+    // than on the traced thread which reuses the chunk.
+    chunk->Reset(0);
+
+    AutoLock lock(lock_);
+    stats_.chunks_written++;
+    if (written_chunks_.size() < max_pending_chunks_)
+      written_chunks_.push_back(std::move(chunk));
+  }
+
+  WriteEnd();
+}
+
+void TraceStreamWriter::WriteChunk(const TraceBufferChunk& chunk) {
+  bool keep[TraceBufferChunk::kTraceBufferChunkSize];
+  if (batch_filter_)
+    batch_filter_->FilterChunk(chunk, keep);
+  for (size_t i = 0; i < chunk.size(); ++i) {
+    if (!batch_filter_ || keep[i])
+      AppendEvent(*chunk.GetEventAt(i));
+  }
+  WriteOutput();
+}
+
+void TraceStreamWriter::WriteEnd() {
+  const Stats stats = GetStats();
+  const char* arg_names[] = {"chunks_dropped", "events_dropped"};
+  const unsigned char arg_types[] = {TRACE_VALUE_TYPE_UINT,
+                                     TRACE_VALUE_TYPE_UINT};
+  const unsigned long long arg_values[] = {stats.chunks_dropped,
+                                           stats.events_dropped};
+  TraceEvent event;
+  event.Initialize(static_cast<int>(PlatformThread::CurrentId()), TimeTicks(),
+                   ThreadTicks(), TRACE_EVENT_PHASE_METADATA,
+                   CategoryRegistry::kCategoryMetadata->state_ptr(),
+                   "trace_stream", trace_event_internal::kGlobalScope,
+                   trace_event_internal::kNoId, trace_event_internal::kNoId,
+                   arraysize(arg_names), arg_names, arg_types, arg_values,
+                   nullptr, TRACE_EVENT_FLAG_NONE);
+  AppendEvent(event);
+  if (format_ == TraceLog::FlushFormat::kJSON)
+    output_ += "]\n";
+  WriteOutput();
+}
+
+void TraceStreamWriter::AppendEvent(const TraceEvent& event) {
+  if (binary_writer_) {
+    binary_writer_->AppendEvent(event, &output_);
+    return;
+  }
+  if (wrote_event_)
+    output_ += ",\n";
+  event.AppendAsJSON(&output_, argument_filter_predicate_);
+  wrote_event_ = true;
+}
+
+void TraceStreamWriter::WriteOutput() {
+  if (output_.empty())
+    return;
+  const int size = static_cast<int>(output_.size());
+  if (file_.WriteAtCurrentPos(output_.data(), size) != size)
+    DPLOG(ERROR) << "Failed to write the trace stream";
+  output_.clear();
+}
+
+}  // namespace trace_event
+}  // namespace base
@@ -0,0 +1,120 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef BASE_TRACE_EVENT_TRACE_STREAM_WRITER_H_
+#define BASE_TRACE_EVENT_TRACE_STREAM_WRITER_H_
+
+#include <stddef.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "base/base_export.h"
+#include "base/containers/circular_deque.h"
+#include "base/files/file.h"
+#include "base/macros.h"
+#include "base/memory/ref_counted.h"
+#include "base/synchronization/condition_variable.h"
+#include "base/synchronization/lock.h"
+#include "base/threading/platform_thread.h"
+#include "base/trace_event/trace_event_impl.h"
+#include "base/trace_event/trace_log.h"
+
+namespace base {
+namespace trace_event {
+
+class TraceBuffer;
+class TraceBufferChunk;
+class TraceEventBatchFilter;
+class TraceEventBinaryWriter;
+
+// Writes the chunks of a trace to a file on a background thread while
+// tracing is running, so that a long trace neither needs unbounded memory nor
+// loses its beginning like a RECORD_CONTINUOUSLY one. See
+// TraceLog::SetStreamingOutput().
+//
+// The output is the same as the concatenated output of a Flush() in |format|,
+// in brackets for FlushFormat::kJSON so that the file is a JSON trace. When
+// the writer can't keep up, full chunks are dropped rather than blocking the
+// traced threads; the last event of the stream is a "trace_stream" metadata
+// event with the number of dropped events.
+class BASE_EXPORT TraceStreamWriter : public PlatformThread::Delegate {
+ public:
+  struct Stats {
+    size_t chunks_written = 0;
+    size_t chunks_dropped = 0;
+    size_t events_dropped = 0;
+  };
+
+  // At most |max_pending_chunks| chunks wait for the writer thread.
+  TraceStreamWriter(File file,
+                    TraceLog::FlushFormat format,
+                    size_t max_pending_chunks);
+  ~TraceStreamWriter() override;
+
+  // Returns a TraceBuffer which hands the chunks returned to it to |writer|,
+  // and finishes the stream once it has been flushed.
+  static TraceBuffer* CreateTraceBuffer(
+      std::unique_ptr<TraceStreamWriter> writer,
+      const ArgumentFilterPredicate& argument_filter_predicate,
+      scoped_refptr<TraceEventBatchFilter> batch_filter);
+
+  // Starts the writer thread. Returns false if it couldn't be created. The
+  // events are filtered by |batch_filter|, if not null, before being written.
+  bool Start(const ArgumentFilterPredicate& argument_filter_predicate,
+             scoped_refptr<TraceEventBatchFilter> batch_filter);
+
+  // Queues |chunk| to be written, or drops it if the writer thread is behind.
+  void Write(std::unique_ptr<TraceBufferChunk> chunk);
+
+  // Returns a chunk which was written, to be reused, or null.
+  std::unique_ptr<TraceBufferChunk> TakeWrittenChunk();
+
+  // Writes the pending chunks and the end of the stream, then stops the
+  // writer thread. Chunks passed to Write() afterwards are dropped.
+  void Finish();
+
+  Stats GetStats() const;
+  size_t GetPendingChunkCount() const;
+  size_t max_pending_chunks() const { return max_pending_chunks_; }
+
+  // PlatformThread::Delegate:
+  void ThreadMain() override;
+
+  static constexpr size_t kDefaultMaxPendingChunks = 256;
+
+ private:
+  void WriteChunk(const TraceBufferChunk& chunk);
+  void WriteEnd();
+  void AppendEvent(const TraceEvent& event);
+  void WriteOutput();
+
+  File file_;
+  const TraceLog::FlushFormat format_;
+  const size_t max_pending_chunks_;
+  PlatformThreadHandle thread_handle_;
+
+  // Only used on the writer thread once it started.
+  ArgumentFilterPredicate argument_filter_predicate_;
+  scoped_refptr<TraceEventBatchFilter> batch_filter_;
+  std::unique_ptr<TraceEventBinaryWriter> binary_writer_;
+  std::string output_;
+  bool wrote_event_ = false;
+
+  mutable Lock lock_;
+  ConditionVariable pending_chunk_or_finish_;
+  circular_deque<std::unique_ptr<TraceBufferChunk>> pending_chunks_;
+  std::vector<std::unique_ptr<TraceBufferChunk>> written_chunks_;
+  bool started_ = false;
+  bool finishing_ = false;
+  Stats stats_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceStreamWriter);
+};
+
+}  // namespace trace_event
+}  // namespace base
+
+#endif  // BASE_TRACE_EVENT_TRACE_STREAM_WRITER_H_
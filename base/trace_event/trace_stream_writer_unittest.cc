@@ -0,0 +1,254 @@
+// Copyright 2018 The Chromium Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "base/trace_event/trace_stream_writer.h"
+
+#include <memory>
+#include <string>
+
+#include "base/at_exit.h"
+#include "base/bind.h"
+#include "base/files/file_path.h"
+#include "base/files/file_util.h"
+#include "base/files/scoped_temp_dir.h"
+#include "base/json/json_reader.h"
+#include "base/memory/ref_counted_memory.h"
+#include "base/threading/platform_thread.h"
+#include "base/threading/simple_thread.h"
+#include "base/time/time.h"
+#include "base/trace_event/trace_event.h"
+#include "base/trace_event/trace_event_binary_format.h"
+#include "base/values.h"
+#include "build/build_config.h"
+#include "testing/gtest/include/gtest/gtest.h"
+
+#if defined(OS_POSIX)
+#include <unistd.h>
+
+#include "base/posix/eintr_wrapper.h"
+#endif
+
+namespace base {
+namespace trace_event {
+
+namespace {
+
+constexpr int kNumEvents = 20000;
+
+// The counts of a streamed trace.
+struct StreamedEvents {
+  int events = 0;
+  int next_i = 0;
+  bool in_order = true;
+  const Value* stream_args = nullptr;
+};
+
+class TraceStreamWriterTest : public testing::Test {
+ public:
+  void SetUp() override { TraceLog::ResetForTesting(); }
+  void TearDown() override { TraceLog::ResetForTesting(); }
+
+ protected:
+  void StartStreaming(File file,
+                      TraceLog::FlushFormat format,
+                      size_t max_pending_chunks) {
+    TraceLog::GetInstance()->SetStreamingOutput(
+        std::make_unique<TraceStreamWriter>(std::move(file), format,
+                                            max_pending_chunks));
+    TraceLog::GetInstance()->SetEnabled(TraceConfig("cat", ""),
+                                        TraceLog::RECORDING_MODE);
+  }
+
+  void AddEvents() {
+    for (int i = 0; i < kNumEvents; ++i) {
+      TRACE_EVENT_INSTANT1("cat", "event", TRACE_EVENT_SCOPE_THREAD, "i", i);
+    }
+  }
+
+  // Stops tracing and checks that the flush callback isn't passed the events,
+  // which were streamed.
+  void StopStreaming() {
+    TraceLog::GetInstance()->SetDisabled();
+    std::string flushed;
+    bool done = false;
+    TraceLog::GetInstance()->Flush(
+        BindRepeating(
+            [](std::string* flushed, bool* done,
+               const scoped_refptr<RefCountedString>& chunk,
+               bool has_more_events) {
+              flushed->append(chunk->data());
+              *done = !has_more_events;
+            },
+            &flushed, &done));
+    EXPECT_TRUE(done);
+    EXPECT_TRUE(flushed.empty());
+  }
+
+  // Parses the JSON array |json| into |result|.
+  void ParseStream(const std::string& json, StreamedEvents* result) {
+    events_ = JSONReader::Read(json);
+    ASSERT_TRUE(events_);
+    ASSERT_TRUE(events_->is_list());
+    for (const Value& event : events_->GetList()) {
+      const Value* name = event.FindKey("name");
+      ASSERT_TRUE(name);
+      if (name->GetString() == "trace_stream") {
+        result->stream_args = event.FindKey("args");
+        continue;
+      }
+      if (name->GetString() != "event")
+        continue;
+      const Value* i =
+          event.FindPathOfType({"args", "i"}, Value::Type::INTEGER);
+      ASSERT_TRUE(i);
+      if (i->GetInt() < result->next_i)
+        result->in_order = false;
+      result->next_i = i->GetInt() + 1;
+      result->events++;
+    }
+    ASSERT_TRUE(result->stream_args);
+  }
+
+ private:
+  std::unique_ptr<Value> events_;
+  ShadowingAtExitManager at_exit_manager_;
+};
+
+int GetIntArg(const Value* args, const char* name) {
+  const Value* value = args->FindKeyOfType(name, Value::Type::INTEGER);
+  return value ? value->GetInt() : -1;
+}
+
+#if defined(OS_POSIX)
+// Drains a pipe until its write end is closed.
+class PipeReader : public DelegateSimpleThread::Delegate {
+ public:
+  explicit PipeReader(int fd) : fd_(fd) {}
+
+  void Run() override {
+    char buffer[4096];
+    ssize_t size;
+    while ((size = HANDLE_EINTR(read(fd_, buffer, sizeof(buffer)))) > 0)
+      data_.append(buffer, size);
+  }
+
+  const std::string& data() const { return data_; }
+
+ private:
+  const int fd_;
+  std::string data_;
+
+  DISALLOW_COPY_AND_ASSIGN(PipeReader);
+};
+#endif  // defined(OS_POSIX)
+
+}  // namespace
+
+TEST_F(TraceStreamWriterTest, StreamsWhileTracing) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const FilePath path = temp_dir.GetPath().AppendASCII("trace.json");
+  StartStreaming(File(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE),
+                 TraceLog::FlushFormat::kJSON,
+                 TraceStreamWriter::kDefaultMaxPendingChunks);
+  AddEvents();
+
+  // The full chunks are written before tracing stops.
+  int64_t size = 0;
+  for (int i = 0; i < 1000 && size == 0; ++i) {
+    PlatformThread::Sleep(TimeDelta::FromMilliseconds(10));
+    ASSERT_TRUE(GetFileSize(path, &size));
+  }
+  EXPECT_GT(size, 0);
+
+  StopStreaming();
+  std::string json;
+  ASSERT_TRUE(ReadFileToString(path, &json));
+  StreamedEvents streamed;
+  ParseStream(json, &streamed);
+  EXPECT_EQ(kNumEvents, streamed.events);
+  EXPECT_TRUE(streamed.in_order);
+  EXPECT_EQ(0, GetIntArg(streamed.stream_args, "chunks_dropped"));
+  EXPECT_EQ(0, GetIntArg(streamed.stream_args, "events_dropped"));
+}
+
+TEST_F(TraceStreamWriterTest, BinaryFormat) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const FilePath path = temp_dir.GetPath().AppendASCII("trace.pb");
+  StartStreaming(File(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE),
+                 TraceLog::FlushFormat::kBinary,
+                 TraceStreamWriter::kDefaultMaxPendingChunks);
+  AddEvents();
+  StopStreaming();
+
+  std::string binary;
+  ASSERT_TRUE(ReadFileToString(path, &binary));
+  std::string json;
+  ASSERT_TRUE(ConvertBinaryTraceToJSON(binary, &json));
+  StreamedEvents streamed;
+  ParseStream("[" + json + "]", &streamed);
+  EXPECT_EQ(kNumEvents, streamed.events);
+  EXPECT_TRUE(streamed.in_order);
+  EXPECT_EQ(0, GetIntArg(streamed.stream_args, "events_dropped"));
+}
+
+#if defined(OS_POSIX)
+// The writer thread blocks on a pipe nobody reads, so that the traced thread
+// has to drop chunks instead of waiting for it.
+TEST_F(TraceStreamWriterTest, DropsChunksWhenBehind) {
+  int fds[2];
+  ASSERT_EQ(0, pipe(fds));
+  StartStreaming(File(fds[1]), TraceLog::FlushFormat::kJSON, 2);
+  AddEvents();
+
+  PipeReader reader(fds[0]);
+  DelegateSimpleThread reader_thread(&reader, "PipeReader");
+  reader_thread.Start();
+  StopStreaming();
+  // The writer closed the pipe when the stream ended.
+  reader_thread.Join();
+  IGNORE_EINTR(close(fds[0]));
+
+  StreamedEvents streamed;
+  ParseStream(reader.data(), &streamed);
+  EXPECT_TRUE(streamed.in_order);
+  const int events_dropped =
+      GetIntArg(streamed.stream_args, "events_dropped");
+  EXPECT_GT(events_dropped, 0);
+  EXPECT_GT(GetIntArg(streamed.stream_args, "chunks_dropped"), 0);
+  EXPECT_LT(streamed.events, kNumEvents);
+  // Metadata events may have been dropped too.
+  EXPECT_GE(streamed.events + events_dropped, kNumEvents);
+}
+#endif  // defined(OS_POSIX)
+
+TEST_F(TraceStreamWriterTest, CancelTracingFinishesStream) {
+  ScopedTempDir temp_dir;
+  ASSERT_TRUE(temp_dir.CreateUniqueTempDir());
+  const FilePath path = temp_dir.GetPath().AppendASCII("trace.json");
+  StartStreaming(File(path, File::FLAG_CREATE_ALWAYS | File::FLAG_WRITE),
+                 TraceLog::FlushFormat::kJSON,
+                 TraceStreamWriter::kDefaultMaxPendingChunks);
+  AddEvents();
+  TraceLog::GetInstance()->CancelTracing(TraceLog::OutputCallback());
+
+  std::string json;
+  ASSERT_TRUE(ReadFileToString(path, &json));
+  StreamedEvents streamed;
+  ParseStream(json, &streamed);
+  EXPECT_EQ(kNumEvents, streamed.events);
+
+  // The next trace isn't streamed.
+  TraceLog::GetInstance()->SetEnabled(TraceConfig("cat", ""),
+                                      TraceLog::RECORDING_MODE);
+  TRACE_EVENT_INSTANT0("cat", "event", TRACE_EVENT_SCOPE_THREAD);
+  TraceLog::GetInstance()->SetDisabled();
+  int64_t size = 0;
+  ASSERT_TRUE(GetFileSize(path, &size));
+  EXPECT_EQ(static_cast<int64_t>(json.size()), size);
+}
+
+}  // namespace trace_event
+}  // namespace base